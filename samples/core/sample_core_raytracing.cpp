@@ -30,7 +30,7 @@ int main(int argc, char* args[])
     auto triangles = mesh.TriangleSoup();
 
 
-    AccelerationStructure::ObjectMedianBVH bf(triangles);
+    AccelerationStructure::SAHBVH bvh(triangles);
 
     std::cout << "Num triangles = " << triangles.size() << std::endl;
 
@@ -39,22 +39,28 @@ int main(int argc, char* args[])
 
     {
         SAIGA_BLOCK_TIMER();
-#pragma omp parallel for
+
+        // Row major order -> the rays of a packet are neighbouring pixels
+        std::vector<Ray> rays;
+        rays.reserve(w * h);
         for (int i = 0; i < h; ++i)
         {
             for (int j = 0; j < w; ++j)
             {
-                img(i, j) = ucvec3(255, 0, 0);
-
                 //                vec3 dir = camera.inverseprojectToWorldSpace(vec2(j, i), 1, w, h);
                 //                Ray ray(normalize(dir), camera.getPosition());
-                Ray ray = camera.PixelRay(vec2(j, i), w, h, false);
+                rays.push_back(camera.PixelRay(vec2(j, i), w, h, false));
+            }
+        }
+
+        auto inters = bvh.getClosest(rays);
 
-                auto inter = bf.getClosest(ray);
-                if (inter && !inter.backFace)
-                {
-                    img(i, j) = ucvec3(0, 255, 0);
-                }
+        for (int i = 0; i < h; ++i)
+        {
+            for (int j = 0; j < w; ++j)
+            {
+                auto& inter = inters[i * w + j];
+                img(i, j)   = (inter && !inter.backFace) ? ucvec3(0, 255, 0) : ucvec3(255, 0, 0);
             }
         }
     }
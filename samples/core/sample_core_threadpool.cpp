@@ -5,7 +5,9 @@
  */
 
 #include "saiga/core/Core.h"
+#include "saiga/core/time/performanceMeasure.h"
 #include "saiga/core/util/Thread/SpinLock.h"
+#include "saiga/core/util/table.h"
 
 #include <chrono>
 
@@ -50,6 +52,81 @@ void testRingBuffer()
     pipeline.stop();
 }
 
+// Measures how many tiny tasks per second the schedulers can process.
+void benchmarkTaskThroughput(int threads)
+{
+    const int N    = 200000;
+    const int its  = 5;
+    auto tiny_task = [](std::atomic<int>& counter) { counter.fetch_add(1, std::memory_order_relaxed); };
+
+    Table table({35, 15, 15});
+    table << "Scheduler"
+          << "Time (ms)"
+          << "MTasks/s";
+    auto print = [&](const std::string& name, const Statistics<float>& st) {
+        table << name << st.median << (N / (st.median * 1000.0f));
+    };
+
+    for (auto scheduler : {ThreadPoolScheduler::CentralQueue, ThreadPoolScheduler::WorkStealing})
+    {
+        ThreadPool pool(threads, "Bench", scheduler);
+        std::atomic<int> counter;
+        std::vector<std::future<void>> futures(N);
+        auto st = measureObject(its, [&]() {
+            counter = 0;
+            for (int i = 0; i < N; ++i)
+            {
+                futures[i] = pool.enqueue([&]() { tiny_task(counter); });
+            }
+            for (auto& f : futures) f.wait();
+        });
+        SAIGA_ASSERT(counter == N);
+        print(scheduler == ThreadPoolScheduler::CentralQueue ? "ThreadPool::enqueue (Queue)"
+                                                             : "ThreadPool::enqueue (WorkStealing)",
+              st);
+    }
+
+    WorkStealingScheduler ws(threads, "Bench");
+    {
+        std::atomic<int> counter;
+        auto st = measureObject(its, [&]() {
+            counter = 0;
+            TaskGroup group(ws);
+            for (int i = 0; i < N; ++i)
+            {
+                group.run([&]() { tiny_task(counter); });
+            }
+            group.wait();
+        });
+        SAIGA_ASSERT(counter == N);
+        print("TaskGroup::run", st);
+    }
+
+    {
+        std::atomic<int> counter;
+        auto st = measureObject(its, [&]() {
+            counter = 0;
+            ws.parallel_for(0, N, [&](int) { tiny_task(counter); }, 1);
+        });
+        SAIGA_ASSERT(counter == N);
+        print("parallel_for (grain 1)", st);
+    }
+
+    {
+        std::atomic<int> counter;
+        auto st = measureObject(its, [&]() {
+            counter = 0;
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+            for (int i = 0; i < N; ++i)
+            {
+                tiny_task(counter);
+            }
+        });
+        SAIGA_ASSERT(counter == N);
+        print("OpenMP (dynamic, 1)", st);
+    }
+}
+
 int main(int argc, char* argv[])
 {
     SynchronizedBuffer<int> buffer(5);
@@ -96,5 +173,7 @@ int main(int argc, char* argv[])
     f.wait();
 
     std::cout << "Done." << std::endl;
+
+    benchmarkTaskThroughput(std::max(1u, std::thread::hardware_concurrency()));
     return 0;
 }
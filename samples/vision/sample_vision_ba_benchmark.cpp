@@ -18,6 +18,11 @@
 #include "saiga/vision/scene/SynteticScene.h"
 
 #include <fstream>
+#ifdef __linux__
+#    include <sys/resource.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
 
 const std::string balPrefix = "vision/bal/";
 
@@ -164,6 +169,147 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
     }
 }
 
+// Double vs. mixed precision normal equations in the recursive solver
+void test_precision(const OptimizationOptions& baoptions, const Scene& scene, int its)
+{
+    Saiga::Table table({20, 15, 15, 15});
+    table << "Precision"
+          << "Final Error"
+          << "Time_LS"
+          << "Time_Total";
+
+    for (int refinement = -1; refinement < 2; ++refinement)
+    {
+        BARec ba;
+        ba.optimizationOptions = baoptions;
+        if (refinement >= 0)
+        {
+            ba.baOptions.precision             = BAOptions::Precision::Mixed;
+            ba.baOptions.refinement_iterations = refinement;
+        }
+
+        std::vector<double> times;
+        std::vector<double> timesl;
+        double chi2;
+        for (int i = 0; i < its; ++i)
+        {
+            Scene cpy = scene;
+            ba.create(cpy);
+            auto result = ba.initAndSolve();
+            chi2        = result.cost_final;
+            times.push_back(result.total_time);
+            timesl.push_back(result.linear_solver_time);
+        }
+
+        std::string name = refinement < 0 ? "Double" : "Mixed (ref " + std::to_string(refinement) + ")";
+        table << name << chi2 << Statistics(timesl).median << Statistics(times).median;
+    }
+}
+
+// Peak resident set size of this process in MB
+double peakRSS()
+{
+#ifdef __linux__
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#else
+    return 0;
+#endif
+}
+
+struct SchurResult
+{
+    double chi2          = 0;
+    double time_per_iter = 0;
+    double peak_rss      = 0;
+};
+
+// Runs one solver on one file. The peak RSS of a process never decreases, therefore every run is executed in a
+// forked child process which was created before any dataset was loaded.
+SchurResult run_schur(OptimizationOptions baoptions, const std::string& file, int mode, int its)
+{
+    auto run = [&]() {
+        Scene scene;
+        buildSceneBAL(scene, balPrefix + file);
+
+        BARec ba;
+        ba.optimizationOptions                    = baoptions;
+        ba.optimizationOptions.buildExplizitSchur = mode == 2;
+        ba.baOptions.matrix_free_schur            = mode == 0;
+
+        std::vector<double> times;
+        SchurResult res;
+        for (int i = 0; i < its; ++i)
+        {
+            Scene cpy = scene;
+            ba.create(cpy);
+            auto result = ba.initAndSolve();
+            res.chi2    = result.cost_final;
+            // LM may terminate early
+            times.push_back(result.total_time / std::max(result.iterations, 1));
+        }
+        res.time_per_iter = Statistics(times).median;
+        res.peak_rss      = peakRSS();
+        return res;
+    };
+
+#ifdef __linux__
+    int fd[2];
+    if (pipe(fd) != 0) return run();
+    pid_t pid = fork();
+    if (pid < 0) return run();
+    if (pid == 0)
+    {
+        close(fd[0]);
+        SchurResult res = run();
+        ssize_t written = write(fd[1], &res, sizeof(res));
+        close(fd[1]);
+        _exit(written == sizeof(res) ? 0 : 1);
+    }
+    close(fd[1]);
+    SchurResult res;
+    ssize_t n = read(fd[0], &res, sizeof(res));
+    close(fd[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (n != sizeof(res) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cerr << "Benchmark of " << file << " failed." << std::endl;
+        return {};
+    }
+    return res;
+#else
+    return run();
+#endif
+}
+
+// Explicit vs. implicit vs. matrix-free Schur complement on the BAL datasets.
+void test_schur(OptimizationOptions baoptions, int its)
+{
+    baoptions.solverType = OptimizationOptions::SolverType::Iterative;
+
+    Saiga::Table table({30, 15, 15, 15, 15});
+    table << "File"
+          << "Schur"
+          << "Final Error"
+          << "Time/It (ms)"
+          << "Peak RSS (MB)";
+
+    for (auto file : getBALFiles())
+    {
+        if (hasEnding(file, ".scene")) continue;
+
+        for (int mode = 0; mode < 3; ++mode)
+        {
+            auto res = run_schur(baoptions, file, mode, its);
+
+            const char* names[3] = {"Matrix Free", "Implicit", "Explicit"};
+            table << file << names[mode] << res.chi2 << res.time_per_iter << res.peak_rss;
+        }
+    }
+}
+
 
 int main(int, char**)
 {
@@ -193,6 +339,11 @@ int main(int, char**)
             baoptions.solverType = OptimizationOptions::SolverType::Direct;
             test_to_file(baoptions, "ba_benchmark_chol.csv", testIts);
         }
+        if (1)
+        {
+            baoptions.maxIterativeIterations = 25;
+            test_schur(baoptions, testIts);
+        }
         return 0;
     }
 #endif
@@ -296,5 +447,7 @@ int main(int, char**)
         std::cout << std::endl;
     }
 
+    test_precision(baoptions, scene, 5);
+
     return 0;
 }
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/scene/BALDataset.h"
+#include "saiga/vision/scene/SceneView.h"
+
+using namespace Saiga;
+
+// Converts a BAL dataset (http://grail.cs.washington.edu/projects/bal/) into the binary scene format.
+//
+// Usage: sample_vision_bal_convert problem-1723-156502-pre.txt problem-1723-156502.bscene
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+
+    if (argc != 3)
+    {
+        std::cout << "Usage: " << argv[0] << " <bal_file> <output_file>" << std::endl;
+        return 1;
+    }
+
+    Scene scene;
+    {
+        SAIGA_BLOCK_TIMER("Load BAL");
+        BALDataset bal(argv[1]);
+        scene = bal.makeScene();
+    }
+
+    {
+        SAIGA_BLOCK_TIMER("Save binary");
+        scene.saveBinary(argv[2]);
+    }
+
+    {
+        SAIGA_BLOCK_TIMER("Open view");
+        SceneView view(argv[2]);
+        SAIGA_ASSERT(view.isOpen());
+    }
+
+    Scene scene2;
+    {
+        SAIGA_BLOCK_TIMER("Load binary");
+        scene2.loadBinary(argv[2]);
+    }
+    std::cout << scene2 << std::endl;
+    return 0;
+}
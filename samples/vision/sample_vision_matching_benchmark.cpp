@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/features/HammingMatcher.h"
+#include "saiga/vision/features/MultiIndexHashing.h"
+
+using namespace Saiga;
+
+// Brute force ORB matching throughput in descriptor comparisons per second.
+//  - Reference: one distance() call per pair with a branching knn2 update (the old BruteForceMatcher)
+//  - HammingMatcher::Knn2 with every supported kernel on one thread and on all threads
+//  - HammingMatcher::Match with the fused ratio test and mutual check
+//  - Nearest neighbor and radius queries in a MultiIndexHashing index compared to brute force. The queries are noisy
+//    copies (< 32 bits) of indexed descriptors. The search cost grows quickly with the radius (2-NN queries for the
+//    ratio test are not much faster than brute force on random descriptors, because the second neighbor is far away).
+// Usage: sample_vision_matching_benchmark [num_query] [num_train] [index_size]
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+    Random::setSeed(2357);
+
+    int n   = argc > 1 ? atoi(argv[1]) : 2000;
+    int m          = argc > 2 ? atoi(argv[2]) : 2000;
+    int index_size = argc > 3 ? atoi(argv[3]) : 1000000;
+    int its        = 5;
+
+    std::vector<DescriptorORB> query(n), train(m);
+    for (auto& d : query)
+        for (auto& w : d) w = Random::urand64();
+    for (auto& d : train)
+        for (auto& w : d) w = Random::urand64();
+
+    std::vector<std::pair<int, int>> knn2(n * 2);
+
+    auto print = [&](const std::string& name, const Statistics<float>& st) {
+        std::cout << std::setw(24) << name << std::setw(10) << st.median << " ms " << std::setw(10)
+                  << double(n) * m / st.median / 1000 << " M comparisons/s" << std::endl;
+    };
+
+    std::cout << "Query " << n << " Train " << m << " Threads " << OMP::getMaxThreads() << std::endl;
+
+    auto reference = measureObject(its, [&]() {
+        for (int i = 0; i < n; ++i)
+        {
+            std::pair<int, int> best = {1000, -1}, second = best;
+            for (int j = 0; j < m; ++j)
+            {
+                int dis = distance(query[i], train[j]);
+                if (dis < best.first)
+                {
+                    second = best;
+                    best   = {dis, j};
+                }
+                else if (dis < second.first)
+                {
+                    second = {dis, j};
+                }
+            }
+            knn2[2 * i]     = best;
+            knn2[2 * i + 1] = second;
+        }
+    });
+    print("Reference", reference);
+
+    std::vector<std::pair<HammingKernel, std::string>> kernels = {
+        {HammingKernel::Scalar, "Scalar"}, {HammingKernel::AVX2, "AVX2"}, {HammingKernel::AVX512, "AVX512"}};
+    for (auto& k : kernels)
+    {
+        if (!HammingKernelSupported(k.first)) continue;
+        HammingMatcher matcher(k.first, 1);
+        std::vector<std::pair<int, int>> matches;
+        auto knn   = [&]() { matcher.Knn2(query, train, knn2.data()); };
+        auto match = [&]() { matcher.Match(query, train, 64, 0.8, true, matches); };
+
+        print(k.second + " Knn2", measureObject(its, knn));
+        print(k.second + " Match mutual", measureObject(its, match));
+        matcher.threads = OMP::getMaxThreads();
+        print(k.second + " Knn2 (all threads)", measureObject(its, knn));
+    }
+
+    {
+        std::vector<DescriptorORB> map(index_size);
+        for (auto& d : map)
+            for (auto& w : d) w = Random::urand64();
+        for (int i = 0; i < n; ++i)
+        {
+            query[i] = map[Random::uniformInt(0, index_size - 1)];
+            for (int f = Random::uniformInt(0, 31); f > 0; --f)
+            {
+                int bit = Random::uniformInt(0, 255);
+                query[i][bit / 64] ^= uint64_t(1) << (bit % 64);
+            }
+        }
+
+        MultiIndexHashing mih;
+        auto insert = measureObject(1, [&]() {
+            for (auto& d : map) mih.Insert(d);
+        });
+
+        std::vector<std::pair<int, int>> result;
+        auto nn = measureObject(its, [&]() {
+            for (auto& q : query) mih.KnnSearch(q, 1, result);
+        });
+        auto radius = measureObject(its, [&]() {
+            for (auto& q : query) mih.RadiusSearch(q, 31, result);
+        });
+
+        HammingMatcher matcher;
+        auto brute_force = measureObject(1, [&]() { matcher.Knn2(query, map, knn2.data()); });
+
+        auto print_queries = [&](const std::string& name, const Statistics<float>& st) {
+            std::cout << std::setw(24) << name << std::setw(10) << n / st.median * 1000 << " queries/s" << std::endl;
+        };
+        std::cout << "MultiIndexHashing with " << index_size << " descriptors (insert " << insert.median << " ms)"
+                  << std::endl;
+        print_queries("MIH 1-NN", nn);
+        print_queries("MIH radius 31", radius);
+        print_queries("Brute force 2-NN", brute_force);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/image/all.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+#include "saiga/vision/features/ORBExtractorAsync.h"
+
+using namespace Saiga;
+
+// Per frame time of the ORB extraction and its building blocks.
+// The pipelined ORBExtractorAsync is measured on a stream of 'its' frames.
+// Usage: sample_vision_orb_benchmark [image] [num_features] [threads]
+// Without an image, a synthetic 640x480 image with random rectangles is used.
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+    Random::setSeed(2358);
+
+    TemplatedImage<unsigned char> img;
+    if (argc > 1 && std::string(argv[1]) != "-")
+    {
+        img.load(argv[1]);
+    }
+    else
+    {
+        img.create(480, 640);
+        img.getImageView().set(100);
+        for (int r = 0; r < 300; ++r)
+        {
+            int y0 = Random::uniformInt(0, img.rows - 1), x0 = Random::uniformInt(0, img.cols - 1);
+            int h = Random::uniformInt(5, 80), w = Random::uniformInt(5, 80);
+            int c = Random::uniformInt(0, 255);
+            img.getImageView().subImageView(y0, x0, std::min(h, img.rows - y0), std::min(w, img.cols - x0)).set(c);
+        }
+    }
+    SAIGA_ASSERT(img.valid());
+
+    int num_features = argc > 2 ? atoi(argv[2]) : 1000;
+    int threads      = argc > 3 ? atoi(argv[3]) : 1;
+    int its          = 50;
+
+    std::cout << "Image " << img.cols << "x" << img.rows << " Features " << num_features << " Threads " << threads
+              << std::endl;
+
+    auto print = [](const std::string& name, float ms) {
+        std::cout << std::setw(20) << name << std::setw(10) << ms << " ms" << std::endl;
+    };
+
+    TemplatedImage<unsigned char> tmp(img.rows, img.cols);
+    TemplatedImage<unsigned char> small(iRound(img.rows / 1.2), iRound(img.cols / 1.2));
+
+    std::vector<KeyPoint<float>> keypoints;
+    FastDetector fast(20, true);
+    print("FAST", measureObject(its, [&]() {
+              keypoints.clear();
+              fast.Detect(img.getImageView(), keypoints);
+          }).median);
+    print("GaussianBlur", measureObject(its, [&]() {
+              ImageTransformation::GaussianBlur(img.getImageView(), tmp.getImageView(), 3, 2);
+          }).median);
+    print("ResizeLinear", measureObject(its, [&]() {
+              ImageTransformation::ResizeLinear(img.getImageView(), small.getImageView());
+          }).median);
+
+    ORBExtractor extractor(num_features, 1.2, 8, 20, 7, threads);
+    std::vector<DescriptorORB> descriptors;
+    print("ORBExtractor",
+          measureObject(its, [&]() { extractor.Detect(img.getImageView(), keypoints, descriptors); }).median);
+
+    ORBExtractorAsync extractor_async(num_features, 1.2, 8, 20, 7, threads);
+    auto stream = measureObject(5, [&]() {
+        std::vector<std::future<ORBExtractorAsync::Features>> frames;
+        for (int i = 0; i < its; ++i) frames.push_back(extractor_async.Detect(img.getImageView()));
+        for (auto& f : frames) f.get();
+    });
+    print("ORBExtractorAsync", stream.median / its);
+    std::cout << "Keypoints: " << keypoints.size() << std::endl;
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/reconstruction/FivePoint.h"
+#include "saiga/vision/reconstruction/Homography.h"
+#include "saiga/vision/reconstruction/P3P.h"
+#include "saiga/vision/util/Random.h"
+
+using namespace Saiga;
+
+// Throughput of the RANSAC estimators on synthetic data with 30% outliers.
+//  - Hypotheses/s: complete RANSAC iterations (model + scoring) on one thread
+//  - Scoring: residuals per second of computeResidual() (scalar) and computeResiduals() (SoA, vectorized)
+//  - Time of a complete solve() with all maxIterations and with adaptive termination + SPRT
+struct Data
+{
+    SE3 T;
+    std::vector<Vec3> wps;
+    std::vector<Vec2> points1, points2;
+
+    Data(int N, bool planar)
+    {
+        T = SE3(Sophus::SO3d::exp(Vec3(0.05, 0.1, -0.02)), Vec3(1, 0.1, 0.2));
+        for (int i = 0; i < N; ++i)
+        {
+            Vec3 wp(Random::sampleDouble(-2, 2), Random::sampleDouble(-2, 2), 4);
+            if (!planar) wp(2) = Random::sampleDouble(2, 6);
+
+            Vec2 p1 = wp.hnormalized() + Vec2(Random::gaussRand(0, 1e-3), Random::gaussRand(0, 1e-3));
+            Vec2 p2 = (T * wp).hnormalized() + Vec2(Random::gaussRand(0, 1e-3), Random::gaussRand(0, 1e-3));
+            if (Random::sampleDouble(0, 1) < 0.3) p2 = Vec2(Random::sampleDouble(-1, 1), Random::sampleDouble(-1, 1));
+            wps.push_back(wp);
+            points1.push_back(p1);
+            points2.push_back(p2);
+        }
+    }
+};
+
+template <typename Ransac, typename Model>
+void benchmarkScoring(const std::string& name, Ransac& ransac, const Model& model, int N)
+{
+    int its = 200;
+    std::vector<double> residuals(N);
+
+    auto scalar = measureObject(its, [&]() {
+        for (int i = 0; i < N; ++i) residuals[i] = ransac.computeResidual(model, i);
+    });
+    auto simd = measureObject(its, [&]() { ransac.computeResiduals(model, 0, N, residuals.data()); });
+
+    std::cout << std::setw(12) << name << " scoring  scalar " << std::setw(8) << N / scalar.median / 1000
+              << " M/s  simd " << std::setw(8) << N / simd.median / 1000 << " M/s" << std::endl;
+}
+
+void printHypotheses(const std::string& name, const Statistics<float>& st, int iterations, int inliers)
+{
+    std::cout << std::setw(12) << name << " ransac   " << std::setw(10) << iterations / st.median * 1000
+              << " hypotheses/s (inliers " << inliers << ")" << std::endl;
+}
+
+// solve(params) -> number of inliers
+template <typename Ransac, typename Solve>
+void benchmarkTermination(const std::string& name, RansacParameters params, Solve solve)
+{
+    int its = 5;
+    for (bool early : {false, true})
+    {
+        params.adaptive = early;
+        params.sprt     = early;
+        Ransac ransac(params);
+        int num_inliers = 0;
+        auto st         = measureObject(its, [&]() { num_inliers = solve(ransac); });
+        std::cout << std::setw(12) << name << (early ? " adaptive+sprt " : " fixed         ") << std::setw(8)
+                  << st.median << " ms  iterations " << std::setw(5) << ransac.Iterations() << "  inliers "
+                  << num_inliers << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+    Random::setSeed(3947563);
+
+    int N   = argc > 1 ? atoi(argv[1]) : 2000;
+    int its = 5;
+
+    RansacParameters params;
+    params.maxIterations     = 200;
+    params.residualThreshold = 4e-3 * 4e-3;
+    params.reserveN          = N;
+    params.threads           = 1;
+    // Measure the throughput of the complete iterations
+    params.adaptive = false;
+    params.sprt     = false;
+
+    std::cout << "Correspondences: " << N << std::endl;
+
+    {
+        Data data(N, false);
+        FivePointRansac ransac(params);
+        Mat3 E;
+        SE3 T;
+        std::vector<int> inliers;
+        std::vector<char> mask;
+        int num_inliers = 0;
+        auto st         = measureObject(its, [&]() {
+            num_inliers = ransac.solve(data.points1, data.points2, E, T, inliers, mask);
+        });
+        printHypotheses("FivePoint", st, ransac.Iterations(), num_inliers);
+        benchmarkScoring("FivePoint", ransac, std::make_pair(E, T), N);
+    }
+
+    {
+        Data data(N, true);
+        HomographyRansac ransac(params);
+        Mat3 H;
+        int num_inliers = 0;
+        auto st         = measureObject(its, [&]() { num_inliers = ransac.solve(data.points1, data.points2, H); });
+        printHypotheses("Homography", st, ransac.Iterations(), num_inliers);
+        benchmarkScoring("Homography", ransac, H, N);
+    }
+
+    {
+        Data data(N, false);
+        P3PRansac ransac(params);
+        SE3 T;
+        std::vector<int> inliers;
+        std::vector<char> mask;
+        int num_inliers = 0;
+        auto st         = measureObject(its, [&]() {
+            num_inliers = ransac.solve(data.wps, data.points2, T, inliers, mask);
+        });
+        printHypotheses("P3P", st, ransac.Iterations(), num_inliers);
+        benchmarkScoring("P3P", ransac, T, N);
+    }
+
+    params.maxIterations = 1000;
+    {
+        Data data(N, false);
+        benchmarkTermination<FivePointRansac>("FivePoint", params, [&](FivePointRansac& ransac) {
+            Mat3 E;
+            SE3 T;
+            std::vector<int> inliers;
+            std::vector<char> mask;
+            return ransac.solve(data.points1, data.points2, E, T, inliers, mask);
+        });
+    }
+    {
+        Data data(N, true);
+        benchmarkTermination<HomographyRansac>("Homography", params, [&](HomographyRansac& ransac) {
+            Mat3 H;
+            return ransac.solve(data.points1, data.points2, H);
+        });
+    }
+    {
+        Data data(N, false);
+        benchmarkTermination<P3PRansac>("P3P", params, [&](P3PRansac& ransac) {
+            SE3 T;
+            std::vector<int> inliers;
+            std::vector<char> mask;
+            return ransac.solve(data.wps, data.points2, T, inliers, mask);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/reconstruction/RobustPoseOptimization.h"
+#include "saiga/vision/util/Random.h"
+
+using namespace Saiga;
+
+// Throughput of the parallel robust pose optimization of many frames compared to one optimizePoseRobust() call per
+// frame. The frames are synthetic with 10% outliers and 30% stereo observations.
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+    Random::setSeed(93865023985);
+
+    int num_frames       = argc > 1 ? atoi(argv[1]) : 500;
+    int num_observations = argc > 2 ? atoi(argv[2]) : 300;
+    int its              = 5;
+
+    using T = double;
+    StereoCamera4Base<T> K(458.654, 457.296, 367.215, 248.375, 0, 50);
+
+    std::vector<PoseOptimizationScene<T>> scenes(num_frames);
+    for (auto& scene : scenes)
+    {
+        scene.K    = K;
+        scene.pose = Random::randomSE3();
+        for (int i = 0; i < num_observations; ++i)
+        {
+            ObsBase<T> o;
+            o.ip     = Vec2(Random::sampleDouble(0, K.cx * 2), Random::sampleDouble(0, K.cy * 2));
+            double d = Random::sampleDouble(1, 5);
+            Vec3 wp  = scene.pose.inverse() * K.unproject(o.ip, d);
+            o.ip += Vec2(Random::gaussRand(0, 0.5), Random::gaussRand(0, 0.5));
+            if (Random::sampleDouble(0, 1) < 0.3) o.depth = d;
+            if (Random::sampleDouble(0, 1) < 0.1) o.ip = Vec2(Random::sampleDouble(0, K.cx * 2), o.ip(1));
+            scene.obs.push_back(o);
+            scene.wps.push_back(wp);
+        }
+        scene.outlier.resize(scene.obs.size(), false);
+        scene.pose = Random::JitterPose(scene.pose, 0.04, 0.01);
+    }
+
+    RobustPoseOptimization<T, false> rpo;
+
+    std::vector<PoseOptimizationScene<T>> cpy;
+    long sum_single = 0;
+    auto single     = measureObject(
+        its,
+        [&]() {
+            for (auto& s : cpy) sum_single += rpo.optimizePoseRobust(s);
+        },
+        [&]() {
+            cpy        = scenes;
+            sum_single = 0;
+        });
+
+    std::vector<int> inliers;
+    auto measureBatch = [&](int threads) {
+        return measureObject(
+            its, [&]() { inliers = rpo.optimizePoseRobust(cpy, threads); }, [&]() { cpy = scenes; });
+    };
+    auto batch_1 = measureBatch(1);
+    auto batch_n = measureBatch(OMP::getMaxThreads());
+
+    long sum_batch = 0;
+    for (auto i : inliers) sum_batch += i;
+
+    std::cout << "Frames " << num_frames << " Observations/Frame " << num_observations << std::endl;
+    std::cout << "Inliers single/batch: " << sum_single << " / " << sum_batch << std::endl;
+
+    auto print = [&](const std::string& name, const Statistics<float>& st) {
+        std::cout << std::setw(20) << name << std::setw(10) << st.median << " ms " << std::setw(10)
+                  << num_frames / st.median * 1000 << " frames/s" << std::endl;
+    };
+    print("Single", single);
+    print("Batch (1 thread)", batch_1);
+    print("Batch (" + std::to_string(OMP::getMaxThreads()) + " threads)", batch_n);
+    return 0;
+}
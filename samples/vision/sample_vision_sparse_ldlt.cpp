@@ -432,6 +432,23 @@ class Sparse_LDLT_TEST
     }
 
 
+    auto solveEigenRecursiveSupernodalLDLT()
+    {
+        x.setZero();
+        using LDLT = Eigen::Recursive::RecursiveSupernodalLDLT<AType, Eigen::Lower>;
+        LDLT ldlt;
+        float time = 0;
+        {
+            Saiga::ScopedTimer<float> timer(time);
+            ldlt.compute(A);
+        }
+        x = ldlt.solve(b);
+
+        double error = expand((A * x - b).eval()).squaredNorm();
+        return std::make_tuple(time, error, SAIGA_SHORT_FUNCTION);
+    }
+
+
     Eigen::PermutationMatrix<-1> permFull, permBlock;
     std::vector<int> orderingFull;
     std::vector<int> orderingBlock;
@@ -633,6 +650,7 @@ void run()
     //        make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLTRowMajor);
     make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT);
     make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT3);
+    make_test(test, table, &LDLT::solveEigenRecursiveSupernodalLDLT);
 
     //    make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT);
 
@@ -673,6 +691,7 @@ void perf_test()
     strm << "n,nnz,block_size,density,"
             "eigen_recursive,"
             "eigen_recursive2,"
+            "eigen_supernodal,"
             "cholmod_simp,"
             "cholmod_super"
          << std::endl;
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/reconstruction/SparseTSDF.h"
+#include "saiga/vision/reconstruction/TSDFRaycaster.h"
+
+using namespace Saiga;
+
+// Voxel scans over a block sparse grid with different voxel layouts (see VoxelLayout.h).
+//  - distance: reads all distances (raycasting, surface extraction)
+//  - clamp:    read-modify-write of all distances (SparseTSDF::ClampDistance)
+//  - weight:   counts the observed voxels (SparseTSDF::NumNonZeroVoxels)
+// The grid is larger than the caches, so the scans are limited by the memory bandwidth.
+template <typename Grid>
+void BenchmarkLayout(const std::string& name, int n, int its)
+{
+    constexpr int N = Grid::VOXEL_BLOCK_SIZE;
+    Grid grid(0.01, n * n * n, 2 * n * n * n);
+
+    for (int z = 0; z < n; ++z)
+    {
+        for (int y = 0; y < n; ++y)
+        {
+            for (int x = 0; x < n; ++x)
+            {
+                auto* block = grid.InsertBlock(ivec3(x, y, z));
+                for (int i = 0; i < N; ++i)
+                    for (int j = 0; j < N; ++j)
+                        for (int k = 0; k < N; ++k) block->Set(i, j, k, {float(k - j) * 0.01f, float(i % 4)});
+            }
+        }
+    }
+    int num_blocks = grid.Size();
+
+    double sum       = 0;
+    auto st_distance = measureObject(its, [&]() {
+#pragma omp parallel for reduction(+ : sum)
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            auto& block = grid.blocks[b];
+            float s     = 0;
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    for (int k = 0; k < N; ++k) s += std::abs(block.Distance(i, j, k));
+            sum += s;
+        }
+    });
+
+    auto st_clamp = measureObject(its, [&]() {
+#pragma omp parallel for
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            auto& block = grid.blocks[b];
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    for (int k = 0; k < N; ++k)
+                        block.SetDistance(i, j, k, clamp(block.Distance(i, j, k), -0.05f, 0.05f));
+        }
+    });
+
+    long count     = 0;
+    auto st_weight = measureObject(its, [&]() {
+#pragma omp parallel for reduction(+ : count)
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            auto& block = grid.blocks[b];
+            int c       = 0;
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    for (int k = 0; k < N; ++k) c += block.Weight(i, j, k) != 0;
+            count += c;
+        }
+    });
+
+    double voxels = double(num_blocks) * N * N * N;
+    std::cout << std::setw(16) << name << std::setw(8) << sizeof(typename Grid::VoxelBlock) << " B/block"
+              << "  distance " << std::setw(8) << voxels / st_distance.median / 1000 << " MVoxel/s"
+              << "  clamp " << std::setw(8) << voxels / st_clamp.median / 1000 << " MVoxel/s"
+              << "  weight " << std::setw(8) << voxels / st_weight.median / 1000 << " MVoxel/s"
+              << "  (" << sum + count << ")" << std::endl;
+}
+
+// Renders a QVGA depth + normal map of a sphere (r = 0.5) with RaycastTSDF.
+// Only the blocks within the truncation distance of the surface are allocated, like after an integration.
+// The target for frame-to-model tracking is 30 Hz (33 ms per frame).
+void BenchmarkRaycast(float voxel_size, float truncation, int its)
+{
+    float radius = 0.5;
+    SparseTSDF tsdf(voxel_size);
+    int n = std::ceil((radius + truncation) / (voxel_size * SparseTSDF::VOXEL_BLOCK_SIZE));
+    for (int z = -n; z < n; ++z)
+    {
+        for (int y = -n; y < n; ++y)
+        {
+            for (int x = -n; x < n; ++x)
+            {
+                ivec3 index(x, y, z);
+                float d = tsdf.BlockCenter(index).norm() - radius;
+                if (std::abs(d) > truncation + voxel_size * SparseTSDF::VOXEL_BLOCK_SIZE) continue;
+                auto* block = tsdf.InsertBlock(index);
+                for (int i = 0; i < SparseTSDF::VOXEL_BLOCK_SIZE; ++i)
+                    for (int j = 0; j < SparseTSDF::VOXEL_BLOCK_SIZE; ++j)
+                        for (int k = 0; k < SparseTSDF::VOXEL_BLOCK_SIZE; ++k)
+                        {
+                            float dist = tsdf.GlobalPosition(index, i, j, k).norm() - radius;
+                            block->Set(i, j, k, {clamp(dist, -truncation, truncation), 1});
+                        }
+            }
+        }
+    }
+
+    int w = 320, h = 240;
+    TemplatedImage<float> depth(h, w);
+    ArrayImage<Vec3> normals(h, w);
+    SE3 pose(Quat::Identity(), Vec3(0.1, 0, -1.5));
+    IntrinsicsPinholed K(262.5, 262.5, w / 2, h / 2, 0);
+
+    std::cout << "Raycast " << w << "x" << h << " voxel size " << voxel_size << " truncation " << truncation
+              << " blocks " << tsdf.Size() << std::endl;
+    std::vector<int> thread_counts = {1};
+    if (OMP::getMaxThreads() > 1) thread_counts.push_back(OMP::getMaxThreads());
+    for (int threads : thread_counts)
+    {
+        TSDFRaycastParams params;
+        params.threads = threads;
+        auto st        = measureObject(its, [&]() {
+            RaycastTSDF(tsdf, pose, K, depth.getImageView(), normals, params);
+        });
+        std::cout << "  Threads " << threads << std::setw(10) << st.median << " ms/frame " << std::setw(8)
+                  << 1000 / st.median << " Hz" << (st.median <= 1000.0 / 30 ? "" : " (below 30 Hz)") << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+
+    // n^3 blocks
+    int n   = argc > 1 ? atoi(argv[1]) : 32;
+    int its = 10;
+
+    std::cout << "Blocks: " << n * n * n << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    BenchmarkLayout<BlockSparseGrid<TSDFVoxel, 8, VoxelLayoutAoS<TSDFVoxel, 8>>>("AoS float", n, its);
+    BenchmarkLayout<SparseTSDF>("SoA float", n, its);
+    BenchmarkLayout<BlockSparseGrid<TSDFVoxel, 8, VoxelLayoutSoA<TSDFVoxel, 8, Eigen::half, uint8_t>>>(
+        "SoA half/uint8", n, its);
+
+    std::cout << std::endl;
+    BenchmarkRaycast(0.05, 1, its);
+    BenchmarkRaycast(0.01, 0.05, its);
+    return 0;
+}
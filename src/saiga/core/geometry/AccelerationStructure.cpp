@@ -5,12 +5,108 @@
  */
 #include "AccelerationStructure.h"
 
+#include "saiga/core/math/imath.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/core/util/assert.h"
+
 #include "algorithm"
 
 namespace Saiga
 {
 namespace AccelerationStructure
 {
+namespace
+{
+vec3 InverseDirection(const vec3& direction)
+{
+    return vec3(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+}
+
+// Same as Intersection::RayAABB with a precomputed inverse direction.
+// Additionally returns false if the box starts behind t_max.
+inline bool RayBox(const vec3& origin, const vec3& inv_dir, const AABB& box, float t_max, float& t)
+{
+    float t1 = (box.min.x() - origin.x()) * inv_dir.x();
+    float t2 = (box.max.x() - origin.x()) * inv_dir.x();
+    float t3 = (box.min.y() - origin.y()) * inv_dir.y();
+    float t4 = (box.max.y() - origin.y()) * inv_dir.y();
+    float t5 = (box.min.z() - origin.z()) * inv_dir.z();
+    float t6 = (box.max.z() - origin.z()) * inv_dir.z();
+
+    float tmin = std::max(std::max(std::min(t1, t2), std::min(t3, t4)), std::min(t5, t6));
+    float tmax = std::min(std::min(std::max(t1, t2), std::max(t3, t4)), std::max(t5, t6));
+
+    t = tmin;
+    return tmax >= 0 && tmin <= tmax && tmin <= t_max;
+}
+
+// P rays in structure-of-arrays layout. The lane loops are vectorized by the compiler.
+template <int P>
+struct RayPacket
+{
+    alignas(32) float ox[P];
+    alignas(32) float oy[P];
+    alignas(32) float oz[P];
+    alignas(32) float ix[P];
+    alignas(32) float iy[P];
+    alignas(32) float iz[P];
+    // Closest hit so far
+    alignas(32) float t[P];
+
+    // Returns the mask of rays that hit the box before their closest hit.
+    // t_near is the minimum entry distance of these rays.
+    int Intersect(const AABB& box, float& t_near) const
+    {
+        alignas(32) float t_entry[P];
+        alignas(32) int hit[P];
+        for (int i = 0; i < P; ++i)
+        {
+            float t1 = (box.min.x() - ox[i]) * ix[i];
+            float t2 = (box.max.x() - ox[i]) * ix[i];
+            float t3 = (box.min.y() - oy[i]) * iy[i];
+            float t4 = (box.max.y() - oy[i]) * iy[i];
+            float t5 = (box.min.z() - oz[i]) * iz[i];
+            float t6 = (box.max.z() - oz[i]) * iz[i];
+
+            float tmin = std::max(std::max(std::min(t1, t2), std::min(t3, t4)), std::min(t5, t6));
+            float tmax = std::min(std::min(std::max(t1, t2), std::max(t3, t4)), std::max(t5, t6));
+
+            // No short circuit evaluation so that the loop can be vectorized
+            hit[i]     = (tmax >= 0) & (tmin <= tmax) & (tmin <= t[i]);
+            t_entry[i] = hit[i] ? tmin : std::numeric_limits<float>::infinity();
+        }
+
+        int mask = 0;
+        t_near   = t_entry[0];
+        for (int i = 0; i < P; ++i)
+        {
+            mask |= hit[i] << i;
+            t_near = std::min(t_near, t_entry[i]);
+        }
+        return mask;
+    }
+};
+
+// Half of the surface area. The factor doesn't matter for the SAH.
+inline float HalfArea(const AABB& box)
+{
+    vec3 d = box.max - box.min;
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+}  // namespace
+
+std::vector<RayTriangleIntersection> Base::getClosest(const std::vector<Ray>& rays)
+{
+    std::vector<RayTriangleIntersection> result(rays.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int)rays.size(); ++i)
+    {
+        result[i] = getClosest(rays[i]);
+    }
+    return result;
+}
+
 BruteForce::BruteForce(const std::vector<Saiga::Triangle>& triangles) : triangles(triangles) {}
 
 RayTriangleIntersection BruteForce::getClosest(const Ray& ray)
@@ -58,26 +154,269 @@ BVH::BVH(const std::vector<Saiga::Triangle>& triangles)
 
 RayTriangleIntersection BVH::getClosest(const Ray& ray)
 {
-    Intersection::RayTriangleIntersection result;
-    if (!nodes.empty()) getClosest(0, ray, result);
+    RayTriangleIntersection result;
+    if (nodes.empty()) return result;
+
+    vec3 inv_dir = InverseDirection(ray.direction);
+
+    // (node, entry distance)
+    std::pair<uint32_t, float> stack[MAX_DEPTH];
+    int stack_size = 0;
+
+    float t;
+    if (!RayBox(ray.origin, inv_dir, nodes[0].box, result.t, t)) return result;
+    stack[stack_size++] = {0, t};
+
+    while (stack_size > 0)
+    {
+        auto [node_id, node_t] = stack[--stack_size];
+        // The node is further than the closest hit
+        if (node_t > result.t) continue;
+
+        const BVHNode& n = nodes[node_id];
+        if (!n._inner)
+        {
+            // Leaf node -> intersect with triangles
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
+                if (inter && inter < result)
+                {
+                    inter.triangleIndex = triangles[i].second;
+                    result              = inter;
+                }
+            }
+            continue;
+        }
+
+        float tl, tr;
+        bool hit_left  = RayBox(ray.origin, inv_dir, nodes[n._left].box, result.t, tl);
+        bool hit_right = RayBox(ray.origin, inv_dir, nodes[n._right].box, result.t, tr);
+
+        // Push the far child first so that the near child is processed next
+        if (hit_left && hit_right)
+        {
+            if (tl < tr)
+            {
+                stack[stack_size++] = {n._right, tr};
+                stack[stack_size++] = {n._left, tl};
+            }
+            else
+            {
+                stack[stack_size++] = {n._left, tl};
+                stack[stack_size++] = {n._right, tr};
+            }
+        }
+        else if (hit_left)
+        {
+            stack[stack_size++] = {n._left, tl};
+        }
+        else if (hit_right)
+        {
+            stack[stack_size++] = {n._right, tr};
+        }
+    }
+    return result;
+}
+
+template <int P>
+void BVH::getClosestPacket(const Ray* rays, int n, RayTriangleIntersection* result)
+{
+    RayPacket<P> packet;
+    int active = 0;
+    for (int i = 0; i < P; ++i)
+    {
+        // Unused lanes are filled with the first ray and are never active
+        const Ray& ray = rays[i < n ? i : 0];
+        vec3 inv_dir   = InverseDirection(ray.direction);
+        packet.ox[i]   = ray.origin.x();
+        packet.oy[i]   = ray.origin.y();
+        packet.oz[i]   = ray.origin.z();
+        packet.ix[i]   = inv_dir.x();
+        packet.iy[i]   = inv_dir.y();
+        packet.iz[i]   = inv_dir.z();
+        packet.t[i]    = std::numeric_limits<float>::infinity();
+        if (i < n) active |= 1 << i;
+    }
+
+    // (node, mask of the rays that hit the node)
+    std::pair<uint32_t, int> stack[MAX_DEPTH];
+    int stack_size = 0;
+
+    float t;
+    int mask = packet.Intersect(nodes[0].box, t) & active;
+    if (mask) stack[stack_size++] = {0, mask};
+
+    while (stack_size > 0)
+    {
+        auto [node_id, node_mask] = stack[--stack_size];
+        const BVHNode& node       = nodes[node_id];
+
+        if (!node._inner)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                if (!(node_mask & (1 << j))) continue;
+                for (uint32_t i = node._left; i < node._right; ++i)
+                {
+                    auto inter = Intersection::RayTriangle(rays[j], triangles[i].first, triangle_epsilon);
+                    if (inter && inter < result[j])
+                    {
+                        inter.triangleIndex = triangles[i].second;
+                        result[j]           = inter;
+                        packet.t[j]         = inter.t;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // The masks are recomputed because the closest hits might have changed since the parent was pushed
+        float tl, tr;
+        int mask_left  = packet.Intersect(nodes[node._left].box, tl) & node_mask;
+        int mask_right = packet.Intersect(nodes[node._right].box, tr) & node_mask;
+
+        // Traverse the child first, which is closer for any of the rays
+        if (mask_left && mask_right)
+        {
+            if (tl < tr)
+            {
+                stack[stack_size++] = {node._right, mask_right};
+                stack[stack_size++] = {node._left, mask_left};
+            }
+            else
+            {
+                stack[stack_size++] = {node._left, mask_left};
+                stack[stack_size++] = {node._right, mask_right};
+            }
+        }
+        else if (mask_left)
+        {
+            stack[stack_size++] = {node._left, mask_left};
+        }
+        else if (mask_right)
+        {
+            stack[stack_size++] = {node._right, mask_right};
+        }
+    }
+}
+
+std::vector<RayTriangleIntersection> BVH::getClosest(const std::vector<Ray>& rays)
+{
+    SAIGA_ASSERT(packet_size == 4 || packet_size == 8);
+    std::vector<RayTriangleIntersection> result(rays.size());
+    if (nodes.empty()) return result;
+
+    int num_packets = iDivUp((int)rays.size(), packet_size);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int p = 0; p < num_packets; ++p)
+    {
+        int begin = p * packet_size;
+        int n     = std::min<int>(packet_size, rays.size() - begin);
+        if (packet_size == 4)
+        {
+            getClosestPacket<4>(rays.data() + begin, n, result.data() + begin);
+        }
+        else
+        {
+            getClosestPacket<8>(rays.data() + begin, n, result.data() + begin);
+        }
+    }
     return result;
 }
 
 std::vector<Intersection::RayTriangleIntersection> BVH::getAll(const Ray& ray)
 {
     std::vector<RayTriangleIntersection> result;
-    if (!nodes.empty()) getAll(0, ray, result);
+    if (nodes.empty()) return result;
+
+    vec3 inv_dir = InverseDirection(ray.direction);
+    float inf    = std::numeric_limits<float>::infinity();
+
+    uint32_t stack[MAX_DEPTH];
+    int stack_size      = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const BVHNode& n = nodes[stack[--stack_size]];
+
+        float t;
+        // The ray missed the box
+        if (!RayBox(ray.origin, inv_dir, n.box, inf, t)) continue;
+
+        if (n._inner)
+        {
+            stack[stack_size++] = n._right;
+            stack[stack_size++] = n._left;
+        }
+        else
+        {
+            // Leaf node -> intersect with triangles
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
+                if (inter)
+                {
+                    inter.triangleIndex = triangles[i].second;
+                    result.push_back(inter);
+                }
+            }
+        }
+    }
     return result;
 }
 
 std::pair<float, int> BVH::ClosestPoint(const vec3& p)
 {
     std::pair<float, int> result = {std::numeric_limits<float>::infinity(), -1};
-    if (!nodes.empty())
+    if (nodes.empty()) return result;
+
+    // (node, squared distance to the box)
+    std::pair<uint32_t, float> stack[MAX_DEPTH];
+    int stack_size      = 0;
+    stack[stack_size++] = {0, 0.f};
+
+    while (stack_size > 0)
     {
-        ClosestPoint(0, p, result);
-        result.first = sqrt(result.first);
+        auto [node_id, node_d] = stack[--stack_size];
+        if (node_d >= result.first) continue;
+
+        const BVHNode& n = nodes[node_id];
+        if (n._inner)
+        {
+            auto ld = nodes[n._left].box.DistanceSquared(p);
+            auto rd = nodes[n._right].box.DistanceSquared(p);
+
+            // go into closest box first
+            if (ld < rd)
+            {
+                stack[stack_size++] = {n._right, rd};
+                stack[stack_size++] = {n._left, ld};
+            }
+            else
+            {
+                stack[stack_size++] = {n._left, ld};
+                stack[stack_size++] = {n._right, rd};
+            }
+        }
+        else
+        {
+            // Leaf node -> compute triangle distance
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                auto& tri = triangles[i].first;
+                auto d    = tri.Distance(p);
+                d         = d * d;
+                if (d < result.first)
+                {
+                    result.first  = d;
+                    result.second = triangles[i].second;
+                }
+            }
+        }
     }
+    result.first = sqrt(result.first);
     return result;
 }
 
@@ -103,165 +442,431 @@ void BVH::sortByAxis(int start, int end, int axis)
     std::sort(triangles.begin() + start, triangles.begin() + end, SortTriangleByAxis(axis));
 }
 
-void BVH::getClosest(int node, const Ray& ray, Intersection::RayTriangleIntersection& result)
+void ObjectMedianBVH::construct()
 {
-    BVHNode& n = nodes[node];
-
-    float aabbT;
+    nodes.reserve(triangles.size());
+    construct(0, triangles.size());
+}
 
-    // The ray missed the box
-    if (!Intersection::RayAABB(ray, n.box, aabbT)) return;
+int ObjectMedianBVH::construct(int start, int end)
+{
+    int nodeid = nodes.size();
+    nodes.push_back({});
+    auto& node = nodes.back();
 
-    // The node is further than the closest hit
-    if (aabbT > result.t) return;
+    node.box = computeBox(start, end);
 
-    if (n._inner)
+    if (end - start <= leafTriangles)
     {
-        getClosest(n._left, ray, result);
-        getClosest(n._right, ray, result);
+        // leaf node
+        node._inner = 0;
+        node._left  = start;
+        node._right = end;
     }
     else
     {
-        // Leaf node -> intersect with triangles
-        for (uint32_t i = n._left; i < n._right; ++i)
+        node._inner = 1;
+        int axis    = node.box.maxDimension();
+        sortByAxis(start, end, axis);
+
+        int mid = (start + end) / 2;
+
+        int l = construct(start, mid);
+        int r = construct(mid, end);
+
+        // reload node, because the reference from above might be broken
+        auto& node2  = nodes[nodeid];
+        node2._left  = l;
+        node2._right = r;
+    }
+
+    return nodeid;
+}
+
+void SAHBVH::construct()
+{
+    SAIGA_ASSERT(bins >= 2 && bins <= MAX_BINS);
+    SAIGA_ASSERT(leafTriangles >= 1 && leafTriangles <= MAX_LEAF_TRIANGLES);
+    nodes.clear();
+    int n = triangles.size();
+    if (n == 0) return;
+
+    // Build the upper levels sequentially until there are enough subtrees for all threads
+    int parallel_depth = 0;
+    while ((1 << parallel_depth) < 8 * OMP::getMaxThreads() && (n >> parallel_depth) > 1024)
+    {
+        parallel_depth++;
+    }
+
+    std::vector<Subtree> deferred;
+    construct(nodes, 0, n, 0, parallel_depth, &deferred);
+
+    // Each subtree is built into its own node array. The subtrees operate on disjoint triangle ranges.
+    std::vector<std::vector<BVHNode>> subtrees(deferred.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)deferred.size(); ++i)
+    {
+        auto& d = deferred[i];
+        subtrees[i].reserve(2 * (d.end - d.start) / leafTriangles);
+        construct(subtrees[i], d.start, d.end, d.depth, -1, nullptr);
+    }
+
+    // Append the subtrees. The root replaces the placeholder node, all other nodes are shifted.
+    for (int i = 0; i < (int)deferred.size(); ++i)
+    {
+        auto& subtree = subtrees[i];
+        int offset    = (int)nodes.size() - 1;
+        for (auto& node : subtree)
         {
-            auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
-            if (inter && inter < result)
+            if (node._inner)
             {
-                inter.triangleIndex = triangles[i].second;
-                result              = inter;
+                node._left += offset;
+                node._right += offset;
             }
         }
+        nodes[deferred[i].node] = subtree.front();
+        nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
     }
 }
 
-void BVH::getAll(int node, const Ray& ray, std::vector<Intersection::RayTriangleIntersection>& result)
+int SAHBVH::construct(std::vector<BVHNode>& out, int start, int end, int depth, int parallel_depth,
+                      std::vector<Subtree>* deferred)
 {
-    BVHNode& n = nodes[node];
+    int nodeid = out.size();
+    out.push_back({});
 
-    float aabbT;
+    if (parallel_depth == 0)
+    {
+        deferred->push_back({nodeid, start, end, depth});
+        return nodeid;
+    }
 
-    if (!Intersection::RayAABB(ray, n.box, aabbT))
+    AABB box = computeBox(start, end);
+    int mid  = split(start, end, depth, box);
+
+    if (mid < 0)
     {
-        // The ray missed the box
-        return;
+        // leaf node
+        auto& node  = out[nodeid];
+        node.box    = box;
+        node._inner = 0;
+        node._left  = start;
+        node._right = end;
+        return nodeid;
     }
 
-    if (n._inner)
+    int l = construct(out, start, mid, depth + 1, parallel_depth - 1, deferred);
+    int r = construct(out, mid, end, depth + 1, parallel_depth - 1, deferred);
+
+    // reload node, because the reference from above might be broken
+    auto& node  = out[nodeid];
+    node.box    = box;
+    node._inner = 1;
+    node._left  = l;
+    node._right = r;
+    return nodeid;
+}
+
+int SAHBVH::split(int start, int end, int depth, const AABB& box)
+{
+    int n = end - start;
+    if (n <= leafTriangles) return -1;
+
+    AABB center_box;
+    center_box.makeNegative();
+    for (int i = start; i < end; ++i)
     {
-        getAll(n._left, ray, result);
-        getAll(n._right, ray, result);
+        center_box.growBox(triangles[i].first.center());
     }
-    else
+
+    auto median_split = [&]() {
+        int axis = center_box.maxDimension();
+        int mid  = (start + end) / 2;
+        std::nth_element(triangles.begin() + start, triangles.begin() + mid, triangles.begin() + end,
+                         SortTriangleByAxis(axis));
+        return mid;
+    };
+
+    // The median split below this depth guarantees that the tree is not deeper than MAX_DEPTH
+    if (depth >= MAX_DEPTH - 40) return median_split();
+
+    struct Bin
+    {
+        AABB box;
+        int count = 0;
+    };
+
+    float best_cost = std::numeric_limits<float>::infinity();
+    int best_axis   = -1;
+    int best_bin    = -1;
+
+    // Bin all axes in a single pass over the triangles
+    Bin axis_bins[3][MAX_BINS];
+    vec3 scale;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float extent = center_box.max[axis] - center_box.min[axis];
+        scale[axis]  = extent > 0 ? bins / extent : 0;
+        for (int b = 0; b < bins; ++b) axis_bins[axis][b].box.makeNegative();
+    }
+
+    for (int i = start; i < end; ++i)
+    {
+        auto& t = triangles[i].first;
+        AABB triangle_box(t.a.array().min(t.b.array()).min(t.c.array()),
+                          t.a.array().max(t.b.array()).max(t.c.array()));
+        vec3 center = t.center();
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            int b    = std::min(bins - 1, int((center[axis] - center_box.min[axis]) * scale[axis]));
+            auto& bb = axis_bins[axis][b];
+            bb.count++;
+            bb.box.min = bb.box.min.array().min(triangle_box.min.array());
+            bb.box.max = bb.box.max.array().max(triangle_box.max.array());
+        }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
     {
-        // Leaf node -> intersect with triangles
-        for (uint32_t i = n._left; i < n._right; ++i)
+        if (scale[axis] == 0) continue;
+        Bin* bin = axis_bins[axis];
+
+        // Sweep from the right to get the cost of the right side for each split plane
+        float right_cost[MAX_BINS];
+        AABB right_box;
+        right_box.makeNegative();
+        int right_count = 0;
+        for (int b = bins - 1; b > 0; --b)
         {
-            auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
-            if (inter)
+            right_box.growBox(bin[b].box);
+            right_count += bin[b].count;
+            right_cost[b] = right_count > 0 ? right_count * HalfArea(right_box) : 0;
+        }
+
+        // Split plane b: bins [0, b) go to the left child
+        AABB left_box;
+        left_box.makeNegative();
+        int left_count = 0;
+        for (int b = 1; b < bins; ++b)
+        {
+            left_box.growBox(bin[b - 1].box);
+            left_count += bin[b - 1].count;
+            if (left_count == 0 || left_count == n) continue;
+
+            float cost = left_count * HalfArea(left_box) + right_cost[b];
+            if (cost < best_cost)
             {
-                inter.triangleIndex = triangles[i].second;
-                result.push_back(inter);
+                best_cost = cost;
+                best_axis = axis;
+                best_bin  = b;
             }
         }
     }
+
+    if (best_axis < 0)
+    {
+        // All centers are identical
+        return n <= MAX_LEAF_TRIANGLES ? -1 : median_split();
+    }
+
+    // Compare to the cost of a leaf. The areas are relative to the parent box.
+    float area       = HalfArea(box);
+    float split_cost = traversal_cost + best_cost / area;
+    if (split_cost >= n && n <= MAX_LEAF_TRIANGLES) return -1;
+
+    auto it = std::partition(triangles.begin() + start, triangles.begin() + end, [&](const auto& t) {
+        vec3 center = t.first.center();
+        int b       = std::min(bins - 1, int((center[best_axis] - center_box.min[best_axis]) * scale[best_axis]));
+        return b < best_bin;
+    });
+    int mid = it - triangles.begin();
+
+    // Should not happen, because the bins are recomputed with exactly the same formula
+    if (mid == start || mid == end) return median_split();
+    return mid;
 }
 
-void BVH::ClosestPoint(int node, const vec3& p, std::pair<float, int>& result)
+template <int W>
+WideBVH<W>::WideBVH(const std::vector<Triangle>& triangles, int leafTriangles, int bins)
+    : SAHBVH(triangles, leafTriangles, bins)
 {
-    BVHNode& n = nodes[node];
-
+    if (nodes.empty()) return;
+    wide_nodes.reserve(nodes.size() / (W / 2) + 1);
+    collapse(0);
+}
 
-    if (n._inner)
+template <int W>
+int WideBVH<W>::collapse(int node)
+{
+    // Replace the inner child with the largest surface area by its children until there are W children
+    int children[W];
+    int num_children = 0;
+    if (nodes[node]._inner)
     {
-        auto& l = nodes[n._left];
-        auto& r = nodes[n._right];
-
-        auto ld = l.box.DistanceSquared(p);
-        auto rd = r.box.DistanceSquared(p);
+        children[num_children++] = nodes[node]._left;
+        children[num_children++] = nodes[node]._right;
+    }
+    else
+    {
+        // Only if the root is a leaf
+        children[num_children++] = node;
+    }
 
-        // go into closest box first
-        if (ld < rd)
+    while (num_children < W)
+    {
+        int best        = -1;
+        float best_area = -1;
+        for (int i = 0; i < num_children; ++i)
         {
-            if (ld < result.first)
-            {
-                ClosestPoint(n._left, p, result);
-            }
-            if (rd < result.first)
+            auto& c = nodes[children[i]];
+            if (c._inner && HalfArea(c.box) > best_area)
             {
-                ClosestPoint(n._right, p, result);
+                best      = i;
+                best_area = HalfArea(c.box);
             }
         }
-        else
+        if (best < 0) break;
+
+        auto& c                  = nodes[children[best]];
+        children[best]           = c._left;
+        children[num_children++] = c._right;
+    }
+
+    int wide_id = wide_nodes.size();
+    wide_nodes.push_back({});
+    {
+        auto& w        = wide_nodes.back();
+        w.num_children = num_children;
+        for (int i = 0; i < W; ++i)
         {
-            if (rd < result.first)
-            {
-                ClosestPoint(n._right, p, result);
-            }
-            if (ld < result.first)
-            {
-                ClosestPoint(n._left, p, result);
-            }
+            // Unused children are never hit because of num_children
+            AABB box;
+            if (i < num_children) box = nodes[children[i]].box;
+            w.min_x[i] = box.min.x();
+            w.min_y[i] = box.min.y();
+            w.min_z[i] = box.min.z();
+            w.max_x[i] = box.max.x();
+            w.max_y[i] = box.max.y();
+            w.max_z[i] = box.max.z();
+            w.child[i] = -1;
+            w.count[i] = 0;
         }
     }
-    else
+
+    for (int i = 0; i < num_children; ++i)
     {
-        // Leaf node -> compute triangle distance
-        for (uint32_t i = n._left; i < n._right; ++i)
+        auto& c = nodes[children[i]];
+        if (c._inner)
         {
-            auto& tri = triangles[i].first;
-            auto d    = tri.Distance(p);
-            d         = d * d;
-            if (d < result.first)
-            {
-                result.first  = d;
-                result.second = triangles[i].second;
-            }
+            int child_id = collapse(children[i]);
+            // reload node, because the reference from above might be broken
+            wide_nodes[wide_id].child[i] = child_id;
+        }
+        else
+        {
+            wide_nodes[wide_id].child[i] = c._left;
+            wide_nodes[wide_id].count[i] = c._right - c._left;
         }
     }
+    return wide_id;
 }
 
-void ObjectMedianBVH::construct()
+template <int W>
+RayTriangleIntersection WideBVH<W>::getClosest(const Ray& ray)
 {
-    nodes.reserve(triangles.size());
-    construct(0, triangles.size());
-}
+    RayTriangleIntersection result;
+    if (wide_nodes.empty()) return result;
 
-int ObjectMedianBVH::construct(int start, int end)
-{
-    int nodeid = nodes.size();
-    nodes.push_back({});
-    auto& node = nodes.back();
+    vec3 inv_dir = InverseDirection(ray.direction);
+    float ox = ray.origin.x(), oy = ray.origin.y(), oz = ray.origin.z();
+    float ix = inv_dir.x(), iy = inv_dir.y(), iz = inv_dir.z();
 
-    node.box = computeBox(start, end);
+    // (node, entry distance). Each level pushes at most W-1 nodes.
+    std::pair<int, float> stack[MAX_DEPTH * (W - 1) + 1];
+    int stack_size      = 0;
+    stack[stack_size++] = {0, 0.f};
 
-    if (end - start <= leafTriangles)
-    {
-        // leaf node
-        node._inner = 0;
-        node._left  = start;
-        node._right = end;
-    }
-    else
+    while (stack_size > 0)
     {
-        node._inner = 1;
-        int axis    = node.box.maxDimension();
-        sortByAxis(start, end, axis);
+        auto [node_id, node_t] = stack[--stack_size];
+        if (node_t > result.t) continue;
 
-        int mid = (start + end) / 2;
+        const WideBVHNode<W>& n = wide_nodes[node_id];
 
-        int l = construct(start, mid);
-        int r = construct(mid, end);
+        // One ray against all children
+        alignas(32) float t_near[W];
+        alignas(32) int hit[W];
+        float t_max = result.t;
+        for (int i = 0; i < W; ++i)
+        {
+            float t1 = (n.min_x[i] - ox) * ix;
+            float t2 = (n.max_x[i] - ox) * ix;
+            float t3 = (n.min_y[i] - oy) * iy;
+            float t4 = (n.max_y[i] - oy) * iy;
+            float t5 = (n.min_z[i] - oz) * iz;
+            float t6 = (n.max_z[i] - oz) * iz;
+
+            float tmin = std::max(std::max(std::min(t1, t2), std::min(t3, t4)), std::min(t5, t6));
+            float tmax = std::min(std::min(std::max(t1, t2), std::max(t3, t4)), std::max(t5, t6));
+
+            // No short circuit evaluation so that the loop can be vectorized
+            hit[i]    = (tmax >= 0) & (tmin <= tmax) & (tmin <= t_max);
+            t_near[i] = tmin;
+        }
 
-        // reload node, because the reference from above might be broken
-        auto& node2  = nodes[nodeid];
-        node2._left  = l;
-        node2._right = r;
+        int mask = 0;
+        for (int i = 0; i < W; ++i)
+        {
+            mask |= hit[i] << i;
+        }
+        // Unused children
+        mask &= (1 << n.num_children) - 1;
+        if (!mask) continue;
+
+        // Leafs are intersected directly. The inner children are sorted by distance.
+        int inner[W];
+        int num_inner = 0;
+        for (int i = 0; i < W; ++i)
+        {
+            if (!(mask & (1 << i))) continue;
+            if (n.count[i] == 0)
+            {
+                int j = num_inner++;
+                for (; j > 0 && t_near[inner[j - 1]] < t_near[i]; --j) inner[j] = inner[j - 1];
+                inner[j] = i;
+                continue;
+            }
+
+            for (int k = n.child[i]; k < n.child[i] + n.count[i]; ++k)
+            {
+                auto inter = Intersection::RayTriangle(ray, triangles[k].first, triangle_epsilon);
+                if (inter && inter < result)
+                {
+                    inter.triangleIndex = triangles[k].second;
+                    result              = inter;
+                }
+            }
+        }
+
+        // Sorted far to near -> the nearest child is on top of the stack
+        for (int j = 0; j < num_inner; ++j)
+        {
+            stack[stack_size++] = {n.child[inner[j]], t_near[inner[j]]};
+        }
     }
+    return result;
+}
 
-    return nodeid;
+template <int W>
+std::vector<RayTriangleIntersection> WideBVH<W>::getClosest(const std::vector<Ray>& rays)
+{
+    // The SIMD lanes are used for the children, therefore each ray is traced on its own
+    return Base::getClosest(rays);
 }
 
+template class WideBVH<4>;
+template class WideBVH<8>;
+
 
 }  // namespace AccelerationStructure
 }  // namespace Saiga
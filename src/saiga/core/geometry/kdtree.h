@@ -8,6 +8,7 @@
 
 #include "saiga/config.h"
 #include "saiga/core/math/math.h"
+#include "saiga/core/util/Thread/omp.h"
 
 #include <algorithm>
 #include <iostream>
@@ -17,263 +18,334 @@ namespace Saiga
 {
 // D : Dimension. for example D=3 for 3 dimensional points
 // point_t : should be a vector type. for example vec2 or vec3
+//
+// The tree is stored in a flat array in depth-first order. The left child of an inner node is always the next
+// node, therefore most of the traversal is a linear walk through memory. The points are reordered so that each
+// leaf references a contiguous bucket of up to LEAF_SIZE points.
+//
+// The build splits at the median (std::nth_element) of the axis with the largest extent. The upper levels are
+// built sequentially and the remaining subtrees in parallel.
+//
+// All queries are const and can be called from multiple threads. The batched versions process the search points
+// in parallel.
 template <int D, typename point_t>
 class SAIGA_TEMPLATE KDTree
 {
    public:
+    static constexpr int LEAF_SIZE = 16;
+
     // create an empty tree
     KDTree() {}
     KDTree(const std::vector<point_t>& points);
 
     // returns the nearest point in this tree to the searchpoint
-    int NearestNeighborSearch(const point_t& searchPoint);
+    int NearestNeighborSearch(const point_t& searchPoint) const;
 
     // returns the k nearest points in this tree to the searchpoint
-    std::vector<int> KNearestNeighborSearch(const point_t& searchPoint, int k);
-
+    // sorted by distance (closest first)
+    std::vector<int> KNearestNeighborSearch(const point_t& searchPoint, int k) const;
 
-    std::vector<int> RadiusSearch(const point_t& searchPoint, float radius);
+    // returns all points with distance < radius sorted by index
+    std::vector<int> RadiusSearch(const point_t& searchPoint, float radius) const;
 
+    // Batched queries. Element i of the result is the answer for searchPoints[i].
+    std::vector<int> NearestNeighborSearch(const std::vector<point_t>& searchPoints) const;
+    std::vector<std::vector<int>> KNearestNeighborSearch(const std::vector<point_t>& searchPoints, int k) const;
+    std::vector<std::vector<int>> RadiusSearch(const std::vector<point_t>& searchPoints, float radius) const;
 
+    int Size() const { return points.size(); }
 
    private:
     typedef int index_t;
-    typedef unsigned int axis_t;
     typedef std::vector<std::pair<float, index_t>> queue_t;
 
     struct kd_node_t
     {
-        point_t p;
-        int initial_index;
-        index_t left = -1, right = -1;
+        // Inner node: split plane. Leaf: unused.
+        float split = 0;
+        // -1 for leafs
+        int axis = -1;
+        // The left child is the next node
+        index_t right = -1;
+        // Point range of this subtree
+        index_t begin = 0, end = 0;
     };
 
     std::vector<kd_node_t> nodes;
-    index_t rootNode = -1;
-
-    index_t sortByAxis(index_t startIndex, index_t endIndex, axis_t axis);
-    index_t make_tree(index_t startIndex, index_t endIndex, axis_t currentAxis);
+    std::vector<point_t> points;
+    std::vector<int> initial_index;
 
-    // rekursive helper functions for nearest neighbour lookup
-    void NearestNeighborSearch(index_t currentNode, const point_t& searchPoint, axis_t currentAxis, index_t& bestNode,
-                               float& bestDist);
+    static index_t NumNodes(index_t n);
+    void make_tree(const std::vector<point_t>& input, index_t node, index_t begin, index_t end, int parallel_depth,
+                   std::vector<index_t>* deferred);
+    int SplitAxis(const std::vector<point_t>& input, index_t begin, index_t end) const;
 
-    void KNearestNeighborSearch(index_t currentNode, const point_t& searchPoint, int k, axis_t currentAxis,
-                                queue_t& queue);
+    void KNearestNeighborSearch(const point_t& searchPoint, int k, queue_t& queue) const;
+    void RadiusSearch(const point_t& searchPoint, float r2, std::vector<int>& result) const;
 
-    void RadiusSearch(index_t currentNode, const point_t& searchPoint, float r, axis_t currentAxis,
-                      std::vector<int>& result);
-
-    float addToQueue(queue_t& queue, index_t currentNode, float distance);
-    float distance(point_t a, point_t b);
-    void printPoints(index_t startIndex, index_t endIndex);
+    static float distance(const point_t& a, const point_t& b);
 };
 
 template <int D, typename point_t>
-KDTree<D, point_t>::KDTree(const std::vector<point_t>& points)
+KDTree<D, point_t>::KDTree(const std::vector<point_t>& input)
 {
-    nodes.resize(points.size());
-    for (int i = 0; i < points.size(); ++i)
+    index_t n = input.size();
+    if (n == 0) return;
+
+    // The build only reorders the initial_index. The points are copied in this order at the end.
+    initial_index.resize(n);
+    for (index_t i = 0; i < n; ++i)
     {
-        nodes[i].p             = points[i];
-        nodes[i].initial_index = i;
+        initial_index[i] = i;
     }
-    rootNode = make_tree(0, nodes.size(), 0);
-}
-
-template <int D, typename point_t>
-typename KDTree<D, point_t>::index_t KDTree<D, point_t>::sortByAxis(index_t startIndex, index_t endIndex, axis_t axis)
-{
-    auto cmp = [axis](const kd_node_t& a, const kd_node_t& b) -> bool { return a.p[axis] < b.p[axis]; };
-    std::sort(nodes.begin() + startIndex, nodes.begin() + endIndex, cmp);
-    // return the median point
-    return (startIndex + endIndex) / 2;
-}
+    nodes.resize(NumNodes(n));
 
-template <int D, typename point_t>
-typename KDTree<D, point_t>::index_t KDTree<D, point_t>::make_tree(index_t startIndex, index_t endIndex,
-                                                                   axis_t currentAxis)
-{
-    if (startIndex == endIndex) return -1;
-    if (startIndex + 1 == endIndex) return startIndex;
-
-    index_t median = sortByAxis(startIndex, endIndex, currentAxis);
-    currentAxis    = (currentAxis + 1) % D;
+    // Build the upper levels sequentially until there are enough subtrees for all threads
+    int parallel_depth = 0;
+    while ((1 << parallel_depth) < 8 * OMP::getMaxThreads() && (n >> parallel_depth) > 4 * LEAF_SIZE)
+    {
+        parallel_depth++;
+    }
 
+    std::vector<index_t> deferred;
+    make_tree(input, 0, 0, n, parallel_depth, &deferred);
 
-    nodes[median].left  = make_tree(startIndex, median, currentAxis);
-    nodes[median].right = make_tree(median + 1, endIndex, currentAxis);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)deferred.size(); ++i)
+    {
+        auto& node = nodes[deferred[i]];
+        make_tree(input, deferred[i], node.begin, node.end, -1, nullptr);
+    }
 
-    return median;
+    points.resize(n);
+#pragma omp parallel for
+    for (index_t i = 0; i < n; ++i)
+    {
+        points[i] = input[initial_index[i]];
+    }
 }
 
 template <int D, typename point_t>
-int KDTree<D, point_t>::NearestNeighborSearch(const point_t& searchPoint)
+typename KDTree<D, point_t>::index_t KDTree<D, point_t>::NumNodes(index_t n)
 {
-    KDTree::index_t bestNode;
-    float bestDist = std::numeric_limits<float>::infinity();
-    NearestNeighborSearch(rootNode, searchPoint, 0, bestNode, bestDist);
-    return nodes[bestNode].initial_index;
+    if (n <= LEAF_SIZE) return 1;
+    index_t left = n / 2;
+    return 1 + NumNodes(left) + NumNodes(n - left);
 }
 
-
 template <int D, typename point_t>
-void KDTree<D, point_t>::NearestNeighborSearch(index_t currentNode, const point_t& searchPoint, axis_t currentAxis,
-                                               index_t& bestNode, float& bestDist)
+int KDTree<D, point_t>::SplitAxis(const std::vector<point_t>& input, index_t begin, index_t end) const
 {
-    if (currentNode == -1) return;
+    point_t min_p = input[initial_index[begin]];
+    point_t max_p = min_p;
+    for (index_t i = begin + 1; i < end; ++i)
+    {
+        auto& p = input[initial_index[i]];
+        for (int d = 0; d < D; ++d)
+        {
+            min_p[d] = std::min(min_p[d], p[d]);
+            max_p[d] = std::max(max_p[d], p[d]);
+        }
+    }
 
-    // calculate distance to current point and update the current best
-    float d = distance(nodes[currentNode].p, searchPoint);
-    if (d < bestDist)
+    int axis = 0;
+    for (int d = 1; d < D; ++d)
     {
-        bestDist = d;
-        bestNode = currentNode;
+        if (max_p[d] - min_p[d] > max_p[axis] - min_p[axis]) axis = d;
     }
+    return axis;
+}
 
-    // exact match (can't get any better)
-    if (d == 0) return;
+template <int D, typename point_t>
+void KDTree<D, point_t>::make_tree(const std::vector<point_t>& input, index_t node, index_t begin, index_t end,
+                                   int parallel_depth, std::vector<index_t>* deferred)
+{
+    auto& current = nodes[node];
+    current.begin = begin;
+    current.end   = end;
 
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
+    if (parallel_depth == 0)
+    {
+        deferred->push_back(node);
+        return;
+    }
 
-    currentAxis = (currentAxis + 1) % D;
+    index_t n = end - begin;
+    if (n <= LEAF_SIZE)
+    {
+        current.axis = -1;
+        return;
+    }
+
+    int axis      = SplitAxis(input, begin, end);
+    index_t split = begin + n / 2;
 
-    // first traverse the subtree in which the point lays
-    NearestNeighborSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, currentAxis,
-                          bestNode, bestDist);
+    // Median split. Left: all points <= split, right: all points >= split
+    std::nth_element(initial_index.begin() + begin, initial_index.begin() + split, initial_index.begin() + end,
+                     [&](index_t a, index_t b) { return input[a][axis] < input[b][axis]; });
 
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= bestDist) return;
+    current.axis  = axis;
+    current.split = input[initial_index[split]][axis];
+    current.right = node + 1 + NumNodes(split - begin);
 
-    // there may be a better point in this subtree
-    NearestNeighborSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, currentAxis,
-                          bestNode, bestDist);
+    make_tree(input, node + 1, begin, split, parallel_depth - 1, deferred);
+    make_tree(input, current.right, split, end, parallel_depth - 1, deferred);
 }
 
+template <int D, typename point_t>
+int KDTree<D, point_t>::NearestNeighborSearch(const point_t& searchPoint) const
+{
+    auto result = KNearestNeighborSearch(searchPoint, 1);
+    return result.empty() ? -1 : result.front();
+}
 
 template <int D, typename point_t>
-std::vector<int> KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k)
+std::vector<int> KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k) const
 {
-    queue_t queue(k);
-    for (auto& p : queue)
-    {
-        p.second = -1;
-        p.first  = 3467369476;
-    }
-    KNearestNeighborSearch(rootNode, searchPoint, k, 0, queue);
+    queue_t queue;
+    KNearestNeighborSearch(searchPoint, k, queue);
 
-    std::vector<int> points;
-    for (auto& p : queue)
+    std::vector<int> result(queue.size());
+    for (size_t i = 0; i < queue.size(); ++i)
     {
-        if (p.second != -1)
-        {
-            points.push_back(nodes[p.second].initial_index);
-        }
+        result[i] = initial_index[queue[i].second];
     }
-    return points;
+    return result;
 }
 
-
 template <int D, typename point_t>
-void KDTree<D, point_t>::KNearestNeighborSearch(index_t currentNode, const point_t& searchPoint, int k,
-                                                axis_t currentAxis, queue_t& queue)
+void KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k, queue_t& queue) const
 {
-    if (currentNode == -1) return;
-
-    // calculate distance to current point and update the current best
-    float d     = distance(nodes[currentNode].p, searchPoint);
-    float lastD = addToQueue(queue, currentNode, d);
-
-
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
-
-    currentAxis = (currentAxis + 1) % D;
+    // The queue is sorted by distance and contains at most k elements
+    queue.clear();
+    queue.reserve(k + 1);
+    if (nodes.empty() || k <= 0) return;
+    auto worst = [&]() { return (int)queue.size() < k ? std::numeric_limits<float>::infinity() : queue.back().first; };
+
+    // (node, squared distance of the search point to the node's half space)
+    std::pair<index_t, float> stack[64];
+    int stack_size = 0;
+
+    stack[stack_size++] = {0, 0.f};
+    while (stack_size > 0)
+    {
+        auto [node_id, node_dist] = stack[--stack_size];
+        if (node_dist >= worst()) continue;
 
-    // first traverse the subtree in which the point lays
-    KNearestNeighborSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, k, currentAxis,
-                           queue);
+        // Walk down to the leaf. The far children are pushed to the stack.
+        const kd_node_t* node = &nodes[node_id];
+        while (node->axis >= 0)
+        {
+            float d             = searchPoint[node->axis] - node->split;
+            index_t near_id     = d < 0 ? node_id + 1 : node->right;
+            index_t far_id      = d < 0 ? node->right : node_id + 1;
+            stack[stack_size++] = {far_id, d * d};
+            node_id             = near_id;
+            node                = &nodes[node_id];
+        }
 
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= lastD) return;
+        for (index_t i = node->begin; i < node->end; ++i)
+        {
+            float dist = distance(points[i], searchPoint);
+            if (dist >= worst()) continue;
 
-    // there may be a better point in this subtree
-    KNearestNeighborSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, k, currentAxis,
-                           queue);
+            // Insertion into the sorted queue
+            auto it = std::upper_bound(queue.begin(), queue.end(), std::make_pair(dist, i));
+            queue.insert(it, {dist, i});
+            if ((int)queue.size() > k) queue.pop_back();
+        }
+    }
+}
 
-    //    nearestNeighbour(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, currentAxis
-    //    ,bestNode,  bestDist);
+template <int D, typename point_t>
+std::vector<int> KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float r) const
+{
+    std::vector<int> result;
+    RadiusSearch(searchPoint, r * r, result);
+    std::sort(result.begin(), result.end());
+    return result;
 }
 
 template <int D, typename point_t>
-float KDTree<D, point_t>::addToQueue(queue_t& queue, index_t currentNode, float distance)
+void KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float r2, std::vector<int>& result) const
 {
-    float lastD = queue[queue.size() - 1].first;
-    if (distance >= lastD) return lastD;
+    if (nodes.empty()) return;
 
-    queue[queue.size() - 1].first  = distance;
-    queue[queue.size() - 1].second = currentNode;
+    index_t stack[64];
+    int stack_size = 0;
 
-    std::sort(queue.begin(), queue.end());
+    stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        index_t node_id       = stack[--stack_size];
+        const kd_node_t* node = &nodes[node_id];
 
+        if (node->axis < 0)
+        {
+            for (index_t i = node->begin; i < node->end; ++i)
+            {
+                if (distance(points[i], searchPoint) < r2) result.push_back(initial_index[i]);
+            }
+            continue;
+        }
 
-    return queue[queue.size() - 1].first;
+        float d = searchPoint[node->axis] - node->split;
+        // The left subtree contains all points <= split and the right all points >= split
+        if (d < 0 || d * d < r2) stack[stack_size++] = node_id + 1;
+        if (d >= 0 || d * d < r2) stack[stack_size++] = node->right;
+    }
 }
 
-
 template <int D, typename point_t>
-void KDTree<D, point_t>::RadiusSearch(index_t currentNode, const point_t& searchPoint, float r, axis_t currentAxis,
-                                      std::vector<int>& result)
+std::vector<int> KDTree<D, point_t>::NearestNeighborSearch(const std::vector<point_t>& searchPoints) const
 {
-    if (currentNode == -1) return;
-
-    // calculate distance to current point and update the current best
-    float d = distance(nodes[currentNode].p, searchPoint);
-    if (d < r)
+    std::vector<int> result(searchPoints.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int)searchPoints.size(); ++i)
     {
-        result.push_back(nodes[currentNode].initial_index);
+        result[i] = NearestNeighborSearch(searchPoints[i]);
     }
-
-
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
-
-    currentAxis = (currentAxis + 1) % D;
-
-    // first traverse the subtree in which the point lies
-    RadiusSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, r, currentAxis, result);
-
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= r) return;
-
-    // there may be a better point in this subtree
-    RadiusSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, r, currentAxis, result);
+    return result;
 }
 
-
 template <int D, typename point_t>
-std::vector<int> KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float r)
+std::vector<std::vector<int>> KDTree<D, point_t>::KNearestNeighborSearch(const std::vector<point_t>& searchPoints,
+                                                                         int k) const
 {
-    std::vector<int> points;
-    RadiusSearch(rootNode, searchPoint, r * r, 0, points);
-    std::sort(points.begin(), points.end());
-    return points;
+    std::vector<std::vector<int>> result(searchPoints.size());
+#pragma omp parallel
+    {
+        queue_t queue;
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < (int)searchPoints.size(); ++i)
+        {
+            KNearestNeighborSearch(searchPoints[i], k, queue);
+            result[i].resize(queue.size());
+            for (size_t j = 0; j < queue.size(); ++j)
+            {
+                result[i][j] = initial_index[queue[j].second];
+            }
+        }
+    }
+    return result;
 }
 
-
+template <int D, typename point_t>
+std::vector<std::vector<int>> KDTree<D, point_t>::RadiusSearch(const std::vector<point_t>& searchPoints,
+                                                               float radius) const
+{
+    std::vector<std::vector<int>> result(searchPoints.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int)searchPoints.size(); ++i)
+    {
+        RadiusSearch(searchPoints[i], radius * radius, result[i]);
+        std::sort(result[i].begin(), result[i].end());
+    }
+    return result;
+}
 
 template <int D, typename point_t>
-float KDTree<D, point_t>::distance(point_t a, point_t b)
+float KDTree<D, point_t>::distance(const point_t& a, const point_t& b)
 {
     // use the squared distance so we don't have to calculate the sqrt
     point_t tmp = a - b;
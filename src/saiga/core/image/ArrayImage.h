@@ -25,14 +25,15 @@ class ArrayImage : public ImageBase
 
     ImageView<T> getImageView()
     {
-        ImageView<T> res(*this);
+        // Cast to the base, because the conversion operator below would call this function again.
+        ImageView<T> res(static_cast<const ImageBase&>(*this));
         res.data = data();
         return res;
     }
 
     ImageView<const T> getConstImageView() const
     {
-        ImageView<const T> res(*this);
+        ImageView<const T> res(static_cast<const ImageBase&>(*this));
         res.data = data();
         return res;
     }
@@ -12,6 +12,9 @@
 
 #include "templatedImage.h"
 
+#include <cstring>
+#include <vector>
+
 namespace Saiga
 {
 namespace ImageTransformation
@@ -224,7 +227,183 @@ void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst)
     }
 }
 
+// Maps i to [0, n) by mirroring at the first and last element without repeating it.
+static inline int Reflect101(int i, int n)
+{
+    if (n == 1) return 0;
+    while (i < 0 || i >= n)
+    {
+        i = i < 0 ? -i : 2 * n - 2 - i;
+    }
+    return i;
+}
+
+void ResizeLinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst)
+{
+    SAIGA_ASSERT(!src.empty() && !dst.empty());
+    constexpr int bits = 11;
+    constexpr int one  = 1 << bits;
+    const int cols     = dst.cols;
+
+    const float scale_x = float(src.cols) / dst.cols;
+    const float scale_y = float(src.rows) / dst.rows;
+
+    // Source index and weight of the left pixel
+    auto mapping = [](int i, float scale, int n, int& index, int& weight) {
+        float f = (i + 0.5f) * scale - 0.5f;
+        index   = int(std::floor(f));
+        f -= index;
+        if (index < 0)
+        {
+            index = 0;
+            f     = 0;
+        }
+        if (index >= n - 1)
+        {
+            index = n - 1;
+            f     = 0;
+        }
+        weight = one - iRound(f * one);
+    };
+
+    std::vector<int> x0(cols), x1(cols), wx0(cols), wx1(cols);
+    for (int x = 0; x < cols; ++x)
+    {
+        int w;
+        mapping(x, scale_x, src.cols, x0[x], w);
+        x1[x]  = std::min(x0[x] + 1, src.cols - 1);
+        wx0[x] = w;
+        wx1[x] = one - w;
+    }
+
+    // The horizontally interpolated source rows. Consecutive output rows usually share source rows.
+    std::vector<int> rows[2] = {std::vector<int>(cols), std::vector<int>(cols)};
+    int row_index[2]         = {-1, -1};
+    auto horizontal          = [&](int sy, std::vector<int>& out) {
+        const unsigned char* s = src.rowPtr(sy);
+        for (int x = 0; x < cols; ++x)
+        {
+            out[x] = s[x0[x]] * wx0[x] + s[x1[x]] * wx1[x];
+        }
+    };
+
+    for (int y = 0; y < dst.rows; ++y)
+    {
+        int sy, wy0;
+        mapping(y, scale_y, src.rows, sy, wy0);
+        int sy1 = std::min(sy + 1, src.rows - 1);
+        int wy1 = one - wy0;
 
+        if (row_index[0] != sy)
+        {
+            if (row_index[1] == sy)
+            {
+                std::swap(rows[0], rows[1]);
+                std::swap(row_index[0], row_index[1]);
+            }
+            else
+            {
+                horizontal(sy, rows[0]);
+                row_index[0] = sy;
+            }
+        }
+        if (row_index[1] != sy1)
+        {
+            horizontal(sy1, rows[1]);
+            row_index[1] = sy1;
+        }
+
+        const int* r0    = rows[0].data();
+        const int* r1    = rows[1].data();
+        unsigned char* d = dst.rowPtr(y);
+        for (int x = 0; x < cols; ++x)
+        {
+            d[x] = (r0[x] * wy0 + r1[x] * wy1 + (1 << (2 * bits - 1))) >> (2 * bits);
+        }
+    }
+}
+
+void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius, float sigma)
+{
+    SAIGA_ASSERT(src.width == dst.width && src.height == dst.height);
+    SAIGA_ASSERT(radius >= 0);
+    const int K    = 2 * radius + 1;
+    const int cols = src.cols;
+
+    // Integer kernel with sum 256
+    std::vector<float> kf(K);
+    float sum = 0;
+    for (int i = 0; i < K; ++i)
+    {
+        kf[i] = std::exp(-float((i - radius) * (i - radius)) / (2 * sigma * sigma));
+        sum += kf[i];
+    }
+    std::vector<uint16_t> kernel(K);
+    int isum = 0;
+    for (int i = 0; i < K; ++i)
+    {
+        kernel[i] = iRound(kf[i] / sum * 256);
+        isum += kernel[i];
+    }
+    kernel[radius] += 256 - isum;
+
+    // Vertical pass into a padded row, then horizontal pass.
+    // The vertical sums are at most 255 * 256 and fit into 16 bit.
+    std::vector<uint16_t> tmp(cols + 2 * radius);
+    std::vector<uint32_t> acc(cols);
+    uint16_t* t = tmp.data() + radius;
+
+    for (int y = 0; y < src.rows; ++y)
+    {
+        std::fill(t, t + cols, 0);
+        for (int i = 0; i < K; ++i)
+        {
+            const unsigned char* s = src.rowPtr(Reflect101(y - radius + i, src.rows));
+            uint16_t w             = kernel[i];
+            for (int x = 0; x < cols; ++x) t[x] += w * s[x];
+        }
+        for (int i = 0; i < radius; ++i)
+        {
+            t[-1 - i]   = t[Reflect101(-1 - i, cols)];
+            t[cols + i] = t[Reflect101(cols + i, cols)];
+        }
+
+        std::fill(acc.begin(), acc.end(), 1 << 15);
+        for (int i = 0; i < K; ++i)
+        {
+            const uint16_t* h = tmp.data() + i;
+            uint32_t w        = kernel[i];
+            for (int x = 0; x < cols; ++x) acc[x] += w * h[x];
+        }
+
+        unsigned char* d = dst.rowPtr(y);
+        for (int x = 0; x < cols; ++x) d[x] = acc[x] >> 16;
+    }
+}
+
+void FillBorderReflect101(ImageView<unsigned char> img, int border)
+{
+    SAIGA_ASSERT(img.rows > 2 * border && img.cols > 2 * border);
+    const int inner_rows = img.rows - 2 * border;
+    const int inner_cols = img.cols - 2 * border;
+
+    for (int y = border; y < img.rows - border; ++y)
+    {
+        unsigned char* r = img.rowPtr(y) + border;
+        for (int i = 0; i < border; ++i)
+        {
+            r[-1 - i]         = r[Reflect101(-1 - i, inner_cols)];
+            r[inner_cols + i] = r[Reflect101(inner_cols + i, inner_cols)];
+        }
+    }
+
+    for (int i = 0; i < border; ++i)
+    {
+        memcpy(img.rowPtr(border - 1 - i), img.rowPtr(border + Reflect101(-1 - i, inner_rows)), img.cols);
+        memcpy(img.rowPtr(border + inner_rows + i), img.rowPtr(border + Reflect101(inner_rows + i, inner_rows)),
+               img.cols);
+    }
+}
 
 }  // namespace ImageTransformation
 }  // namespace Saiga
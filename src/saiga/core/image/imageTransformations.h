@@ -34,6 +34,19 @@ SAIGA_CORE_API void Gray8ToRGBA(ImageView<unsigned char> src, ImageView<ucvec4>
 
 SAIGA_CORE_API void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst);
 
+// Bilinear resize with the same pixel mapping as cv::resize with INTER_LINEAR (pixel centers are aligned).
+// The interpolation weights have 11 bit fixed point precision.
+SAIGA_CORE_API void ResizeLinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst);
+
+// Separable gaussian blur with a (2 * radius + 1)^2 kernel and reflect101 border (gfedcb|abcdefgh|gfedcba).
+// The kernel weights are quantized to 8 bit. src and dst must not overlap.
+SAIGA_CORE_API void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius,
+                                 float sigma);
+
+// Fills the outer 'border' pixels of the image by mirroring the inner region at its edge (reflect101).
+// Same as cv::copyMakeBorder with BORDER_REFLECT_101, but in-place.
+SAIGA_CORE_API void FillBorderReflect101(ImageView<unsigned char> img, int border);
+
 
 SAIGA_CORE_API float sharpness(ImageView<const unsigned char> src);
 /**
@@ -8,6 +8,9 @@
 
 #include "saiga/config.h"
 
+#include <utility>
+#include <vector>
+
 namespace Saiga
 {
 /**
@@ -26,4 +29,36 @@ inline _Tp exclusive_scan(_InputIterator1 __first1, _InputIterator1 __last1, _In
 }
 
 
+/**
+ * Greedy edge coloring of a graph with n vertices. edge_vertices(k) returns the two vertices of edge k.
+ *
+ * Edges with the same color do not share a vertex. Per-vertex data (for example the diagonal blocks of a normal
+ * equation) can therefore be accumulated in parallel over the edges of one color without locks or atomics.
+ * The returned vector contains the edge ids grouped by color in increasing order.
+ */
+template <typename EdgeVertices>
+inline std::vector<std::vector<int>> greedyEdgeColoring(int n, int num_edges, EdgeVertices edge_vertices)
+{
+    std::vector<std::vector<bool>> used(n);
+    std::vector<std::vector<int>> colors;
+    for (int k = 0; k < num_edges; ++k)
+    {
+        std::pair<int, int> e = edge_vertices(k);
+        auto& ui              = used[e.first];
+        auto& uj              = used[e.second];
+
+        int c = 0;
+        while ((c < (int)ui.size() && ui[c]) || (c < (int)uj.size() && uj[c])) ++c;
+
+        if (c >= (int)ui.size()) ui.resize(c + 1, false);
+        if (c >= (int)uj.size()) uj.resize(c + 1, false);
+        ui[c] = true;
+        uj[c] = true;
+
+        if (c >= (int)colors.size()) colors.resize(c + 1);
+        colors[c].push_back(k);
+    }
+    return colors;
+}
+
 }  // namespace Saiga
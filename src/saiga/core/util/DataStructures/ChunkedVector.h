@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/util/assert.h"
+
+#include <atomic>
+#include <memory>
+
+namespace Saiga
+{
+/**
+ * An array which is stored in fixed-size chunks of 2^CHUNK_BITS elements.
+ *
+ * In contrast to std::vector, growing does not move existing elements. Therefore references stay valid and
+ * reserve() can be called concurrently to reads and writes of already existing elements.
+ * The chunk pointers are installed with a CAS, so growing is also lock-free.
+ *
+ * Elements are default constructed when their chunk is allocated.
+ *
+ * Usage:
+ *
+ * ChunkedVector<Block> blocks;
+ * int id = counter.fetch_add(1);
+ * blocks.reserve(id + 1);  // thread-safe
+ * blocks[id] = ...;
+ */
+template <typename T, int CHUNK_BITS = 9, int MAX_CHUNKS = (1 << 15)>
+class ChunkedVector
+{
+   public:
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    ChunkedVector(size_t n = 0) : chunks(new std::atomic<T*>[MAX_CHUNKS])
+    {
+        for (int i = 0; i < MAX_CHUNKS; ++i) chunks[i].store(nullptr, std::memory_order_relaxed);
+        reserve(n);
+    }
+
+    ~ChunkedVector() { clear(); }
+
+    ChunkedVector(const ChunkedVector& other) : ChunkedVector(0) { *this = other; }
+
+    ChunkedVector& operator=(const ChunkedVector& other)
+    {
+        if (this == &other) return *this;
+        clear();
+        reserve(other.capacity());
+        for (size_t i = 0; i < other.capacity(); ++i)
+        {
+            (*this)[i] = other[i];
+        }
+        return *this;
+    }
+
+    // Makes sure that the elements [0, n) exist.
+    // Thread-safe. Existing elements are not moved.
+    void reserve(size_t n)
+    {
+        size_t required = (n + CHUNK_MASK) >> CHUNK_BITS;
+        SAIGA_ASSERT(required <= MAX_CHUNKS, "ChunkedVector: Maximum capacity reached.");
+
+        // Early exit without touching the chunk table.
+        if (required <= num_chunks.load(std::memory_order_acquire)) return;
+
+        for (size_t c = 0; c < required; ++c)
+        {
+            if (chunks[c].load(std::memory_order_acquire)) continue;
+
+            T* new_chunk = new T[CHUNK_SIZE];
+            T* expected  = nullptr;
+            if (!chunks[c].compare_exchange_strong(expected, new_chunk, std::memory_order_acq_rel))
+            {
+                // Another thread was faster
+                delete[] new_chunk;
+            }
+        }
+
+        // Chunks are always allocated from the front, so num_chunks only grows.
+        size_t current = num_chunks.load(std::memory_order_relaxed);
+        while (current < required &&
+               !num_chunks.compare_exchange_weak(current, required, std::memory_order_release,
+                                                 std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Frees all chunks which are not required to store the elements [0, n).
+    // Not thread-safe.
+    void shrink(size_t n)
+    {
+        size_t required = (n + CHUNK_MASK) >> CHUNK_BITS;
+        for (size_t c = required; c < num_chunks; ++c)
+        {
+            delete[] chunks[c].exchange(nullptr);
+        }
+        num_chunks = std::min<size_t>(num_chunks, required);
+    }
+
+    void clear() { shrink(0); }
+
+    size_t capacity() const { return num_chunks.load(std::memory_order_acquire) * CHUNK_SIZE; }
+
+    size_t Memory() const { return capacity() * sizeof(T) + MAX_CHUNKS * sizeof(T*); }
+
+    T& operator[](size_t i)
+    {
+        T* chunk = chunks[i >> CHUNK_BITS].load(std::memory_order_acquire);
+        SAIGA_DEBUG_ASSERT(chunk);
+        return chunk[i & CHUNK_MASK];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        const T* chunk = chunks[i >> CHUNK_BITS].load(std::memory_order_acquire);
+        SAIGA_DEBUG_ASSERT(chunk);
+        return chunk[i & CHUNK_MASK];
+    }
+
+   private:
+    std::unique_ptr<std::atomic<T*>[]> chunks;
+    std::atomic<size_t> num_chunks = {0};
+};
+
+}  // namespace Saiga
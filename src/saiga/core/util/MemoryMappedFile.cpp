@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "MemoryMappedFile.h"
+
+#include "saiga/core/util/assert.h"
+
+#include "internal/noGraphicsAPI.h"
+
+#if defined(_WIN32)
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace Saiga
+{
+#if defined(_WIN32)
+
+bool MemoryMappedFile::open(const std::string& file, Mode mode)
+{
+    close();
+    this->mode = mode;
+
+    DWORD access      = mode == Mode::Read ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+    DWORD disposition = mode == Mode::Read ? OPEN_EXISTING : OPEN_ALWAYS;
+    HANDLE h = CreateFileA(file.c_str(), access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    file_handle = h;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(h, &size);
+    mapped_size = size.QuadPart;
+
+    is_open = map();
+    if (!is_open) close();
+    return is_open;
+}
+
+void MemoryMappedFile::close()
+{
+    unmap();
+    if (file_handle) CloseHandle(file_handle);
+    file_handle = nullptr;
+    is_open     = false;
+    mapped_size = 0;
+}
+
+bool MemoryMappedFile::map()
+{
+    // Empty files can not be mapped
+    if (mapped_size == 0) return true;
+
+    DWORD protect  = mode == Mode::Read ? PAGE_READONLY : PAGE_READWRITE;
+    DWORD access   = mode == Mode::Read ? FILE_MAP_READ : FILE_MAP_WRITE;
+    mapping_handle = CreateFileMappingA(file_handle, NULL, protect, 0, 0, NULL);
+    if (!mapping_handle) return false;
+    mapped_data = (char*)MapViewOfFile(mapping_handle, access, 0, 0, mapped_size);
+    return mapped_data != nullptr;
+}
+
+void MemoryMappedFile::unmap()
+{
+    if (mapped_data) UnmapViewOfFile(mapped_data);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    mapped_data    = nullptr;
+    mapping_handle = nullptr;
+}
+
+bool MemoryMappedFile::resize(size_t new_size)
+{
+    SAIGA_ASSERT(is_open && mode == Mode::ReadWrite);
+    unmap();
+
+    LARGE_INTEGER size;
+    size.QuadPart = new_size;
+    if (!SetFilePointerEx(file_handle, size, NULL, FILE_BEGIN) || !SetEndOfFile(file_handle)) return false;
+    mapped_size = new_size;
+    return map();
+}
+
+void MemoryMappedFile::flush()
+{
+    if (mapped_data) FlushViewOfFile(mapped_data, mapped_size);
+}
+
+#else
+
+bool MemoryMappedFile::open(const std::string& file, Mode mode)
+{
+    close();
+    this->mode = mode;
+
+    fd = mode == Mode::Read ? ::open(file.c_str(), O_RDONLY) : ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close();
+        return false;
+    }
+    mapped_size = st.st_size;
+
+    is_open = map();
+    if (!is_open) close();
+    return is_open;
+}
+
+void MemoryMappedFile::close()
+{
+    unmap();
+    if (fd >= 0) ::close(fd);
+    fd          = -1;
+    is_open     = false;
+    mapped_size = 0;
+}
+
+bool MemoryMappedFile::map()
+{
+    // Empty files can not be mapped
+    if (mapped_size == 0) return true;
+
+    int prot  = mode == Mode::Read ? PROT_READ : (PROT_READ | PROT_WRITE);
+    void* ptr = mmap(nullptr, mapped_size, prot, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) return false;
+    mapped_data = (char*)ptr;
+    return true;
+}
+
+void MemoryMappedFile::unmap()
+{
+    if (mapped_data) munmap(mapped_data, mapped_size);
+    mapped_data = nullptr;
+}
+
+bool MemoryMappedFile::resize(size_t new_size)
+{
+    SAIGA_ASSERT(is_open && mode == Mode::ReadWrite);
+    unmap();
+    if (ftruncate(fd, new_size) != 0) return false;
+    mapped_size = new_size;
+    return map();
+}
+
+void MemoryMappedFile::flush()
+{
+    if (mapped_data) msync(mapped_data, mapped_size, MS_SYNC);
+}
+
+#endif
+
+}  // namespace Saiga
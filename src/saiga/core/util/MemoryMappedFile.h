@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include <string>
+
+namespace Saiga
+{
+/**
+ * A file which is mapped into the virtual address space.
+ * Uses mmap on unix and MapViewOfFile on windows.
+ *
+ * Usage Reading:
+ *
+ * MemoryMappedFile mf("data.bin");
+ * SAIGA_ASSERT(mf.isOpen());
+ * const Header* h = reinterpret_cast<const Header*>(mf.data());
+ *
+ * Usage Writing:
+ *
+ * MemoryMappedFile mf("data.bin", MemoryMappedFile::Mode::ReadWrite);
+ * mf.resize(1024);
+ * memcpy(mf.data(), src, 1024);
+ */
+class SAIGA_CORE_API MemoryMappedFile
+{
+   public:
+    enum class Mode
+    {
+        Read,
+        // Creates the file if it does not exist.
+        ReadWrite,
+    };
+
+    MemoryMappedFile() {}
+    MemoryMappedFile(const std::string& file, Mode mode = Mode::Read) { open(file, mode); }
+    ~MemoryMappedFile() { close(); }
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    bool open(const std::string& file, Mode mode = Mode::Read);
+    void close();
+
+    // Changes the file size and maps the new range.
+    // Only valid in ReadWrite mode. All pointers into the old mapping are invalidated.
+    bool resize(size_t new_size);
+
+    // Writes the modified pages back to the file.
+    void flush();
+
+    bool isOpen() const { return is_open; }
+    size_t size() const { return mapped_size; }
+
+    char* data() { return mapped_data; }
+    const char* data() const { return mapped_data; }
+
+   private:
+    bool map();
+    void unmap();
+
+    Mode mode          = Mode::Read;
+    bool is_open       = false;
+    char* mapped_data  = nullptr;
+    size_t mapped_size = 0;
+
+#if defined(_WIN32)
+    void* file_handle    = nullptr;
+    void* mapping_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+}  // namespace Saiga
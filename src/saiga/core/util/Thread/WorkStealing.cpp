@@ -0,0 +1,425 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "WorkStealing.h"
+
+#include "saiga/core/util/Thread/SpinLock.h"
+#include "saiga/core/util/Thread/threadName.h"
+#include "saiga/core/util/assert.h"
+
+#include <stdexcept>
+
+namespace Saiga
+{
+namespace WorkStealing
+{
+static std::atomic<size_t> num_task_allocations = {0};
+
+/**
+ * Cache of the task objects allocated by one thread.
+ *
+ * The owner pushes and pops 'head' without synchronization. Other threads return tasks with a lock-free push onto
+ * 'remote', which the owner takes completely when 'head' is empty. Because only the owner removes elements from
+ * 'remote', there is no ABA problem.
+ *
+ * The list is reference counted by the owning thread and by all task objects that belong to it. It can therefore
+ * outlive its thread, if tasks of that thread are still executed somewhere else. After the thread has exited
+ * ('orphaned'), returned tasks are deleted.
+ */
+struct TaskFreeList
+{
+    static constexpr int kMaxSize = 4096;
+
+    Task* head = nullptr;
+    int size   = 0;
+
+    std::atomic<Task*> remote = {nullptr};
+    std::atomic<bool> orphaned = {false};
+    std::atomic<int> refs      = {1};
+
+    Task* create()
+    {
+        refs.fetch_add(1, std::memory_order_relaxed);
+        num_task_allocations.fetch_add(1, std::memory_order_relaxed);
+        Task* t  = new Task();
+        t->owner = this;
+        return t;
+    }
+
+    static void destroy(Task* task)
+    {
+        TaskFreeList* owner = task->owner;
+        delete task;
+        owner->release();
+    }
+
+    void release()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    // Deletes all tasks of the remote list. Called after the owner has exited.
+    void deleteRemote()
+    {
+        Task* t = remote.exchange(nullptr, std::memory_order_acquire);
+        while (t)
+        {
+            Task* next = t->next;
+            destroy(t);
+            t = next;
+        }
+    }
+
+    void pushRemote(Task* task)
+    {
+        // After the push, a different thread can take the task and release the last reference of the list.
+        refs.fetch_add(1, std::memory_order_relaxed);
+
+        Task* old = remote.load(std::memory_order_relaxed);
+        do
+        {
+            task->next = old;
+        } while (!remote.compare_exchange_weak(old, task, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+        // Pairs with the exit of the owner: either the owner sees this task in its last deleteRemote() or we see
+        // the orphaned flag and clean up ourselves.
+        if (orphaned.load(std::memory_order_seq_cst))
+        {
+            deleteRemote();
+        }
+        release();
+    }
+};
+
+// Owns the free list of the current thread.
+struct TaskFreeListHandle
+{
+    TaskFreeList* list = new TaskFreeList();
+
+    ~TaskFreeListHandle()
+    {
+        while (list->head)
+        {
+            Task* next = list->head->next;
+            TaskFreeList::destroy(list->head);
+            list->head = next;
+        }
+        list->orphaned.store(true, std::memory_order_seq_cst);
+        list->deleteRemote();
+        list->release();
+    }
+};
+
+static thread_local TaskFreeListHandle task_free_list;
+
+Task* allocateTask()
+{
+    auto& fl = *task_free_list.list;
+    if (!fl.head)
+    {
+        // Take the tasks which were executed by other threads
+        fl.head = fl.remote.exchange(nullptr, std::memory_order_acquire);
+        for (Task* t = fl.head; t; t = t->next) fl.size++;
+    }
+    if (fl.head)
+    {
+        Task* t = fl.head;
+        fl.head = t->next;
+        fl.size--;
+        t->next = nullptr;
+        return t;
+    }
+    return fl.create();
+}
+
+void freeTask(Task* task)
+{
+    auto& fl = *task_free_list.list;
+    if (task->owner != &fl)
+    {
+        task->owner->pushRemote(task);
+        return;
+    }
+
+    // Bounded, so that a burst of tasks does not keep its memory forever. The tasks in 'remote' are not counted.
+    if (fl.size >= TaskFreeList::kMaxSize)
+    {
+        TaskFreeList::destroy(task);
+        return;
+    }
+    task->next = fl.head;
+    fl.head    = task;
+    fl.size++;
+}
+
+size_t numTaskAllocations()
+{
+    return num_task_allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace WorkStealing
+
+using WorkStealing::Task;
+
+struct SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) WorkStealingScheduler::Worker
+{
+    WorkStealing::ChaseLevDeque deque;
+    std::thread thread;
+    uint32_t rng_state;
+};
+
+static thread_local WorkStealingScheduler* tl_scheduler = nullptr;
+static thread_local int tl_worker_id                    = -1;
+
+
+WorkStealingScheduler::WorkStealingScheduler(size_t threads, const std::string& name)
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        auto w       = std::make_unique<Worker>();
+        w->rng_state = 0x9E3779B9u * (i + 1);
+        workers.push_back(std::move(w));
+    }
+
+    // Start the threads after all deques are created, because they immediately start stealing from each other.
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers[i]->thread = std::thread([this, i, name]() {
+            setThreadName(name + std::to_string(i));
+            tl_scheduler = this;
+            tl_worker_id = i;
+            workerLoop(i);
+        });
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    quit();
+}
+
+void WorkStealingScheduler::quit()
+{
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if (stop) return;
+        stop = true;
+        wake_epoch++;
+    }
+    sleep_cv.notify_all();
+    for (auto& w : workers)
+    {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+size_t WorkStealingScheduler::approximateQueueSize() const
+{
+    size_t n = 0;
+    for (auto& w : workers)
+    {
+        n += w->deque.size();
+    }
+    n += std::max(0, injected_size.load(std::memory_order_relaxed));
+    return n;
+}
+
+int WorkStealingScheduler::currentWorkerId() const
+{
+    return tl_scheduler == this ? tl_worker_id : -1;
+}
+
+void WorkStealingScheduler::submit(Task* task)
+{
+    if (workers.empty())
+    {
+        // This is an empty scheduler
+        // -> emulate single threaded behaviour
+        execute(task);
+        return;
+    }
+
+    int id = currentWorkerId();
+
+    // Workers are allowed to spawn while the remaining tasks are executed in quit().
+    if (id < 0 && stop.load(std::memory_order_relaxed))
+        throw std::runtime_error("submit on stopped WorkStealingScheduler");
+    if (id >= 0)
+    {
+        workers[id]->deque.push(task);
+    }
+    else
+    {
+        Task* head = injected.load(std::memory_order_relaxed);
+        do
+        {
+            task->next = head;
+        } while (!injected.compare_exchange_weak(head, task, std::memory_order_release, std::memory_order_relaxed));
+        injected_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in workerLoop before a worker goes to sleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) > 0)
+    {
+        wakeOne();
+    }
+}
+
+void WorkStealingScheduler::wakeOne()
+{
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_epoch++;
+    }
+    sleep_cv.notify_one();
+}
+
+bool WorkStealingScheduler::hasWork() const
+{
+    if (injected.load(std::memory_order_relaxed)) return true;
+    for (auto& w : workers)
+    {
+        if (w->deque.size() > 0) return true;
+    }
+    return false;
+}
+
+void WorkStealingScheduler::execute(Task* task)
+{
+    // The group can be destroyed as soon as the counter reaches zero.
+    // -> Don't touch the task or the group after that.
+    TaskGroup* group = task->group;
+    task->execute(task);
+    WorkStealing::freeTask(task);
+    if (group) group->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+Task* WorkStealingScheduler::steal(int worker_id)
+{
+    int n = workers.size();
+
+    // Random start to spread the thieves over the victims.
+    uint32_t r;
+    if (worker_id >= 0)
+    {
+        uint32_t& x = workers[worker_id]->rng_state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        r = x;
+    }
+    else
+    {
+        r = std::hash<std::thread::id>()(std::this_thread::get_id());
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        int victim = (r + i) % n;
+        if (victim == worker_id) continue;
+        Task* t = workers[victim]->deque.steal();
+        if (t) return t;
+    }
+    return nullptr;
+}
+
+Task* WorkStealingScheduler::takeInjected(int worker_id)
+{
+    // Only workers take the injected tasks, because the remaining tasks are moved to the local deque.
+    if (worker_id < 0 || !injected.load(std::memory_order_relaxed)) return nullptr;
+
+    Task* list = injected.exchange(nullptr, std::memory_order_acquire);
+    if (!list) return nullptr;
+
+    // The list is in LIFO order -> reverse to execute the tasks in submission order.
+    Task* reversed = nullptr;
+    int count      = 0;
+    while (list)
+    {
+        count++;
+        Task* next = list->next;
+        list->next = reversed;
+        reversed   = list;
+        list       = next;
+    }
+
+    injected_size.fetch_sub(count, std::memory_order_relaxed);
+
+    Task* first = reversed;
+    auto& deque = workers[worker_id]->deque;
+    for (Task* t = first->next; t;)
+    {
+        Task* next = t->next;
+        t->next    = nullptr;
+        deque.push(t);
+        t = next;
+    }
+    first->next = nullptr;
+    return first;
+}
+
+bool WorkStealingScheduler::executeOne(int worker_id)
+{
+    Task* t = nullptr;
+    if (worker_id >= 0) t = workers[worker_id]->deque.pop();
+    if (!t) t = takeInjected(worker_id);
+    if (!t) t = steal(worker_id);
+    if (!t) return false;
+    execute(t);
+    return true;
+}
+
+void WorkStealingScheduler::wait(TaskGroup& group)
+{
+    int id = currentWorkerId();
+    for (unsigned k = 0; !group.finished();)
+    {
+        if (executeOne(id))
+        {
+            k = 0;
+        }
+        else
+        {
+            yield(k++);
+        }
+    }
+}
+
+void WorkStealingScheduler::workerLoop(int id)
+{
+    unsigned idle = 0;
+    while (true)
+    {
+        if (executeOne(id))
+        {
+            idle = 0;
+            continue;
+        }
+
+        if (idle < 64)
+        {
+            yield(idle++);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if (stop && !hasWork()) return;
+
+        uint64_t epoch = wake_epoch;
+        sleeping.fetch_add(1, std::memory_order_relaxed);
+        // Pairs with the fence in submit.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasWork())
+        {
+            sleep_cv.wait(lock, [&]() { return wake_epoch != epoch || stop; });
+        }
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,450 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Saiga
+{
+class TaskGroup;
+class WorkStealingScheduler;
+
+namespace WorkStealing
+{
+struct TaskFreeList;
+
+/**
+ * A type-erased unit of work of the work-stealing scheduler.
+ *
+ * Closures up to kInlineSize bytes are stored directly in the task. The task objects themselves are recycled
+ * through a thread local free list. A task is returned to the list of the thread that allocated it, also if it was
+ * executed by a different thread. Therefore, spawning small tasks does not hit the global allocator, neither on the
+ * workers nor on external threads that only submit work.
+ */
+struct SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) Task
+{
+    static constexpr size_t kInlineSize = 96;
+    using ExecuteFunc                   = void (*)(Task*);
+
+    // Runs the closure and destroys it afterwards.
+    ExecuteFunc execute = nullptr;
+    TaskGroup* group    = nullptr;
+    // Intrusive link for the injection list and the free list.
+    Task* next = nullptr;
+    // The free list of the allocating thread
+    TaskFreeList* owner = nullptr;
+
+    SAIGA_ALIGN(16) unsigned char storage[kInlineSize];
+};
+
+SAIGA_CORE_API Task* allocateTask();
+SAIGA_CORE_API void freeTask(Task* task);
+
+// Number of task objects created with new since the program start.
+SAIGA_CORE_API size_t numTaskAllocations();
+
+// Stores the closure in an unused task object.
+template <typename F>
+void constructTask(Task* task, F&& f, TaskGroup* group)
+{
+    using Fn = std::decay_t<F>;
+
+    task->group = group;
+    if constexpr (sizeof(Fn) <= Task::kInlineSize && alignof(Fn) <= 16)
+    {
+        new (task->storage) Fn(std::forward<F>(f));
+        task->execute = [](Task* t) {
+            Fn* fn = std::launder(reinterpret_cast<Fn*>(t->storage));
+            (*fn)();
+            fn->~Fn();
+        };
+    }
+    else
+    {
+        // Large closure -> fall back to a heap allocation
+        new (task->storage) Fn*(new Fn(std::forward<F>(f)));
+        task->execute = [](Task* t) {
+            Fn* fn = *std::launder(reinterpret_cast<Fn**>(t->storage));
+            (*fn)();
+            delete fn;
+        };
+    }
+}
+
+template <typename F>
+Task* makeTask(F&& f, TaskGroup* group)
+{
+    Task* task = allocateTask();
+    constructTask(task, std::forward<F>(f), group);
+    return task;
+}
+
+/**
+ * The lock-free work-stealing deque from
+ *
+ * Lê, Pop, Cohen, Zappa Nardelli.
+ * Correct and Efficient Work-Stealing for Weak Memory Models. PPoPP 2013.
+ *
+ * push/pop must only be called by the owner. steal can be called by any thread.
+ */
+class ChaseLevDeque
+{
+   public:
+    ChaseLevDeque(int64_t initial_capacity = 1024)
+    {
+        arrays.push_back(std::make_unique<Array>(initial_capacity));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    void push(Task* task)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a  = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+        {
+            a = grow(a, b, t);
+        }
+        a->put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    Task* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a  = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        Task* result = nullptr;
+        if (t <= b)
+        {
+            result = a->get(b);
+            if (t == b)
+            {
+                // Last element -> race against thieves
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    result = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    Task* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t < b)
+        {
+            Array* a    = array.load(std::memory_order_acquire);
+            Task* task  = a->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return task;
+        }
+        return nullptr;
+    }
+
+    int64_t size() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return std::max<int64_t>(0, b - t);
+    }
+
+   private:
+    struct Array
+    {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<Task*>[]> buffer;
+
+        Array(int64_t capacity) : capacity(capacity), mask(capacity - 1), buffer(new std::atomic<Task*>[capacity])
+        {
+            SAIGA_ASSERT((capacity & mask) == 0);
+        }
+        // acquire/release instead of relaxed (as in the paper) is free on x86 and makes the deque TSAN-friendly.
+        Task* get(int64_t i) { return buffer[i & mask].load(std::memory_order_acquire); }
+        void put(int64_t i, Task* t) { buffer[i & mask].store(t, std::memory_order_release); }
+    };
+
+    Array* grow(Array* a, int64_t b, int64_t t)
+    {
+        auto na = std::make_unique<Array>(a->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+        {
+            na->put(i, a->get(i));
+        }
+        // Thieves might still read from the old array -> keep it alive until the deque is destroyed.
+        arrays.push_back(std::move(na));
+        array.store(arrays.back().get(), std::memory_order_release);
+        return arrays.back().get();
+    }
+
+    SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) std::atomic<int64_t> top = {0};
+    SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) std::atomic<int64_t> bottom = {0};
+    SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) std::atomic<Array*> array = {nullptr};
+    std::vector<std::unique_ptr<Array>> arrays;
+};
+
+}  // namespace WorkStealing
+
+
+/**
+ * A set of tasks that can be waited on.
+ * The destructor waits until all tasks of this group are finished.
+ *
+ * Usage:
+ *
+ * TaskGroup group(scheduler);
+ * group.run([&]() { left(); });
+ * group.run([&]() { right(); });
+ * group.wait();
+ *
+ * Tasks must not throw. Use WorkStealingScheduler::enqueue if you need the result or exception in a future.
+ */
+class TaskGroup
+{
+   public:
+    explicit TaskGroup(WorkStealingScheduler& scheduler) : scheduler(scheduler) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename F>
+    void run(F&& f);
+
+    // Blocks until all tasks are finished. The calling thread helps executing pending tasks.
+    void wait();
+
+    bool finished() const { return pending.load(std::memory_order_acquire) == 0; }
+
+   private:
+    friend class WorkStealingScheduler;
+    WorkStealingScheduler& scheduler;
+    std::atomic<int> pending = {0};
+};
+
+
+/**
+ * A work-stealing task scheduler.
+ *
+ * Every worker owns a Chase-Lev deque. New tasks are pushed to the bottom of the local deque and idle workers
+ * steal from the top of other deques. Tasks submitted from outside the pool are pushed to a lock-free injection
+ * list, which is drained by the workers.
+ *
+ * Compared to the central queue of the ThreadPool this scales to many small tasks and supports fork/join
+ * parallelism (see TaskGroup, parallel_for and parallel_reduce), because waiting threads execute pending tasks.
+ *
+ * The ThreadPool (and therefore also the globalThreadPool) can use this scheduler as a backend.
+ * See ThreadPoolScheduler.
+ */
+class SAIGA_CORE_API WorkStealingScheduler
+{
+   public:
+    WorkStealingScheduler(size_t threads, const std::string& name = "WorkStealing");
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    // Executes all remaining tasks and joins the worker threads.
+    void quit();
+
+    size_t numThreads() const { return workers.size(); }
+
+    // Number of workers, which are currently not sleeping.
+    size_t activeThreads() const { return workers.size() - sleeping.load(std::memory_order_relaxed); }
+
+    // Approximated number of tasks that are waiting for execution.
+    size_t approximateQueueSize() const;
+
+    // Fire and forget.
+    template <typename F>
+    void spawn(F&& f)
+    {
+        submit(WorkStealing::makeTask(std::forward<F>(f), nullptr));
+    }
+
+    // Same interface as ThreadPool::enqueue.
+    template <class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>;
+
+    /**
+     * Calls f(i) for all i in [begin, end).
+     * The range is recursively split in halves until the size is below 'grain'.
+     * A grain size <= 0 creates approximately 8 tasks per thread.
+     */
+    template <typename F>
+    void parallel_for(int begin, int end, F&& f, int grain = 0);
+
+    /**
+     * Parallel reduction over [begin, end).
+     * f(i, partial) accumulates element i into the partial result of the current chunk.
+     * The partial results are combined in a deterministic order with reduce(T, T) -> T.
+     */
+    template <typename T, typename F, typename R>
+    T parallel_reduce(int begin, int end, const T& identity, F&& f, R&& reduce, int grain = 0);
+
+    // Pushes the task to the local deque (if called from a worker) or to the injection list.
+    void submit(WorkStealing::Task* task);
+
+    // Executes tasks until the group is finished.
+    void wait(TaskGroup& group);
+
+   private:
+    struct Worker;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Lock-free list of tasks submitted from outside threads
+    std::atomic<WorkStealing::Task*> injected = {nullptr};
+    std::atomic<int> injected_size            = {0};
+
+    std::atomic<int> sleeping = {0};
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    uint64_t wake_epoch = 0;
+    std::atomic<bool> stop = {false};
+
+    void workerLoop(int id);
+    int currentWorkerId() const;
+    bool hasWork() const;
+    void wakeOne();
+
+    // Pops or steals a single task and executes it.
+    // Returns false if no task was found.
+    bool executeOne(int worker_id);
+    WorkStealing::Task* steal(int worker_id);
+    WorkStealing::Task* takeInjected(int worker_id);
+    void execute(WorkStealing::Task* task);
+
+    int defaultGrain(int n) const
+    {
+        int parts = std::max<int>(1, numThreads()) * 8;
+        return std::max(1, n / parts);
+    }
+
+    template <typename F>
+    void parallelForRecursive(int begin, int end, int grain, F& f, TaskGroup& group);
+};
+
+
+template <typename F>
+void TaskGroup::run(F&& f)
+{
+    pending.fetch_add(1, std::memory_order_relaxed);
+    scheduler.submit(WorkStealing::makeTask(std::forward<F>(f), this));
+}
+
+inline void TaskGroup::wait()
+{
+    if (!finished()) scheduler.wait(*this);
+}
+
+
+template <class F, class... Args>
+auto WorkStealingScheduler::enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    using return_type = typename std::result_of<F(Args...)>::type;
+    // The packaged task is moved into the inline storage of the task object.
+    std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<return_type> res = task.get_future();
+    spawn([task = std::move(task)]() mutable { task(); });
+    return res;
+}
+
+template <typename F>
+void WorkStealingScheduler::parallel_for(int begin, int end, F&& f, int grain)
+{
+    if (end <= begin) return;
+    if (grain <= 0) grain = defaultGrain(end - begin);
+
+    TaskGroup group(*this);
+    parallelForRecursive(begin, end, grain, f, group);
+    group.wait();
+}
+
+template <typename F>
+void WorkStealingScheduler::parallelForRecursive(int begin, int end, int grain, F& f, TaskGroup& group)
+{
+    // Push the right half to the local deque, so it can be stolen, and continue with the left half.
+    while (end - begin > grain)
+    {
+        int mid = begin + (end - begin) / 2;
+        group.run([this, mid, end, grain, &f, &group]() { parallelForRecursive(mid, end, grain, f, group); });
+        end = mid;
+    }
+    for (int i = begin; i < end; ++i)
+    {
+        f(i);
+    }
+}
+
+template <typename T, typename F, typename R>
+T WorkStealingScheduler::parallel_reduce(int begin, int end, const T& identity, F&& f, R&& reduce, int grain)
+{
+    if (end <= begin) return identity;
+    if (grain <= 0) grain = defaultGrain(end - begin);
+
+    // One cache line per partial result to avoid false sharing.
+    // This also prevents the bit packing of std::vector<bool>, which would be a data race.
+    struct SAIGA_ALIGN(SAIGA_CACHE_LINE_SIZE) Partial
+    {
+        T value;
+    };
+
+    int chunks = (end - begin + grain - 1) / grain;
+    std::vector<Partial> partials(chunks, Partial{identity});
+    parallel_for(
+        0, chunks,
+        [&](int c) {
+            int b      = begin + c * grain;
+            int e      = std::min(end, b + grain);
+            T& partial = partials[c].value;
+            for (int i = b; i < e; ++i)
+            {
+                f(i, partial);
+            }
+        },
+        1);
+
+    T result = identity;
+    for (auto& p : partials)
+    {
+        result = reduce(result, p.value);
+    }
+    return result;
+}
+
+}  // namespace Saiga
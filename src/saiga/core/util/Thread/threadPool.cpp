@@ -32,28 +32,35 @@
 
 namespace Saiga
 {
-ThreadPool::ThreadPool(size_t threads, const std::string& name) : name(name), stop(false)
+ThreadPool::ThreadPool(size_t threads, const std::string& name, ThreadPoolScheduler scheduler)
+    : name(name), stop(false)
 {
+    if (scheduler == ThreadPoolScheduler::WorkStealing)
+    {
+        work_stealing = std::make_unique<WorkStealingScheduler>(threads, name);
+        return;
+    }
+
     workingThreads = threads;
     for (size_t i = 0; i < threads; ++i)
     {
         workers.emplace_back([this, i, name] {
             setThreadName(name + std::to_string(i));
+            WorkStealing::Task* task = nullptr;
             for (;;)
             {
-                std::function<void()> task;
-
                 {
                     std::unique_lock<std::mutex> lock(this->queue_mutex);
+                    if (task) free_tasks.push_back(task);
                     workingThreads--;
                     this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
                     if (this->stop && this->tasks.empty()) return;
                     workingThreads++;
-                    task = std::move(this->tasks.front());
+                    task = this->tasks.front();
                     this->tasks.pop();
                 }
 
-                task();
+                task->execute(task);
             }
         });
     }
@@ -66,6 +73,12 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::quit()
 {
+    if (work_stealing)
+    {
+        work_stealing->quit();
+        return;
+    }
+
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         if (stop) return;
@@ -74,11 +87,14 @@ void ThreadPool::quit()
     condition.notify_all();
     for (std::thread& worker : workers) worker.join();
     workers.clear();
+
+    for (auto t : free_tasks) delete t;
+    free_tasks.clear();
 }
 
 std::unique_ptr<ThreadPool> globalThreadPool;
 
-void createGlobalThreadPool(int threads)
+void createGlobalThreadPool(int threads, ThreadPoolScheduler scheduler)
 {
     if (threads < 0)
     {
@@ -94,7 +110,7 @@ void createGlobalThreadPool(int threads)
     }
 
     SAIGA_ASSERT(!globalThreadPool);
-    globalThreadPool = std::make_unique<ThreadPool>(threads, "GlobalTP");
+    globalThreadPool = std::make_unique<ThreadPool>(threads, "GlobalTP", scheduler);
 }
 
 
@@ -26,6 +26,7 @@
 #pragma once
 
 #include "saiga/config.h"
+#include "saiga/core/util/Thread/WorkStealing.h"
 
 #include <functional>
 #include <future>
@@ -40,10 +41,19 @@
 
 namespace Saiga
 {
+enum class ThreadPoolScheduler
+{
+    // A single queue protected by a mutex.
+    CentralQueue,
+    // Per-worker deques with stealing. See WorkStealingScheduler.
+    WorkStealing,
+};
+
 class SAIGA_CORE_API ThreadPool
 {
    public:
-    ThreadPool(size_t threads, const std::string& name = "ThreadPool");
+    ThreadPool(size_t threads, const std::string& name = "ThreadPool",
+               ThreadPoolScheduler scheduler = ThreadPoolScheduler::CentralQueue);
     ~ThreadPool();
 
     template <class F, class... Args>
@@ -53,19 +63,28 @@ class SAIGA_CORE_API ThreadPool
 
     size_t queueSize()
     {
+        if (work_stealing) return work_stealing->approximateQueueSize();
         std::unique_lock<std::mutex> lock(queue_mutex);
         return tasks.size();
     }
-    size_t getWorkingThreads() { return workingThreads; }
+    size_t getWorkingThreads() { return work_stealing ? work_stealing->activeThreads() : workingThreads; }
+
+    // Returns nullptr if this pool uses the central queue.
+    // Can be used for fork/join parallelism with TaskGroup, parallel_for and parallel_reduce.
+    WorkStealingScheduler* workStealingScheduler() { return work_stealing.get(); }
 
    private:
+    std::unique_ptr<WorkStealingScheduler> work_stealing;
+
     // number of currently working threads
     size_t workingThreads = 0;
     std::string name;
     // need to keep track of threads so we can join them
     std::vector<std::thread> workers;
     // the task queue
-    std::queue<std::function<void()> > tasks;
+    std::queue<WorkStealing::Task*> tasks;
+    // executed task objects, which are reused by enqueue
+    std::vector<WorkStealing::Task*> free_tasks;
 
     // synchronization
     std::mutex queue_mutex;
@@ -79,17 +98,24 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::res
     using return_type = typename std::result_of<F(Args...)>::type;
 
 
-    auto task = std::make_shared<std::packaged_task<return_type()> >(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    std::future<return_type> res = task->get_future();
+    std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<return_type> res = task.get_future();
 
+    // The packaged task is moved into the inline storage of a recycled task object.
+    auto run = [task = std::move(task)]() mutable { task(); };
+
+    if (work_stealing)
+    {
+        work_stealing->spawn(std::move(run));
+        return res;
+    }
 
     if (workers.size() == 0)
     {
         // This is an empty thread pool
         // -> execute this task here without adding it to the queue
         // -> emulate single threaded behaviour
-        (*task)();
+        run();
         return res;
     }
 
@@ -100,7 +126,18 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::res
         // don't allow enqueueing after stopping the pool
         if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
 
-        tasks.emplace([task]() { (*task)(); });
+        WorkStealing::Task* t;
+        if (free_tasks.empty())
+        {
+            t = new WorkStealing::Task();
+        }
+        else
+        {
+            t = free_tasks.back();
+            free_tasks.pop_back();
+        }
+        WorkStealing::constructTask(t, std::move(run), nullptr);
+        tasks.push(t);
     }
     condition.notify_one();
     return res;
@@ -113,6 +150,7 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::res
  * -1 initializes the thread count with omp_get_thread_num
  */
 extern SAIGA_CORE_API std::unique_ptr<ThreadPool> globalThreadPool;
-extern SAIGA_CORE_API void createGlobalThreadPool(int threads = -1);
+extern SAIGA_CORE_API void createGlobalThreadPool(int threads                 = -1,
+                                                  ThreadPoolScheduler scheduler = ThreadPoolScheduler::CentralQueue);
 
 }  // namespace Saiga
@@ -14,6 +14,16 @@ void BAOptions::imgui()
 {
     ImGui::InputFloat("huberMono", &huberMono);
     ImGui::InputFloat("huberStereo", &huberStereo);
+
+    int currentItem             = (int)precision;
+    static const char* items[2] = {"Double", "Mixed"};
+    ImGui::Combo("Precision", &currentItem, items, 2);
+    precision = (Precision)currentItem;
+    if (precision == Precision::Mixed)
+    {
+        ImGui::InputInt("refinement_iterations", &refinement_iterations);
+    }
+    ImGui::Checkbox("matrix_free_schur", &matrix_free_schur);
 }
 
 
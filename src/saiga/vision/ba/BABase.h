@@ -22,6 +22,25 @@ struct SAIGA_VISION_API BAOptions
     int helper_threads = 1;
     int solver_threads = 1;
 
+    // Scalar type of the normal equations in the recursive solver (BARec).
+    //  Double: Everything in double precision.
+    //  Mixed:  The blocks of J^T J are accumulated and solved in float, which halves the memory traffic of the
+    //          Schur complement and the PCG. The right hand side, the cost and the solution stay in double. The
+    //          solution is improved with 'refinement_iterations' steps of iterative refinement. A step that
+    //          increases the residual is reverted.
+    enum class Precision : int
+    {
+        Double = 0,
+        Mixed  = 1
+    };
+    Precision precision       = Precision::Double;
+    int refinement_iterations = 0;
+
+    // Iterative solver of BARec only. Solves the Schur complement system with PCG without building any matrix
+    // except the inverted point blocks. Use this for large problems with a dense co-visibility graph, where
+    // buildExplizitSchur runs out of memory. Overrides buildExplizitSchur.
+    bool matrix_free_schur = false;
+
     void imgui();
 };
 
@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "FastDetector.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace Saiga
+{
+// Bresenham circle of radius 3 in the same order as OpenCV.
+static constexpr int circle_x[16] = {0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+static constexpr int circle_y[16] = {3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1, 0, 1, 2, 3};
+
+// The largest threshold for which p is a corner. Negative if it is not a corner for threshold 0.
+// The minimum of all 16 arcs of length 9 is computed by combining the minima of arcs with length 2, 4 and 8.
+static inline int CornerScore(const unsigned char* p, const int* offsets)
+{
+    int center = p[0];
+    int d[32];
+    for (int k = 0; k < 16; ++k) d[k] = p[offsets[k]] - center;
+    for (int k = 0; k < 16; ++k) d[16 + k] = d[k];
+
+    int best = 0;
+    for (int sign = -1; sign <= 1; sign += 2)
+    {
+        int m2[32], m4[32], m8[16];
+        for (int k = 0; k < 31; ++k) m2[k] = std::min(sign * d[k], sign * d[k + 1]);
+        for (int k = 0; k < 29; ++k) m4[k] = std::min(m2[k], m2[k + 2]);
+        for (int k = 0; k < 16; ++k) m8[k] = std::min(m4[k], m4[k + 4]);
+        for (int k = 0; k < 16; ++k) best = std::max(best, std::min(m8[k], sign * d[k + 8]));
+    }
+    return best - 1;
+}
+
+// Every arc of 9 pixels contains two neighboring compass points (0, 4, 8, 12).
+static inline bool CompassTest(const unsigned char* p, const int* offsets, int threshold)
+{
+    int center = p[0];
+    int hi = center + threshold, lo = center - threshold;
+    int v0 = p[offsets[0]], v4 = p[offsets[4]], v8 = p[offsets[8]], v12 = p[offsets[12]];
+
+    bool b0 = v0 > hi, b4 = v4 > hi, b8 = v8 > hi, b12 = v12 > hi;
+    bool d0 = v0 < lo, d4 = v4 < lo, d8 = v8 < lo, d12 = v12 < lo;
+    return (b0 & b4) | (b4 & b8) | (b8 & b12) | (b12 & b0) | (d0 & d4) | (d4 & d8) | (d8 & d12) | (d12 & d0);
+}
+
+void FastDetector::Detect(ImageView<const unsigned char> image, std::vector<KeyPoint<float>>& keypoints,
+                          int row_begin, int row_end)
+{
+    if (image.rows < 7 || image.cols < 7) return;
+    row_begin = std::max(row_begin, 3);
+    row_end   = std::min(row_end, image.rows - 3);
+    if (row_begin >= row_end) return;
+
+    // With non-maximum suppression the scores of the neighboring rows are required as well.
+    // The score buffer stores the rows [score_begin - 1, score_end + 1).
+    const int margin      = nonmax_suppression ? 1 : 0;
+    const int score_begin = std::max(row_begin - margin, 3);
+    const int score_end   = std::min(row_end + margin, image.rows - 3);
+
+    const int t = std::min(std::max(threshold, 0), 254);
+
+    int offsets[16];
+    for (int k = 0; k < 16; ++k) offsets[k] = circle_y[k] * image.pitchBytes + circle_x[k];
+
+    if (nonmax_suppression) scores.assign((score_end - score_begin + 2) * image.cols, 0);
+    auto score_ptr = [&](int x, int y) { return scores.data() + (y - score_begin + 1) * image.cols + x; };
+
+    const size_t first = keypoints.size();
+
+    auto add = [&](int x, int y, int score) {
+        if (y >= row_begin && y < row_end) keypoints.emplace_back(float(x), float(y), 7.f, -1.f, float(score));
+        if (nonmax_suppression) *score_ptr(x, y) = score + 1;
+    };
+
+    for (int y = score_begin; y < score_end; ++y)
+    {
+        const unsigned char* row = image.rowPtr(y);
+        int x                    = 3;
+
+#if defined(__SSE2__)
+        // 16 pixels at once. The unsigned comparisons are done on signed values shifted by 128.
+        // The compass test rejects most pixels before the score is computed.
+        const __m128i sign = _mm_set1_epi8(char(0x80));
+        const __m128i th   = _mm_set1_epi8(char(t));
+        for (; x + 16 <= image.cols - 3; x += 16)
+        {
+            const unsigned char* p = row + x;
+            __m128i v              = _mm_loadu_si128((const __m128i*)p);
+            __m128i hi             = _mm_xor_si128(_mm_adds_epu8(v, th), sign);
+            __m128i lo             = _mm_xor_si128(_mm_subs_epu8(v, th), sign);
+
+            __m128i c[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                c[k] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + offsets[k * 4])), sign);
+            }
+
+            __m128i b[4], d[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                b[k] = _mm_cmpgt_epi8(c[k], hi);
+                d[k] = _mm_cmpgt_epi8(lo, c[k]);
+            }
+
+            __m128i m = _mm_setzero_si128();
+            for (int k = 0; k < 4; ++k)
+            {
+                m = _mm_or_si128(m, _mm_and_si128(b[k], b[(k + 1) % 4]));
+                m = _mm_or_si128(m, _mm_and_si128(d[k], d[(k + 1) % 4]));
+            }
+
+            if (_mm_movemask_epi8(m) == 0) continue;
+
+            // Same as CornerScore() but for 16 pixels with saturated differences
+            __m128i brighter[16], darker[16];
+            for (int k = 0; k < 16; ++k)
+            {
+                __m128i ck  = _mm_loadu_si128((const __m128i*)(p + offsets[k]));
+                brighter[k] = _mm_subs_epu8(ck, v);
+                darker[k]   = _mm_subs_epu8(v, ck);
+            }
+            __m128i score = _mm_setzero_si128();
+            for (__m128i* diff : {brighter, darker})
+            {
+                __m128i m2[16], m4[16];
+                for (int k = 0; k < 16; ++k) m2[k] = _mm_min_epu8(diff[k], diff[(k + 1) % 16]);
+                for (int k = 0; k < 16; ++k) m4[k] = _mm_min_epu8(m2[k], m2[(k + 2) % 16]);
+                for (int k = 0; k < 16; ++k)
+                {
+                    __m128i m9 = _mm_min_epu8(_mm_min_epu8(m4[k], m4[(k + 4) % 16]), diff[(k + 8) % 16]);
+                    score      = _mm_max_epu8(score, m9);
+                }
+            }
+
+            // score - 1 >= t
+            int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_xor_si128(score, sign), _mm_xor_si128(th, sign)));
+            alignas(16) unsigned char block_score[16];
+            _mm_store_si128((__m128i*)block_score, score);
+            while (mask)
+            {
+                int i = __builtin_ctz(mask);
+                mask &= mask - 1;
+                add(x + i, y, block_score[i] - 1);
+            }
+        }
+#endif
+        for (; x < image.cols - 3; ++x)
+        {
+            if (!CompassTest(row + x, offsets, t)) continue;
+            int score = CornerScore(row + x, offsets);
+            if (score >= t) add(x, y, score);
+        }
+    }
+
+    if (!nonmax_suppression) return;
+
+    // A corner survives if its score is strictly larger than the scores of all 8 neighbors.
+    auto out = keypoints.begin() + first;
+    for (auto it = keypoints.begin() + first; it != keypoints.end(); ++it)
+    {
+        int x = int(it->point.x()), y = int(it->point.y());
+        const unsigned char* s = score_ptr(x, y);
+        int c                  = s[0];
+        const int w            = image.cols;
+        if (c > s[-w - 1] && c > s[-w] && c > s[-w + 1] && c > s[-1] && c > s[1] && c > s[w - 1] && c > s[w] &&
+            c > s[w + 1])
+        {
+            *out++ = *it;
+        }
+    }
+    keypoints.erase(out, keypoints.end());
+}
+
+}  // namespace Saiga
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/image/imageView.h"
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * FAST-9 corner detector (9 contiguous pixels on a circle of 16).
+ *
+ * Same definition as cv::FAST with TYPE_9_16: A pixel is a corner if 9 contiguous circle pixels are all brighter than
+ * center + threshold or all darker than center - threshold. The response is the largest threshold for which the pixel
+ * is still a corner. With non-maximum suppression a corner is only kept if its response is larger than the response
+ * of all 8 neighbors.
+ *
+ * Only pixels with a distance of at least 3 to the image border are tested. The keypoint positions are relative to
+ * the image view. 16 pixels are tested at once with SSE2 if it is available.
+ *
+ * The detector keeps an internal buffer and should be reused. It is not thread safe.
+ */
+class SAIGA_VISION_API FastDetector
+{
+   public:
+    FastDetector(int threshold = 20, bool nonmax_suppression = true)
+        : threshold(threshold), nonmax_suppression(nonmax_suppression)
+    {
+    }
+
+    // The keypoints are appended to the output vector.
+    void Detect(ImageView<const unsigned char> image, std::vector<KeyPoint<float>>& keypoints)
+    {
+        Detect(image, keypoints, 0, image.rows);
+    }
+
+    // Only returns the corners in the rows [row_begin, row_end). The non-maximum suppression still uses the rows
+    // next to this range. Splitting an image into bands (with one detector per band) gives the same corners as a
+    // single call.
+    void Detect(ImageView<const unsigned char> image, std::vector<KeyPoint<float>>& keypoints, int row_begin,
+                int row_end);
+
+    int threshold;
+    bool nonmax_suppression;
+
+   private:
+    // Response + 1 of the corners. 0 for no corner.
+    std::vector<unsigned char> scores;
+};
+
+}  // namespace Saiga
@@ -127,10 +127,7 @@ inline int distance(const DescriptorORB& a, const DescriptorORB& b)
     for (int i = 0; i < (int)a.size(); i++)
     {
         auto v = a[i] ^ b[i];
-        // TODO: if this is really a bottleneck we can also use AVX-2
-        // to gain around 25% more performance
-        // according to this source:
-        // https://github.com/kimwalisch/libpopcnt
+        // For many descriptors use HammingMatcher, which computes 8 distances at once with AVX2/AVX-512.
         dist += popcnt(v);
     }
 
@@ -138,6 +135,11 @@ inline int distance(const DescriptorORB& a, const DescriptorORB& b)
 }
 
 
+// Two nearest neighbors of each query descriptor. Same result as BruteForceMatcher::matchKnn2, but blocked, vectorized
+// and without the n x m distance matrix. Writes 2 (distance, index) pairs per query. See HammingMatcher.h.
+SAIGA_VISION_API void HammingKnn2(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train,
+                                  std::pair<int, int>* knn2, int threads = 1);
+
 
 // Compute the euclidean distance between the descriptors
 inline float distance(const DescriptorSIFT& a, const DescriptorSIFT& b)
@@ -301,6 +303,11 @@ struct BruteForceMatcher
     using DistanceType = int;
 
 
+    /**
+     * Deprecated: Computes the dense n x m distance matrix with the scalar distance().
+     * Only useful for inspecting all distances. For matching ORB descriptors use HammingMatcher (or matchKnn2 +
+     * filterMatches below), which never stores the full matrix and uses the SIMD kernels.
+     */
     template <typename _InputIterator>
     void match(_InputIterator first1, int n, _InputIterator first2, int m)
     {
@@ -315,76 +322,18 @@ struct BruteForceMatcher
             }
             ++first1;
         }
-
-        int sum = distances.sum();
-        std::cout << "distance sum: " << sum << " avg: " << double(sum) / (n * m) << std::endl;
     }
 
     void matchKnn2(Saiga::ArrayView<DescriptorORB> desc1, Saiga::ArrayView<DescriptorORB> desc2)
     {
         knn2.resize(desc1.size(), 2);
-
-        for (int i = 0; i < (int)desc1.size(); ++i)
-        {
-            // init best to infinity distance
-            knn2(i, 0) = {1000, -1};
-            knn2(i, 1) = knn2(i, 0);
-
-
-            for (int j = 0; j < (int)desc2.size(); ++j)
-            {
-                auto dis = distance(desc1[i], desc2[j]);
-
-                if (dis < knn2(i, 0).first)
-                {
-                    // set second best to old best
-                    knn2(i, 1) = knn2(i, 0);
-                    // create new best
-                    knn2(i, 0).first  = dis;
-                    knn2(i, 0).second = j;
-                }
-                else if (dis < knn2(i, 1).first)
-                {
-                    // override second best
-                    knn2(i, 1).first  = dis;
-                    knn2(i, 1).second = j;
-                }
-            }
-        }
+        HammingKnn2(desc1, desc2, knn2.data(), 1);
     }
 
     void matchKnn2_omp(Saiga::ArrayView<DescriptorORB> desc1, Saiga::ArrayView<DescriptorORB> desc2, int threads)
     {
         knn2.resize(desc1.size(), 2);
-
-#pragma omp parallel for num_threads(threads)
-        for (int i = 0; i < (int)desc1.size(); ++i)
-        {
-            // init best to infinity distance
-            knn2(i, 0) = {1000, -1};
-            knn2(i, 1) = knn2(i, 0);
-
-
-            for (int j = 0; j < (int)desc2.size(); ++j)
-            {
-                auto dis = distance(desc1[i], desc2[j]);
-
-                if (dis < knn2(i, 0).first)
-                {
-                    // set second best to old best
-                    knn2(i, 1) = knn2(i, 0);
-                    // create new best
-                    knn2(i, 0).first  = dis;
-                    knn2(i, 0).second = j;
-                }
-                else if (dis < knn2(i, 1).first)
-                {
-                    // override second best
-                    knn2(i, 1).first  = dis;
-                    knn2(i, 1).second = j;
-                }
-            }
-        }
+        HammingKnn2(desc1, desc2, knn2.data(), threads);
     }
 
     /**
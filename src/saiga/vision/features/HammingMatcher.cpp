@@ -0,0 +1,516 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "HammingMatcher.h"
+
+#include "saiga/core/math/imath.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#    include <immintrin.h>
+#    define SAIGA_HAMMING_X86
+#endif
+
+#if defined(SAIGA_HAMMING_X86) && (defined(__GNUC__) || defined(__clang__))
+#    define SAIGA_HAMMING_TARGET_AVX2 __attribute__((target("avx2")))
+#    define SAIGA_HAMMING_TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq,avx2")))
+#    define SAIGA_HAS_HAMMING_AVX2
+#    define SAIGA_HAS_HAMMING_AVX512
+#elif defined(SAIGA_HAMMING_X86)
+// MSVC: The intrinsics can only be used if the instruction set is enabled for the whole project.
+#    define SAIGA_HAMMING_TARGET_AVX2
+#    define SAIGA_HAMMING_TARGET_AVX512
+#    if defined(__AVX2__)
+#        define SAIGA_HAS_HAMMING_AVX2
+#    endif
+#    if defined(__AVX512VPOPCNTDQ__)
+#        define SAIGA_HAS_HAMMING_AVX512
+#    endif
+#endif
+
+namespace Saiga
+{
+// Key = distance << index_bits | index. A distance has at most 9 bits.
+static constexpr int index_bits     = 23;
+static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+static constexpr uint32_t no_match   = 0xFFFFFFFFu;
+// Train descriptors per transposed block
+static constexpr int block_size = 8;
+
+static_assert(HammingMatcher::train_tile % block_size == 0, "A tile must consist of complete blocks.");
+
+struct HammingKernelData
+{
+    const DescriptorORB* query;
+    // Original layout (scalar kernel)
+    const DescriptorORB* train;
+    // Transposed blocks (SIMD kernels)
+    const uint64_t* train_blocks;
+    int num_train;
+
+    uint32_t* row_best;
+    uint32_t* row_second;
+    // nullptr if the mutual check is not used
+    uint32_t* col_best;
+};
+
+bool HammingKernelSupported(HammingKernel kernel)
+{
+    switch (kernel)
+    {
+        case HammingKernel::Auto:
+        case HammingKernel::Scalar:
+            return true;
+        case HammingKernel::AVX2:
+#if defined(SAIGA_HAS_HAMMING_AVX2) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("avx2");
+#elif defined(SAIGA_HAS_HAMMING_AVX2)
+            return true;
+#else
+            return false;
+#endif
+        case HammingKernel::AVX512:
+#if defined(SAIGA_HAS_HAMMING_AVX512) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq") &&
+                   __builtin_cpu_supports("avx2");
+#elif defined(SAIGA_HAS_HAMMING_AVX512)
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+HammingKernel SelectHammingKernel(HammingKernel kernel)
+{
+    if (kernel == HammingKernel::Auto)
+    {
+        if (HammingKernelSupported(HammingKernel::AVX512)) return HammingKernel::AVX512;
+        if (HammingKernelSupported(HammingKernel::AVX2)) return HammingKernel::AVX2;
+        return HammingKernel::Scalar;
+    }
+    return HammingKernelSupported(kernel) ? kernel : HammingKernel::Scalar;
+}
+
+// Inserts a key into the sorted pair (best, second).
+static inline void InsertKey(uint32_t key, uint32_t& best, uint32_t& second)
+{
+    second = std::min(second, std::max(best, key));
+    best   = std::min(best, key);
+}
+
+static void Knn2Scalar(const HammingKernelData& d, int query_begin, int query_end)
+{
+    for (int tile_begin = 0; tile_begin < d.num_train; tile_begin += HammingMatcher::train_tile)
+    {
+        int tile_end = std::min(tile_begin + HammingMatcher::train_tile, d.num_train);
+        for (int i = query_begin; i < query_end; ++i)
+        {
+            const DescriptorORB q      = d.query[i];
+            const DescriptorORB* train = d.train;
+            uint32_t* col_best         = d.col_best;
+
+            uint32_t best   = d.row_best[i];
+            uint32_t second = d.row_second[i];
+            for (int j = tile_begin; j < tile_end; ++j)
+            {
+                uint32_t key = uint32_t(distance(q, train[j])) << index_bits;
+                // Most candidates are rejected here, which is faster than the branch free update
+                if ((key | j) < second) InsertKey(key | j, best, second);
+                if (col_best) col_best[j] = std::min(col_best[j], key | i);
+            }
+            d.row_best[i]   = best;
+            d.row_second[i] = second;
+        }
+    }
+}
+
+// Merges the per lane (best, second) keys of a query into the output.
+static inline void ReduceLanes(const uint32_t* lane_best, const uint32_t* lane_second, uint32_t& best,
+                               uint32_t& second)
+{
+    for (int l = 0; l < block_size; ++l)
+    {
+        InsertKey(lane_best[l], best, second);
+        second = std::min(second, lane_second[l]);
+    }
+}
+
+
+static int NearestScalar(const DescriptorORB& query, const uint64_t* blocks, int n)
+{
+    int best = 0, best_distance = 1000;
+    for (int j = 0; j < n; ++j)
+    {
+        const uint64_t* d = blocks + (j / block_size) * block_size * 4 + j % block_size;
+        int distance      = 0;
+        for (int k = 0; k < 4; ++k) distance += popcnt(query[k] ^ d[k * block_size]);
+        if (distance < best_distance)
+        {
+            best_distance = distance;
+            best          = j;
+        }
+    }
+    return best;
+}
+
+
+#ifdef SAIGA_HAS_HAMMING_AVX2
+
+// Packed keys of the descriptors j..j+7. The padding after num_train gets the key no_match.
+SAIGA_HAMMING_TARGET_AVX2 static inline __m256i RowKeys8(__m256i distances, int j, int num_train)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256i index = _mm256_add_epi32(lane, _mm256_set1_epi32(j));
+    __m256i row   = _mm256_or_si256(_mm256_slli_epi32(distances, index_bits), index);
+    if (j + block_size > num_train)
+    {
+        __m256i invalid = _mm256_cmpgt_epi32(lane, _mm256_set1_epi32(num_train - j - 1));
+        row             = _mm256_or_si256(row, invalid);
+    }
+    return row;
+}
+
+// Adds the 8 distances of a block to the lane keys of query i.
+SAIGA_HAMMING_TARGET_AVX2 static inline void UpdateKeys8(__m256i distances, int i, int j, int num_train,
+                                                        __m256i& best, __m256i& second, uint32_t* col_best)
+{
+    __m256i row = RowKeys8(distances, j, num_train);
+    second      = _mm256_min_epu32(second, _mm256_max_epu32(best, row));
+    best        = _mm256_min_epu32(best, row);
+
+    if (col_best)
+    {
+        __m256i key  = _mm256_slli_epi32(distances, index_bits);
+        __m256i* ptr = reinterpret_cast<__m256i*>(col_best + j);
+        __m256i col  = _mm256_loadu_si256(ptr);
+        col          = _mm256_min_epu32(col, _mm256_or_si256(key, _mm256_set1_epi32(i)));
+        _mm256_storeu_si256(ptr, col);
+    }
+}
+
+SAIGA_HAMMING_TARGET_AVX2 static inline uint32_t HorizontalMin8(__m256i v)
+{
+    alignas(32) uint32_t lanes[block_size];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return *std::min_element(lanes, lanes + block_size);
+}
+
+// Popcount of each byte with a 4 bit lookup table.
+SAIGA_HAMMING_TARGET_AVX2 static inline __m256i PopcountBytes(__m256i v, __m256i lookup, __m256i low_mask)
+{
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+}
+
+// Distances of the broadcasted query q to the 8 descriptors of a transposed block.
+SAIGA_HAMMING_TARGET_AVX2 static inline __m256i Distances8(const __m256i* q, const uint64_t* block)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,  //
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i order    = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    // Word k of the descriptors 0..3 is at blk[2k] and of 4..7 at blk[2k+1]
+    const __m256i* blk = reinterpret_cast<const __m256i*>(block);
+
+    // The byte counts of the 4 words add up to at most 32
+    __m256i c0 = zero, c1 = zero;
+    for (int k = 0; k < 4; ++k)
+    {
+        __m256i x0 = _mm256_xor_si256(q[k], _mm256_loadu_si256(blk + 2 * k));
+        __m256i x1 = _mm256_xor_si256(q[k], _mm256_loadu_si256(blk + 2 * k + 1));
+        c0         = _mm256_add_epi8(c0, PopcountBytes(x0, lookup, low_mask));
+        c1         = _mm256_add_epi8(c1, PopcountBytes(x1, lookup, low_mask));
+    }
+
+    // One 64 bit sum per descriptor: [d0 d4 d1 d5 d2 d6 d3 d7] -> [d0 .. d7]
+    __m256i s0        = _mm256_sad_epu8(c0, zero);
+    __m256i s1        = _mm256_sad_epu8(c1, zero);
+    __m256i distances = _mm256_or_si256(s0, _mm256_slli_epi64(s1, 32));
+    return _mm256_permutevar8x32_epi32(distances, order);
+}
+
+SAIGA_HAMMING_TARGET_AVX2 static void Knn2AVX2(const HammingKernelData& d, int query_begin, int query_end)
+{
+    // Local copies, the stores to col_best could alias d
+    const uint64_t* train_blocks = d.train_blocks;
+    const int num_train          = d.num_train;
+    uint32_t* col_best           = d.col_best;
+
+    alignas(32) uint32_t lane_best[HammingMatcher::query_block][block_size];
+    alignas(32) uint32_t lane_second[HammingMatcher::query_block][block_size];
+    std::fill(&lane_best[0][0], &lane_best[0][0] + HammingMatcher::query_block * block_size, no_match);
+    std::fill(&lane_second[0][0], &lane_second[0][0] + HammingMatcher::query_block * block_size, no_match);
+
+    for (int tile_begin = 0; tile_begin < d.num_train; tile_begin += HammingMatcher::train_tile)
+    {
+        int tile_end = std::min(tile_begin + HammingMatcher::train_tile, d.num_train);
+        for (int i = query_begin; i < query_end; ++i)
+        {
+            __m256i q[4];
+            for (int k = 0; k < 4; ++k) q[k] = _mm256_set1_epi64x(d.query[i][k]);
+
+            __m256i* best_ptr   = reinterpret_cast<__m256i*>(lane_best[i - query_begin]);
+            __m256i* second_ptr = reinterpret_cast<__m256i*>(lane_second[i - query_begin]);
+            __m256i best        = _mm256_load_si256(best_ptr);
+            __m256i second      = _mm256_load_si256(second_ptr);
+
+            for (int j = tile_begin; j < tile_end; j += block_size)
+            {
+                __m256i distances = Distances8(q, train_blocks + j * 4);
+                UpdateKeys8(distances, i, j, num_train, best, second, col_best);
+            }
+            _mm256_store_si256(best_ptr, best);
+            _mm256_store_si256(second_ptr, second);
+        }
+    }
+
+    for (int i = query_begin; i < query_end; ++i)
+    {
+        ReduceLanes(lane_best[i - query_begin], lane_second[i - query_begin], d.row_best[i], d.row_second[i]);
+    }
+}
+SAIGA_HAMMING_TARGET_AVX2 static int NearestAVX2(const DescriptorORB& query, const uint64_t* blocks, int n)
+{
+    __m256i q[4];
+    for (int k = 0; k < 4; ++k) q[k] = _mm256_set1_epi64x(query[k]);
+
+    __m256i best = _mm256_set1_epi32(no_match);
+    for (int j = 0; j < n; j += block_size)
+    {
+        best = _mm256_min_epu32(best, RowKeys8(Distances8(q, blocks + j * 4), j, n));
+    }
+    return HorizontalMin8(best) & index_mask;
+}
+#endif
+
+
+#ifdef SAIGA_HAS_HAMMING_AVX512
+// Distances of the broadcasted query q to the 8 descriptors of a transposed block. Word k is at blk[k].
+SAIGA_HAMMING_TARGET_AVX512 static inline __m256i Distances8(const __m512i* q, const uint64_t* block)
+{
+    const __m512i* blk = reinterpret_cast<const __m512i*>(block);
+
+    __m512i c0 = _mm512_popcnt_epi64(_mm512_xor_si512(q[0], _mm512_loadu_si512(blk + 0)));
+    __m512i c1 = _mm512_popcnt_epi64(_mm512_xor_si512(q[1], _mm512_loadu_si512(blk + 1)));
+    __m512i c2 = _mm512_popcnt_epi64(_mm512_xor_si512(q[2], _mm512_loadu_si512(blk + 2)));
+    __m512i c3 = _mm512_popcnt_epi64(_mm512_xor_si512(q[3], _mm512_loadu_si512(blk + 3)));
+    return _mm512_maskz_cvtepi64_epi32(0xFF, _mm512_add_epi64(_mm512_add_epi64(c0, c1), _mm512_add_epi64(c2, c3)));
+}
+
+SAIGA_HAMMING_TARGET_AVX512 static void Knn2AVX512(const HammingKernelData& d, int query_begin, int query_end)
+{
+    // Local copies, the stores to col_best could alias d
+    const uint64_t* train_blocks = d.train_blocks;
+    const int num_train          = d.num_train;
+    uint32_t* col_best           = d.col_best;
+
+    alignas(32) uint32_t lane_best[HammingMatcher::query_block][block_size];
+    alignas(32) uint32_t lane_second[HammingMatcher::query_block][block_size];
+    std::fill(&lane_best[0][0], &lane_best[0][0] + HammingMatcher::query_block * block_size, no_match);
+    std::fill(&lane_second[0][0], &lane_second[0][0] + HammingMatcher::query_block * block_size, no_match);
+
+    for (int tile_begin = 0; tile_begin < d.num_train; tile_begin += HammingMatcher::train_tile)
+    {
+        int tile_end = std::min(tile_begin + HammingMatcher::train_tile, d.num_train);
+        for (int i = query_begin; i < query_end; ++i)
+        {
+            __m512i q[4];
+            for (int k = 0; k < 4; ++k) q[k] = _mm512_set1_epi64(d.query[i][k]);
+
+            __m256i* best_ptr   = reinterpret_cast<__m256i*>(lane_best[i - query_begin]);
+            __m256i* second_ptr = reinterpret_cast<__m256i*>(lane_second[i - query_begin]);
+            __m256i best        = _mm256_load_si256(best_ptr);
+            __m256i second      = _mm256_load_si256(second_ptr);
+
+            for (int j = tile_begin; j < tile_end; j += block_size)
+            {
+                UpdateKeys8(Distances8(q, train_blocks + j * 4), i, j, num_train, best, second, col_best);
+            }
+            _mm256_store_si256(best_ptr, best);
+            _mm256_store_si256(second_ptr, second);
+        }
+    }
+
+    for (int i = query_begin; i < query_end; ++i)
+    {
+        ReduceLanes(lane_best[i - query_begin], lane_second[i - query_begin], d.row_best[i], d.row_second[i]);
+    }
+}
+SAIGA_HAMMING_TARGET_AVX512 static int NearestAVX512(const DescriptorORB& query, const uint64_t* blocks, int n)
+{
+    __m512i q[4];
+    for (int k = 0; k < 4; ++k) q[k] = _mm512_set1_epi64(query[k]);
+
+    __m256i best = _mm256_set1_epi32(no_match);
+    for (int j = 0; j < n; j += block_size)
+    {
+        best = _mm256_min_epu32(best, RowKeys8(Distances8(q, blocks + j * 4), j, n));
+    }
+    return HorizontalMin8(best) & index_mask;
+}
+#endif
+
+
+void HammingMatcher::Compute(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, bool mutual)
+{
+    int n = query.size();
+    int m = train.size();
+    SAIGA_ASSERT(n <= int(index_mask) && m <= int(index_mask));
+
+    HammingKernel k = SelectHammingKernel(kernel);
+    int num_blocks  = iDivUp(m, block_size);
+
+    if (k != HammingKernel::Scalar)
+    {
+        train_blocks.resize(HammingBlocksSize(m));
+        HammingTransposeBlocks(train, train_blocks.data());
+    }
+
+    row_best.assign(n, no_match);
+    row_second.assign(n, no_match);
+
+    int num_threads = std::max(threads, 1);
+    if (mutual)
+    {
+        col_best.resize(num_threads);
+        for (auto& c : col_best) c.assign(num_blocks * block_size, no_match);
+    }
+
+    HammingKernelData data;
+    data.query        = query.data();
+    data.train        = train.data();
+    data.train_blocks = train_blocks.data();
+    data.num_train    = m;
+    data.row_best     = row_best.data();
+    data.row_second   = row_second.data();
+
+    int num_query_blocks = iDivUp(n, query_block);
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int b = 0; b < num_query_blocks; ++b)
+    {
+        HammingKernelData local = data;
+        local.col_best          = mutual ? col_best[OMP::getThreadNum()].data() : nullptr;
+
+        int begin = b * query_block;
+        int end   = std::min(begin + query_block, n);
+        switch (k)
+        {
+#ifdef SAIGA_HAS_HAMMING_AVX2
+            case HammingKernel::AVX2:
+                Knn2AVX2(local, begin, end);
+                break;
+#endif
+#ifdef SAIGA_HAS_HAMMING_AVX512
+            case HammingKernel::AVX512:
+                Knn2AVX512(local, begin, end);
+                break;
+#endif
+            default:
+                Knn2Scalar(local, begin, end);
+                break;
+        }
+    }
+
+    if (mutual)
+    {
+        for (int t = 1; t < num_threads; ++t)
+        {
+            for (int j = 0; j < m; ++j) col_best[0][j] = std::min(col_best[0][j], col_best[t][j]);
+        }
+    }
+}
+
+void HammingMatcher::Knn2(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train,
+                          std::pair<int, int>* knn2)
+{
+    Compute(query, train, false);
+
+    auto unpack = [](uint32_t key) -> std::pair<int, int> {
+        if (key == no_match) return {1000, -1};
+        return {int(key >> index_bits), int(key & index_mask)};
+    };
+
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        knn2[2 * i]     = unpack(row_best[i]);
+        knn2[2 * i + 1] = unpack(row_second[i]);
+    }
+}
+
+int HammingMatcher::Match(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int threshold,
+                          float ratio, bool mutual, std::vector<std::pair<int, int>>& matches)
+{
+    Compute(query, train, mutual);
+
+    matches.clear();
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        uint32_t best = row_best[i];
+        if (best == no_match) continue;
+
+        int best_distance   = best >> index_bits;
+        int second_distance = row_second[i] == no_match ? 1000 : int(row_second[i] >> index_bits);
+        int j               = best & index_mask;
+
+        if (best_distance > threshold) continue;
+        if (float(best_distance) > float(second_distance) * ratio) continue;
+        if (mutual && int(col_best[0][j] & index_mask) != i) continue;
+
+        matches.push_back({i, j});
+    }
+    return matches.size();
+}
+
+void HammingTransposeBlocks(ArrayView<const DescriptorORB> descriptors, uint64_t* blocks)
+{
+    int n = descriptors.size();
+    std::fill(blocks, blocks + HammingBlocksSize(n), 0);
+    for (int j = 0; j < n; ++j)
+    {
+        uint64_t* blk = blocks + (j / block_size) * block_size * 4;
+        for (int k = 0; k < 4; ++k)
+        {
+            blk[k * block_size + j % block_size] = descriptors[j][k];
+        }
+    }
+}
+
+int HammingNearest(const DescriptorORB& query, const uint64_t* blocks, int n, HammingKernel kernel)
+{
+    SAIGA_ASSERT(n > 0);
+    if (kernel == HammingKernel::Auto) kernel = SelectHammingKernel(kernel);
+    switch (kernel)
+    {
+#ifdef SAIGA_HAS_HAMMING_AVX2
+        case HammingKernel::AVX2:
+            return NearestAVX2(query, blocks, n);
+#endif
+#ifdef SAIGA_HAS_HAMMING_AVX512
+        case HammingKernel::AVX512:
+            return NearestAVX512(query, blocks, n);
+#endif
+        default:
+            return NearestScalar(query, blocks, n);
+    }
+}
+
+void HammingKnn2(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train,
+                 std::pair<int, int>* knn2, int threads)
+{
+    HammingMatcher matcher(HammingKernel::Auto, threads);
+    matcher.Knn2(query, train, knn2);
+}
+
+}  // namespace Saiga
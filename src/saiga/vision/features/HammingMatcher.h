@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+enum class HammingKernel
+{
+    // The fastest kernel supported by the CPU
+    Auto,
+    Scalar,
+    // Nibble lookup popcount (vpshufb), 8 descriptors per iteration
+    AVX2,
+    // VPOPCNTDQ, 8 descriptors per iteration
+    AVX512,
+};
+
+SAIGA_VISION_API bool HammingKernelSupported(HammingKernel kernel);
+
+// Resolves 'Auto' and falls back to the scalar kernel if the requested one is not supported.
+SAIGA_VISION_API HammingKernel SelectHammingKernel(HammingKernel kernel);
+
+// Size of the transposed block layout of n descriptors.
+inline int HammingBlocksSize(int n)
+{
+    return (n + 7) / 8 * 32;
+}
+
+// Stores the descriptors in the layout of the SIMD kernels: Word k of the descriptors 8b..8b+7 is at
+// blocks[32b + 8k .. 32b + 8k + 7]. 'blocks' must have HammingBlocksSize(n) elements. The padding is set to 0.
+SAIGA_VISION_API void HammingTransposeBlocks(ArrayView<const DescriptorORB> descriptors, uint64_t* blocks);
+
+// Index of the nearest of the n descriptors in the transposed blocks. The smallest index on ties.
+// Resolve 'kernel' once with SelectHammingKernel if this is called in a loop.
+SAIGA_VISION_API int HammingNearest(const DescriptorORB& query, const uint64_t* blocks, int n,
+                                    HammingKernel kernel = HammingKernel::Auto);
+
+/**
+ * Brute force matching of ORB descriptors.
+ *
+ * Computes the two nearest neighbors of every query descriptor without storing the n x m distance matrix. The train
+ * descriptors are transposed into blocks of 8 (word k of 8 descriptors is contiguous), so the SIMD kernels compute 8
+ * distances with 4 xor + 4 popcount instructions and without a horizontal reduction. Queries are processed in blocks
+ * against tiles of train descriptors that fit into the L1 cache. The query blocks are distributed over the threads.
+ *
+ * The distance and index of a candidate are packed into one 32 bit key (distance << 23 | index). The smallest key is
+ * the nearest neighbor with the smallest index, therefore the result is identical to the scalar loop in
+ * BruteForceMatcher::matchKnn2 and does not depend on the kernel or the number of threads.
+ *
+ * Usage:
+ *   HammingMatcher matcher;
+ *   matcher.threads = 4;
+ *   std::vector<std::pair<int, int>> matches;
+ *   matcher.Match(desc1, desc2, 50, 0.8, true, matches);
+ */
+class SAIGA_VISION_API HammingMatcher
+{
+   public:
+    HammingMatcher(HammingKernel kernel = HammingKernel::Auto, int threads = 1) : kernel(kernel), threads(threads) {}
+
+    // Writes the (distance, index) pairs of the two nearest train descriptors of each query to knn2[2*i] and
+    // knn2[2*i+1]. Missing neighbors are {1000, -1}.
+    void Knn2(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, std::pair<int, int>* knn2);
+
+    /**
+     * Knn2 with a fused threshold + ratio test.
+     * A query i is matched to its nearest neighbor j if
+     *    dist(i,j) <= threshold
+     *    dist(i,j) <= ratio * second best distance
+     * With mutual=true, i must also be the nearest query of j (smallest index on ties).
+     * The matches (query index, train index) are sorted by query index.
+     *
+     * @return The number of matches
+     */
+    int Match(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int threshold, float ratio,
+              bool mutual, std::vector<std::pair<int, int>>& matches);
+
+    HammingKernel kernel;
+    int threads;
+
+    // Queries per block and train descriptors per tile
+    static constexpr int query_block = 32;
+    static constexpr int train_tile  = 512;
+
+   private:
+    void Compute(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, bool mutual);
+
+    // Transposed train descriptors in blocks of 8
+    std::vector<uint64_t> train_blocks;
+    // Packed keys of the best and second best train descriptor of each query
+    std::vector<uint32_t> row_best, row_second;
+    // Packed key of the best query for each train descriptor. One array per thread
+    std::vector<std::vector<uint32_t>> col_best;
+};
+
+}  // namespace Saiga
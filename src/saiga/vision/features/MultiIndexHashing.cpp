@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "MultiIndexHashing.h"
+
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+
+namespace Saiga
+{
+static constexpr int num_keys = 1 << MultiIndexHashing::substring_bits;
+
+static inline int Substring(const DescriptorORB& d, int t)
+{
+    return (d[t / 4] >> (16 * (t % 4))) & 0xFFFF;
+}
+
+// All 16 bit masks sorted by the number of set bits. The masks with s bits are [offsets[s], offsets[s+1]).
+struct SubstringMasks
+{
+    std::vector<uint16_t> masks;
+    int offsets[MultiIndexHashing::substring_bits + 2];
+
+    SubstringMasks()
+    {
+        for (int s = 0; s <= MultiIndexHashing::substring_bits; ++s)
+        {
+            offsets[s] = masks.size();
+            for (int m = 0; m < num_keys; ++m)
+            {
+                if (popcnt(uint32_t(m)) == uint32_t(s)) masks.push_back(m);
+            }
+        }
+        offsets[MultiIndexHashing::substring_bits + 1] = masks.size();
+    }
+};
+
+static const SubstringMasks& Masks()
+{
+    static SubstringMasks masks;
+    return masks;
+}
+
+// True if t is the first table with the smallest substring distance. With that every descriptor is reported only
+// once: in the first table (and round) in which it is found.
+static inline bool FirstMinimumTable(const DescriptorORB& a, const DescriptorORB& b, int t, int s)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        uint64_t x = a[i] ^ b[i];
+        for (int j = 0; j < 4; ++j)
+        {
+            int table = i * 4 + j;
+            if (table == t) continue;
+            int c = popcnt(uint32_t((x >> (16 * j)) & 0xFFFF));
+            if (c < s || (c == s && table < t)) return false;
+        }
+    }
+    return true;
+}
+
+MultiIndexHashing::MultiIndexHashing() : buckets(num_tables * num_keys) {}
+
+int MultiIndexHashing::Insert(const DescriptorORB& descriptor)
+{
+    int id;
+    if (free_ids.empty())
+    {
+        id = descriptors.size();
+        descriptors.push_back(descriptor);
+        valid.push_back(true);
+    }
+    else
+    {
+        id = free_ids.back();
+        free_ids.pop_back();
+        descriptors[id] = descriptor;
+        valid[id]       = true;
+    }
+
+    for (int t = 0; t < num_tables; ++t)
+    {
+        buckets[t * num_keys + Substring(descriptor, t)].push_back(id);
+    }
+    num_valid++;
+    return id;
+}
+
+void MultiIndexHashing::Remove(int id)
+{
+    SAIGA_ASSERT(Valid(id));
+    for (int t = 0; t < num_tables; ++t)
+    {
+        auto& bucket = buckets[t * num_keys + Substring(descriptors[id], t)];
+        auto it      = std::find(bucket.begin(), bucket.end(), id);
+        SAIGA_ASSERT(it != bucket.end());
+        *it = bucket.back();
+        bucket.pop_back();
+    }
+    valid[id] = false;
+    free_ids.push_back(id);
+    num_valid--;
+}
+
+void MultiIndexHashing::Clear()
+{
+    for (auto& b : buckets) b.clear();
+    descriptors.clear();
+    valid.clear();
+    free_ids.clear();
+    num_valid = 0;
+}
+
+template <typename Op>
+void MultiIndexHashing::SearchRound(const DescriptorORB& query, int s, int t, const int& bound, Op op) const
+{
+    auto& masks      = Masks();
+    const Bucket* tb = buckets.data() + t * num_keys;
+    int key          = Substring(query, t);
+
+    for (int m = masks.offsets[s]; m < masks.offsets[s + 1]; ++m)
+    {
+        for (int id : tb[key ^ masks.masks[m]])
+        {
+            const auto& d = descriptors[id];
+            int dist      = distance(query, d);
+            if (dist > bound || !FirstMinimumTable(query, d, t, s)) continue;
+            op(dist, id);
+        }
+    }
+}
+
+void MultiIndexHashing::RadiusSearch(const DescriptorORB& query, int radius,
+                                     std::vector<std::pair<int, int>>& result) const
+{
+    result.clear();
+    if (radius < 0) return;
+
+    // Every descriptor with distance <= radius has a substring with distance <= radius / num_tables
+    int max_s = std::min(radius / num_tables, substring_bits);
+    for (int s = 0; s <= max_s; ++s)
+    {
+        for (int t = 0; t < num_tables; ++t)
+        {
+            SearchRound(query, s, t, radius, [&](int dist, int id) { result.push_back({dist, id}); });
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
+void MultiIndexHashing::KnnSearch(const DescriptorORB& query, int k, std::vector<std::pair<int, int>>& result,
+                                  int max_radius) const
+{
+    result.clear();
+    if (k <= 0 || max_radius < 0) return;
+    result.reserve(k + 1);
+
+    // Largest distance which can still be inserted
+    int bound   = max_radius;
+    auto insert = [&](int dist, int id) {
+        std::pair<int, int> e(dist, id);
+        if ((int)result.size() == k)
+        {
+            if (!(e < result.back())) return;
+            result.pop_back();
+        }
+        result.insert(std::upper_bound(result.begin(), result.end(), e), e);
+        if ((int)result.size() == k) bound = result.back().first;
+    };
+
+    for (int s = 0; s <= substring_bits; ++s)
+    {
+        for (int t = 0; t < num_tables; ++t)
+        {
+            SearchRound(query, s, t, bound, insert);
+        }
+
+        // All descriptors with a distance of at most 'complete' have been found
+        int complete = num_tables * (s + 1) - 1;
+        if (complete >= bound) break;
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * Multi-index hashing for exact Hamming distance search of ORB descriptors.
+ * Norouzi et al. "Fast Exact Search in Hamming Space with Multi-Index Hashing", PAMI 2014.
+ *
+ * A descriptor is split into 16 substrings of 16 bits. Each substring indexes one of 16 hash tables. If two descriptors
+ * have a distance of at most 16 * (s + 1) - 1, at least one of their substrings differs in at most s bits. A search
+ * therefore only has to visit the buckets within a substring distance of s of the query in every table. The result is
+ * exact, i.e. identical to a brute force search.
+ *
+ * The search time depends on the distance of the neighbors and not on the size of the index. For typical ORB
+ * matches (distance < 50) it is much faster than brute force for more than ~10^4 descriptors. Each table is a direct
+ * array of 2^16 buckets, which costs a constant 24 MB.
+ *
+ * Descriptors can be inserted and removed at any time. The ids of removed descriptors are reused. The search methods
+ * are const and can be called from multiple threads.
+ *
+ * Usage:
+ *   MultiIndexHashing mih;
+ *   for (auto& d : map_descriptors) ids.push_back(mih.Insert(d));
+ *   std::vector<std::pair<int, int>> result;
+ *   mih.KnnSearch(query, 2, result);
+ */
+class SAIGA_VISION_API MultiIndexHashing
+{
+   public:
+    static constexpr int num_tables     = 16;
+    static constexpr int substring_bits = 16;
+
+    MultiIndexHashing();
+
+    // Returns the id of the descriptor.
+    int Insert(const DescriptorORB& descriptor);
+    void Remove(int id);
+    void Clear();
+
+    bool Valid(int id) const { return id >= 0 && id < (int)valid.size() && valid[id]; }
+    const DescriptorORB& Descriptor(int id) const { return descriptors[id]; }
+
+    // Number of valid descriptors
+    int size() const { return num_valid; }
+
+    /**
+     * All descriptors with distance <= radius.
+     * The result contains (distance, id) pairs sorted by distance and id.
+     */
+    void RadiusSearch(const DescriptorORB& query, int radius, std::vector<std::pair<int, int>>& result) const;
+
+    /**
+     * The k nearest descriptors with distance <= max_radius.
+     * The result contains (distance, id) pairs sorted by distance and id. On ties the smaller id is returned.
+     * A large max_radius is slow if there are less than k close descriptors, because all buckets have to be visited.
+     */
+    void KnnSearch(const DescriptorORB& query, int k, std::vector<std::pair<int, int>>& result,
+                   int max_radius = 80) const;
+
+   private:
+    using Bucket = std::vector<int>;
+
+    std::vector<DescriptorORB> descriptors;
+    std::vector<char> valid;
+    std::vector<int> free_ids;
+    int num_valid = 0;
+
+    // num_tables * 2^substring_bits buckets
+    std::vector<Bucket> buckets;
+
+    // Calls op(distance, id) for all descriptors with distance <= bound, a substring distance of exactly s in table t
+    // and that were not found in a previous table or round.
+    template <typename Op>
+    void SearchRound(const DescriptorORB& query, int s, int t, const int& bound, Op op) const;
+};
+
+}  // namespace Saiga
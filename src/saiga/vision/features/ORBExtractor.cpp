@@ -60,23 +60,19 @@
 
 #include "ORBExtractor.h"
 
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
 
-#ifdef SAIGA_USE_OPENCV
-
-#    include "saiga/core/time/all.h"
-#    include "saiga/core/util/Thread/omp.h"
-#    include "saiga/vision/opencv/opencv.h"
-
-#    include <opencv2/core/core.hpp>
-#    include <opencv2/features2d/features2d.hpp>
-#    include <opencv2/highgui/highgui.hpp>
-#    include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
 
 
 namespace Saiga
 {
 const int PATCH_SIZE     = 31;
 const int EDGE_THRESHOLD = 19;
+// Height of the FAST bands, which are processed in parallel
+const int BAND_HEIGHT = 96;
 
 
 ORBExtractor::ORBExtractor(int _nfeatures, float _scaleFactor, int _nlevels, int _iniThFAST, int _minThFAST,
@@ -87,156 +83,149 @@ ORBExtractor::ORBExtractor(int _nfeatures, float _scaleFactor, int _nlevels, int
     levels.resize(num_levels);
 }
 
-void ORBExtractor::DetectKeypoints()
+void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vector<KeypointType>& _keypoints,
+                          std::vector<Saiga::DescriptorORB>& outputDescriptors)
 {
-    const float W = 30;
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
-    for (int level = 0; level < num_levels; ++level)
-    {
-        auto& level_data = levels[level];
-        level_data.keypoints_tmp.clear();
+    if (inputImage.empty()) return;
 
-        auto image = Saiga::ImageViewToMat(level_data.image);
+    SetImage(inputImage);
+    ComputePyramid();
 
-        const int minBorderX = EDGE_THRESHOLD - 3;
-        const int minBorderY = minBorderX;
-        const int maxBorderX = level_data.image.cols - EDGE_THRESHOLD + 3;
-        const int maxBorderY = level_data.image.rows - EDGE_THRESHOLD + 3;
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int i = 0; i < (int)bands.size(); ++i)
+    {
+        DetectBand(bands[i].first, bands[i].second);
+    }
 
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int level = 0; level < num_levels; ++level)
+    {
+        DistributeKeypoints(level);
+    }
 
-        const float width  = (maxBorderX - minBorderX);
-        const float height = (maxBorderY - minBorderY);
+    int nkeypoints = ComputeOffsets();
+    outputDescriptors.resize(nkeypoints);
+    _keypoints.resize(nkeypoints);
 
-        const int nCols = width / W;
-        const int nRows = height / W;
-        const int wCell = ceil(width / nCols);
-        const int hCell = ceil(height / nRows);
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int level = 0; level < num_levels; ++level)
+    {
+        int n = NumKeypoints(level);
+        if (n == 0) continue;
 
-        for (int i = 0; i < nRows; i++)
-        {
-            const float iniY = minBorderY + i * hCell;
-            float maxY       = iniY + hCell + 6;
-
-            if (iniY >= maxBorderY - 3) continue;
-            if (maxY > maxBorderY) maxY = maxBorderY;
-
-            for (int j = 0; j < nCols; j++)
-            {
-                const float iniX = minBorderX + j * wCell;
-                float maxX       = iniX + wCell + 6;
-                if (iniX >= maxBorderX - 6) continue;
-                if (maxX > maxBorderX) maxX = maxBorderX;
-
-
-                std::vector<cv::KeyPoint> cv_KeysCell;
-
-                FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast, true);
-                int dis_before = cv_KeysCell.size();
-
-                if (cv_KeysCell.empty())
-                {
-                    FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast_min, true);
-                    dis_before = cv_KeysCell.size();
-                }
-
-                for (auto& cvkp : cv_KeysCell)
-                {
-                    KeypointType kp;
-                    kp.point    = Saiga::vec2(cvkp.pt.x, cvkp.pt.y);
-                    kp.size     = cvkp.size;
-                    kp.angle    = cvkp.angle;
-                    kp.response = cvkp.response;
-                    kp.octave   = cvkp.octave;
-
-
-                    kp.point.x() += j * wCell;
-                    kp.point.y() += i * hCell;
-                    level_data.keypoints_tmp.push_back(kp);
-                }
-            }
-        }
+        BlurLevel(level);
+        ComputeDescriptors(level, 0, n, _keypoints.data() + LevelOffset(level),
+                           outputDescriptors.data() + LevelOffset(level));
+    }
+}
 
-        level_data.keypoints_tmp =
-            level_data.distributor.Distribute(level_data.keypoints_tmp, Saiga::vec2(minBorderX, minBorderY),
-                                              Saiga::vec2(maxBorderX, maxBorderY), pyramid.Features(level));
+void ORBExtractor::DetectBand(int level, int band)
+{
+    auto& level_data = levels[level];
+    auto& b          = level_data.bands[band];
+    b.keypoints.clear();
+    b.fast.threshold = th_fast_min;
+    b.fast.Detect(level_data.detection_region, b.keypoints, b.row_begin, b.row_end);
+}
 
-        const int scaledPatchSize = PATCH_SIZE * pyramid.Scale(level);
+void ORBExtractor::DistributeKeypoints(int level)
+{
+    auto& level_data = levels[level];
+    auto& keypoints  = level_data.keypoints_tmp;
 
-        for (auto& kp : level_data.keypoints_tmp)
-        {
-            kp.point.x() += minBorderX;
-            kp.point.y() += minBorderY;
-            kp.octave = level;
-            kp.size   = scaledPatchSize;
-            kp.angle  = orb.ComputeAngle(level_data.image, kp.point);
-        }
+    keypoints.clear();
+    for (auto& b : level_data.bands)
+    {
+        keypoints.insert(keypoints.end(), b.keypoints.begin(), b.keypoints.end());
     }
-}
-
 
+    // FAST is computed once for the whole level with the lower threshold. Cells that contain a corner with a
+    // response of at least th_fast only keep these corners. Because the non-maximum suppression only compares
+    // responses, this is the same as running FAST again with th_fast.
+    const int nCols = level_data.cell_cols;
+    const int nRows = level_data.cell_rows;
+    auto cell_index = [&](const KeypointType& kp) {
+        int j = std::min((int(kp.point.x()) - 3) / level_data.cell_width, nCols - 1);
+        int i = std::min((int(kp.point.y()) - 3) / level_data.cell_height, nRows - 1);
+        return i * nCols + j;
+    };
+
+    level_data.strong_cell.assign(nRows * nCols, 0);
+    for (auto& kp : keypoints)
+    {
+        if (kp.response >= th_fast) level_data.strong_cell[cell_index(kp)] = 1;
+    }
+    keypoints.erase(std::remove_if(keypoints.begin(), keypoints.end(),
+                                   [&](const KeypointType& kp) {
+                                       return kp.response < th_fast && level_data.strong_cell[cell_index(kp)];
+                                   }),
+                    keypoints.end());
 
-void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vector<KeypointType>& _keypoints,
-                          std::vector<Saiga::DescriptorORB>& outputDescriptors)
-{
-    cv::setNumThreads(1);
-    if (inputImage.empty()) return;
+    const int minBorderX = EDGE_THRESHOLD - 3;
+    const int minBorderY = minBorderX;
+    const int maxBorderX = minBorderX + level_data.detection_region.cols;
+    const int maxBorderY = minBorderY + level_data.detection_region.rows;
 
+    keypoints = level_data.distributor.Distribute(keypoints, Saiga::vec2(minBorderX, minBorderY),
+                                                  Saiga::vec2(maxBorderX, maxBorderY), pyramid.Features(level));
 
-    outputDescriptors.clear();
-    ComputePyramid(inputImage);
-    DetectKeypoints();
+    const int scaledPatchSize = PATCH_SIZE * pyramid.Scale(level);
 
+    for (auto& kp : keypoints)
+    {
+        kp.point.x() += minBorderX;
+        kp.point.y() += minBorderY;
+        kp.octave = level;
+        kp.size   = scaledPatchSize;
+        kp.angle  = orb.ComputeAngle(level_data.image, kp.point);
+    }
+}
 
+int ORBExtractor::ComputeOffsets()
+{
     int nkeypoints = 0;
     for (int level = 0; level < num_levels; ++level)
     {
         levels[level].offset = nkeypoints;
-        int n                = (int)levels[level].keypoints_tmp.size();
-        nkeypoints += n;
+        nkeypoints += (int)levels[level].keypoints_tmp.size();
     }
+    return nkeypoints;
+}
 
-    outputDescriptors.resize(nkeypoints);
-    _keypoints.resize(nkeypoints);
+void ORBExtractor::BlurLevel(int level)
+{
+    // The border is blurred as well, so the descriptor patterns near the image edge are valid.
+    auto& level_data = levels[level];
+    ImageTransformation::GaussianBlur(level_data.image_with_border.getImageView(),
+                                      level_data.image_gauss.getImageView(), 3, 2);
+}
 
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
-    for (int level = 0; level < num_levels; ++level)
+void ORBExtractor::ComputeDescriptors(int level, int begin, int end, KeypointType* keypoints,
+                                      DescriptorORB* descriptors)
+{
+    auto& level_data = levels[level];
+    float scale      = pyramid.Scale(level);
+    for (int i = begin; i < end; ++i)
     {
-        auto& level_data    = levels[level];
-        auto& keypoints     = level_data.keypoints_tmp;
-        int nkeypointsLevel = (int)keypoints.size();
-
-        if (nkeypointsLevel == 0) continue;
-
-        auto image       = Saiga::ImageViewToMat(level_data.image);
-        auto image_gauss = Saiga::ImageViewToMat(level_data.image_gauss.getImageView());
+        auto& kp       = level_data.keypoints_tmp[i];
+        descriptors[i] = orb.ComputeDescriptor(level_data.image_gauss_inner, kp.point, kp.angle);
 
-        cv::GaussianBlur(image, image_gauss, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
-
-        int offset = level_data.offset;
-        for (size_t i = 0; i < keypoints.size(); i++)
-        {
-            outputDescriptors[offset + i] =
-                orb.ComputeDescriptor(level_data.image_gauss.getImageView(), keypoints[i].point, keypoints[i].angle);
-        }
-
-        // Scale keypoint coordinates
-        if (level != 0)
-        {
-            float scale = pyramid.Scale(level);
-            for (auto& kp : keypoints) kp.point *= scale;
-        }
-        // And add the keypoints to the output
-        for (int i = 0; i < nkeypointsLevel; ++i)
-        {
-            _keypoints[offset + i] = keypoints[i];
-        }
+        // Scale keypoint coordinates to level 0
+        keypoints[i] = kp;
+        keypoints[i].point *= scale;
     }
 }
 
 void ORBExtractor::AllocatePyramid(int rows, int cols)
 {
     SAIGA_ASSERT(!levels.empty());
-    if (levels.front().image.valid()) return;
+    if (levels.front().image.valid())
+    {
+        SAIGA_ASSERT(levels.front().image.rows == rows && levels.front().image.cols == cols);
+        return;
+    }
+
+    const float W = 30;
 
     for (int level = 0; level < num_levels; ++level)
     {
@@ -252,40 +241,54 @@ void ORBExtractor::AllocatePyramid(int rows, int cols)
         level_data.image_with_border.create(level_rows_with_border, level_cols_with_border);
         level_data.image = level_data.image_with_border.getImageView().subImageView(EDGE_THRESHOLD, EDGE_THRESHOLD,
                                                                                     level_rows, level_cols);
-        level_data.image_gauss.create(level_rows, level_cols);
+        level_data.image_gauss.create(level_rows_with_border, level_cols_with_border);
+        level_data.image_gauss_inner = level_data.image_gauss.getImageView().subImageView(
+            EDGE_THRESHOLD, EDGE_THRESHOLD, level_rows, level_cols);
+
+        // FAST is computed in the inner region with a distance of EDGE_THRESHOLD - 3 to the image border
+        const int minBorder = EDGE_THRESHOLD - 3;
+        const int width     = level_cols - 2 * minBorder;
+        const int height    = level_rows - 2 * minBorder;
+
+        level_data.detection_region = level_data.image.subImageView(minBorder, minBorder, height, width);
+
+        level_data.cell_cols   = width / W;
+        level_data.cell_rows   = height / W;
+        level_data.cell_width  = ceil(width / float(level_data.cell_cols));
+        level_data.cell_height = ceil(height / float(level_data.cell_rows));
+
+        int num_bands = std::max(1, height / BAND_HEIGHT);
+        level_data.bands.resize(num_bands);
+        for (int b = 0; b < num_bands; ++b)
+        {
+            level_data.bands[b].row_begin = b * height / num_bands;
+            level_data.bands[b].row_end   = (b + 1) * height / num_bands;
+            level_data.bands[b].keypoints.reserve(pyramid.total_num_features * 10 / num_bands);
+            bands.emplace_back(level, b);
+        }
 
         level_data.keypoints_tmp.reserve(pyramid.total_num_features * 10);
     }
 }
 
-void ORBExtractor::ComputePyramid(Saiga::ImageView<unsigned char> image)
+void ORBExtractor::SetImage(Saiga::ImageView<const unsigned char> image)
 {
     AllocatePyramid(image.rows, image.cols);
+    image.copyTo(levels.front().image);
+}
 
-    cv::Mat cv_image = Saiga::ImageViewToMat(image);
-    assert(cv_image.type() == CV_8UC1);
-
-    SAIGA_ASSERT(!levels.empty());
-    cv::copyMakeBorder(cv_image, Saiga::ImageViewToMat(levels.front().image_with_border.getImageView()), EDGE_THRESHOLD,
-                       EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, cv::BORDER_REFLECT_101);
-
+void ORBExtractor::ComputePyramid()
+{
+    // Each level is downsampled from the inner region of the previous level
     for (int level = 1; level < num_levels; ++level)
     {
-        auto& level_data      = levels[level];
-        auto& level_data_prev = levels[level - 1];
-
-        auto image      = Saiga::ImageViewToMat(level_data.image);
-        auto image_prev = Saiga::ImageViewToMat(level_data_prev.image);
-        auto temp       = Saiga::ImageViewToMat(levels.front().image_with_border.getImageView());
-
-
-        cv::resize(image_prev, image, cv::Size(image.cols, image.rows), 0, 0, cv::INTER_LINEAR);
+        ImageTransformation::ResizeLinear(levels[level - 1].image, levels[level].image);
+    }
 
-        cv::copyMakeBorder(image, temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                           cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED);
+    for (auto& level_data : levels)
+    {
+        ImageTransformation::FillBorderReflect101(level_data.image_with_border.getImageView(), EDGE_THRESHOLD);
     }
 }
 
 }  // namespace Saiga
-
-#endif
@@ -30,17 +30,23 @@
 #include "saiga/config.h"
 #include "saiga/core/image/imageView.h"
 #include "saiga/core/image/templatedImage.h"
+#include "saiga/vision/features/FastDetector.h"
 #include "saiga/vision/features/FeatureDistribution.h"
 #include "saiga/vision/features/Features.h"
 #include "saiga/vision/features/OrbDescriptors.h"
 #include "saiga/vision/util/ScalePyramid.h"
 
+#include <utility>
 #include <vector>
 
-#ifdef SAIGA_USE_OPENCV
-
 namespace Saiga
 {
+/**
+ * Multi-scale ORB feature extraction.
+ *
+ * The scale pyramid, FAST corners and the gaussian blur for the descriptors are computed with the CPU
+ * implementations in FastDetector and ImageTransformation. OpenCV is not required.
+ */
 class SAIGA_VISION_API ORBExtractor
 {
    public:
@@ -62,10 +68,39 @@ class SAIGA_VISION_API ORBExtractor
         return pyramid;
     }
 
+    int NumLevels() const { return num_levels; }
+
+    // ============== Stages of Detect() ==============
+    // Used by ORBExtractorAsync to schedule the work of multiple frames on a task scheduler.
+    // The stages must be called in this order. Calls with different level or band arguments of the same stage can
+    // run in parallel.
+
+    // Copies the image to level 0.
+    void SetImage(Saiga::ImageView<const unsigned char> image);
+    // Computes the other levels and the borders.
+    void ComputePyramid();
+
+    // FAST in one horizontal band of a level. The band list is valid after the first SetImage.
+    const std::vector<std::pair<int, int>>& Bands() const { return bands; }
+    void DetectBand(int level, int band);
+
+    // Selects the keypoints of this level with the quadtree and computes their orientation.
+    void DistributeKeypoints(int level);
+    int NumKeypoints(int level) const { return levels[level].keypoints_tmp.size(); }
+
+    // Computes the offset of each level in the output arrays. Returns the total number of keypoints.
+    int ComputeOffsets();
+    int LevelOffset(int level) const { return levels[level].offset; }
+
+    void BlurLevel(int level);
+
+    // Computes the descriptors of the keypoints [begin, end) of this level after BlurLevel.
+    // keypoints/descriptors point to the start of this level in the output arrays.
+    // The output keypoints are scaled to level 0.
+    void ComputeDescriptors(int level, int begin, int end, KeypointType* keypoints, DescriptorORB* descriptors);
+
    protected:
     void AllocatePyramid(int rows, int cols);
-    void ComputePyramid(Saiga::ImageView<unsigned char> image);
-    void DetectKeypoints();
 
     int num_levels;
     int th_fast;
@@ -80,15 +115,37 @@ class SAIGA_VISION_API ORBExtractor
     {
         int N;
         int offset;
+        // The image and its blurred version have a reflected border of EDGE_THRESHOLD pixels.
         Saiga::TemplatedImage<unsigned char> image_with_border;
         Saiga::TemplatedImage<unsigned char> image_gauss;
+        // Views to the inner region (without border)
         Saiga::ImageView<unsigned char> image;
+        Saiga::ImageView<unsigned char> image_gauss_inner;
+        // The region of 'image' in which FAST is computed
+        Saiga::ImageView<unsigned char> detection_region;
+
+        // Grid of the detection region. Each cell keeps either the corners with th_fast or th_fast_min.
+        int cell_cols, cell_rows;
+        int cell_width, cell_height;
+
+        // FAST is computed in horizontal bands of the detection region, which can be processed in parallel
+        struct Band
+        {
+            int row_begin, row_end;
+            Saiga::FastDetector fast;
+            std::vector<KeypointType> keypoints;
+        };
+        std::vector<Band> bands;
+
+        // 1 if the cell has a corner with response >= th_fast
+        std::vector<char> strong_cell;
         std::vector<KeypointType> keypoints_tmp;
         Saiga::QuadtreeFeatureDistributor distributor;
     };
     std::vector<Level> levels;
+
+    // (level, band) of all bands
+    std::vector<std::pair<int, int>> bands;
 };
 
 }  // namespace Saiga
-
-#endif
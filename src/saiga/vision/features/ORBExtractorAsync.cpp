@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "ORBExtractorAsync.h"
+
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+
+namespace Saiga
+{
+// Number of keypoints per descriptor task
+static constexpr int kDescriptorChunk = 128;
+
+ORBExtractorAsync::ORBExtractorAsync(int nfeatures, float scaleFactor, int num_levels, int th_fast,
+                                     int th_fast_min, int num_threads, int num_buffers)
+{
+    SAIGA_ASSERT(num_buffers > 0);
+    for (int i = 0; i < num_buffers; ++i)
+    {
+        buffers.push_back(
+            std::make_unique<ORBExtractor>(nfeatures, scaleFactor, num_levels, th_fast, th_fast_min, 1));
+        free_buffers.push_back(i);
+    }
+    scheduler = std::make_unique<WorkStealingScheduler>(std::max(num_threads, 1), "ORBExtractor");
+}
+
+ORBExtractorAsync::~ORBExtractorAsync()
+{
+    Wait();
+    scheduler->quit();
+}
+
+std::future<ORBExtractorAsync::Features> ORBExtractorAsync::Detect(ImageView<const unsigned char> image)
+{
+    auto promise = std::make_shared<std::promise<Features>>();
+    auto result  = promise->get_future();
+    Detect(image, [promise](Features&& features) { promise->set_value(std::move(features)); });
+    return result;
+}
+
+void ORBExtractorAsync::Detect(ImageView<const unsigned char> image, Callback callback)
+{
+    int buffer;
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex);
+        buffer_cv.wait(lock, [this]() { return !free_buffers.empty(); });
+        buffer = free_buffers.back();
+        free_buffers.pop_back();
+    }
+
+    int64_t frame;
+    {
+        std::unique_lock<std::mutex> lock(delivery_mutex);
+        frame = next_frame++;
+    }
+
+    buffers[buffer]->SetImage(image);
+    scheduler->spawn([this, buffer, frame, callback = std::move(callback)]() mutable {
+        Process(buffer, frame, std::move(callback));
+    });
+}
+
+void ORBExtractorAsync::Wait()
+{
+    std::unique_lock<std::mutex> lock(delivery_mutex);
+    delivery_cv.wait(lock, [this]() { return next_delivery == next_frame; });
+}
+
+void ORBExtractorAsync::Process(int buffer, int64_t frame, Callback callback)
+{
+    ORBExtractor& extractor = *buffers[buffer];
+    const int num_levels    = extractor.NumLevels();
+
+    // While this task waits for its children, the worker executes other tasks, for example the pyramid of the
+    // next frame.
+    extractor.ComputePyramid();
+    {
+        TaskGroup group(*scheduler);
+        for (auto band : extractor.Bands())
+        {
+            group.run([&extractor, band]() { extractor.DetectBand(band.first, band.second); });
+        }
+        group.wait();
+
+        for (int level = 0; level < num_levels; ++level)
+        {
+            group.run([&extractor, level]() { extractor.DistributeKeypoints(level); });
+        }
+        group.wait();
+    }
+
+    Features features;
+    int n = extractor.ComputeOffsets();
+    features.keypoints.resize(n);
+    features.descriptors.resize(n);
+
+    {
+        TaskGroup group(*scheduler);
+        for (int level = 0; level < num_levels; ++level)
+        {
+            int n_level = extractor.NumKeypoints(level);
+            if (n_level == 0) continue;
+
+            group.run([this, &extractor, &features, level, n_level]() {
+                extractor.BlurLevel(level);
+
+                KeypointType* keypoints    = features.keypoints.data() + extractor.LevelOffset(level);
+                DescriptorORB* descriptors = features.descriptors.data() + extractor.LevelOffset(level);
+
+                TaskGroup chunks(*scheduler);
+                for (int begin = 0; begin < n_level; begin += kDescriptorChunk)
+                {
+                    int end = std::min(begin + kDescriptorChunk, n_level);
+                    chunks.run([&extractor, level, begin, end, keypoints, descriptors]() {
+                        extractor.ComputeDescriptors(level, begin, end, keypoints, descriptors);
+                    });
+                }
+                chunks.wait();
+            });
+        }
+        group.wait();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex);
+        free_buffers.push_back(buffer);
+    }
+    buffer_cv.notify_one();
+
+    Deliver(frame, std::move(features), std::move(callback));
+}
+
+void ORBExtractorAsync::Deliver(int64_t frame, Features&& features, Callback&& callback)
+{
+    std::unique_lock<std::mutex> lock(delivery_mutex);
+    finished.emplace(frame, std::make_pair(std::move(features), std::move(callback)));
+
+    // Only one thread delivers at a time: the one that finished the frame 'next_delivery'.
+    if (frame != next_delivery) return;
+    while (!finished.empty() && finished.begin()->first == next_delivery)
+    {
+        auto item = std::move(finished.begin()->second);
+        finished.erase(finished.begin());
+
+        lock.unlock();
+        if (item.second) item.second(std::move(item.first));
+        lock.lock();
+
+        next_delivery++;
+    }
+    lock.unlock();
+    delivery_cv.notify_all();
+}
+
+}  // namespace Saiga
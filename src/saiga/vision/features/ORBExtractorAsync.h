@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/Thread/WorkStealing.h"
+#include "saiga/vision/features/ORBExtractor.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * Pipelined ORB extraction of an image stream.
+ *
+ * Every frame is split into tasks of a work-stealing scheduler: pyramid, FAST on all bands of all levels, keypoint
+ * distribution per level and descriptors in chunks of keypoints. The workers execute the tasks of all frames in
+ * flight, therefore the pyramid of frame N+1 is built while the keypoints and descriptors of frame N are computed.
+ *
+ * The pyramid and FAST buffers are the Levels of 'num_buffers' ORBExtractor objects, which are reused for the
+ * following frames. Detect() only blocks if all buffers are in use. The results are identical to
+ * ORBExtractor::Detect.
+ *
+ * Usage:
+ *   ORBExtractorAsync extractor(1000, 1.2, 8, 20, 7, 4);
+ *   auto f0 = extractor.Detect(image0);
+ *   auto f1 = extractor.Detect(image1);
+ *   ORBExtractorAsync::Features features0 = f0.get();
+ */
+class SAIGA_VISION_API ORBExtractorAsync
+{
+   public:
+    using KeypointType = ORBExtractor::KeypointType;
+
+    struct Features
+    {
+        std::vector<KeypointType> keypoints;
+        std::vector<DescriptorORB> descriptors;
+    };
+    using Callback = std::function<void(Features&&)>;
+
+    ORBExtractorAsync(int nfeatures, float scaleFactor, int num_levels, int th_fast, int th_fast_min,
+                      int num_threads, int num_buffers = 2);
+    // Waits until all frames are finished.
+    ~ORBExtractorAsync();
+
+    // The image is copied before this function returns.
+    // Must not be called from a callback.
+    std::future<Features> Detect(ImageView<const unsigned char> image);
+
+    // The callback is executed on a worker thread. The callbacks are called in the same order as Detect().
+    void Detect(ImageView<const unsigned char> image, Callback callback);
+
+    // Blocks until the callbacks of all frames are finished.
+    void Wait();
+
+   private:
+    std::vector<std::unique_ptr<ORBExtractor>> buffers;
+    std::unique_ptr<WorkStealingScheduler> scheduler;
+
+    // Extracts the features of the image in the given buffer.
+    void Process(int buffer, int64_t frame, Callback callback);
+    void Deliver(int64_t frame, Features&& features, Callback&& callback);
+
+    std::mutex buffer_mutex;
+    std::condition_variable buffer_cv;
+    std::vector<int> free_buffers;
+
+    // Finished frames, which wait for the delivery of their predecessors
+    std::mutex delivery_mutex;
+    std::condition_variable delivery_cv;
+    std::map<int64_t, std::pair<Features, Callback>> finished;
+    int64_t next_frame    = 0;
+    int64_t next_delivery = 0;
+};
+
+}  // namespace Saiga
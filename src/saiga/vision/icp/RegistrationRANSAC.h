@@ -52,9 +52,10 @@ class RegistrationProjectRANSAC
      *
      * @brief solve
      * @param maxIterations
-     * @param stopInliers Early termination when that amount of inliers are found
+     * @param confidence Early termination when an outlier free sample was drawn with this probability.
+     *                   See RansacRequiredIterations(). 1 runs all iterations.
      */
-    std::tuple<SE3, double, int> solve(int maxIterations, bool computeScale)
+    std::tuple<SE3, double, int> solve(int maxIterations, bool computeScale, double confidence = 0.999)
     {
         constexpr int sampleSize = 3;
 
@@ -69,7 +70,8 @@ class RegistrationProjectRANSAC
         int bestInliers  = 0;
         double bestScale = 1;
 
-        for (int i = 0; i < maxIterations; ++i)
+        int iterations = maxIterations;
+        for (int i = 0; i < iterations; ++i)
         {
             // Get 3 matches and store them in A,B
             for (auto j : Range(0, sampleSize))
@@ -113,6 +115,7 @@ class RegistrationProjectRANSAC
                 bestInliers = currentInliers;
                 bestT       = rel;
                 bestScale   = scale;
+                iterations  = RansacRequiredIterations(double(bestInliers) / N, sampleSize, confidence, maxIterations);
             }
         }
         return {bestT, bestScale, bestInliers};
@@ -8,20 +8,26 @@
 #include "saiga/core/geometry/all.h"
 #include "saiga/core/image/all.h"
 #include "saiga/core/util/BinaryFile.h"
+#include "saiga/core/util/DataStructures/ChunkedVector.h"
 #include "saiga/core/util/ProgressBar.h"
 #include "saiga/core/util/Thread/SpinLock.h"
 #include "saiga/core/util/Thread/omp.h"
 
+#include "VoxelLayout.h"
+
+#include <functional>
 
 namespace Saiga
 {
-template <typename VoxelType, int _VOXEL_BLOCK_SIZE>
+// The Layout defines how the voxels of a block are stored in memory. See VoxelLayout.h.
+template <typename VoxelType, int _VOXEL_BLOCK_SIZE, typename Layout = VoxelLayoutAoS<VoxelType, _VOXEL_BLOCK_SIZE>>
 struct SAIGA_TEMPLATE BlockSparseGrid
 {
     static constexpr int VOXEL_BLOCK_SIZE = _VOXEL_BLOCK_SIZE;
     using VoxelBlockIndex                 = ivec3;
     using VoxelIndex                      = ivec3;
     using Voxel                           = VoxelType;
+    using VoxelLayout                     = Layout;
 
 
     // A voxel block is a 3 dimensional array of voxels.
@@ -29,23 +35,33 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     //
     // Due to the sparse storage, each voxel block has to known it's own index.
     // The next_index points to the next voxel block in the same hash bucket.
+    //
+    // With the default (AoS) layout, 'data' can be indexed directly as data[z][y][x]. The accessors below work for
+    // all layouts.
     struct VoxelBlock
     {
-        //        Voxel data[VOXEL_BLOCK_SIZE][VOXEL_BLOCK_SIZE][VOXEL_BLOCK_SIZE];
-        std::array<std::array<std::array<Voxel, 8>, 8>, 8> data;
+        typename Layout::Storage data;
         VoxelBlockIndex index = VoxelBlockIndex(-973454, -973454, -973454);
         int next_index        = -1;
 
+        Voxel Get(int z, int y, int x) const { return Layout::Get(data, z, y, x); }
+        void Set(int z, int y, int x, const Voxel& v) { Layout::Set(data, z, y, x, v); }
+
+        float Distance(int z, int y, int x) const { return Layout::Distance(data, z, y, x); }
+        float Weight(int z, int y, int x) const { return Layout::Weight(data, z, y, x); }
+        void SetDistance(int z, int y, int x, float distance) { Layout::SetDistance(data, z, y, x, distance); }
+        void SetWeight(int z, int y, int x, float weight) { Layout::SetWeight(data, z, y, x, weight); }
+
         // the weight of all voxels is 0
-        bool Empty()
+        bool Empty() const
         {
-            for (auto& vz : data)
+            for (int z = 0; z < VOXEL_BLOCK_SIZE; ++z)
             {
-                for (auto& vy : vz)
+                for (int y = 0; y < VOXEL_BLOCK_SIZE; ++y)
                 {
-                    for (auto& v : vy)
+                    for (int x = 0; x < VOXEL_BLOCK_SIZE; ++x)
                     {
-                        if (v.weight > 0) return false;
+                        if (Weight(z, y, x) > 0) return false;
                     }
                 }
             }
@@ -54,32 +70,39 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     };
 
 
+    // The block storage grows on demand. 'reserve_blocks' is only the initial capacity.
     BlockSparseGrid(float voxel_size = 0.01, int reserve_blocks = 1000, int hash_size = 100000)
         : voxel_size(voxel_size),
           voxel_size_inv(1.0 / voxel_size),
           hash_size(hash_size),
           blocks(reserve_blocks),
-          first_hashed_block(hash_size, -1),
-          hash_locks(hash_size)
+          first_hashed_block(hash_size),
+          hash_locks(hash_size),
+          block_dirty(reserve_blocks)
 
     {
         block_size_inv = 1.0 / (voxel_size * VOXEL_BLOCK_SIZE);
+        ResetHash();
     }
 
+    // The block_fault_handler is not copied, because it is bound to the original grid.
     BlockSparseGrid(const BlockSparseGrid& other)
     {
-        voxel_size         = other.voxel_size;
-        voxel_size_inv     = other.voxel_size_inv;
-        hash_size          = other.hash_size;
-        blocks             = other.blocks;
-        first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
-        current_blocks     = other.current_blocks.load();
+        voxel_size     = other.voxel_size;
+        voxel_size_inv = other.voxel_size_inv;
+        block_size_inv = other.block_size_inv;
+        hash_size      = other.hash_size;
+        blocks         = other.blocks;
+        block_dirty    = other.block_dirty;
+        erased_blocks  = other.erased_blocks;
+        CopyHash(other);
+        hash_locks     = std::vector<SpinLock>(hash_size);
+        current_blocks = other.current_blocks.load();
     }
 
     size_t Memory()
     {
-        size_t mem_blocks = blocks.size() * sizeof(VoxelBlock);
+        size_t mem_blocks = blocks.Memory();
         size_t mem_hash   = first_hashed_block.size() * sizeof(int);
         return mem_blocks + mem_hash + sizeof(*this);
     }
@@ -101,23 +124,11 @@ struct SAIGA_TEMPLATE BlockSparseGrid
             return block;
         }
 
-        // Create block and insert as the first element.
-        int new_index = current_blocks.fetch_add(1);
-
-        if (new_index >= (int)blocks.size())
-        {
-            blocks.resize(blocks.size() * 2);
-        }
-
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
-        return new_block;
+        return InsertNewBlock(i, h);
     }
 
-    bool EraseBlock(const VoxelBlockIndex& i)
+    // If 'report' is set, the index of the removed block is returned by the next call to TakeDirtyBlocks.
+    bool EraseBlock(const VoxelBlockIndex& i, bool report = true)
     {
         int block_id = GetBlockId(i);
         //        if (block_id < 0) return false;
@@ -125,12 +136,14 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
         int h = H(i);
         if (!EraseBlockWithHole(i, h)) return false;
+        if (report) erased_blocks.push_back(i);
 
         if (block_id == current_blocks - 1)
         {
             // The removed block is at the end of the array -> just remove
             //            std::cout << "remove end" << std::endl;
             current_blocks--;
+            block_dirty[block_id] = false;
             return true;
         }
         else
@@ -147,9 +160,11 @@ struct SAIGA_TEMPLATE BlockSparseGrid
             EraseBlockWithHole(last_b.index, last_h);
             auto* new_block = &blocks[block_id];
 
-            *new_block                 = last_b;
-            new_block->next_index      = first_hashed_block[last_h];
-            first_hashed_block[last_h] = block_id;
+            *new_block                      = last_b;
+            new_block->next_index           = first_hashed_block[last_h];
+            first_hashed_block[last_h]      = block_id;
+            block_dirty[block_id]           = block_dirty[current_blocks - 1];
+            block_dirty[current_blocks - 1] = false;
             current_blocks--;
             return true;
         }
@@ -157,56 +172,55 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
     bool EraseBlockWithHole(const VoxelBlockIndex& i, int hash)
     {
-        int* block_id_ptr = &first_hashed_block[hash];
-
-        bool found = false;
+        int prev_id  = -1;
+        int block_id = first_hashed_block[hash].load(std::memory_order_relaxed);
 
-        while (*block_id_ptr != -1)
+        while (block_id != -1)
         {
-            auto& b = blocks[*block_id_ptr];
-
-            if (b.index == i)
-            {
-                found = true;
-                break;
-            }
-
-            block_id_ptr = &b.next_index;
+            if (blocks[block_id].index == i) break;
+            prev_id  = block_id;
+            block_id = blocks[block_id].next_index;
         }
-        if (!found) return false;
+        if (block_id == -1) return false;
 
-        *block_id_ptr = blocks[*block_id_ptr].next_index;
+        int next = blocks[block_id].next_index;
+        if (prev_id == -1)
+        {
+            first_hashed_block[hash].store(next, std::memory_order_relaxed);
+        }
+        else
+        {
+            blocks[prev_id].next_index = next;
+        }
         return true;
     }
 
+    // Thread-safe version of InsertBlock.
+    //
+    // The lookup is lock-free. Only if the block does not exist yet, the bucket is locked and the block is
+    // appended to the chunked block storage. The storage grows lock-free, therefore no capacity has to be
+    // reserved before a parallel insertion.
+    //
+    // Must not be called concurrently with EraseBlock.
     VoxelBlock* InsertBlockLock(const VoxelBlockIndex& i)
     {
         int h = H(i);
 
-        std::unique_lock lock(hash_locks[h]);
-
+        // Fast path: most calls hit an existing block.
         auto block = GetBlock(i, h);
+        if (block) return block;
 
-        if (block)
-        {
-            // block already exists
-            return block;
-        }
-
-        // Create block and insert as the first element.
-        int new_index = current_blocks.fetch_add(1);
+        std::unique_lock lock(hash_locks[h]);
 
-        if (new_index >= (int)blocks.size())
+        // Check again, because a different thread could have inserted it in the meantime.
+        // The fault handler is not called here, because it locks the bucket itself.
+        int id = GetBlockId(i, h);
+        if (id >= 0)
         {
-            SAIGA_EXIT_ERROR("Resizing not allowed during parallel insertion!");
+            // block already exists
+            return &blocks[id];
         }
-
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
-        return new_block;
+        return InsertNewBlock(i, h);
     }
 
     void AllocateAroundPoint(const vec3& position, int r = 1)
@@ -281,7 +295,7 @@ struct SAIGA_TEMPLATE BlockSparseGrid
         if (block)
         {
             ivec3 local_offset = GetLocalOffset(block_id, virtual_voxel);
-            return block->data[local_offset.z()][local_offset.y()][local_offset.x()];
+            return block->Get(local_offset.z(), local_offset.y(), local_offset.x());
         }
         else
         {
@@ -295,7 +309,7 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     {
         if (current_blocks == 0) return {};
 
-        iRect<3> result(blocks.front().index);
+        iRect<3> result(blocks[0].index);
 
         for (int i = 0; i < current_blocks; ++i)
         {
@@ -351,7 +365,42 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     }
 
 
-    void Compact() { blocks.resize(current_blocks); }
+    // Frees the unused block storage.
+    void Compact()
+    {
+        blocks.shrink(current_blocks);
+        block_dirty.shrink(current_blocks);
+    }
+
+    // Returns the index of all blocks which changed since the last call and resets the dirty flags.
+    // A block is dirty after the insertion, after it was removed by EraseBlock, or if it was marked with SetDirty.
+    // Removed blocks can be detected with GetBlockId(index) < 0.
+    std::vector<VoxelBlockIndex> TakeDirtyBlocks()
+    {
+        std::vector<VoxelBlockIndex> result;
+        result.swap(erased_blocks);
+        for (int i = 0; i < current_blocks; ++i)
+        {
+            if (block_dirty[i])
+            {
+                result.push_back(blocks[i].index);
+                block_dirty[i] = false;
+            }
+        }
+        return result;
+    }
+
+    // Thread-safe for different block ids.
+    void SetDirty(int block_id) { block_dirty[block_id] = true; }
+
+    void SetAllDirty()
+    {
+        block_dirty.reserve(current_blocks);
+        for (int i = 0; i < current_blocks; ++i)
+        {
+            block_dirty[i] = true;
+        }
+    }
 
     int Size() { return current_blocks; }
 
@@ -364,21 +413,59 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
     unsigned int hash_size;
     std::atomic_int current_blocks = 0;
-    std::vector<VoxelBlock> blocks;
-    std::vector<int> first_hashed_block;
+
+    // Stable addresses -> can grow during parallel insertion
+    ChunkedVector<VoxelBlock> blocks;
+
+    // The first block id of each hash bucket. Atomic, so that lookups don't need the lock.
+    std::vector<std::atomic_int> first_hashed_block;
     std::vector<SpinLock> hash_locks;
 
+    // One flag for each element in 'blocks'. Stored separately to keep the memory layout of the voxel blocks.
+    ChunkedVector<unsigned char> block_dirty;
+
+    // Blocks removed since the last TakeDirtyBlocks.
+    std::vector<VoxelBlockIndex> erased_blocks;
+
+    // Called by GetBlock if the block is not resident.
+    // Can load the block from an external storage (for example the SparseTSDFStreamer) and must return nullptr
+    // if the block does not exist at all. The handler has to lock the hash bucket before inserting the block.
+    std::function<VoxelBlock*(const VoxelBlockIndex&)> block_fault_handler;
+
 
     void Clear()
     {
+        for (int i = 0; i < current_blocks; ++i)
+        {
+            erased_blocks.push_back(blocks[i].index);
+        }
         current_blocks = 0;
-        for (auto& b : blocks)
+        for (size_t i = 0; i < blocks.capacity(); ++i)
+        {
+            blocks[i] = VoxelBlock();
+        }
+        for (size_t i = 0; i < block_dirty.capacity(); ++i)
         {
-            b = VoxelBlock();
+            block_dirty[i] = false;
         }
+        ResetHash();
+    }
+
+    void ResetHash()
+    {
         for (auto& i : first_hashed_block)
         {
-            i = -1;
+            i.store(-1, std::memory_order_relaxed);
+        }
+    }
+
+    void CopyHash(const BlockSparseGrid& other)
+    {
+        first_hashed_block = std::vector<std::atomic_int>(other.first_hashed_block.size());
+        for (size_t i = 0; i < first_hashed_block.size(); ++i)
+        {
+            first_hashed_block[i].store(other.first_hashed_block[i].load(std::memory_order_relaxed),
+                                        std::memory_order_relaxed);
         }
     }
 
@@ -398,7 +485,7 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     // returns -1 if it does not exist
     int GetBlockId(const VoxelBlockIndex& i, int hash)
     {
-        int block_id = first_hashed_block[hash];
+        int block_id = first_hashed_block[hash].load(std::memory_order_acquire);
 
         while (block_id != -1)
         {
@@ -420,11 +507,40 @@ struct SAIGA_TEMPLATE BlockSparseGrid
         {
             return &blocks[id];
         }
+        else if (block_fault_handler)
+        {
+            return block_fault_handler(i);
+        }
         else
         {
             return nullptr;
         }
     }
+
+    // Creates a new block and inserts it as the first element of the bucket.
+    // The voxels are initialized with 'data' or default constructed if data is nullptr.
+    // If called in parallel, the bucket must be locked.
+    VoxelBlock* InsertNewBlock(const VoxelBlockIndex& i, int hash, const decltype(VoxelBlock::data)* data = nullptr)
+    {
+        int new_index = current_blocks.fetch_add(1);
+        blocks.reserve(new_index + 1);
+        block_dirty.reserve(new_index + 1);
+        block_dirty[new_index] = true;
+
+        // The slot might contain an old block from a previous EraseBlock.
+        auto* new_block = &blocks[new_index];
+        *new_block      = VoxelBlock();
+        if (data)
+        {
+            new_block->data = *data;
+        }
+        new_block->index      = i;
+        new_block->next_index = first_hashed_block[hash].load(std::memory_order_relaxed);
+
+        // Publish the block to lock-free readers
+        first_hashed_block[hash].store(new_index, std::memory_order_release);
+        return new_block;
+    }
 };
 
 
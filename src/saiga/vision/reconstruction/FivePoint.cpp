@@ -495,33 +495,33 @@ int FivePointRansac::solve(ArrayView<const Vec2> _points1, ArrayView<const Vec2>
         points1 = _points1;
         points2 = _points2;
         N       = points1.size();
+        soa1.set(points1);
+        soa2.set(points2);
     }
 
 
 
-    int idx;
-    idx = compute(points1.size());
+    int num_inliers = compute(points1.size());
 
 
 
 #pragma omp single
     {
-        //            std::cout << "best idx " << idx << std::endl;
-        bestE = models[idx].first;
-        bestT = models[idx].second;
+        bestE = bestModel.first;
+        bestT = bestModel.second;
 
         bestInlierMatches.clear();
-        bestInlierMatches.reserve(numInliers[idx]);
+        bestInlierMatches.reserve(num_inliers);
         for (int i = 0; i < N; ++i)
         {
-            if (inliers[idx][i]) bestInlierMatches.push_back(i);
+            if (bestInlierMask[i]) bestInlierMatches.push_back(i);
         }
 
-        inlierMask = inliers[idx];
+        inlierMask = bestInlierMask;
     }
 
 
-    return numInliers[idx];
+    return num_inliers;
 }
 
 bool FivePointRansac::computeModel(const RansacBase::Subset& set, FivePointRansac::Model& model)
@@ -559,4 +559,22 @@ double FivePointRansac::computeResidual(const FivePointRansac::Model& model, int
     return EpipolarDistanceSquared(points1[i], points2[i], model.first);
 }
 
+void FivePointRansac::computeResiduals(const FivePointRansac::Model& model, int begin, int end, double* residuals)
+{
+    const Mat3& E    = model.first;
+    const double *x1 = soa1[0], *y1 = soa1[1], *x2 = soa2[0], *y2 = soa2[1];
+
+    // Same as EpipolarDistanceSquared
+#pragma omp simd
+    for (int i = begin; i < end; ++i)
+    {
+        double lx = E(0, 0) * x1[i] + E(0, 1) * y1[i] + E(0, 2);
+        double ly = E(1, 0) * x1[i] + E(1, 1) * y1[i] + E(1, 2);
+        double lz = E(2, 0) * x1[i] + E(2, 1) * y1[i] + E(2, 2);
+        double d  = x2[i] * lx + y2[i] * ly + lz;
+
+        residuals[i - begin] = d * d / (lx * lx + ly * ly);
+    }
+}
+
 }  // namespace Saiga
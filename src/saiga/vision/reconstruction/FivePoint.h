@@ -73,8 +73,14 @@ class SAIGA_VISION_API FivePointRansac : public RansacBase<FivePointRansac, std:
 
     double computeResidual(const Model& model, int i);
 
+    // Vectorized version of computeResidual() on the SoA copy of the points.
+    void computeResiduals(const Model& model, int begin, int end, double* residuals);
+
     ArrayView<const Vec2> points1;
     ArrayView<const Vec2> points2;
+
+   private:
+    RansacPoints<2> soa1, soa2;
 };
 
 
@@ -67,21 +67,12 @@ int HomographyRansac::solve(ArrayView<const Vec2> _points1, ArrayView<const Vec2
 {
     points1 = _points1;
     points2 = _points2;
+    soa1.set(points1);
+    soa2.set(points2);
 
-    int idx = 0;
-
-#pragma omp parallel num_threads(params.threads)
-    {
-        int l_idx = compute(points1.size());
-
-        if (OMP::getThreadNum() == 0)
-        {
-            // fix write/write face condition
-            idx = l_idx;
-        }
-    }
-    bestH = models[idx];
-    return numInliers[idx];
+    int num_inliers = compute(points1.size());
+    bestH           = bestModel;
+    return num_inliers;
 }
 
 bool HomographyRansac::computeModel(const RansacBase::Subset& set, HomographyRansac::Model& model)
@@ -102,6 +93,24 @@ double HomographyRansac::computeResidual(const HomographyRansac::Model& model, i
     return homographyResidual(points1[i], points2[i], model);
 }
 
+void HomographyRansac::computeResiduals(const HomographyRansac::Model& H, int begin, int end, double* residuals)
+{
+    const double *x1 = soa1[0], *y1 = soa1[1], *x2 = soa2[0], *y2 = soa2[1];
+
+#pragma omp simd
+    for (int i = begin; i < end; ++i)
+    {
+        double px   = H(0, 0) * x1[i] + H(0, 1) * y1[i] + H(0, 2);
+        double py   = H(1, 0) * x1[i] + H(1, 1) * y1[i] + H(1, 2);
+        double pz   = H(2, 0) * x1[i] + H(2, 1) * y1[i] + H(2, 2);
+        double invz = 1.0 / pz;
+        double rx   = x2[i] - px * invz;
+        double ry   = y2[i] - py * invz;
+
+        residuals[i - begin] = rx * rx + ry * ry;
+    }
+}
+
 
 
 }  // namespace Saiga
@@ -50,8 +50,14 @@ class SAIGA_VISION_API HomographyRansac : public RansacBase<HomographyRansac, Ma
 
     double computeResidual(const Model& model, int i);
 
+    // Vectorized version of computeResidual() on the SoA copy of the points.
+    void computeResiduals(const Model& model, int begin, int end, double* residuals);
+
     ArrayView<const Vec2> points1;
     ArrayView<const Vec2> points2;
+
+   private:
+    RansacPoints<2> soa1, soa2;
 };
 
 
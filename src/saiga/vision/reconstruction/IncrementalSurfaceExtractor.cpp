@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "IncrementalSurfaceExtractor.h"
+
+#include <tuple>
+#include <unordered_set>
+
+namespace Saiga
+{
+IncrementalSurfaceExtractor::IncrementalSurfaceExtractor(SparseTSDF* tsdf, float iso, float outlier_factor,
+                                                         float min_weight)
+    : tsdf(tsdf), iso(iso), outlier_factor(outlier_factor), min_weight(min_weight)
+{
+    SAIGA_ASSERT(tsdf);
+    Reset();
+}
+
+void IncrementalSurfaceExtractor::Reset()
+{
+    mesh          = UnifiedMesh();
+    num_triangles = 0;
+    slots.clear();
+    free_slots.clear();
+    changed_triangles.clear();
+    tsdf->SetAllDirty();
+}
+
+int IncrementalSurfaceExtractor::Update(int threads)
+{
+    changed_triangles.clear();
+
+    // The triangles of a block depend on the neighbours in +x, +y, +z direction.
+    // -> A changed block invalidates itself and the 7 blocks in -x, -y, -z direction.
+    std::unordered_set<ivec3> to_update;
+    for (auto& index : tsdf->TakeDirtyBlocks())
+    {
+        if (tsdf->GetBlockId(index) < 0)
+        {
+            // The block was removed from the TSDF -> remove its triangles
+            auto it = slots.find(index);
+            if (it != slots.end())
+            {
+                num_triangles -= it->second.count;
+                Free(it->second);
+                slots.erase(it);
+            }
+        }
+
+        for (int z = 0; z <= 1; ++z)
+        {
+            for (int y = 0; y <= 1; ++y)
+            {
+                for (int x = 0; x <= 1; ++x)
+                {
+                    ivec3 n = index - ivec3(x, y, z);
+                    // GetBlockId doesn't load evicted blocks. Their triangles are kept.
+                    if (tsdf->GetBlockId(n) >= 0) to_update.insert(n);
+                }
+            }
+        }
+    }
+
+    // Sorted, so that the triangle ranges are allocated in a deterministic order
+    std::vector<ivec3> update_list(to_update.begin(), to_update.end());
+    std::sort(update_list.begin(), update_list.end(), [](const ivec3& a, const ivec3& b) {
+        return std::make_tuple(a.z(), a.y(), a.x()) < std::make_tuple(b.z(), b.y(), b.x());
+    });
+    std::vector<std::vector<Triangle>> triangles(update_list.size());
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 8)
+    for (int i = 0; i < (int)update_list.size(); ++i)
+    {
+        tsdf->ExtractBlockSurface(update_list[i], iso, outlier_factor, min_weight, triangles[i]);
+    }
+
+    // Find the (new) triangle ranges of all blocks
+    std::vector<Slot> write_slots(update_list.size());
+    for (int i = 0; i < (int)update_list.size(); ++i)
+    {
+        int count = triangles[i].size();
+        Slot slot;
+
+        auto it = slots.find(update_list[i]);
+        if (it != slots.end())
+        {
+            num_triangles -= it->second.count;
+            if (count > 0 && count <= it->second.capacity)
+            {
+                // Fits into the old range
+                slot = it->second;
+            }
+            else
+            {
+                Free(it->second);
+                slots.erase(it);
+            }
+        }
+
+        if (count > 0)
+        {
+            if (slot.capacity == 0) slot = Allocate(count);
+            slot.count            = count;
+            slots[update_list[i]] = slot;
+            num_triangles += count;
+            changed_triangles.push_back({slot.first_triangle, slot.capacity});
+        }
+        write_slots[i] = slot;
+    }
+
+#pragma omp parallel for num_threads(threads)
+    for (int i = 0; i < (int)update_list.size(); ++i)
+    {
+        if (write_slots[i].capacity == 0) continue;
+        WriteTriangles(write_slots[i].first_triangle, write_slots[i].capacity, triangles[i]);
+    }
+
+    return update_list.size();
+}
+
+UnifiedMesh IncrementalSurfaceExtractor::CompactMesh() const
+{
+    UnifiedMesh result;
+    for (int t = 0; t < mesh.NumFaces(); ++t)
+    {
+        auto f = mesh.triangles[t];
+        if (f(0) == f(1)) continue;
+
+        int n = result.NumVertices();
+        for (int i = 0; i < 3; ++i)
+        {
+            result.position.push_back(mesh.position[f(i)]);
+            result.normal.push_back(mesh.normal[f(i)]);
+            result.color.push_back(mesh.color[f(i)]);
+        }
+        result.triangles.push_back(ivec3(n, n + 1, n + 2));
+    }
+    return result;
+}
+
+IncrementalSurfaceExtractor::Slot IncrementalSurfaceExtractor::Allocate(int count)
+{
+    Slot slot;
+
+    // Best fit
+    auto it = free_slots.lower_bound(count);
+    if (it != free_slots.end())
+    {
+        slot.capacity       = it->first;
+        slot.first_triangle = it->second;
+        free_slots.erase(it);
+        return slot;
+    }
+
+    // Append with some space for growing
+    slot.capacity       = std::max(4, count + count / 2);
+    slot.first_triangle = mesh.NumFaces();
+
+    int new_size = mesh.NumFaces() + slot.capacity;
+    mesh.triangles.resize(new_size);
+    mesh.position.resize(new_size * 3, vec3::Zero());
+    mesh.normal.resize(new_size * 3, vec3::Zero());
+    mesh.color.resize(new_size * 3, vec4(1, 1, 1, 1));
+    return slot;
+}
+
+void IncrementalSurfaceExtractor::Free(const Slot& slot)
+{
+    WriteTriangles(slot.first_triangle, slot.capacity, {});
+    changed_triangles.push_back({slot.first_triangle, slot.capacity});
+    free_slots.insert({slot.capacity, slot.first_triangle});
+}
+
+void IncrementalSurfaceExtractor::WriteTriangles(int first, int capacity, const std::vector<Triangle>& triangles)
+{
+    SAIGA_ASSERT((int)triangles.size() <= capacity);
+
+    int count = triangles.size();
+    for (int i = 0; i < count; ++i)
+    {
+        int t     = first + i;
+        auto& tri = triangles[i];
+        vec3 n    = (tri[1] - tri[0]).cross(tri[2] - tri[0]);
+        float l   = n.norm();
+        n         = l > 0 ? vec3(n / l) : vec3::Zero();
+        int v     = 3 * t;
+        for (int j = 0; j < 3; ++j)
+        {
+            mesh.position[v + j] = tri[j];
+            mesh.normal[v + j]   = n;
+        }
+        mesh.triangles[t] = ivec3(v, v + 1, v + 2);
+    }
+
+    // Unused triangles of this range are degenerate
+    for (int i = count; i < capacity; ++i)
+    {
+        int t             = first + i;
+        int v             = 3 * t;
+        mesh.triangles[t] = ivec3(v, v, v);
+    }
+}
+
+}  // namespace Saiga
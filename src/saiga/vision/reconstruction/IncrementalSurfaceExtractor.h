@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/model/UnifiedMesh.h"
+#include "saiga/vision/VisionIncludes.h"
+
+#include "SparseTSDF.h"
+
+#include <map>
+#include <unordered_map>
+
+namespace Saiga
+{
+/**
+ * Incremental marching cubes on a SparseTSDF.
+ *
+ * Only the dirty blocks of the TSDF (see BlockSparseGrid::TakeDirtyBlocks) and their neighbours are triangulated
+ * again. The triangles of all other blocks are reused from the previous update. The triangles of blocks removed with
+ * EraseBlock are deleted, while blocks evicted by the SparseTSDFStreamer keep their triangles.
+ *
+ * Every block owns a contiguous range of triangles in the output mesh. Triangle t always uses the vertices
+ * 3t, 3t+1, 3t+2, therefore the vertex indices of unchanged blocks are stable between updates and a renderer only
+ * has to upload the ChangedTriangles(). Unused triangles inside a range are degenerate (all indices equal).
+ * Use CompactMesh() to get a mesh without these holes, for example for exporting.
+ *
+ * Usage:
+ *
+ * IncrementalSurfaceExtractor extractor(tsdf.get());
+ * while (running)
+ * {
+ *     scene.FuseIncrement(image, first);
+ *     extractor.Update();
+ *     upload(extractor.Mesh(), extractor.ChangedTriangles());
+ * }
+ */
+class SAIGA_VISION_API IncrementalSurfaceExtractor
+{
+   public:
+    IncrementalSurfaceExtractor(SparseTSDF* tsdf, float iso = 0, float outlier_factor = 8, float min_weight = 0);
+
+    // Triangulates all dirty blocks and patches the mesh.
+    // Returns the number of triangulated blocks.
+    int Update(int threads = 4);
+
+    // Clears the mesh and marks all blocks of the TSDF as dirty.
+    void Reset();
+
+    const UnifiedMesh& Mesh() const { return mesh; }
+
+    // The triangle soup of Mesh() without the holes of the free slots. Every triangle has its own three vertices.
+    // Unlike SparseTSDF::CreateMesh, the vertices are not merged and no post processing is applied.
+    UnifiedMesh CompactMesh() const;
+
+    // The triangle ranges [first, first + count) that were modified by the last update.
+    const std::vector<std::pair<int, int>>& ChangedTriangles() const { return changed_triangles; }
+
+    int NumTriangles() const { return num_triangles; }
+
+   private:
+    using Triangle = SparseTSDF::Triangle;
+
+    struct Slot
+    {
+        int first_triangle = 0;
+        int capacity       = 0;
+        int count          = 0;
+    };
+
+    SparseTSDF* tsdf;
+    float iso, outlier_factor, min_weight;
+
+    UnifiedMesh mesh;
+    int num_triangles = 0;
+    std::vector<std::pair<int, int>> changed_triangles;
+
+    std::unordered_map<ivec3, Slot> slots;
+    // Free triangle ranges (capacity -> first triangle) for best-fit allocation
+    std::multimap<int, int> free_slots;
+
+    Slot Allocate(int count);
+    void Free(const Slot& slot);
+    void WriteTriangles(int first, int capacity, const std::vector<Triangle>& triangles);
+};
+
+}  // namespace Saiga
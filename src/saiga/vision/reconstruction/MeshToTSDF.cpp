@@ -217,7 +217,7 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
 
 
 
-    AccelerationStructure::ObjectMedianBVH bvh(triangles);
+    AccelerationStructure::SAHBVH bvh(triangles);
     bvh.triangle_epsilon = 0;
     {
         ProgressBar bar(std::cout, "M2TSDF Compute Unsigned Distance", tsdf->current_blocks);
@@ -242,8 +242,8 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
                         //                            std::cout << ":o " << dis << " " << dis2 << std::endl;
                         //                        }
 
-                        b.data[i][j][k].distance = -dis;
-                        b.data[i][j][k].weight   = 1;
+                        b.SetDistance(i, j, k, -dis);
+                        b.SetWeight(i, j, k, 1);
                     }
                 }
             }
@@ -288,7 +288,6 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
                     for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
                     {
                         Vec3 global_pos = tsdf->GlobalPosition(id, i, j, k).cast<double>();
-                        auto& cell      = b.data[i][j][k];
 
                         for (auto& d : directions)
                         {
@@ -297,7 +296,7 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
                             r.origin    = global_pos.cast<float>();
                             if (bvh.getAll(r).empty())
                             {
-                                cell.distance = std::abs(cell.distance);
+                                b.SetDistance(i, j, k, std::abs(b.Distance(i, j, k)));
                                 break;
                             }
                         }
@@ -197,26 +197,27 @@ int P3PRansac::solve(ArrayView<const Vec3> _worldPoints, ArrayView<const Vec2> _
         worldPoints           = _worldPoints;
         normalizedImagePoints = _normalizedImagePoints;
         N                     = _worldPoints.size();
+        soaWorldPoints.set(worldPoints);
+        soaImagePoints.set(normalizedImagePoints);
     }
 
 
-    int idx;
-    idx = compute(_worldPoints.size());
+    int num_inliers = compute(_worldPoints.size());
 
 #pragma omp single
     {
-        bestT      = models[idx];
-        inlierMask = inliers[idx];
+        bestT      = bestModel;
+        inlierMask = bestInlierMask;
 
         bestInlierMatches.clear();
-        bestInlierMatches.reserve(numInliers[idx]);
+        bestInlierMatches.reserve(num_inliers);
         for (int i = 0; i < N; ++i)
         {
-            if (inliers[idx][i]) bestInlierMatches.push_back(i);
+            if (bestInlierMask[i]) bestInlierMatches.push_back(i);
         }
     }
 
-    return numInliers[idx];
+    return num_inliers;
 }
 
 bool P3PRansac::computeModel(const RansacBase::Subset& set, P3PRansac::Model& model)
@@ -248,6 +249,27 @@ double P3PRansac::computeResidual(const P3PRansac::Model& model, int i)
     return (ip - normalizedImagePoints[i]).squaredNorm();
 }
 
+void P3PRansac::computeResiduals(const P3PRansac::Model& model, int begin, int end, double* residuals)
+{
+    const Mat3 R     = model.so3().matrix();
+    const Vec3 t     = model.translation();
+    const double *wx = soaWorldPoints[0], *wy = soaWorldPoints[1], *wz = soaWorldPoints[2];
+    const double *u  = soaImagePoints[0], *v = soaImagePoints[1];
+
+#pragma omp simd
+    for (int i = begin; i < end; ++i)
+    {
+        double px   = R(0, 0) * wx[i] + R(0, 1) * wy[i] + R(0, 2) * wz[i] + t(0);
+        double py   = R(1, 0) * wx[i] + R(1, 1) * wy[i] + R(1, 2) * wz[i] + t(1);
+        double pz   = R(2, 0) * wx[i] + R(2, 1) * wy[i] + R(2, 2) * wz[i] + t(2);
+        double invz = 1.0 / pz;
+        double rx   = px * invz - u[i];
+        double ry   = py * invz - v[i];
+
+        residuals[i - begin] = rx * rx + ry * ry;
+    }
+}
+
 
 #if 0
 SE3 refinePose(const SE3& pose, const Vec3* worldPoints, const Vec2* normalizedImagePoints, int N, int iterations)
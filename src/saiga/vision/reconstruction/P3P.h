@@ -79,9 +79,14 @@ class SAIGA_VISION_API P3PRansac : public RansacBase<P3PRansac, SE3, 4>
 
     double computeResidual(const Model& model, int i);
 
+    // Vectorized version of computeResidual() on the SoA copy of the points.
+    void computeResiduals(const Model& model, int begin, int end, double* residuals);
+
    private:
     ArrayView<const Vec3> worldPoints;
     ArrayView<const Vec2> normalizedImagePoints;
+    RansacPoints<3> soaWorldPoints;
+    RansacPoints<2> soaImagePoints;
 };
 
 
@@ -128,7 +128,8 @@ struct SAIGA_ALIGN_CACHE RobustPoseOptimization
 
 
 
-                        auto& local = locals[OMP::getThreadNum()];
+                        // The optimization of one frame is serial -> this may be called from inside a parallel region
+                        auto& local = locals[0];
                         local.JtJ.setZero();
                         local.Jtb.setZero();
                         local.chi2    = 0;
@@ -253,6 +254,28 @@ struct SAIGA_ALIGN_CACHE RobustPoseOptimization
         return inliers;
     }
 
+    /**
+     * Optimizes many independent frames. The frames are distributed over the threads and every thread uses its own
+     * copy of this optimizer, therefore the result is identical to calling optimizePoseRobust() on every scene.
+     *
+     * Returns the number of inliers of each frame.
+     */
+    std::vector<int> optimizePoseRobust(std::vector<PoseOptimizationScene<T>>& scenes,
+                                        int num_threads = OMP::getMaxThreads()) const
+    {
+        std::vector<int> result(scenes.size());
+#pragma omp parallel num_threads(num_threads)
+        {
+            auto local = *this;
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < (int)scenes.size(); ++i)
+            {
+                result[i] = local.optimizePoseRobust(scenes[i]);
+            }
+        }
+        return result;
+    }
+
     struct SAIGA_ALIGN_CACHE ThreadLocalData
     {
         JType JtJ;
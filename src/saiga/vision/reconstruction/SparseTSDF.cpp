@@ -38,103 +38,107 @@ std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double
 #pragma omp parallel for num_threads(threads)
     for (int b = 0; b < current_blocks; ++b)
     {
-        auto& triangle_soup = triangle_soup_per_block[b];
-        auto& block         = blocks[b];
-        // Compute positions and values of (n+1) x (n+1) x (n+1) block.
-        // The (+1) data point is taken from neighbouring blocks to close the holes.
-        std::pair<vec3, float> local_data[VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1];
-
-        // Fill from own block
-        for (int i = 0; i < VOXEL_BLOCK_SIZE + 1; ++i)
+        ExtractBlockSurface(blocks[b].index, iso, outlier_factor, min_weight, triangle_soup_per_block[b]);
+        loading_bar.addProgress(1);
+    }
+
+
+    return triangle_soup_per_block;
+}
+
+void SparseTSDF::ExtractBlockSurface(const VoxelBlockIndex& index, double iso, float outlier_factor, float min_weight,
+                                     std::vector<Triangle>& triangle_soup)
+{
+    // Compute positions and values of (n+1) x (n+1) x (n+1) block.
+    // The (+1) data point is taken from neighbouring blocks to close the holes.
+    std::pair<vec3, float> local_data[VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1];
+
+    // Fill from own block
+    for (int i = 0; i < VOXEL_BLOCK_SIZE + 1; ++i)
+    {
+        for (int j = 0; j < VOXEL_BLOCK_SIZE + 1; ++j)
         {
-            for (int j = 0; j < VOXEL_BLOCK_SIZE + 1; ++j)
+            for (int k = 0; k < VOXEL_BLOCK_SIZE + 1; ++k)
             {
-                for (int k = 0; k < VOXEL_BLOCK_SIZE + 1; ++k)
-                {
-                    int li = i % VOXEL_BLOCK_SIZE;
-                    int lj = j % VOXEL_BLOCK_SIZE;
-                    int lk = k % VOXEL_BLOCK_SIZE;
+                int li = i % VOXEL_BLOCK_SIZE;
+                int lj = j % VOXEL_BLOCK_SIZE;
+                int lk = k % VOXEL_BLOCK_SIZE;
 
-                    int bi = i / VOXEL_BLOCK_SIZE;
-                    int bj = j / VOXEL_BLOCK_SIZE;
-                    int bk = k / VOXEL_BLOCK_SIZE;
+                int bi = i / VOXEL_BLOCK_SIZE;
+                int bj = j / VOXEL_BLOCK_SIZE;
+                int bk = k / VOXEL_BLOCK_SIZE;
 
-                    VoxelBlockIndex read_block_id = block.index + ivec3(bk, bj, bi);
+                VoxelBlockIndex read_block_id = index + ivec3(bk, bj, bi);
 
-                    auto* read_block = GetBlock(read_block_id);
+                auto* read_block = GetBlock(read_block_id);
 
 
-                    vec3 p = GlobalPosition(block.index, i, j, k);
+                vec3 p = GlobalPosition(index, i, j, k);
 
-                    if (read_block)
-                    {
-                        float dis           = read_block->data[li][lj][lk].distance;
-                        float wei           = read_block->data[li][lj][lk].weight;
-                        local_data[i][j][k] = {p, wei > min_weight ? dis : std::numeric_limits<float>::infinity()};
-                        //                        local_data[i][j][k] = {p, dis};
-                    }
-                    else
-                    {
-                        local_data[i][j][k] = {p, std::numeric_limits<float>::infinity()};
-                    }
+                if (read_block)
+                {
+                    float dis           = read_block->Distance(li, lj, lk);
+                    float wei           = read_block->Weight(li, lj, lk);
+                    local_data[i][j][k] = {p, wei > min_weight ? dis : std::numeric_limits<float>::infinity()};
+                    //                        local_data[i][j][k] = {p, dis};
+                }
+                else
+                {
+                    local_data[i][j][k] = {p, std::numeric_limits<float>::infinity()};
                 }
             }
         }
+    }
 
 
-        // create triangles
-        for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
+    // create triangles
+    for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
+    {
+        for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
         {
-            for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
+            for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
             {
-                for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
-                {
-                    std::array<std::pair<vec3, float>, 8> cell;
+                std::array<std::pair<vec3, float>, 8> cell;
 
-                    cell[0] = local_data[i][j][k];
-                    cell[1] = local_data[i][j][k + 1];
-                    cell[2] = local_data[i + 1][j][k + 1];
-                    cell[3] = local_data[i + 1][j][k];
-                    cell[4] = local_data[i][j + 1][k];
-                    cell[5] = local_data[i][j + 1][k + 1];
-                    cell[6] = local_data[i + 1][j + 1][k + 1];
-                    cell[7] = local_data[i + 1][j + 1][k];
+                cell[0] = local_data[i][j][k];
+                cell[1] = local_data[i][j][k + 1];
+                cell[2] = local_data[i + 1][j][k + 1];
+                cell[3] = local_data[i + 1][j][k];
+                cell[4] = local_data[i][j + 1][k];
+                cell[5] = local_data[i][j + 1][k + 1];
+                cell[6] = local_data[i + 1][j + 1][k + 1];
+                cell[7] = local_data[i + 1][j + 1][k];
 
-                    bool finite   = true;
-                    float abs_max = 0;
+                bool finite   = true;
+                float abs_max = 0;
 
-                    for (auto i = 0; i < 8; ++i)
-                    {
-                        finite &= std::isfinite(cell[i].second);
-                        abs_max = std::max(abs_max, std::abs(cell[i].second));
-                    }
+                for (auto i = 0; i < 8; ++i)
+                {
+                    finite &= std::isfinite(cell[i].second);
+                    abs_max = std::max(abs_max, std::abs(cell[i].second));
+                }
 
-                    if (abs_max > outlier_factor * voxel_size)
-                    {
-                        continue;
-                    }
+                if (abs_max > outlier_factor * voxel_size)
+                {
+                    continue;
+                }
 
-                    if (!finite)
-                    {
-                        continue;
-                    }
+                if (!finite)
+                {
+                    continue;
+                }
 
-                    auto [triangles, count] = MarchingCubes(cell, iso);
+                auto [triangles, count] = MarchingCubes(cell, iso);
 
 
-                    for (int n = 0; n < count; ++n)
-                    {
-                        auto tri = triangles[n];
-                        triangle_soup.push_back(tri);
-                    }
+                for (int n = 0; n < count; ++n)
+                {
+                    auto tri = triangles[n];
+                    triangle_soup.push_back(tri);
                 }
             }
         }
-        loading_bar.addProgress(1);
     }
-
-
-    return triangle_soup_per_block;
 }
 
 UnifiedMesh SparseTSDF::CreateMesh(const std::vector<std::vector<SparseTSDF::Triangle>>& triangles, bool post_process)
@@ -161,12 +165,72 @@ UnifiedMesh SparseTSDF::CreateMesh(const std::vector<std::vector<SparseTSDF::Tri
 }
 
 
+// The voxels are always stored interleaved (AoS) in the file, independent of the layout in memory.
+using FileVoxelLayout = VoxelLayoutAoS<TSDFVoxel, SparseTSDF::VOXEL_BLOCK_SIZE>;
+
+template <typename Function>
+static void ForAllVoxels(Function f)
+{
+    for (int i = 0; i < SparseTSDF::VOXEL_BLOCK_SIZE; ++i)
+        for (int j = 0; j < SparseTSDF::VOXEL_BLOCK_SIZE; ++j)
+            for (int k = 0; k < SparseTSDF::VOXEL_BLOCK_SIZE; ++k) f(i, j, k);
+}
+
+// The blocks and the hash table are stored in the same format as a std::vector<T> in the BinaryFile.
+// Only the used blocks are written.
+template <typename StreamType>
+static void WriteBlocks(StreamType& strm, const SparseTSDF& tsdf)
+{
+    strm << (size_t)tsdf.current_blocks;
+    for (int i = 0; i < tsdf.current_blocks; ++i)
+    {
+        auto& b = tsdf.blocks[i];
+        FileVoxelLayout::Storage data;
+        ForAllVoxels([&](int z, int y, int x) { FileVoxelLayout::Set(data, z, y, x, b.Get(z, y, x)); });
+        strm << data << b.index << b.next_index;
+    }
+    strm << tsdf.first_hashed_block.size();
+    for (auto& h : tsdf.first_hashed_block)
+    {
+        strm << h.load();
+    }
+}
+
+template <typename StreamType>
+static void ReadBlocks(StreamType& strm, SparseTSDF& tsdf)
+{
+    size_t n;
+    strm >> n;
+    tsdf.blocks.clear();
+    tsdf.blocks.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto& b = tsdf.blocks[i];
+        FileVoxelLayout::Storage data;
+        strm >> data >> b.index >> b.next_index;
+        ForAllVoxels([&](int z, int y, int x) { b.Set(z, y, x, FileVoxelLayout::Get(data, z, y, x)); });
+    }
+
+    strm >> n;
+    tsdf.first_hashed_block = std::vector<std::atomic_int>(n);
+    for (auto& h : tsdf.first_hashed_block)
+    {
+        int id;
+        strm >> id;
+        h.store(id);
+    }
+    tsdf.hash_locks = std::vector<SpinLock>(n);
+
+    // All loaded blocks are new
+    tsdf.block_dirty.clear();
+    tsdf.SetAllDirty();
+}
+
 void SparseTSDF::Save(const std::string& file)
 {
     BinaryFile strm(file, std::ios_base::out);
     strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
-    strm << first_hashed_block;
+    WriteBlocks(strm, *this);
 }
 
 void SparseTSDF::Load(const std::string& file)
@@ -174,8 +238,7 @@ void SparseTSDF::Load(const std::string& file)
     BinaryFile strm(file, std::ios_base::in);
     SAIGA_ASSERT(strm.strm.is_open());
     strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
-    strm >> first_hashed_block;
+    ReadBlocks(strm, *this);
 }
 
 void SparseTSDF::SaveCompressed(const std::string& file)
@@ -183,8 +246,7 @@ void SparseTSDF::SaveCompressed(const std::string& file)
 #ifdef SAIGA_USE_ZLIB
     BinaryOutputVector strm;
     strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
-    strm << first_hashed_block;
+    WriteBlocks(strm, *this);
     auto compressed = compress(strm.data.data(), strm.data.size());
     File::saveFileBinary(file, compressed.data(), compressed.size());
 #else
@@ -199,8 +261,7 @@ void SparseTSDF::LoadCompressed(const std::string& file)
     auto data            = uncompress(compressed_data.data());
     BinaryInputVector strm(data.data(), data.size());
     strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
-    strm >> first_hashed_block;
+    ReadBlocks(strm, *this);
 #else
     SAIGA_EXIT_ERROR("zlib not found.");
 #endif
@@ -210,14 +271,17 @@ bool SparseTSDF::operator==(const SparseTSDF& other) const
 {
     if (voxel_size != other.voxel_size || voxel_size_inv != other.voxel_size_inv ||
         block_size_inv != other.block_size_inv || hash_size != other.hash_size ||
-        current_blocks != other.current_blocks || first_hashed_block != other.first_hashed_block)
+        current_blocks != other.current_blocks || first_hashed_block.size() != other.first_hashed_block.size())
     {
         return false;
     }
 
-    if (blocks.size() != other.blocks.size()) return false;
+    for (size_t i = 0; i < first_hashed_block.size(); ++i)
+    {
+        if (first_hashed_block[i].load() != other.first_hashed_block[i].load()) return false;
+    }
 
-    for (int i = 0; i < (int)std::min(blocks.size(), other.blocks.size()); ++i)
+    for (int i = 0; i < current_blocks; ++i)
     {
         auto& b1 = blocks[i];
         auto& b2 = other.blocks[i];
@@ -238,13 +302,13 @@ void SparseTSDF::ClampDistance(float distance)
     {
         auto& block = blocks[b];
 
-        for (auto& z : block.data)
+        for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
         {
-            for (auto& y : z)
+            for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
             {
-                for (auto& x : y)
+                for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
-                    x.distance = clamp(x.distance, -distance, distance);
+                    block.SetDistance(i, j, k, clamp(block.Distance(i, j, k), -distance, distance));
                 }
             }
         }
@@ -264,10 +328,9 @@ void SparseTSDF::EraseAboveDistance(float threshold)
             {
                 for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
-                    if (std::abs(b.data[i][j][k].distance) > threshold)
+                    if (std::abs(b.Distance(i, j, k)) > threshold)
                     {
-                        b.data[i][j][k].weight   = 0;
-                        b.data[i][j][k].distance = 0;
+                        b.Set(i, j, k, Voxel());
                     }
                 }
             }
@@ -282,13 +345,13 @@ int SparseTSDF::NumZeroVoxels() const
     {
         auto& block = blocks[b];
 
-        for (auto& z : block.data)
+        for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
         {
-            for (auto& y : z)
+            for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
             {
-                for (auto& x : y)
+                for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
-                    if (x.weight == 0) n++;
+                    if (block.Weight(i, j, k) == 0) n++;
                 }
             }
         }
@@ -303,13 +366,13 @@ int SparseTSDF::NumNonZeroVoxels() const
     {
         auto& block = blocks[b];
 
-        for (auto& z : block.data)
+        for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
         {
-            for (auto& y : z)
+            for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
             {
-                for (auto& x : y)
+                for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
-                    if (x.weight != 0) n++;
+                    if (block.Weight(i, j, k) != 0) n++;
                 }
             }
         }
@@ -324,14 +387,14 @@ void SparseTSDF::SetForAll(float distance, float weight)
     {
         auto& block = blocks[b];
 
-        for (auto& z : block.data)
+        for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
         {
-            for (auto& y : z)
+            for (int j = 0; j < VOXEL_BLOCK_SIZE; ++j)
             {
-                for (auto& x : y)
+                for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
-                    x.distance = distance;
-                    x.weight   = weight;
+                    block.SetDistance(i, j, k, distance);
+                    block.SetWeight(i, j, k, weight);
                 }
             }
         }
@@ -341,7 +404,7 @@ void SparseTSDF::SetForAll(float distance, float weight)
 
 std::ostream& operator<<(std::ostream& strm, const SparseTSDF& tsdf)
 {
-    size_t mem_blocks = tsdf.blocks.size() * sizeof(SparseTSDF::VoxelBlock);
+    size_t mem_blocks = tsdf.blocks.Memory();
     size_t mem_hash   = tsdf.first_hashed_block.size() * sizeof(int);
 
     // Compute some statistics
@@ -351,10 +414,11 @@ std::ostream& operator<<(std::ostream& strm, const SparseTSDF& tsdf)
     {
         auto& block = tsdf.blocks[b];
 
-        for (auto& z : block.data)
-            for (auto& y : z)
-                for (auto& x : y)
+        for (int i = 0; i < SparseTSDF::VOXEL_BLOCK_SIZE; ++i)
+            for (int j = 0; j < SparseTSDF::VOXEL_BLOCK_SIZE; ++j)
+                for (int k = 0; k < SparseTSDF::VOXEL_BLOCK_SIZE; ++k)
                 {
+                    auto x = block.Get(i, j, k);
                     if (x.weight > 0)
                     {
                         distances.push_back(x.distance);
@@ -369,7 +433,7 @@ std::ostream& operator<<(std::ostream& strm, const SparseTSDF& tsdf)
     strm << "[SparseTSDF]" << std::endl;
     strm << "  VoxelSize    " << tsdf.voxel_size << std::endl;
     strm << "  hash_size    " << tsdf.hash_size << std::endl;
-    strm << "  Blocks       " << tsdf.current_blocks << "/" << tsdf.blocks.size() << std::endl;
+    strm << "  Blocks       " << tsdf.current_blocks << "/" << tsdf.blocks.capacity() << std::endl;
     strm << "  Mem Blocks   " << mem_blocks / (1000.0 * 1000) << " MB" << std::endl;
     strm << "  Mem Hash     " << mem_hash / (1000.0 * 1000) << " MB" << std::endl;
     strm << "  Distance     [" << d_st.min << ", " << d_st.max << "]" << std::endl;
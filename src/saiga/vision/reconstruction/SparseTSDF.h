@@ -32,7 +32,11 @@ struct TSDFVoxel
 //
 // The voxel blocks are stored sparse using a hashmap. For each hashbucket,
 // we store a linked-list with all blocks inside this bucket.
-struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
+//
+// The voxels use the SoA layout with float precision. Scans which only read the distance (raycasting, surface
+// extraction, ClampDistance) therefore touch half of the block memory. Use the accessors of the VoxelBlock
+// (Get, Distance, Weight, ...) to read and write voxels.
+struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8, VoxelLayoutSoA<TSDFVoxel, 8>>
 {
     static constexpr int VOXEL_BLOCK_SIZE = 8;
     using VoxelBlockIndex                 = ivec3;
@@ -51,16 +55,7 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     SparseTSDF(const std::string& file) { Load(file); }
 
 
-    SparseTSDF(const SparseTSDF& other)
-    {
-        voxel_size         = other.voxel_size;
-        voxel_size_inv     = other.voxel_size_inv;
-        hash_size          = other.hash_size;
-        blocks             = other.blocks;
-        first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
-        current_blocks     = other.current_blocks.load();
-    }
+    SparseTSDF(const SparseTSDF& other) : BlockSparseGrid(other) {}
 
     SAIGA_VISION_API friend std::ostream& operator<<(std::ostream& os, const SparseTSDF& tsdf);
 
@@ -281,6 +276,11 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     std::vector<std::vector<Triangle>> ExtractSurface(double iso, float outlier_factor, float min_weight, int threads,
                                                       bool verbose);
 
+    // Marching cubes on a single block. The triangles are appended to 'triangle_soup'.
+    // The result depends on the block itself and the neighbours in +x, +y and +z direction.
+    void ExtractBlockSurface(const VoxelBlockIndex& index, double iso, float outlier_factor, float min_weight,
+                             std::vector<Triangle>& triangle_soup);
+
     // Create a triangle mesh from the list of triangles
     UnifiedMesh CreateMesh(const std::vector<std::vector<Triangle>>& triangles, bool post_process);
 
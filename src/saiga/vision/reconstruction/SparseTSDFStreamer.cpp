@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SparseTSDFStreamer.h"
+
+#include "saiga/core/time/TimerBase.h"
+#include "saiga/core/util/zlib.h"
+
+#include <cstring>
+
+namespace Saiga
+{
+std::ostream& operator<<(std::ostream& os, const TSDFStreamingStatistics& st)
+{
+    os << "[TSDFStreaming]" << std::endl;
+    os << "  Resident Blocks " << st.resident_blocks << std::endl;
+    os << "  Stored Blocks   " << st.stored_blocks << std::endl;
+    os << "  Evicted/Loaded  " << st.evicted_blocks << "/" << st.loaded_blocks << " (dropped "
+       << st.dropped_blocks << " empty)" << std::endl;
+    os << "  Written/Read    " << st.bytes_written / (1000.0 * 1000) << "/" << st.bytes_read / (1000.0 * 1000)
+       << " MB" << std::endl;
+    os << "  Store Size      " << st.store_size / (1000.0 * 1000) << " MB" << std::endl;
+    os << "  Time Evict/Load " << st.time_evict_ms << "/" << st.time_load_ms << " ms";
+    return os;
+}
+
+SparseTSDFStreamer::SparseTSDFStreamer(SparseTSDF* tsdf, const TSDFStreamingParams& params)
+    : tsdf(tsdf), params(params)
+{
+    SAIGA_ASSERT(tsdf);
+    SAIGA_ASSERT(!tsdf->block_fault_handler, "The TSDF is already streamed.");
+
+    bool opened = store.open(params.file, MemoryMappedFile::Mode::ReadWrite);
+    SAIGA_ASSERT(opened, "Could not open block store " + params.file);
+    // Old content is not valid anymore
+    store.resize(0);
+
+    // All current blocks are treated as new blocks in the first UpdateWorkingSet.
+    last_used.resize(tsdf->current_blocks, 0);
+
+    tsdf->block_fault_handler = [this](const ivec3& index) { return FaultIn(index); };
+}
+
+SparseTSDFStreamer::~SparseTSDFStreamer()
+{
+    tsdf->block_fault_handler = nullptr;
+}
+
+int SparseTSDFStreamer::MaxResidentBlocks() const
+{
+    return std::max<int>(1, params.ram_budget_mb * 1000 * 1000 / sizeof(VoxelBlock));
+}
+
+void SparseTSDFStreamer::UpdateWorkingSet(const vec3& camera_position)
+{
+    current_frame++;
+
+    int n = tsdf->current_blocks;
+    // Blocks that were inserted since the last update are part of the working set.
+    last_used.resize(n, current_frame);
+
+    std::vector<std::pair<float, ivec3>> candidates;
+    for (int i = 0; i < n; ++i)
+    {
+        auto& b    = tsdf->blocks[i];
+        float dist = (tsdf->BlockCenter(b.index) - camera_position).norm();
+        if (dist < params.working_set_radius)
+        {
+            last_used[i] = current_frame;
+        }
+        else if (last_used[i] < current_frame)
+        {
+            candidates.push_back({dist, b.index});
+        }
+    }
+
+    int to_evict = n - MaxResidentBlocks();
+    if (to_evict > 0 && !candidates.empty())
+    {
+        // Least recently used first. Blocks with the same age are evicted by distance (farthest first).
+        // The sort key is taken before any eviction, because EraseBlock changes the block ids.
+        std::vector<std::pair<int, int>> order(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            order[i] = {last_used[tsdf->GetBlockId(candidates[i].second)], i};
+        }
+        std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+            if (a.first != b.first) return a.first < b.first;
+            return candidates[a.second].first > candidates[b.second].first;
+        });
+
+        to_evict = std::min<int>(to_evict, order.size());
+
+        double time = 0;
+        {
+            ScopedTimer<double> timer(time);
+            for (int i = 0; i < to_evict; ++i)
+            {
+                Evict(candidates[order[i].second].second);
+            }
+            tsdf->Compact();
+        }
+        stats.time_evict_ms += time;
+    }
+
+    stats.resident_blocks = tsdf->current_blocks;
+    stats.stored_blocks   = num_records;
+    stats.store_size      = store.size();
+}
+
+void SparseTSDFStreamer::LoadAll()
+{
+    std::vector<uint64_t> keys;
+    {
+        std::unique_lock lock(mutex);
+        for (auto& r : records) keys.push_back(r.first);
+    }
+
+    for (auto k : keys)
+    {
+        auto d = [k](int shift) { return int((k >> shift) & ((uint64_t(1) << 21) - 1)) - (1 << 20); };
+        tsdf->GetBlock(ivec3(d(0), d(21), d(42)));
+    }
+    SAIGA_ASSERT(num_records == 0);
+
+    last_used.resize(tsdf->current_blocks, current_frame);
+    stats.resident_blocks = tsdf->current_blocks;
+    stats.stored_blocks   = num_records;
+}
+
+void SparseTSDFStreamer::Evict(const ivec3& index)
+{
+    int id = tsdf->GetBlockId(index);
+    SAIGA_ASSERT(id >= 0);
+    auto& block = tsdf->blocks[id];
+
+    if (block.Empty())
+    {
+        // An empty block is identical to a new block -> no need to store it
+        stats.dropped_blocks++;
+    }
+    else
+    {
+        const void* src = &block.data;
+        size_t size     = sizeof(BlockData);
+        bool compressed = false;
+#ifdef SAIGA_USE_ZLIB
+        std::vector<unsigned char> compressed_data;
+        if (params.compress)
+        {
+            compressed_data = compress(src, size);
+            src             = compressed_data.data();
+            size            = compressed_data.size();
+            compressed      = true;
+        }
+#endif
+
+        std::unique_lock lock(mutex);
+        Record r;
+        r.size       = size;
+        r.compressed = compressed;
+        r.offset     = Allocate(size, r.capacity);
+        memcpy(store.data() + r.offset, src, size);
+        records[Key(index)] = r;
+        num_records++;
+
+        stats.evicted_blocks++;
+        stats.bytes_written += size;
+    }
+
+    // EraseBlock moves the last block into the hole -> mirror this in the LRU stamps
+    tsdf->EraseBlock(index, false);
+    last_used[id] = last_used.back();
+    last_used.pop_back();
+}
+
+SparseTSDF::VoxelBlock* SparseTSDFStreamer::FaultIn(const ivec3& index)
+{
+    // Fast path for the common case of a new block during the integration.
+    if (num_records == 0) return nullptr;
+
+    std::unique_lock lock(mutex);
+
+    // A different thread could have loaded it while we were waiting for the lock.
+    int h  = tsdf->H(index);
+    int id = tsdf->GetBlockId(index, h);
+    if (id >= 0) return &tsdf->blocks[id];
+
+    auto it = records.find(Key(index));
+    if (it == records.end()) return nullptr;
+
+    double time = 0;
+    VoxelBlock* block;
+    {
+        ScopedTimer<double> timer(time);
+        Record r = it->second;
+
+        const char* src = store.data() + r.offset;
+        BlockData data;
+        if (!r.compressed)
+        {
+            memcpy(&data, src, sizeof(BlockData));
+        }
+        else
+        {
+#ifdef SAIGA_USE_ZLIB
+            auto uncompressed = uncompress(src);
+            SAIGA_ASSERT(uncompressed.size() == sizeof(BlockData));
+            memcpy(&data, uncompressed.data(), sizeof(BlockData));
+#else
+            SAIGA_EXIT_ERROR("zlib not found.");
+#endif
+        }
+
+        {
+            std::unique_lock block_lock(tsdf->hash_locks[h]);
+            block = tsdf->InsertNewBlock(index, h, &data);
+        }
+
+        Free(r.offset, r.capacity);
+        records.erase(it);
+        num_records--;
+
+        stats.loaded_blocks++;
+        stats.bytes_read += r.size;
+    }
+    stats.time_load_ms += time;
+    return block;
+}
+
+size_t SparseTSDFStreamer::Allocate(size_t size, size_t& capacity)
+{
+    // Best fit
+    auto it = free_list.lower_bound(size);
+    if (it != free_list.end())
+    {
+        capacity      = it->first;
+        size_t offset = it->second;
+        free_list.erase(it);
+        return offset;
+    }
+
+    // Append to the end of the store. The file size is doubled to amortize the remapping.
+    capacity      = size;
+    size_t offset = store_used;
+    store_used += size;
+    if (store_used > store.size())
+    {
+        bool ok = store.resize(std::max<size_t>(store_used, store.size() * 2));
+        SAIGA_ASSERT(ok, "Could not resize block store.");
+    }
+    return offset;
+}
+
+void SparseTSDFStreamer::Free(size_t offset, size_t capacity)
+{
+    free_list.insert({capacity, offset});
+}
+
+}  // namespace Saiga
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/util/MemoryMappedFile.h"
+#include "saiga/vision/VisionIncludes.h"
+
+#include "SparseTSDF.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace Saiga
+{
+struct SAIGA_VISION_API TSDFStreamingParams
+{
+    // The block store. Created if it does not exist and truncated otherwise.
+    std::string file = "tsdf_blocks.bin";
+
+    // Maximum memory of the resident voxel blocks.
+    double ram_budget_mb = 1024;
+
+    // Blocks closer than this distance (in meters) to the camera are never evicted.
+    float working_set_radius = 5;
+
+    // Compress the evicted blocks with zlib (if available).
+    bool compress = true;
+};
+
+struct SAIGA_VISION_API TSDFStreamingStatistics
+{
+    long evicted_blocks = 0;
+    long loaded_blocks  = 0;
+    // Empty blocks are not written to the store.
+    long dropped_blocks = 0;
+
+    size_t bytes_written = 0;
+    size_t bytes_read    = 0;
+    size_t store_size    = 0;
+
+    int resident_blocks = 0;
+    int stored_blocks   = 0;
+
+    double time_evict_ms = 0;
+    double time_load_ms  = 0;
+
+    SAIGA_VISION_API friend std::ostream& operator<<(std::ostream& os, const TSDFStreamingStatistics& st);
+};
+
+/**
+ * Out-of-core storage for a SparseTSDF.
+ *
+ * Blocks outside of the working set around the camera are evicted in LRU order until the resident blocks fit
+ * into the RAM budget. The evicted blocks are (optionally) compressed and written to a memory mapped block store.
+ * The streamer installs itself as the block_fault_handler of the TSDF, therefore an evicted block is loaded
+ * transparently on the next GetBlock/InsertBlockLock.
+ *
+ * Usage:
+ *
+ * SparseTSDFStreamer streamer(tsdf.get(), params);
+ * for (auto& frame : frames)
+ * {
+ *     // Integrate frame into the tsdf
+ *     ...
+ *     streamer.UpdateWorkingSet(frame.V.inverse().translation());
+ * }
+ * streamer.LoadAll();
+ * tsdf->Save("final.tsdf");
+ *
+ * UpdateWorkingSet and LoadAll must not be called concurrently to other accesses of the TSDF.
+ * Loading blocks through GetBlock is thread-safe.
+ */
+class SAIGA_VISION_API SparseTSDFStreamer
+{
+   public:
+    SparseTSDFStreamer(SparseTSDF* tsdf, const TSDFStreamingParams& params);
+    ~SparseTSDFStreamer();
+
+    SparseTSDFStreamer(const SparseTSDFStreamer&) = delete;
+    SparseTSDFStreamer& operator=(const SparseTSDFStreamer&) = delete;
+
+    // Marks all blocks around the camera as used and evicts the least recently used blocks if the RAM budget is
+    // exceeded. Should be called once per frame after the integration.
+    void UpdateWorkingSet(const vec3& camera_position);
+
+    // Loads all evicted blocks back into the TSDF.
+    // Required before global operations, for example mesh extraction or Save.
+    void LoadAll();
+
+    int MaxResidentBlocks() const;
+
+    const TSDFStreamingStatistics& IOStatistics() const { return stats; }
+
+   private:
+    using VoxelBlock = SparseTSDF::VoxelBlock;
+    using BlockData  = decltype(VoxelBlock::data);
+
+    struct Record
+    {
+        size_t offset;
+        size_t size;
+        size_t capacity;
+        bool compressed;
+    };
+
+    SparseTSDF* tsdf;
+    TSDFStreamingParams params;
+    TSDFStreamingStatistics stats;
+
+    MemoryMappedFile store;
+    size_t store_used = 0;
+
+    // Stored blocks by packed block index
+    std::unordered_map<uint64_t, Record> records;
+    std::atomic<int> num_records = {0};
+    // Free ranges of the store (capacity -> offset) for best-fit allocation
+    std::multimap<size_t, size_t> free_list;
+
+    // The frame in which the block (by block id) was last inside the working set
+    std::vector<int> last_used;
+    int current_frame = 0;
+
+    std::mutex mutex;
+
+    VoxelBlock* FaultIn(const ivec3& index);
+    void Evict(const ivec3& index);
+
+    size_t Allocate(size_t size, size_t& capacity);
+    void Free(size_t offset, size_t capacity);
+
+    static uint64_t Key(const ivec3& i)
+    {
+        // 21 bits per dimension
+        auto u = [](int x) { return uint64_t(x + (1 << 20)) & ((uint64_t(1) << 21) - 1); };
+        return u(i.x()) | (u(i.y()) << 21) | (u(i.z()) << 42);
+    }
+};
+
+}  // namespace Saiga
@@ -0,0 +1,493 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "TSDFIntegration.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#    include <immintrin.h>
+#    define SAIGA_TSDF_X86
+#endif
+
+#if defined(SAIGA_TSDF_X86) && (defined(__GNUC__) || defined(__clang__))
+#    define SAIGA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#    define SAIGA_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#    define SAIGA_HAS_AVX2_KERNEL
+#    define SAIGA_HAS_AVX512_KERNEL
+#elif defined(SAIGA_TSDF_X86)
+// MSVC: The intrinsics can only be used if the instruction set is enabled for the whole project.
+#    define SAIGA_TARGET_AVX2
+#    define SAIGA_TARGET_AVX512
+#    if defined(__AVX2__)
+#        define SAIGA_HAS_AVX2_KERNEL
+#    endif
+#    if defined(__AVX512F__)
+#        define SAIGA_HAS_AVX512_KERNEL
+#    endif
+#endif
+
+namespace Saiga
+{
+bool IntegrationKernelSupported(IntegrationKernel kernel)
+{
+    switch (kernel)
+    {
+        case IntegrationKernel::Auto:
+        case IntegrationKernel::Scalar:
+            return true;
+        case IntegrationKernel::AVX2:
+#if defined(SAIGA_HAS_AVX2_KERNEL) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(SAIGA_HAS_AVX2_KERNEL)
+            return true;
+#else
+            return false;
+#endif
+        case IntegrationKernel::AVX512:
+#if defined(SAIGA_HAS_AVX512_KERNEL) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") &&
+                   __builtin_cpu_supports("fma");
+#elif defined(SAIGA_HAS_AVX512_KERNEL)
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+IntegrationKernel SelectIntegrationKernel(IntegrationKernel kernel)
+{
+    if (kernel == IntegrationKernel::Auto)
+    {
+        // AVX2 first: on most CPUs the 512-bit gathers are not faster and reduce the clock rate.
+        if (IntegrationKernelSupported(IntegrationKernel::AVX2)) return IntegrationKernel::AVX2;
+        if (IntegrationKernelSupported(IntegrationKernel::AVX512)) return IntegrationKernel::AVX512;
+        return IntegrationKernel::Scalar;
+    }
+    return IntegrationKernelSupported(kernel) ? kernel : IntegrationKernel::Scalar;
+}
+
+
+#ifdef SAIGA_HAS_AVX2_KERNEL
+
+SAIGA_TARGET_AVX2 static inline __m256 Gather8(const float* base, __m256i byte_offset, __m256 mask)
+{
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, byte_offset, mask, 1);
+}
+
+SAIGA_TARGET_AVX2 bool IntegrateBlockAVX2(const TSDFIntegrationData& d, const ivec3& block_index,
+                                          SparseTSDF::VoxelBlock& block)
+{
+    static_assert(SparseTSDF::VOXEL_BLOCK_SIZE == 8, "One block row must fit into an AVX register.");
+    static_assert(std::is_same_v<SparseTSDF::VoxelLayout, VoxelLayoutSoA<TSDFVoxel, 8>>,
+                  "The kernel loads the float distance and weight planes directly.");
+
+    vec3 offset = block_index.cast<float>() * d.voxel_size * SparseTSDF::VOXEL_BLOCK_SIZE;
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one  = _mm256_set1_ps(1);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    const __m256 lane_k = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    // World x coordinate of the voxels of a row
+    const __m256 wx = _mm256_add_ps(_mm256_mul_ps(lane_k, _mm256_set1_ps(d.voxel_size)), _mm256_set1_ps(offset.x()));
+
+    const __m256 r00 = _mm256_set1_ps(d.R[0]), r10 = _mm256_set1_ps(d.R[1]), r20 = _mm256_set1_ps(d.R[2]);
+
+    const __m256 k1 = _mm256_set1_ps(d.k1), k2 = _mm256_set1_ps(d.k2), k3 = _mm256_set1_ps(d.k3);
+    const __m256 k4 = _mm256_set1_ps(d.k4), k5 = _mm256_set1_ps(d.k5), k6 = _mm256_set1_ps(d.k6);
+    const __m256 p1 = _mm256_set1_ps(d.p1), p2 = _mm256_set1_ps(d.p2);
+    const __m256 max_r2 = _mm256_set1_ps(100000.f * 100000.f);
+    const __m256 fx = _mm256_set1_ps(d.fx), fy = _mm256_set1_ps(d.fy), s = _mm256_set1_ps(d.s);
+    const __m256 cx = _mm256_set1_ps(d.cx + d.ip_offset_x), cy = _mm256_set1_ps(d.cy + d.ip_offset_y);
+
+    const __m256i edge_x = _mm256_set1_epi32(d.width - 1);
+    const __m256i edge_y = _mm256_set1_epi32(d.height - 1);
+    const __m256i edge   = _mm256_set1_epi32(2);
+    const __m256i dpitch = _mm256_set1_epi32(d.depth_pitch_bytes);
+    const __m256i cpitch = _mm256_set1_epi32(d.confidence_pitch_bytes);
+    const __m256i four   = _mm256_set1_epi32(4);
+
+    const __m256 max_dist   = _mm256_set1_ps(d.max_integration_distance);
+    const __m256 trunc      = _mm256_set1_ps(d.truncation_distance);
+    const __m256 trunc_sc   = _mm256_set1_ps(d.truncation_distance_scale);
+    const __m256 trunc_min  = _mm256_set1_ps(d.min_truncation_distance);
+    const __m256 sd_clamp   = _mm256_set1_ps(d.sd_clamp);
+    const __m256 new_weight = _mm256_set1_ps(d.new_weight);
+    const __m256 max_weight = _mm256_set1_ps(d.max_weight);
+
+    bool changed = false;
+    for (int i = 0; i < SparseTSDF::VOXEL_BLOCK_SIZE; ++i)
+    {
+        for (int j = 0; j < SparseTSDF::VOXEL_BLOCK_SIZE; ++j)
+        {
+            // project to image
+            float wy = j * d.voxel_size + offset.y();
+            float wz = i * d.voxel_size + offset.z();
+            float bx = d.R[3] * wy + d.R[6] * wz + d.t[0];
+            float by = d.R[4] * wy + d.R[7] * wz + d.t[1];
+            float bz = d.R[5] * wy + d.R[8] * wz + d.t[2];
+
+            __m256 px = _mm256_fmadd_ps(r00, wx, _mm256_set1_ps(bx));
+            __m256 py = _mm256_fmadd_ps(r10, wx, _mm256_set1_ps(by));
+            __m256 pz = _mm256_fmadd_ps(r20, wx, _mm256_set1_ps(bz));
+
+            // the voxel is behind the camera
+            __m256 valid = _mm256_cmp_ps(pz, zero, _CMP_GT_OQ);
+            if (_mm256_movemask_ps(valid) == 0) continue;
+
+            __m256 iz = _mm256_div_ps(one, pz);
+            __m256 x  = _mm256_mul_ps(px, iz);
+            __m256 y  = _mm256_mul_ps(py, iz);
+
+            // distortNormalizedPoint
+            __m256 x2       = _mm256_mul_ps(x, x);
+            __m256 y2       = _mm256_mul_ps(y, y);
+            __m256 r2       = _mm256_add_ps(x2, y2);
+            __m256 xy2      = _mm256_mul_ps(_mm256_add_ps(x, x), y);
+            __m256 r4       = _mm256_mul_ps(r2, r2);
+            __m256 r6       = _mm256_mul_ps(r4, r2);
+            __m256 radial_u = _mm256_fmadd_ps(k3, r6, _mm256_fmadd_ps(k2, r4, _mm256_fmadd_ps(k1, r2, one)));
+            __m256 radial_v = _mm256_fmadd_ps(k6, r6, _mm256_fmadd_ps(k5, r4, _mm256_fmadd_ps(k4, r2, one)));
+            __m256 radial   = _mm256_div_ps(radial_u, radial_v);
+            __m256 tan_x = _mm256_fmadd_ps(p1, xy2, _mm256_mul_ps(p2, _mm256_add_ps(r2, _mm256_add_ps(x2, x2))));
+            __m256 tan_y = _mm256_fmadd_ps(p1, _mm256_add_ps(r2, _mm256_add_ps(y2, y2)), _mm256_mul_ps(p2, xy2));
+            __m256 xd    = _mm256_fmadd_ps(x, radial, tan_x);
+            __m256 yd    = _mm256_fmadd_ps(y, radial, tan_y);
+            __m256 big   = _mm256_cmp_ps(r2, max_r2, _CMP_GT_OQ);
+            xd           = _mm256_blendv_ps(xd, _mm256_set1_ps(100000.f), big);
+            yd           = _mm256_blendv_ps(yd, _mm256_set1_ps(100000.f), big);
+
+            // normalizedToImage + ip_offset
+            __m256 ipx = _mm256_fmadd_ps(fx, xd, _mm256_fmadd_ps(s, yd, cx));
+            __m256 ipy = _mm256_fmadd_ps(fy, yd, cy);
+
+            // nearest neighbour lookup
+            // Out of range values are converted to INT_MIN and therefore rejected by the edge test.
+            __m256i rx = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(ipx, half)));
+            __m256i ry = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(ipy, half)));
+
+            __m256i dist_edge = _mm256_min_epi32(_mm256_min_epi32(rx, _mm256_sub_epi32(edge_x, rx)),
+                                                 _mm256_min_epi32(ry, _mm256_sub_epi32(edge_y, ry)));
+            valid = _mm256_and_ps(valid, _mm256_castsi256_ps(_mm256_cmpgt_epi32(dist_edge, edge)));
+            if (_mm256_movemask_ps(valid) == 0) continue;
+
+            // Invalid lanes read from (0,0)
+            __m256i vi = _mm256_castps_si256(valid);
+            rx         = _mm256_and_si256(rx, vi);
+            ry         = _mm256_and_si256(ry, vi);
+
+            __m256 image_depth;
+            if (d.bilinear)
+            {
+                // Bilinear interpolation (reduces artifacts)
+                __m256 fx0 = _mm256_floor_ps(ipx);
+                __m256 fy0 = _mm256_floor_ps(ipy);
+                __m256i x0 = _mm256_and_si256(_mm256_cvttps_epi32(fx0), vi);
+                __m256i y0 = _mm256_and_si256(_mm256_cvttps_epi32(fy0), vi);
+
+                __m256i o00 = _mm256_add_epi32(_mm256_mullo_epi32(y0, dpitch), _mm256_mullo_epi32(x0, four));
+                __m256i o01 = _mm256_add_epi32(o00, four);
+                __m256i o10 = _mm256_add_epi32(o00, dpitch);
+                __m256i o11 = _mm256_add_epi32(o10, four);
+
+                __m256 b00 = Gather8(d.depth, o00, valid);
+                __m256 b01 = Gather8(d.depth, o01, valid);
+                __m256 b10 = Gather8(d.depth, o10, valid);
+                __m256 b11 = Gather8(d.depth, o11, valid);
+
+                __m256 all_positive = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(b00, zero, _CMP_GT_OQ), _mm256_cmp_ps(b01, zero, _CMP_GT_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(b10, zero, _CMP_GT_OQ), _mm256_cmp_ps(b11, zero, _CMP_GT_OQ)));
+                valid = _mm256_and_ps(valid, all_positive);
+
+                __m256 ax = _mm256_sub_ps(ipx, fx0);
+                __m256 ay = _mm256_sub_ps(ipy, fy0);
+                __m256 bx = _mm256_sub_ps(one, ax);
+                __m256 by = _mm256_sub_ps(one, ay);
+
+                image_depth = _mm256_mul_ps(b00, _mm256_mul_ps(bx, by));
+                image_depth = _mm256_fmadd_ps(b01, _mm256_mul_ps(ax, by), image_depth);
+                image_depth = _mm256_fmadd_ps(b10, _mm256_mul_ps(bx, ay), image_depth);
+                image_depth = _mm256_fmadd_ps(b11, _mm256_mul_ps(ax, ay), image_depth);
+            }
+            else
+            {
+                __m256i o   = _mm256_add_epi32(_mm256_mullo_epi32(ry, dpitch), _mm256_mullo_epi32(rx, four));
+                image_depth = Gather8(d.depth, o, valid);
+            }
+
+            // No valid depth
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(image_depth, zero, _CMP_GT_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(image_depth, max_dist, _CMP_LE_OQ));
+
+            __m256 confidence = one;
+            if (d.confidence)
+            {
+                __m256i o  = _mm256_add_epi32(_mm256_mullo_epi32(ry, cpitch), _mm256_mullo_epi32(rx, four));
+                confidence = Gather8(d.confidence, o, valid);
+                valid      = _mm256_and_ps(valid, _mm256_cmp_ps(confidence, zero, _CMP_GT_OQ));
+            }
+
+            // current td
+            __m256 truncation_distance = _mm256_max_ps(trunc_min, _mm256_fmadd_ps(trunc_sc, image_depth, trunc));
+
+            __m256 new_tsdf = _mm256_sub_ps(image_depth, pz);
+            valid           = _mm256_and_ps(valid, _mm256_cmp_ps(new_tsdf, _mm256_sub_ps(zero, truncation_distance),
+                                                             _CMP_GE_OQ));
+            if (_mm256_movemask_ps(valid) == 0) continue;
+
+            new_tsdf = _mm256_min_ps(_mm256_max_ps(new_tsdf, _mm256_sub_ps(zero, sd_clamp)), sd_clamp);
+            __m256 nw = _mm256_mul_ps(new_weight, confidence);
+
+            int row       = SparseTSDF::VoxelLayout::Offset(i, j, 0);
+            float* cell_d = block.data.distance.data() + row;
+            float* cell_w = block.data.weight.data() + row;
+            __m256 cd     = _mm256_loadu_ps(cell_d);
+            __m256 cw     = _mm256_loadu_ps(cell_w);
+
+            __m256 sum_w    = _mm256_add_ps(cw, nw);
+            __m256 avg_tsdf = _mm256_div_ps(_mm256_fmadd_ps(cw, cd, _mm256_mul_ps(nw, new_tsdf)), sum_w);
+            __m256 first    = _mm256_cmp_ps(cw, zero, _CMP_EQ_OQ);
+
+            __m256 updated_tsdf   = _mm256_blendv_ps(avg_tsdf, new_tsdf, first);
+            __m256 updated_weight = _mm256_blendv_ps(_mm256_min_ps(max_weight, sum_w), nw, first);
+
+            __m256 diff = _mm256_or_ps(_mm256_cmp_ps(cd, updated_tsdf, _CMP_NEQ_UQ),
+                                       _mm256_cmp_ps(cw, updated_weight, _CMP_NEQ_UQ));
+            changed |= _mm256_movemask_ps(_mm256_and_ps(diff, valid)) != 0;
+
+            _mm256_storeu_ps(cell_d, _mm256_blendv_ps(cd, updated_tsdf, valid));
+            _mm256_storeu_ps(cell_w, _mm256_blendv_ps(cw, updated_weight, valid));
+        }
+    }
+    return changed;
+}
+
+#else
+
+bool IntegrateBlockAVX2(const TSDFIntegrationData& data, const ivec3& block_index, SparseTSDF::VoxelBlock& block)
+{
+    SAIGA_EXIT_ERROR("AVX2 kernel not available.");
+    return false;
+}
+
+#endif
+
+
+#ifdef SAIGA_HAS_AVX512_KERNEL
+
+// The unmasked AVX-512 intrinsics of GCC pass an undefined source operand to the masked builtins, which GCC 12
+// reports as -Wmaybe-uninitialized after inlining.
+#    if defined(__GNUC__) && !defined(__clang__)
+#        pragma GCC diagnostic push
+#        pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#    endif
+
+SAIGA_TARGET_AVX512 static inline __m512 Floor16(__m512 x)
+{
+    return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+SAIGA_TARGET_AVX512 bool IntegrateBlockAVX512(const TSDFIntegrationData& d, const ivec3& block_index,
+                                              SparseTSDF::VoxelBlock& block)
+{
+    static_assert(SparseTSDF::VOXEL_BLOCK_SIZE == 8, "Two block rows must fit into an AVX-512 register.");
+    static_assert(std::is_same_v<SparseTSDF::VoxelLayout, VoxelLayoutSoA<TSDFVoxel, 8>>,
+                  "The kernel loads the float distance and weight planes directly.");
+
+    vec3 offset = block_index.cast<float>() * d.voxel_size * SparseTSDF::VOXEL_BLOCK_SIZE;
+
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one  = _mm512_set1_ps(1);
+    const __m512 half = _mm512_set1_ps(0.5f);
+
+    // Lane l processes the voxel k = l % 8 of the row j + l / 8
+    const __m512 lane_k = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+    const __m512 lane_j = _mm512_setr_ps(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m512 vs     = _mm512_set1_ps(d.voxel_size);
+    const __m512 wx     = _mm512_add_ps(_mm512_mul_ps(lane_k, vs), _mm512_set1_ps(offset.x()));
+
+    const __m512 k1 = _mm512_set1_ps(d.k1), k2 = _mm512_set1_ps(d.k2), k3 = _mm512_set1_ps(d.k3);
+    const __m512 k4 = _mm512_set1_ps(d.k4), k5 = _mm512_set1_ps(d.k5), k6 = _mm512_set1_ps(d.k6);
+    const __m512 p1 = _mm512_set1_ps(d.p1), p2 = _mm512_set1_ps(d.p2);
+    const __m512 max_r2 = _mm512_set1_ps(100000.f * 100000.f);
+    const __m512 fx = _mm512_set1_ps(d.fx), fy = _mm512_set1_ps(d.fy), s = _mm512_set1_ps(d.s);
+    const __m512 cx = _mm512_set1_ps(d.cx + d.ip_offset_x), cy = _mm512_set1_ps(d.cy + d.ip_offset_y);
+
+    const __m512i edge_x = _mm512_set1_epi32(d.width - 1);
+    const __m512i edge_y = _mm512_set1_epi32(d.height - 1);
+    const __m512i edge   = _mm512_set1_epi32(2);
+    const __m512i dpitch = _mm512_set1_epi32(d.depth_pitch_bytes);
+    const __m512i cpitch = _mm512_set1_epi32(d.confidence_pitch_bytes);
+    const __m512i four   = _mm512_set1_epi32(4);
+
+    const __m512 max_dist   = _mm512_set1_ps(d.max_integration_distance);
+    const __m512 trunc      = _mm512_set1_ps(d.truncation_distance);
+    const __m512 trunc_sc   = _mm512_set1_ps(d.truncation_distance_scale);
+    const __m512 trunc_min  = _mm512_set1_ps(d.min_truncation_distance);
+    const __m512 sd_clamp   = _mm512_set1_ps(d.sd_clamp);
+    const __m512 new_weight = _mm512_set1_ps(d.new_weight);
+    const __m512 max_weight = _mm512_set1_ps(d.max_weight);
+
+    bool changed = false;
+    for (int i = 0; i < SparseTSDF::VOXEL_BLOCK_SIZE; ++i)
+    {
+        for (int j = 0; j < SparseTSDF::VOXEL_BLOCK_SIZE; j += 2)
+        {
+            // project to image
+            __m512 wy = _mm512_fmadd_ps(_mm512_add_ps(lane_j, _mm512_set1_ps(j)), vs, _mm512_set1_ps(offset.y()));
+            float wz  = i * d.voxel_size + offset.z();
+
+            __m512 px = _mm512_fmadd_ps(_mm512_set1_ps(d.R[0]), wx,
+                                        _mm512_fmadd_ps(_mm512_set1_ps(d.R[3]), wy, _mm512_set1_ps(d.R[6] * wz + d.t[0])));
+            __m512 py = _mm512_fmadd_ps(_mm512_set1_ps(d.R[1]), wx,
+                                        _mm512_fmadd_ps(_mm512_set1_ps(d.R[4]), wy, _mm512_set1_ps(d.R[7] * wz + d.t[1])));
+            __m512 pz = _mm512_fmadd_ps(_mm512_set1_ps(d.R[2]), wx,
+                                        _mm512_fmadd_ps(_mm512_set1_ps(d.R[5]), wy, _mm512_set1_ps(d.R[8] * wz + d.t[2])));
+
+            // the voxel is behind the camera
+            __mmask16 valid = _mm512_cmp_ps_mask(pz, zero, _CMP_GT_OQ);
+            if (!valid) continue;
+
+            __m512 iz = _mm512_div_ps(one, pz);
+            __m512 x  = _mm512_mul_ps(px, iz);
+            __m512 y  = _mm512_mul_ps(py, iz);
+
+            // distortNormalizedPoint
+            __m512 x2       = _mm512_mul_ps(x, x);
+            __m512 y2       = _mm512_mul_ps(y, y);
+            __m512 r2       = _mm512_add_ps(x2, y2);
+            __m512 xy2      = _mm512_mul_ps(_mm512_add_ps(x, x), y);
+            __m512 r4       = _mm512_mul_ps(r2, r2);
+            __m512 r6       = _mm512_mul_ps(r4, r2);
+            __m512 radial_u = _mm512_fmadd_ps(k3, r6, _mm512_fmadd_ps(k2, r4, _mm512_fmadd_ps(k1, r2, one)));
+            __m512 radial_v = _mm512_fmadd_ps(k6, r6, _mm512_fmadd_ps(k5, r4, _mm512_fmadd_ps(k4, r2, one)));
+            __m512 radial   = _mm512_div_ps(radial_u, radial_v);
+            __m512 tan_x = _mm512_fmadd_ps(p1, xy2, _mm512_mul_ps(p2, _mm512_add_ps(r2, _mm512_add_ps(x2, x2))));
+            __m512 tan_y = _mm512_fmadd_ps(p1, _mm512_add_ps(r2, _mm512_add_ps(y2, y2)), _mm512_mul_ps(p2, xy2));
+            __m512 xd    = _mm512_fmadd_ps(x, radial, tan_x);
+            __m512 yd    = _mm512_fmadd_ps(y, radial, tan_y);
+            __mmask16 big = _mm512_cmp_ps_mask(r2, max_r2, _CMP_GT_OQ);
+            xd            = _mm512_mask_blend_ps(big, xd, _mm512_set1_ps(100000.f));
+            yd            = _mm512_mask_blend_ps(big, yd, _mm512_set1_ps(100000.f));
+
+            // normalizedToImage + ip_offset
+            __m512 ipx = _mm512_fmadd_ps(fx, xd, _mm512_fmadd_ps(s, yd, cx));
+            __m512 ipy = _mm512_fmadd_ps(fy, yd, cy);
+
+            // nearest neighbour lookup
+            // Out of range values are converted to INT_MIN and therefore rejected by the edge test.
+            __m512i rx = _mm512_cvttps_epi32(Floor16(_mm512_add_ps(ipx, half)));
+            __m512i ry = _mm512_cvttps_epi32(Floor16(_mm512_add_ps(ipy, half)));
+
+            __m512i dist_edge = _mm512_min_epi32(_mm512_min_epi32(rx, _mm512_sub_epi32(edge_x, rx)),
+                                                 _mm512_min_epi32(ry, _mm512_sub_epi32(edge_y, ry)));
+            valid &= _mm512_cmpgt_epi32_mask(dist_edge, edge);
+            if (!valid) continue;
+
+            __m512 image_depth;
+            if (d.bilinear)
+            {
+                // Bilinear interpolation (reduces artifacts)
+                __m512 fx0 = Floor16(ipx);
+                __m512 fy0 = Floor16(ipy);
+                __m512i x0 = _mm512_cvttps_epi32(fx0);
+                __m512i y0 = _mm512_cvttps_epi32(fy0);
+
+                __m512i o00 = _mm512_add_epi32(_mm512_mullo_epi32(y0, dpitch), _mm512_mullo_epi32(x0, four));
+                __m512i o01 = _mm512_add_epi32(o00, four);
+                __m512i o10 = _mm512_add_epi32(o00, dpitch);
+                __m512i o11 = _mm512_add_epi32(o10, four);
+
+                __m512 b00 = _mm512_mask_i32gather_ps(zero, valid, o00, d.depth, 1);
+                __m512 b01 = _mm512_mask_i32gather_ps(zero, valid, o01, d.depth, 1);
+                __m512 b10 = _mm512_mask_i32gather_ps(zero, valid, o10, d.depth, 1);
+                __m512 b11 = _mm512_mask_i32gather_ps(zero, valid, o11, d.depth, 1);
+
+                valid = _mm512_mask_cmp_ps_mask(valid, b00, zero, _CMP_GT_OQ);
+                valid = _mm512_mask_cmp_ps_mask(valid, b01, zero, _CMP_GT_OQ);
+                valid = _mm512_mask_cmp_ps_mask(valid, b10, zero, _CMP_GT_OQ);
+                valid = _mm512_mask_cmp_ps_mask(valid, b11, zero, _CMP_GT_OQ);
+
+                __m512 ax = _mm512_sub_ps(ipx, fx0);
+                __m512 ay = _mm512_sub_ps(ipy, fy0);
+                __m512 bx = _mm512_sub_ps(one, ax);
+                __m512 by = _mm512_sub_ps(one, ay);
+
+                image_depth = _mm512_mul_ps(b00, _mm512_mul_ps(bx, by));
+                image_depth = _mm512_fmadd_ps(b01, _mm512_mul_ps(ax, by), image_depth);
+                image_depth = _mm512_fmadd_ps(b10, _mm512_mul_ps(bx, ay), image_depth);
+                image_depth = _mm512_fmadd_ps(b11, _mm512_mul_ps(ax, ay), image_depth);
+            }
+            else
+            {
+                __m512i o   = _mm512_add_epi32(_mm512_mullo_epi32(ry, dpitch), _mm512_mullo_epi32(rx, four));
+                image_depth = _mm512_mask_i32gather_ps(zero, valid, o, d.depth, 1);
+            }
+
+            // No valid depth
+            valid = _mm512_mask_cmp_ps_mask(valid, image_depth, zero, _CMP_GT_OQ);
+            valid = _mm512_mask_cmp_ps_mask(valid, image_depth, max_dist, _CMP_LE_OQ);
+
+            __m512 confidence = one;
+            if (d.confidence)
+            {
+                __m512i o  = _mm512_add_epi32(_mm512_mullo_epi32(ry, cpitch), _mm512_mullo_epi32(rx, four));
+                confidence = _mm512_mask_i32gather_ps(zero, valid, o, d.confidence, 1);
+                valid      = _mm512_mask_cmp_ps_mask(valid, confidence, zero, _CMP_GT_OQ);
+            }
+
+            // current td
+            __m512 truncation_distance = _mm512_max_ps(trunc_min, _mm512_fmadd_ps(trunc_sc, image_depth, trunc));
+
+            __m512 new_tsdf = _mm512_sub_ps(image_depth, pz);
+            valid = _mm512_mask_cmp_ps_mask(valid, new_tsdf, _mm512_sub_ps(zero, truncation_distance), _CMP_GE_OQ);
+            if (!valid) continue;
+
+            new_tsdf  = _mm512_min_ps(_mm512_max_ps(new_tsdf, _mm512_sub_ps(zero, sd_clamp)), sd_clamp);
+            __m512 nw = _mm512_mul_ps(new_weight, confidence);
+
+            // The two rows j and j+1 are consecutive in memory
+            int row       = SparseTSDF::VoxelLayout::Offset(i, j, 0);
+            float* cell_d = block.data.distance.data() + row;
+            float* cell_w = block.data.weight.data() + row;
+            __m512 cd     = _mm512_loadu_ps(cell_d);
+            __m512 cw     = _mm512_loadu_ps(cell_w);
+
+            __m512 sum_w     = _mm512_add_ps(cw, nw);
+            __m512 avg_tsdf  = _mm512_div_ps(_mm512_fmadd_ps(cw, cd, _mm512_mul_ps(nw, new_tsdf)), sum_w);
+            __mmask16 first  = _mm512_cmp_ps_mask(cw, zero, _CMP_EQ_OQ);
+
+            __m512 updated_tsdf   = _mm512_mask_blend_ps(first, avg_tsdf, new_tsdf);
+            __m512 updated_weight = _mm512_mask_blend_ps(first, _mm512_min_ps(max_weight, sum_w), nw);
+
+            __mmask16 diff = _mm512_mask_cmp_ps_mask(valid, cd, updated_tsdf, _CMP_NEQ_UQ) |
+                             _mm512_mask_cmp_ps_mask(valid, cw, updated_weight, _CMP_NEQ_UQ);
+            changed |= diff != 0;
+
+            _mm512_storeu_ps(cell_d, _mm512_mask_blend_ps(valid, cd, updated_tsdf));
+            _mm512_storeu_ps(cell_w, _mm512_mask_blend_ps(valid, cw, updated_weight));
+        }
+    }
+    return changed;
+}
+
+#    if defined(__GNUC__) && !defined(__clang__)
+#        pragma GCC diagnostic pop
+#    endif
+
+#else
+
+bool IntegrateBlockAVX512(const TSDFIntegrationData& data, const ivec3& block_index, SparseTSDF::VoxelBlock& block)
+{
+    SAIGA_EXIT_ERROR("AVX-512 kernel not available.");
+    return false;
+}
+
+#endif
+
+}  // namespace Saiga
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/vision/VisionIncludes.h"
+
+#include "SparseTSDF.h"
+
+namespace Saiga
+{
+enum class IntegrationKernel
+{
+    // The fastest kernel supported by the CPU
+    Auto,
+    Scalar,
+    // 8 voxels (one block row) per iteration
+    AVX2,
+    // 16 voxels (two block rows) per iteration
+    AVX512,
+};
+
+/**
+ * Vectorized TSDF integration of a single voxel block.
+ *
+ * Computes the same update as the scalar loop in FusionScene::Integrate, but in single precision and for 8/16
+ * voxels of a block at once. The per-image data is converted once to the flat layout below.
+ *
+ * The kernels are compiled with function level target attributes, therefore they are also available if saiga is
+ * not compiled with -march=native. Use IntegrationKernelSupported to check if the CPU supports a kernel.
+ */
+struct SAIGA_VISION_API TSDFIntegrationData
+{
+    // World -> Camera, R is column major
+    float R[9];
+    float t[3];
+
+    float fx, fy, cx, cy, s;
+    float k1, k2, k3, k4, k5, k6, p1, p2;
+    float ip_offset_x, ip_offset_y;
+
+    const float* depth;
+    int depth_pitch_bytes;
+    int width, height;
+
+    // nullptr if the confidence is not used
+    const float* confidence;
+    int confidence_pitch_bytes;
+
+    float voxel_size;
+    float truncation_distance;
+    float truncation_distance_scale;
+    float min_truncation_distance;
+    float max_integration_distance;
+    float sd_clamp;
+    float new_weight;
+    float max_weight;
+    bool bilinear;
+};
+
+SAIGA_VISION_API bool IntegrationKernelSupported(IntegrationKernel kernel);
+
+// Resolves 'Auto' and falls back to the scalar kernel if the requested one is not supported.
+SAIGA_VISION_API IntegrationKernel SelectIntegrationKernel(IntegrationKernel kernel);
+
+// Both kernels return true if at least one voxel of the block has changed.
+SAIGA_VISION_API bool IntegrateBlockAVX2(const TSDFIntegrationData& data, const ivec3& block_index,
+                                         SparseTSDF::VoxelBlock& block);
+SAIGA_VISION_API bool IntegrateBlockAVX512(const TSDFIntegrationData& data, const ivec3& block_index,
+                                           SparseTSDF::VoxelBlock& block);
+
+}  // namespace Saiga
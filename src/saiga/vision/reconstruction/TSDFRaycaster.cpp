@@ -0,0 +1,299 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "TSDFRaycaster.h"
+
+namespace Saiga
+{
+namespace
+{
+using VoxelBlock = SparseTSDF::VoxelBlock;
+constexpr int BS = SparseTSDF::VOXEL_BLOCK_SIZE;
+
+// Block lookups of a single ray. Consecutive samples are usually in the same block.
+struct BlockCache
+{
+    SparseTSDF& tsdf;
+    ivec3 index             = ivec3(-973454, -973454, -973454);
+    const VoxelBlock* block = nullptr;
+
+    BlockCache(SparseTSDF& tsdf) : tsdf(tsdf) {}
+
+    const VoxelBlock* Get(const ivec3& i)
+    {
+        if (i != index)
+        {
+            // GetBlock loads evicted blocks through the fault handler of the TSDF (see SparseTSDFStreamer)
+            block = tsdf.GetBlock(i);
+            index = i;
+        }
+        return block;
+    }
+
+    // Same as SparseTSDF::TrilinearAccess
+    bool Sample(const vec3& position, float min_weight, float& distance)
+    {
+        vec3 normalized_pos = position * tsdf.voxel_size_inv;
+        vec3 ipos           = normalized_pos.array().floor();
+        vec3 frac           = normalized_pos - ipos;
+        ivec3 corner        = ipos.cast<int>();
+
+        ivec3 b(iFloorDiv(corner.x(), BS), iFloorDiv(corner.y(), BS), iFloorDiv(corner.z(), BS));
+        ivec3 l = corner - b * BS;
+
+        float v[2][2][2];
+        if (l.x() < BS - 1 && l.y() < BS - 1 && l.z() < BS - 1)
+        {
+            // Fast path: all 8 voxels are in the same block
+            auto* block = Get(b);
+            if (!block) return false;
+            for (int z = 0; z < 2; ++z)
+            {
+                for (int y = 0; y < 2; ++y)
+                {
+                    for (int x = 0; x < 2; ++x)
+                    {
+                        if (block->Weight(l.z() + z, l.y() + y, l.x() + x) <= min_weight) return false;
+                        v[z][y][x] = block->Distance(l.z() + z, l.y() + y, l.x() + x);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // The voxels are distributed over 2, 4 or 8 blocks. Each of them is looked up only once, because
+            // alternating lookups would evict each other from the cache.
+            const VoxelBlock* neighbors[2][2][2] = {};
+            for (int z = 0; z < 2; ++z)
+            {
+                for (int y = 0; y < 2; ++y)
+                {
+                    for (int x = 0; x < 2; ++x)
+                    {
+                        ivec3 v_l = l + ivec3(x, y, z);
+                        ivec3 o(v_l.x() == BS, v_l.y() == BS, v_l.z() == BS);
+                        auto& block = neighbors[o.z()][o.y()][o.x()];
+                        if (!block)
+                        {
+                            block = o.isZero() ? Get(b) : tsdf.GetBlock(b + o);
+                            if (!block) return false;
+                        }
+                        v_l -= o * BS;
+                        if (block->Weight(v_l.z(), v_l.y(), v_l.x()) <= min_weight) return false;
+                        v[z][y][x] = block->Distance(v_l.z(), v_l.y(), v_l.x());
+                    }
+                }
+            }
+        }
+
+        float fx  = frac.x(), fy = frac.y(), fz = frac.z();
+        float c00 = v[0][0][0] * (1 - fz) + v[1][0][0] * fz;
+        float c01 = v[0][1][0] * (1 - fz) + v[1][1][0] * fz;
+        float c10 = v[0][0][1] * (1 - fz) + v[1][0][1] * fz;
+        float c11 = v[0][1][1] * (1 - fz) + v[1][1][1] * fz;
+        float c0  = c00 * (1 - fy) + c01 * fy;
+        float c1  = c10 * (1 - fy) + c11 * fy;
+        distance  = c0 * (1 - fx) + c1 * fx;
+        return true;
+    }
+
+    // Same as SparseTSDF::TrilinearGradient
+    bool Gradient(const vec3& position, float min_weight, vec3& grad)
+    {
+        float h = tsdf.voxel_size * 0.5f;
+        float d[6];
+        for (int i = 0; i < 3; ++i)
+        {
+            vec3 offset  = vec3::Zero();
+            offset(i)    = h;
+            bool valid_1 = Sample(position - offset, min_weight, d[2 * i]);
+            bool valid_2 = Sample(position + offset, min_weight, d[2 * i + 1]);
+            if (!valid_1 || !valid_2) return false;
+        }
+        grad = vec3(d[1] - d[0], d[3] - d[2], d[5] - d[4]) / (2 * h);
+        return true;
+    }
+};
+
+// Clips [t_min, t_max] to the box (slab test). Returns false if the ray misses the box.
+bool ClipRay(const vec3& origin, const vec3& dir, const vec3& box_min, const vec3& box_max, float& t_min,
+             float& t_max)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (dir(i) == 0)
+        {
+            if (origin(i) < box_min(i) || origin(i) > box_max(i)) return false;
+            continue;
+        }
+        float inv = 1.0f / dir(i);
+        float t1  = (box_min(i) - origin(i)) * inv;
+        float t2  = (box_max(i) - origin(i)) * inv;
+        t_min     = std::max(t_min, std::min(t1, t2));
+        t_max     = std::min(t_max, std::max(t1, t2));
+    }
+    return t_min < t_max;
+}
+
+// Returns the ray parameter of the first positive -> negative zero crossing or -1.
+float TraceRay(BlockCache& cache, const vec3& origin, const vec3& dir, float t_min, float t_max,
+               const TSDFRaycastParams& params)
+{
+    SparseTSDF& tsdf = cache.tsdf;
+    float block_size = tsdf.voxel_size * BS;
+    float min_step   = params.min_step * tsdf.voxel_size;
+
+    // 3D-DDA on the block grid.
+    // The cells are aligned to the trilinear corner voxel, which has to be in the current block for a valid sample.
+    vec3 start = origin + dir * t_min;
+    ivec3 cell = (start / block_size).array().floor().cast<int>();
+    ivec3 step;
+    vec3 t_next, t_delta;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (dir(i) == 0)
+        {
+            step(i)    = 0;
+            t_next(i)  = std::numeric_limits<float>::infinity();
+            t_delta(i) = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        step(i)        = dir(i) > 0 ? 1 : -1;
+        float boundary = (cell(i) + (dir(i) > 0 ? 1 : 0)) * block_size;
+        t_next(i)      = t_min + (boundary - start(i)) / dir(i);
+        t_delta(i)     = block_size / std::abs(dir(i));
+    }
+
+    float t         = t_min;
+    bool has_last   = false;
+    float last_t    = 0;
+    float last_dist = 0;
+
+    while (t < t_max)
+    {
+        int axis;
+        float t_exit = t_next.minCoeff(&axis);
+
+        if (t < t_exit && cache.Get(cell))
+        {
+            while (t < t_exit && t < t_max)
+            {
+                float dist;
+                if (!cache.Sample(origin + dir * t, params.min_weight, dist))
+                {
+                    has_last = false;
+                    t += min_step;
+                    continue;
+                }
+
+                if (has_last && last_dist > 0 && dist < 0)
+                {
+                    // Refine with false position
+                    float a  = last_t, b = t;
+                    float da = last_dist, db = dist;
+                    float c  = a + da / (da - db) * (b - a);
+                    for (int i = 0; i < params.refinement_iterations; ++i)
+                    {
+                        float dc;
+                        if (!cache.Sample(origin + dir * c, params.min_weight, dc)) break;
+                        if (da * dc > 0)
+                        {
+                            a  = c;
+                            da = dc;
+                        }
+                        else
+                        {
+                            b  = c;
+                            db = dc;
+                        }
+                        c = a + da / (da - db) * (b - a);
+                    }
+                    return c;
+                }
+
+                has_last  = true;
+                last_t    = t;
+                last_dist = dist;
+                t += std::max(min_step, params.step_factor * dist);
+            }
+        }
+        else if (t < t_exit)
+        {
+            // Empty space: jump to the next block
+            has_last = false;
+            t        = t_exit;
+        }
+
+        cell(axis) += step(axis);
+        t_next(axis) += t_delta(axis);
+    }
+    return -1;
+}
+
+}  // namespace
+
+void RaycastTSDF(SparseTSDF& tsdf, const SE3& pose, const IntrinsicsPinholed& K, Depthmap::DepthMap depth,
+                 Depthmap::DepthNormalMap normals, const TSDFRaycastParams& params)
+{
+    SAIGA_ASSERT(!normals.valid() || (normals.h == depth.h && normals.w == depth.w));
+
+    Mat3 R_cw   = pose.so3().inverse().matrix();
+    mat3 R_wc   = pose.so3().matrix().cast<float>();
+    vec3 origin = pose.translation().cast<float>();
+
+    // Most rays of a frame pass through empty space, where every block of the 3D-DDA costs a hash lookup.
+    // Therefore, the rays are clipped to the bounding box of the allocated blocks. A streamed TSDF can have evicted
+    // blocks outside of this box, which must be loaded by the rays.
+    bool clip = !tsdf.block_fault_handler;
+    vec3 box_min, box_max;
+    if (clip)
+    {
+        auto bounds      = tsdf.Bounds();
+        float block_size = tsdf.voxel_size * BS;
+        box_min          = bounds.begin.cast<float>() * block_size;
+        box_max          = bounds.end.cast<float>() * block_size;
+    }
+
+#pragma omp parallel for num_threads(params.threads) schedule(dynamic, 4)
+    for (int y = 0; y < depth.h; ++y)
+    {
+        BlockCache cache(tsdf);
+        for (int x = 0; x < depth.w; ++x)
+        {
+            vec3 dir_c = K.unproject(Vec2(x, y), 1).cast<float>().normalized();
+            vec3 dir   = R_wc * dir_c;
+
+            // Convert the depth range to the ray parameter
+            float t_min = params.min_depth / dir_c.z();
+            float t_max = params.max_depth / dir_c.z();
+
+            float t = -1;
+            if (!clip || ClipRay(origin, dir, box_min, box_max, t_min, t_max))
+            {
+                t = TraceRay(cache, origin, dir, t_min, t_max, params);
+            }
+
+            if (t < 0)
+            {
+                depth(y, x) = 0;
+                if (normals.valid()) normals(y, x) = infinityVec3();
+                continue;
+            }
+
+            depth(y, x) = t * dir_c.z();
+
+            if (normals.valid())
+            {
+                vec3 grad;
+                float l = 0;
+                if (cache.Gradient(origin + dir * t, params.min_weight, grad)) l = grad.norm();
+                normals(y, x) = l > 1e-5 ? Vec3(R_cw * (grad / l).cast<double>()) : infinityVec3();
+            }
+        }
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/vision/VisionIncludes.h"
+#include "saiga/vision/util/Depthmap.h"
+
+#include "SparseTSDF.h"
+
+namespace Saiga
+{
+struct SAIGA_VISION_API TSDFRaycastParams
+{
+    // Only surfaces in this depth range (camera space z) are rendered.
+    float min_depth = 0.1;
+    float max_depth = 5;
+
+    // Voxels with a weight <= min_weight are treated as empty.
+    float min_weight = 0;
+
+    // Inside an allocated block, the step is step_factor * distance, but at least min_step * voxel_size.
+    float step_factor = 0.8;
+    float min_step    = 0.5;
+
+    // False position iterations after the zero crossing was found.
+    int refinement_iterations = 2;
+
+    int threads = 4;
+};
+
+/**
+ * Renders the zero level set of the TSDF into a depth map and a normal map.
+ *
+ * For each pixel a ray is marched through the TSDF. The ray traverses the block grid with a 3D-DDA and jumps over
+ * all blocks, which are not allocated in the hash map. Inside an allocated block, the step size is adapted to the
+ * signed distance. The first positive -> negative zero crossing is refined and reported.
+ *
+ * pose: Camera -> World (same as ICP::DepthMapExtended::pose)
+ *
+ * Invalid pixels get the depth 0 and an infinite normal (see Depthmap::normalMap). The normals are given in
+ * camera space. 'normals' can be an empty view if only the depth is required.
+ *
+ * Evicted blocks of a streamed TSDF (see SparseTSDFStreamer) are loaded when a ray enters them. They stay resident
+ * until the next UpdateWorkingSet. Must not be called concurrently with an integration.
+ */
+SAIGA_VISION_API void RaycastTSDF(SparseTSDF& tsdf, const SE3& pose, const IntrinsicsPinholed& K,
+                                  Depthmap::DepthMap depth, Depthmap::DepthNormalMap normals,
+                                  const TSDFRaycastParams& params = TSDFRaycastParams());
+
+}  // namespace Saiga
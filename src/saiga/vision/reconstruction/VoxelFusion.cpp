@@ -20,7 +20,10 @@ void FusionScene::Preprocess()
     triangle_soup_inclusive_prefix_sum.clear();
     triangle_soup.clear();
     mesh = UnifiedMesh();
-    tsdf = std::make_unique<SparseTSDF>(params.voxelSize, params.block_count, params.hash_size);
+    // Detach the streamer from the old tsdf before it is destroyed
+    streamer              = nullptr;
+    incremental_extractor = nullptr;
+    tsdf                  = std::make_unique<SparseTSDF>(params.voxelSize, params.block_count, params.hash_size);
 
     if (images.empty()) return;
 
@@ -49,7 +52,6 @@ void FusionScene::AnalyseSparseStructure()
 {
     ProgressBar loading_bar(params.verbose ? std::cout : strm, "Analysing  ", Size());
 
-    // #pragma omp parallel for
     for (int i = 0; i < Size(); ++i)
     {
         auto& dm  = images[i];
@@ -63,7 +65,8 @@ void FusionScene::AnalyseSparseStructure()
 
         //        std::set<std::tuple<int, int, int>> leset;
 
-        //        for (auto i : dm.depthMap.rowRange())
+        // The block storage grows lock-free, so the rays can be traversed in parallel.
+#pragma omp parallel for schedule(dynamic, 4)
         for (int i = 0; i < dm.depthMap.rows; ++i)
         {
             for (auto j : dm.depthMap.colRange())
@@ -157,7 +160,7 @@ void FusionScene::AnalyseSparseStructure()
                 while (true)
                 {
                     //                    leset.insert({idCurrentVoxel(0), idCurrentVoxel(1), idCurrentVoxel(2)});
-                    tsdf->InsertBlock(idCurrentVoxel);
+                    tsdf->InsertBlockLock(idCurrentVoxel);
                     // Traverse voxel grid
                     if (tMax.x() < tMax.y() && tMax.x() < tMax.z())
                     {
@@ -308,9 +311,64 @@ void FusionScene::Visibility()
 }
 
 
+TSDFIntegrationData FusionScene::CreateIntegrationData(const FusionImage& dm)
+{
+    TSDFIntegrationData data;
+
+    Mat3 R = dm.V.so3().matrix();
+    for (int i = 0; i < 9; ++i)
+    {
+        data.R[i] = R.data()[i];
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        data.t[i] = dm.V.translation()(i);
+    }
+
+    data.fx = K.fx;
+    data.fy = K.fy;
+    data.cx = K.cx;
+    data.cy = K.cy;
+    data.s  = K.s;
+    data.k1 = dis.k1;
+    data.k2 = dis.k2;
+    data.k3 = dis.k3;
+    data.k4 = dis.k4;
+    data.k5 = dis.k5;
+    data.k6 = dis.k6;
+    data.p1 = dis.p1;
+    data.p2 = dis.p2;
+
+    data.ip_offset_x = params.ip_offset(0);
+    data.ip_offset_y = params.ip_offset(1);
+
+    data.depth             = &dm.depthMap(0, 0);
+    data.depth_pitch_bytes = dm.depthMap.pitchBytes;
+    data.width             = dm.depthMap.width;
+    data.height            = dm.depthMap.height;
+
+    data.confidence             = params.use_confidence ? dm.confidence.data() : nullptr;
+    data.confidence_pitch_bytes = params.use_confidence ? dm.confidence.pitchBytes : 0;
+
+    data.voxel_size                = params.voxelSize;
+    data.truncation_distance       = params.truncationDistance;
+    data.truncation_distance_scale = params.truncationDistanceScale;
+    data.min_truncation_distance   = params.min_truncation_factor * params.voxelSize;
+    data.max_integration_distance  = params.maxIntegrationDistance;
+    data.sd_clamp                  = params.sd_clamp;
+    data.new_weight                = params.newWeight;
+    data.max_weight                = params.maxWeight;
+    data.bilinear                  = params.bilinear_intperpolation;
+    return data;
+}
+
 void FusionScene::Integrate()
 {
     Visibility();
+
+    // The vectorized kernels don't implement the ground truth fusion
+    IntegrationKernel kernel =
+        params.ground_truth_fuse ? IntegrationKernel::Scalar : SelectIntegrationKernel(params.integration_kernel);
     {
         ProgressBar loading_bar(params.verbose ? std::cout : strm, "Integrate  ", Size());
 
@@ -318,14 +376,30 @@ void FusionScene::Integrate()
         {
             auto& dm = images[i];
 
+            TSDFIntegrationData integration_data = CreateIntegrationData(dm);
+
 #pragma omp parallel for
             for (int i = 0; i < (int)dm.visible_blocks.size(); ++i)
             {
-                auto& id    = dm.visible_blocks[i];
-                auto* block = tsdf->GetBlock(id);
-                SAIGA_ASSERT(block);
+                auto& id     = dm.visible_blocks[i];
+                int block_id = tsdf->GetBlockId(id);
+                SAIGA_ASSERT(block_id >= 0);
+                auto* block = &tsdf->blocks[block_id];
                 SAIGA_ASSERT(block->index == id);
 
+                // Only blocks with at least one changed voxel are marked dirty
+                bool changed = false;
+                if (kernel == IntegrationKernel::AVX2)
+                {
+                    if (IntegrateBlockAVX2(integration_data, id, *block)) tsdf->SetDirty(block_id);
+                    continue;
+                }
+                if (kernel == IntegrationKernel::AVX512)
+                {
+                    if (IntegrateBlockAVX512(integration_data, id, *block)) tsdf->SetDirty(block_id);
+                    continue;
+                }
+
                 //        Vec3 offset = tsdf.GlobalBlockOffset(id).cast<double>();
 
                 for (int i = 0; i < tsdf->VOXEL_BLOCK_SIZE; ++i)
@@ -335,7 +409,7 @@ void FusionScene::Integrate()
                         for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
                         {
                             Vec3 global_pos = tsdf->GlobalPosition(id, i, j, k).cast<double>();
-                            auto& cell      = block->data[i][j][k];
+                            auto cell       = block->Get(i, j, k);
 
 
 
@@ -452,6 +526,8 @@ void FusionScene::Integrate()
                                     // do nothing
                                 }
 
+                                block->Set(i, j, k, cell);
+                                changed |= cell.distance != current_tsdf || cell.weight != current_weight;
                                 continue;
                             }
 
@@ -502,9 +578,12 @@ void FusionScene::Integrate()
                                 cell.distance        = updated_tsdf;
                                 cell.weight          = updated_weight;
                             }
+                            block->Set(i, j, k, cell);
+                            changed |= cell.distance != current_tsdf || cell.weight != current_weight;
                         }
                     }
                 }
+                if (changed) tsdf->SetDirty(block_id);
             }
 
             loading_bar.addProgress(1);
@@ -527,10 +606,12 @@ void FusionScene::IntegratePointBased()
             for (int i = 0; i < (int)dm.visible_blocks.size(); ++i)
 
             {
-                auto& id    = dm.visible_blocks[i];
-                auto* block = tsdf->GetBlock(id);
-                SAIGA_ASSERT(block);
+                auto& id     = dm.visible_blocks[i];
+                int block_id = tsdf->GetBlockId(id);
+                SAIGA_ASSERT(block_id >= 0);
+                auto* block = &tsdf->blocks[block_id];
                 SAIGA_ASSERT(block->index == id);
+                tsdf->SetDirty(block_id);
 
                 //        Vec3 offset = tsdf.GlobalBlockOffset(id).cast<double>();
 
@@ -541,7 +622,6 @@ void FusionScene::IntegratePointBased()
                         for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
                         {
                             Vec3 global_pos = tsdf->GlobalPosition(id, i, j, k).cast<double>();
-                            auto& cell      = block->data[i][j][k];
 
 
 
@@ -613,26 +693,26 @@ void FusionScene::IntegratePointBased()
 
                             double surface_distance = std::abs(imageDepth - voxelDepth);
 
-                            if (min_dis < cell.distance)
+                            if (min_dis < block->Distance(i, j, k))
                             {
-                                cell.distance = surface_distance;
-                                cell.weight   = (voxelDepth < imageDepth) ? 1 : -1;
+                                block->SetDistance(i, j, k, surface_distance);
+                                block->SetWeight(i, j, k, (voxelDepth < imageDepth) ? 1 : -1);
                                 continue;
                             }
-                            cell.distance = std::min(cell.distance, min_dis);
+                            block->SetDistance(i, j, k, std::min(block->Distance(i, j, k), min_dis));
 
                             if (surface_distance < -params.truncationDistance)
                             {
                                 continue;
                             }
 
-                            if (cell.distance + params.truncationDistance < min_dis)
+                            if (block->Distance(i, j, k) + params.truncationDistance < min_dis)
                             {
                                 //                                continue;
                             }
 
                             //                            cell.weight += 1;  // positive;
-                            cell.weight += (voxelDepth < imageDepth) ? 5 : -1;
+                            block->SetWeight(i, j, k, block->Weight(i, j, k) + ((voxelDepth < imageDepth) ? 5 : -1));
                         }
                     }
                 }
@@ -646,14 +726,16 @@ void FusionScene::IntegratePointBased()
     {
         auto& block = tsdf->blocks[b];
 
-        for (auto& z : block.data)
-            for (auto& y : z)
-                for (auto& x : y)
+        for (int i = 0; i < tsdf->VOXEL_BLOCK_SIZE; ++i)
+            for (int j = 0; j < tsdf->VOXEL_BLOCK_SIZE; ++j)
+                for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
                 {
+                    auto x = block.Get(i, j, k);
                     if (x.weight < 0)
                     {
                         x.distance = -x.distance;
                         x.weight   = -x.weight;
+                        block.Set(i, j, k, x);
                     }
                 }
     }
@@ -700,8 +782,8 @@ void FusionScene::IntegratePointBased()
                                     {
                                         vec3 global_pos           = tsdf->GlobalPosition(current_id, i, j, k);
                                         float dis                 = (global_pos - center).norm();
-                                        b->data[i][j][k].distance = std::min(dis, b->data[i][j][k].distance);
-                                        b->data[i][j][k].weight   = 1;
+                                        b->SetDistance(i, j, k, std::min(dis, b->Distance(i, j, k)));
+                                        b->SetWeight(i, j, k, 1);
                                     }
                                 }
                             }
@@ -718,6 +800,12 @@ void FusionScene::ExtractMesh()
 {
     mesh = UnifiedMesh();
 
+    if (streamer)
+    {
+        // The surface extraction requires all blocks
+        streamer->LoadAll();
+    }
+
     auto triangle_soup_per_block =
         tsdf->ExtractSurface(params.extract_iso, params.extract_outlier_factor, 0, 4, params.verbose);
 
@@ -780,6 +868,16 @@ void FusionScene::Fuse()
 }
 
 
+void FusionScene::ExtractMeshIncremental()
+{
+    if (!incremental_extractor)
+    {
+        incremental_extractor = std::make_shared<IncrementalSurfaceExtractor>(
+            tsdf.get(), params.extract_iso, params.extract_outlier_factor, 0);
+    }
+    incremental_extractor->Update();
+}
+
 void FusionScene::FuseIncrement(const FusionImage& image, bool first)
 {
     images.clear();
@@ -789,9 +887,20 @@ void FusionScene::FuseIncrement(const FusionImage& image, bool first)
     {
         Preprocess();
     }
+    if (first && params.streaming)
+    {
+        streamer = std::make_shared<SparseTSDFStreamer>(tsdf.get(), params.streaming_params);
+    }
     AnalyseSparseStructure();
     ComputeWeight();
     Integrate();
+
+    if (streamer)
+    {
+        vec3 camera_position = image.V.inverse().translation().cast<float>();
+        streamer->UpdateWorkingSet(camera_position);
+        if (params.verbose) std::cout << streamer->IOStatistics() << std::endl;
+    }
 }
 
 
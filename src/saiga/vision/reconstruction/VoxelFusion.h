@@ -11,7 +11,10 @@
 #include "saiga/vision/VisionTypes.h"
 #include "saiga/vision/util/DepthmapPreprocessor.h"
 
+#include "IncrementalSurfaceExtractor.h"
 #include "SparseTSDF.h"
+#include "SparseTSDFStreamer.h"
+#include "TSDFIntegration.h"
 
 #include <saiga/core/model/UnifiedMesh.h>
 #include <set>
@@ -54,9 +57,19 @@ struct SAIGA_VISION_API FusionParams
     float maxWeight              = 250;
 
     int hash_size          = 5 * 1000 * 1000;
+    // Initial capacity of the block storage. It grows on demand, also during the parallel allocation.
     int block_count        = 25 * 1000;
     bool post_process_mesh = true;
 
+    // Scalar or vectorized integration. See TSDFIntegration.h.
+    // The vectorized kernels compute in float and the results differ slightly from the scalar kernel.
+    IntegrationKernel integration_kernel = IntegrationKernel::Scalar;
+
+    // Out-of-core fusion for large scenes. See SparseTSDFStreamer.
+    // Only used by FuseIncrement, because Fuse integrates all images at once.
+    bool streaming = false;
+    TSDFStreamingParams streaming_params;
+
     // added to projet image points.
     // for example -0.5 for opengl renders
     Vec2 ip_offset = Vec2::Zero();
@@ -103,6 +116,8 @@ struct SAIGA_VISION_API FusionScene
 
     ImageDimensions depth_map_size;
     std::shared_ptr<SparseTSDF> tsdf;
+    std::shared_ptr<SparseTSDFStreamer> streamer;
+    std::shared_ptr<IncrementalSurfaceExtractor> incremental_extractor;
 
     std::vector<std::array<vec3, 3>> triangle_soup;
     UnifiedMesh mesh;
@@ -117,8 +132,13 @@ struct SAIGA_VISION_API FusionScene
     void ComputeWeight();
     void Visibility();
     void Integrate();
+    TSDFIntegrationData CreateIntegrationData(const FusionImage& image);
     void IntegratePointBased();
     void ExtractMesh();
+
+    // Only triangulates the blocks that changed since the last call.
+    // Intended for a live preview after FuseIncrement. The result is incremental_extractor->Mesh().
+    void ExtractMeshIncremental();
 };
 
 
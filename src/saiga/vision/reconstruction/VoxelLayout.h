@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/math/math.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace Saiga
+{
+// The memory layout of the voxels inside a BlockSparseGrid::VoxelBlock.
+//
+// A layout defines the 'Storage' type of one block and static accessors on it. The voxel type must have the
+// members 'distance' and 'weight'. Use the accessors of the VoxelBlock (Get, Set, Distance, Weight) to write code
+// that works with all layouts.
+
+// Array of structures. The voxels are stored interleaved as data[z][y][x].
+// This is the default layout of BlockSparseGrid and the block format of the SparseTSDF files.
+template <typename VoxelType, int N>
+struct VoxelLayoutAoS
+{
+    using Voxel   = VoxelType;
+    using Storage = std::array<std::array<std::array<Voxel, N>, N>, N>;
+
+    static Voxel Get(const Storage& s, int z, int y, int x) { return s[z][y][x]; }
+    static void Set(Storage& s, int z, int y, int x, const Voxel& v) { s[z][y][x] = v; }
+
+    static float Distance(const Storage& s, int z, int y, int x) { return s[z][y][x].distance; }
+    static float Weight(const Storage& s, int z, int y, int x) { return s[z][y][x].weight; }
+
+    static void SetDistance(Storage& s, int z, int y, int x, float distance) { s[z][y][x].distance = distance; }
+    static void SetWeight(Storage& s, int z, int y, int x, float weight) { s[z][y][x].weight = weight; }
+};
+
+// Conversion between float and the stored type.
+// Integer types store round(value * SCALE), clamped to the range of the type. Floating point types ignore SCALE.
+template <typename T, int SCALE = 1>
+struct VoxelCodec
+{
+    static T Encode(float value)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            float v = std::round(value * SCALE);
+            v       = std::min<float>(std::max<float>(v, std::numeric_limits<T>::lowest()),
+                                std::numeric_limits<T>::max());
+            return T(v);
+        }
+        else
+        {
+            return T(value);
+        }
+    }
+
+    static float Decode(T value)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return float(value) * (1.0f / SCALE);
+        }
+        else
+        {
+            return float(value);
+        }
+    }
+};
+
+// Structure of arrays. The distances and weights are stored in separate planes, so that a scan over the distances
+// only reads half of the block memory. Optionally, the planes use a smaller type.
+// SparseTSDF uses this layout with float planes, the vectorized integration kernels depend on it.
+//
+// Example: fp16 distance and 8-bit weight. A block of 8^3 voxels needs 1.5 KB instead of 4 KB.
+//
+//   using CompactLayout = VoxelLayoutSoA<TSDFVoxel, 8, Eigen::half, uint8_t>;
+//   BlockSparseGrid<TSDFVoxel, 8, CompactLayout> grid;
+//
+// Integer weights are stored with a resolution of 1/WEIGHT_SCALE (see VoxelCodec). With uint8_t and
+// WEIGHT_SCALE=1 the weight must therefore be integral and <= 255.
+template <typename VoxelType, int N, typename DistanceType = float, typename WeightType = float, int WEIGHT_SCALE = 1>
+struct VoxelLayoutSoA
+{
+    using Voxel         = VoxelType;
+    using DistanceCodec = VoxelCodec<DistanceType>;
+    using WeightCodec   = VoxelCodec<WeightType, WEIGHT_SCALE>;
+
+    struct Storage
+    {
+        std::array<DistanceType, N * N * N> distance;
+        std::array<WeightType, N * N * N> weight;
+
+        Storage()
+        {
+            distance.fill(DistanceCodec::Encode(0));
+            weight.fill(WeightCodec::Encode(0));
+        }
+    };
+
+    static int Offset(int z, int y, int x) { return (z * N + y) * N + x; }
+
+    static Voxel Get(const Storage& s, int z, int y, int x)
+    {
+        Voxel v;
+        v.distance = Distance(s, z, y, x);
+        v.weight   = Weight(s, z, y, x);
+        return v;
+    }
+
+    static void Set(Storage& s, int z, int y, int x, const Voxel& v)
+    {
+        SetDistance(s, z, y, x, v.distance);
+        SetWeight(s, z, y, x, v.weight);
+    }
+
+    static float Distance(const Storage& s, int z, int y, int x)
+    {
+        return DistanceCodec::Decode(s.distance[Offset(z, y, x)]);
+    }
+    static float Weight(const Storage& s, int z, int y, int x)
+    {
+        return WeightCodec::Decode(s.weight[Offset(z, y, x)]);
+    }
+
+    static void SetDistance(Storage& s, int z, int y, int x, float distance)
+    {
+        s.distance[Offset(z, y, x)] = DistanceCodec::Encode(distance);
+    }
+    static void SetWeight(Storage& s, int z, int y, int x, float weight)
+    {
+        s.weight[Offset(z, y, x)] = WeightCodec::Encode(weight);
+    }
+};
+
+}  // namespace Saiga
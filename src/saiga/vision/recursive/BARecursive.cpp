@@ -23,6 +23,129 @@
 
 namespace Saiga
 {
+template <typename T>
+void BAMatrixFreeSchur<T>::analyzePattern(const typename Types::BAMatrix& A)
+{
+    n = A.w.rows();
+    m = A.w.cols();
+    Vinv.resize(m);
+    Sdiag.resize(n);
+    P.resize(n);
+    rhs.resize(n);
+    q.resize(m);
+}
+
+template <typename T>
+void BAMatrixFreeSchur<T>::multVinvWT(const typename Types::WType& W, const typename Types::DAType& p)
+{
+    // q = V^-1 * W^T * p
+    // W is traversed row by row and the result is scattered into one buffer per thread.
+    // The runtime may give us a smaller team than requested -> only reduce over the actual team.
+    int team    = OMP::getNumThreads();
+    auto& local = thread_q[OMP::getThreadNum()];
+    for (auto& l : local) l.setZero();
+
+#pragma omp for
+    for (int i = 0; i < n; ++i)
+    {
+        for (typename Types::WType::InnerIterator it(W, i); it; ++it)
+        {
+            local[it.index()] += it.value().get().transpose() * p(i).get();
+        }
+    }
+
+#pragma omp for
+    for (int j = 0; j < m; ++j)
+    {
+        typename Types::BRes t = thread_q[0][j];
+        for (int k = 1; k < team; ++k) t += thread_q[k][j];
+        q(j).get() = Vinv.diagonal()(j).get() * t;
+    }
+}
+
+template <typename T>
+int BAMatrixFreeSchur<T>::solve(const typename Types::BAMatrix& A, typename Types::BAVector& x,
+                                const typename Types::BAVector& b,
+                                const Eigen::Recursive::LinearSolverOptions& options, int threads)
+{
+    using ADiag = typename Types::ADiag;
+    using ARes  = typename Types::ARes;
+
+    auto& U = A.u.diagonal();
+    auto& V = A.v.diagonal();
+    auto& W = A.w;
+    thread_q.resize(threads);
+    for (auto& l : thread_q) l.resize(m);
+
+    Eigen::Index iters = options.maxIterativeIterations;
+    double tol         = options.iterativeTolerance;
+
+    // S * p = U * p - W * (V^-1 * (W^T * p))
+    // Called by all threads of the parallel region below.
+    auto applyS = [&](const typename Types::DAType& p, typename Types::DAType& result) {
+        multVinvWT(W, p);
+#pragma omp for
+        for (int i = 0; i < n; ++i)
+        {
+            ARes r = U(i).get() * p(i).get();
+            for (typename Types::WType::InnerIterator it(W, i); it; ++it)
+            {
+                r -= it.value().get() * q(it.index()).get();
+            }
+            result(i).get() = r;
+        }
+    };
+
+#pragma omp parallel num_threads(threads)
+    {
+        // q = V^-1 * b_v
+#pragma omp for
+        for (int j = 0; j < m; ++j)
+        {
+            Vinv.diagonal()(j).get() = V(j).get().inverse();
+            q(j).get()               = Vinv.diagonal()(j).get() * b.v(j).get();
+        }
+
+        // Diagonal blocks of S and the right hand side of the Schur system
+        //   rhs = b_u - W * V^-1 * b_v
+#pragma omp for
+        for (int i = 0; i < n; ++i)
+        {
+            ADiag s = U(i).get();
+            ARes r  = b.u(i).get();
+            for (typename Types::WType::InnerIterator it(W, i); it; ++it)
+            {
+                auto& w    = it.value().get();
+                auto& vinv = Vinv.diagonal()(it.index()).get();
+                s -= w * vinv * w.transpose();
+                r -= w * q(it.index()).get();
+            }
+            Sdiag.diagonal()(i).get() = s;
+            rhs(i).get()              = r;
+            x.u(i).get().setZero();
+        }
+
+#pragma omp single
+        {
+            P.compute(Sdiag);
+        }
+
+        Eigen::Recursive::recursive_conjugate_gradient_OMP(applyS, rhs, x.u, P, iters, tol);
+
+        // x_v = V^-1 * (b_v - W^T * x_u)
+        multVinvWT(W, x.u);
+#pragma omp for
+        for (int j = 0; j < m; ++j)
+        {
+            x.v(j).get() = Vinv.diagonal()(j).get() * b.v(j).get() - q(j).get();
+        }
+    }
+    return iters;
+}
+
+template class BAMatrixFreeSchur<float>;
+template class BAMatrixFreeSchur<double>;
+
 void BARec::reserve(int n, int m)
 {
     validImages.reserve(n);
@@ -139,7 +262,17 @@ void BARec::init()
 
     //    SAIGA_ASSERT(n > 0 && m > 0);
 
-    A.resize(n, m);
+    if (mixedPrecision())
+    {
+        A_f.resize(n, m);
+        rhs_f.resize(n, m);
+        delta_f.resize(n, m);
+        residual.resize(n, m);
+    }
+    else
+    {
+        A.resize(n, m);
+    }
     //    U.resize(n);
     //    V.resize(m);
 
@@ -174,24 +307,50 @@ void BARec::init()
     observations = 0;
 
     std::vector<int> innerElements;
-    for (auto&& info : validImages)
+    if (scene.hasObservationIndex())
     {
-        auto imgId  = info.sceneImageId;
-        auto offset = info.variableId;
-        //        std::cout << imgId << " " << offset << std::endl;
-        if (offset == -1) continue;
-
-        auto& img = scene.images[imgId];
+        // Only the world point ids are required here. The index stores them in one flat array.
+        SAIGA_DEBUG_ASSERT(scene.observationIndexValid());
+        auto& index = scene.observationIndex();
+        innerElements.reserve(index.numObservations());
+        for (auto&& info : validImages)
+        {
+            auto offset = info.variableId;
+            if (offset == -1) continue;
 
-        for (auto& ip : img.stereoPoints)
+            int begin = index.image_offsets[info.sceneImageId];
+            int end   = index.image_offsets[info.sceneImageId + 1];
+            for (int o = begin; o < end; ++o)
+            {
+                int j = pointToValidMap[index.obs_wp[o]];
+                pointCameraCounts[j]++;
+                innerElements.push_back(j);
+            }
+            cameraPointCounts[offset] = end - begin;
+            observations += end - begin;
+        }
+    }
+    else
+    {
+        for (auto&& info : validImages)
         {
-            if (ip.wp == -1) continue;
+            auto imgId  = info.sceneImageId;
+            auto offset = info.variableId;
+            //        std::cout << imgId << " " << offset << std::endl;
+            if (offset == -1) continue;
+
+            auto& img = scene.images[imgId];
+
+            for (auto& ip : img.stereoPoints)
+            {
+                if (ip.wp == -1) continue;
 
-            int j = pointToValidMap[ip.wp];
-            cameraPointCounts[offset]++;
-            pointCameraCounts[j]++;
-            innerElements.push_back(j);
-            observations++;
+                int j = pointToValidMap[ip.wp];
+                cameraPointCounts[offset]++;
+                pointCameraCounts[j]++;
+                innerElements.push_back(j);
+                observations++;
+            }
         }
     }
 
@@ -202,30 +361,24 @@ void BARec::init()
 
     SAIGA_ASSERT(test1 == observations && test2 == observations);
 
-    // preset the outer matrix structure
-    //    W.resize(n, m);
-    A.w.setZero();
-    A.w.reserve(observations);
-
-    for (int k = 0; k < A.w.outerSize(); ++k)
+    if (mixedPrecision())
     {
-        A.w.outerIndexPtr()[k] = cameraPointCountsScan[k];
+        initStructure<float>(A_f, innerElements);
     }
-    A.w.outerIndexPtr()[A.w.outerSize()] = observations;
-
-
-    for (int i = 0; i < observations; ++i)
+    else
     {
-        A.w.innerIndexPtr()[i] = innerElements[i];
+        initStructure<double>(A, innerElements);
     }
 
     // ===== Threading Tmps ======
 
     SAIGA_ASSERT(baOptions.helper_threads > 0);
     localChi2.resize(baOptions.helper_threads);
-    pointDiagTemp.resize(baOptions.helper_threads - 1);
+    pointDiagTemp.resize(mixedPrecision() ? 0 : baOptions.helper_threads - 1);
+    pointDiagTemp_f.resize(mixedPrecision() ? baOptions.helper_threads - 1 : 0);
     pointResTemp.resize(baOptions.helper_threads - 1);
     for (auto& a : pointDiagTemp) a.resize(m);
+    for (auto& a : pointDiagTemp_f) a.resize(m);
     for (auto& a : pointResTemp) a.resize(m);
 
 
@@ -237,8 +390,33 @@ void BARec::init()
                               ? Eigen::Recursive::LinearSolverOptions::SolverType::Direct
                               : Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
     loptions.buildExplizitSchur = optimizationOptions.buildExplizitSchur;
+    loptions.numThreads         = baOptions.solver_threads;
+    SAIGA_ASSERT(baOptions.refinement_iterations >= 0);
 
-    if (baOptions.solver_threads == 1)
+    if (matrixFree())
+    {
+        // The other solvers are not initialized, because they allocate W^T.
+        if (mixedPrecision())
+        {
+            mf_solver_f.analyzePattern(A_f);
+        }
+        else
+        {
+            mf_solver.analyzePattern(A);
+        }
+    }
+    else if (mixedPrecision())
+    {
+        if (baOptions.solver_threads == 1)
+        {
+            solver_f.analyzePattern(A_f, loptions);
+        }
+        else
+        {
+            solver_f.analyzePattern_omp(A_f, loptions);
+        }
+    }
+    else if (baOptions.solver_threads == 1)
     {
         solver.analyzePattern(A, loptions);
     }
@@ -339,13 +517,51 @@ void BARec::init()
     }
 }
 
+template <typename BlockScalar>
+void BARec::initStructure(typename BARecTypes<BlockScalar>::BAMatrix& A, const std::vector<int>& innerElements)
+{
+    // preset the outer matrix structure
+    //    W.resize(n, m);
+    A.w.setZero();
+    A.w.reserve(observations);
+
+    for (int k = 0; k < A.w.outerSize(); ++k)
+    {
+        A.w.outerIndexPtr()[k] = cameraPointCountsScan[k];
+    }
+    A.w.outerIndexPtr()[A.w.outerSize()] = observations;
+
+
+    for (int i = 0; i < observations; ++i)
+    {
+        A.w.innerIndexPtr()[i] = innerElements[i];
+    }
+}
+
 double BARec::computeQuadraticForm()
+{
+    if (mixedPrecision())
+    {
+        return computeQuadraticForm<float>(A_f, pointDiagTemp_f);
+    }
+    else
+    {
+        return computeQuadraticForm<double>(A, pointDiagTemp);
+    }
+}
+
+template <typename BlockScalar>
+double BARec::computeQuadraticForm(typename BARecTypes<BlockScalar>::BAMatrix& A,
+                                   std::vector<AlignedVector<typename BARecTypes<BlockScalar>::BDiag>>& pointDiagTemp)
 {
     Scene& scene = *_scene;
 
     //    SAIGA_OPTIONAL_BLOCK_TIMER(RECURSIVE_BA_USE_TIMERS && optimizationOptions.debugOutput);
 
-    using T = BlockBAScalar;
+    // The right hand side is always accumulated in double
+    using T     = BlockBAScalar;
+    using BDiag = typename BARecTypes<BlockScalar>::BDiag;
+    using WElem = typename BARecTypes<BlockScalar>::WElem;
     //    using KernelType = Saiga::Kernel::BAPosePointMono<T>;
 
 
@@ -475,11 +691,11 @@ double BARec::computeQuadraticForm()
                     {
                         auto& targetPosePose = A.u.diagonal()(actualOffset).get();
                         auto& targetPoseRes  = b.u(actualOffset).get();
-                        targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
-                        targetPosePoint = loss_weight * JrowPose.transpose() * JrowPoint;
+                        targetPosePose += (loss_weight * JrowPose.transpose() * JrowPose).template cast<BlockScalar>();
+                        targetPosePoint = (loss_weight * JrowPose.transpose() * JrowPoint).template cast<BlockScalar>();
                         targetPoseRes -= loss_weight * JrowPose.transpose() * res;
                     }
-                    targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
+                    targetPointPoint += (loss_weight * JrowPoint.transpose() * JrowPoint).template cast<BlockScalar>();
                     targetPointRes -= loss_weight * JrowPoint.transpose() * res;
                 }
                 else
@@ -504,11 +720,11 @@ double BARec::computeQuadraticForm()
                     {
                         auto& targetPosePose = A.u.diagonal()(actualOffset).get();
                         auto& targetPoseRes  = b.u(actualOffset).get();
-                        targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
-                        targetPosePoint = loss_weight * JrowPose.transpose() * JrowPoint;
+                        targetPosePose += (loss_weight * JrowPose.transpose() * JrowPose).template cast<BlockScalar>();
+                        targetPosePoint = (loss_weight * JrowPose.transpose() * JrowPoint).template cast<BlockScalar>();
                         targetPoseRes -= loss_weight * JrowPose.transpose() * res;
                     }
-                    targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
+                    targetPointPoint += (loss_weight * JrowPoint.transpose() * JrowPoint).template cast<BlockScalar>();
                     targetPointRes -= loss_weight * JrowPoint.transpose() * res;
                 }
 
@@ -642,6 +858,12 @@ void BARec::addLambda(double lambda)
     //    else
     //    {
     //#pragma omp parallel num_threads(baOptions.helper_threads)
+    if (mixedPrecision())
+    {
+        applyLMDiagonal_omp(A_f.u, lambda);
+        applyLMDiagonal_omp(A_f.v, lambda);
+    }
+    else
     {
         applyLMDiagonal_omp(A.u, lambda);
         applyLMDiagonal_omp(A.v, lambda);
@@ -656,7 +878,15 @@ void BARec::solveLinearSystem()
 {
     SAIGA_OPTIONAL_BLOCK_TIMER(RECURSIVE_BA_USE_TIMERS && optimizationOptions.debugOutput);
 
-    if (baOptions.solver_threads == 1)
+    if (mixedPrecision())
+    {
+        solveLinearSystemMixed();
+    }
+    else if (matrixFree())
+    {
+        mf_solver.solve(A, delta_x, b, loptions, baOptions.solver_threads);
+    }
+    else if (baOptions.solver_threads == 1)
     {
         solver.solve(A, delta_x, b, loptions);
     }
@@ -670,6 +900,122 @@ void BARec::solveLinearSystem()
     //#pragma omp single
 }
 
+void BARec::solveLinearSystemMixed()
+{
+    // Iterative refinement:
+    //   r = b - A * x  (double)
+    //   A * d = r      (float)
+    //   x = x + d
+    // The float solution of the first iteration is usually good enough for LM. For small lambdas the system can be
+    // too badly conditioned for float. A correction, which increases the residual, is therefore reverted.
+    auto accumulate = [this](double scale, bool set) {
+#pragma omp parallel num_threads(baOptions.helper_threads)
+        {
+#pragma omp for nowait
+            for (int i = 0; i < n; ++i)
+            {
+                ARes d = delta_f.u(i).get().cast<double>() * scale;
+                delta_x.u(i).get() = set ? d : ARes(delta_x.u(i).get() + d);
+            }
+#pragma omp for
+            for (int i = 0; i < m; ++i)
+            {
+                BRes d = delta_f.v(i).get().cast<double>() * scale;
+                delta_x.v(i).get() = set ? d : BRes(delta_x.v(i).get() + d);
+            }
+        }
+    };
+
+    double last_norm = std::numeric_limits<double>::infinity();
+    for (int it = 0; it <= baOptions.refinement_iterations; ++it)
+    {
+        if (it > 0)
+        {
+            double norm = computeMixedResidual();
+            if (norm >= last_norm)
+            {
+                accumulate(-1, false);
+                return;
+            }
+            last_norm = norm;
+        }
+        const BAVector& r = it == 0 ? b : residual;
+
+#pragma omp parallel num_threads(baOptions.helper_threads)
+        {
+#pragma omp for nowait
+            for (int i = 0; i < n; ++i) rhs_f.u(i).get() = r.u(i).get().cast<float>();
+#pragma omp for
+            for (int i = 0; i < m; ++i) rhs_f.v(i).get() = r.v(i).get().cast<float>();
+        }
+
+        if (matrixFree())
+        {
+            mf_solver_f.solve(A_f, delta_f, rhs_f, loptions, baOptions.solver_threads);
+        }
+        else if (baOptions.solver_threads == 1)
+        {
+            solver_f.solve(A_f, delta_f, rhs_f, loptions);
+        }
+        else
+        {
+#pragma omp parallel num_threads(baOptions.solver_threads)
+            {
+                solver_f.solve_omp(A_f, delta_f, rhs_f, loptions);
+            }
+        }
+        accumulate(1, it == 0);
+    }
+
+    // Check the last correction
+    if (baOptions.refinement_iterations > 0 && computeMixedResidual() >= last_norm)
+    {
+        accumulate(-1, false);
+    }
+}
+
+double BARec::computeMixedResidual()
+{
+    auto& W = A_f.w;
+
+    // r_u = b_u - U * x_u - W * x_v
+#pragma omp parallel for num_threads(baOptions.helper_threads)
+    for (int i = 0; i < n; ++i)
+    {
+        ARes r = b.u(i).get() - A_f.u.diagonal()(i).get().cast<double>() * delta_x.u(i).get();
+        for (int k = W.outerIndexPtr()[i]; k < W.outerIndexPtr()[i + 1]; ++k)
+        {
+            int j = W.innerIndexPtr()[k];
+            r -= W.valuePtr()[k].get().cast<double>() * delta_x.v(j).get();
+        }
+        residual.u(i).get() = r;
+    }
+
+    // r_v = b_v - V * x_v - W^T * x_u
+    for (int j = 0; j < m; ++j)
+    {
+        residual.v(j).get() = b.v(j).get() - A_f.v.diagonal()(j).get().cast<double>() * delta_x.v(j).get();
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        for (int k = W.outerIndexPtr()[i]; k < W.outerIndexPtr()[i + 1]; ++k)
+        {
+            int j = W.innerIndexPtr()[k];
+            residual.v(j).get() -= W.valuePtr()[k].get().transpose().cast<double>() * delta_x.u(i).get();
+        }
+    }
+
+    double norm = 0;
+#pragma omp parallel num_threads(baOptions.helper_threads)
+    {
+#pragma omp for nowait reduction(+ : norm)
+        for (int i = 0; i < n; ++i) norm += residual.u(i).get().squaredNorm();
+#pragma omp for reduction(+ : norm)
+        for (int j = 0; j < m; ++j) norm += residual.v(j).get().squaredNorm();
+    }
+    return norm;
+}
+
 double BARec::computeCost()
 {
     Scene& scene = *_scene;
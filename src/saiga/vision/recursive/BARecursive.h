@@ -13,20 +13,19 @@
 
 namespace Saiga
 {
-class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
+// The block structured matrix types of the recursive BA with scalar type T.
+template <typename T>
+struct BARecTypes
 {
-   public:
-    // ============== Recusrive Matrix Types ==============
     static constexpr int blockSizeCamera = 6;
     static constexpr int blockSizePoint  = 3;
-    using BlockBAScalar                  = double;
 
-    using ADiag  = Eigen::Matrix<BlockBAScalar, blockSizeCamera, blockSizeCamera, Eigen::RowMajor>;
-    using BDiag  = Eigen::Matrix<BlockBAScalar, blockSizePoint, blockSizePoint, Eigen::RowMajor>;
-    using WElem  = Eigen::Matrix<BlockBAScalar, blockSizeCamera, blockSizePoint, Eigen::RowMajor>;
-    using WTElem = Eigen::Matrix<BlockBAScalar, blockSizePoint, blockSizeCamera, Eigen::RowMajor>;
-    using ARes   = Eigen::Matrix<BlockBAScalar, blockSizeCamera, 1>;
-    using BRes   = Eigen::Matrix<BlockBAScalar, blockSizePoint, 1>;
+    using ADiag  = Eigen::Matrix<T, blockSizeCamera, blockSizeCamera, Eigen::RowMajor>;
+    using BDiag  = Eigen::Matrix<T, blockSizePoint, blockSizePoint, Eigen::RowMajor>;
+    using WElem  = Eigen::Matrix<T, blockSizeCamera, blockSizePoint, Eigen::RowMajor>;
+    using WTElem = Eigen::Matrix<T, blockSizePoint, blockSizeCamera, Eigen::RowMajor>;
+    using ARes   = Eigen::Matrix<T, blockSizeCamera, 1>;
+    using BRes   = Eigen::Matrix<T, blockSizePoint, 1>;
 
     // Block structured diagonal matrices
     using UType = Eigen::DiagonalMatrix<Eigen::Recursive::MatrixScalar<ADiag>, -1>;
@@ -45,6 +44,68 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     using BAMatrix = Eigen::Recursive::SymmetricMixedMatrix2<UType, VType, WType>;
     using BAVector = Eigen::Recursive::MixedVector2<DAType, DBType>;
     using BASolver = Eigen::Recursive::MixedSymmetricRecursiveSolver<BAMatrix, BAVector>;
+};
+
+// Solves the normal equations with PCG on the Schur complement
+//   S = U - W * V^-1 * W^T
+// without building S, W * V^-1 or W^T. The product S * p is evaluated on the fly from the blocks of A. The only
+// additional memory are the inverted point blocks and one point vector per thread. The preconditioner is block Jacobi.
+template <typename T>
+class BAMatrixFreeSchur
+{
+   public:
+    using Types = BARecTypes<T>;
+
+    void analyzePattern(const typename Types::BAMatrix& A);
+
+    // Returns the number of PCG iterations
+    int solve(const typename Types::BAMatrix& A, typename Types::BAVector& x, const typename Types::BAVector& b,
+              const Eigen::Recursive::LinearSolverOptions& options, int threads);
+
+   private:
+    int n = 0, m = 0;
+
+    typename Types::VType Vinv;
+    typename Types::UType Sdiag;
+    Eigen::Recursive::RecursiveDiagonalPreconditioner<Eigen::Recursive::MatrixScalar<typename Types::ADiag>> P;
+    typename Types::DAType rhs;
+    typename Types::DBType q;
+    std::vector<AlignedVector<typename Types::BRes>> thread_q;
+
+    // q = V^-1 * W^T * p. Must be called by all threads of a parallel region.
+    // thread_q must have at least one buffer of size m per thread.
+    void multVinvWT(const typename Types::WType& W, const typename Types::DAType& p);
+};
+
+class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
+{
+   public:
+    // ============== Recusrive Matrix Types ==============
+    static constexpr int blockSizeCamera = 6;
+    static constexpr int blockSizePoint  = 3;
+    using BlockBAScalar                  = double;
+
+    using ADiag  = BARecTypes<BlockBAScalar>::ADiag;
+    using BDiag  = BARecTypes<BlockBAScalar>::BDiag;
+    using WElem  = BARecTypes<BlockBAScalar>::WElem;
+    using WTElem = BARecTypes<BlockBAScalar>::WTElem;
+    using ARes   = BARecTypes<BlockBAScalar>::ARes;
+    using BRes   = BARecTypes<BlockBAScalar>::BRes;
+
+    using UType  = BARecTypes<BlockBAScalar>::UType;
+    using VType  = BARecTypes<BlockBAScalar>::VType;
+    using DAType = BARecTypes<BlockBAScalar>::DAType;
+    using DBType = BARecTypes<BlockBAScalar>::DBType;
+    using WType  = BARecTypes<BlockBAScalar>::WType;
+    using WTType = BARecTypes<BlockBAScalar>::WTType;
+    using SType  = BARecTypes<BlockBAScalar>::SType;
+
+    using BAMatrix = BARecTypes<BlockBAScalar>::BAMatrix;
+    using BAVector = BARecTypes<BlockBAScalar>::BAVector;
+    using BASolver = BARecTypes<BlockBAScalar>::BASolver;
+
+    // The float system of BAOptions::Precision::Mixed
+    using MixedTypes = BARecTypes<float>;
 
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -69,6 +130,16 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     BAVector x, b, delta_x;
     BASolver solver;
 
+    // Mixed precision: A_f is the normal matrix in float. b and delta_x are always in double.
+    MixedTypes::BAMatrix A_f;
+    MixedTypes::BAVector rhs_f, delta_f;
+    MixedTypes::BASolver solver_f;
+    BAVector residual;
+
+    // BAOptions::matrix_free_schur
+    BAMatrixFreeSchur<BlockBAScalar> mf_solver;
+    BAMatrixFreeSchur<float> mf_solver_f;
+
     AlignedVector<SE3> x_u, oldx_u;
     AlignedVector<Vec3> x_v, oldx_v;
 
@@ -115,6 +186,7 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     //    int threads = 1;
     // each thread gets one vector
     std::vector<AlignedVector<BDiag>> pointDiagTemp;
+    std::vector<AlignedVector<MixedTypes::BDiag>> pointDiagTemp_f;
     std::vector<AlignedVector<BRes>> pointResTemp;
     std::vector<double> localChi2;
     double chi2_sum;
@@ -130,6 +202,24 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     virtual void solveLinearSystem() override;
     virtual double computeCost() override;
     virtual void finalize() override;
+
+    bool mixedPrecision() const { return baOptions.precision == BAOptions::Precision::Mixed; }
+    bool matrixFree() const
+    {
+        return baOptions.matrix_free_schur &&
+               optimizationOptions.solverType == OptimizationOptions::SolverType::Iterative;
+    }
+
+    // Shared by both precisions. BlockScalar is the scalar type of the normal matrix.
+    template <typename BlockScalar>
+    void initStructure(typename BARecTypes<BlockScalar>::BAMatrix& A, const std::vector<int>& innerElements);
+    template <typename BlockScalar>
+    double computeQuadraticForm(typename BARecTypes<BlockScalar>::BAMatrix& A,
+                                std::vector<AlignedVector<typename BARecTypes<BlockScalar>::BDiag>>& pointDiagTemp);
+
+    // residual = b - A_f * delta_x in double precision. Returns |residual|^2.
+    double computeMixedResidual();
+    void solveLinearSystemMixed();
 };
 
 
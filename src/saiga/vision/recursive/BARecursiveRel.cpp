@@ -354,6 +354,7 @@ void BARecRel::init()
                               ? Eigen::Recursive::LinearSolverOptions::SolverType::Direct
                               : Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
     loptions.buildExplizitSchur = optimizationOptions.buildExplizitSchur;
+    loptions.numThreads         = baOptions.solver_threads;
 
     if (baOptions.solver_threads == 1)
     {
@@ -0,0 +1,614 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "BASlidingWindow.h"
+
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/kernels/BA.h"
+#include "saiga/vision/kernels/Robust.h"
+#include "saiga/vision/util/LM.h"
+
+namespace Saiga
+{
+namespace
+{
+// Inverse of a symmetric positive semi-definite matrix. Directions with a (numerically) zero eigenvalue are
+// ignored, for example the gauge freedom of a marginalized keyframe.
+template <typename MatrixType>
+MatrixType pseudoInverse(const MatrixType& A)
+{
+    Eigen::SelfAdjointEigenSolver<MatrixType> es(A);
+    auto ev      = es.eigenvalues();
+    double limit = std::max(ev.maxCoeff(), 0.0) * 1e-12;
+    auto inv     = ev.unaryExpr([limit](double v) { return v > limit ? 1.0 / v : 0.0; }).eval();
+    return es.eigenvectors() * inv.asDiagonal() * es.eigenvectors().transpose();
+}
+
+// Schur complement of the 6x6 diagonal block k of the system (H, b, c) in the form of BASlidingWindow::Prior.
+void eliminatePose(Eigen::MatrixXd& H, Eigen::VectorXd& b, double& c, int k)
+{
+    int q = H.rows() / 6;
+    std::vector<int> rest;
+    for (int i = 0; i < q; ++i)
+    {
+        if (i != k) rest.push_back(i);
+    }
+
+    Eigen::Matrix<double, 6, 6> Hkk_inv = pseudoInverse<Eigen::Matrix<double, 6, 6>>(H.block<6, 6>(6 * k, 6 * k));
+    Eigen::Matrix<double, 6, 1> bk      = b.segment<6>(6 * k);
+
+    int r = rest.size();
+    Eigen::MatrixXd Hrr(6 * r, 6 * r), Hrk(6 * r, 6);
+    Eigen::VectorXd br(6 * r);
+    for (int i = 0; i < r; ++i)
+    {
+        Hrk.block<6, 6>(6 * i, 0) = H.block<6, 6>(6 * rest[i], 6 * k);
+        br.segment<6>(6 * i)      = b.segment<6>(6 * rest[i]);
+        for (int j = 0; j < r; ++j)
+        {
+            Hrr.block<6, 6>(6 * i, 6 * j) = H.block<6, 6>(6 * rest[i], 6 * rest[j]);
+        }
+    }
+
+    Eigen::MatrixXd Y = Hrk * Hkk_inv;
+    Hrr -= Y * Hrk.transpose();
+    br -= Y * bk;
+    c -= bk.dot(Hkk_inv * bk);
+
+    H = Hrr;
+    b = br;
+}
+
+}  // namespace
+
+void BASlidingWindow::create(Scene& scene)
+{
+    _scene = &scene;
+    window.clear();
+    keyframes_.clear();
+    points.clear();
+    observations.clear();
+    free_keyframes.clear();
+    free_points.clear();
+    free_observations.clear();
+    keyframe_map.clear();
+    point_map.clear();
+    marginalized_points.clear();
+    prior = Prior();
+}
+
+void BASlidingWindow::addKeyframe(int image_id)
+{
+    Scene& scene = *_scene;
+    SAIGA_ASSERT(image_id >= 0 && image_id < (int)scene.images.size());
+    SAIGA_ASSERT(keyframe_map.count(image_id) == 0);
+
+    auto allocate = [](auto& container, std::vector<int>& free_slots) {
+        if (free_slots.empty())
+        {
+            container.emplace_back();
+            return (int)container.size() - 1;
+        }
+        int slot = free_slots.back();
+        free_slots.pop_back();
+        return slot;
+    };
+
+    int k                   = allocate(keyframes_, free_keyframes);
+    keyframes_[k].image     = image_id;
+    keyframe_map[image_id]  = k;
+    window.push_back(image_id);
+
+    auto& img = scene.images[image_id];
+    for (int i = 0; i < (int)img.stereoPoints.size(); ++i)
+    {
+        int wp = img.stereoPoints[i].wp;
+        if (wp == -1 || !scene.worldPoints[wp].valid || marginalized_points.count(wp)) continue;
+
+        int p;
+        auto it = point_map.find(wp);
+        if (it == point_map.end())
+        {
+            p             = allocate(points, free_points);
+            points[p].wp  = wp;
+            point_map[wp] = p;
+        }
+        else
+        {
+            p = it->second;
+        }
+
+        int o                       = allocate(observations, free_observations);
+        observations[o].keyframe    = k;
+        observations[o].point       = p;
+        observations[o].image_point = i;
+        keyframes_[k].observations.push_back(o);
+        points[p].observations.push_back(o);
+    }
+}
+
+void BASlidingWindow::removeObservation(int o)
+{
+    auto& obs   = observations[o];
+    auto& kf_os = keyframes_[obs.keyframe].observations;
+    auto& p_os  = points[obs.point].observations;
+    kf_os.erase(std::find(kf_os.begin(), kf_os.end(), o));
+    p_os.erase(std::find(p_os.begin(), p_os.end(), o));
+
+    if (p_os.empty())
+    {
+        point_map.erase(points[obs.point].wp);
+        points[obs.point].wp = -1;
+        free_points.push_back(obs.point);
+    }
+
+    obs.keyframe = -1;
+    obs.point    = -1;
+    free_observations.push_back(o);
+}
+
+void BASlidingWindow::removePoint(int world_point_id)
+{
+    auto it = point_map.find(world_point_id);
+    if (it == point_map.end()) return;
+    auto os = points[it->second].observations;
+    for (int o : os) removeObservation(o);
+}
+
+void BASlidingWindow::removeKeyframe(int image_id)
+{
+    auto it = keyframe_map.find(image_id);
+    SAIGA_ASSERT(it != keyframe_map.end());
+    int k = it->second;
+
+    auto os = keyframes_[k].observations;
+    for (int o : os) removeObservation(o);
+
+    // The keyframe is not optimized anymore. Its dependencies to the other keyframes are kept in the prior.
+    auto pit = std::find(prior.images.begin(), prior.images.end(), image_id);
+    if (pit != prior.images.end())
+    {
+        int i = pit - prior.images.begin();
+        eliminatePose(prior.H, prior.b, prior.c, i);
+        prior.images.erase(prior.images.begin() + i);
+        prior.x0.erase(prior.x0.begin() + i);
+    }
+
+    keyframes_[k] = Keyframe();
+    free_keyframes.push_back(k);
+    keyframe_map.erase(it);
+    window.erase(std::find(window.begin(), window.end(), image_id));
+}
+
+void BASlidingWindow::marginalizeKeyframe(int image_id)
+{
+    Scene& scene = *_scene;
+    auto it      = keyframe_map.find(image_id);
+    SAIGA_ASSERT(it != keyframe_map.end());
+    int k = it->second;
+
+    std::vector<int> marg_points;
+    for (int o : keyframes_[k].observations) marg_points.push_back(observations[o].point);
+    std::sort(marg_points.begin(), marg_points.end());
+    marg_points.erase(std::unique(marg_points.begin(), marg_points.end()), marg_points.end());
+
+    // The variables of the new prior: The old prior, all keyframes connected to the removed points and the
+    // marginalized keyframe itself, which is eliminated at the end.
+    std::vector<int> images;
+    std::unordered_map<int, int> index;
+    auto addImage = [&](int image) {
+        if (scene.images[image].constant || index.count(image)) return;
+        index[image] = images.size();
+        images.push_back(image);
+    };
+    for (int image : prior.images) addImage(image);
+    for (int p : marg_points)
+    {
+        for (int o : points[p].observations) addImage(keyframes_[observations[o].keyframe].image);
+    }
+    addImage(image_id);
+
+    int q = images.size();
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(6 * q, 6 * q);
+    Eigen::VectorXd b = Eigen::VectorXd::Zero(6 * q);
+    double c          = 0;
+
+    // Old prior at the current poses
+    if (!prior.images.empty())
+    {
+        AlignedVector<SE3> x;
+        for (int image : prior.images) x.push_back(scene.images[image].se3);
+        Eigen::VectorXd b_current;
+        c = evaluatePrior(x, &b_current);
+
+        for (int i = 0; i < (int)prior.images.size(); ++i)
+        {
+            int a                = index[prior.images[i]];
+            b.segment<6>(6 * a) += b_current.segment<6>(6 * i);
+            for (int j = 0; j < (int)prior.images.size(); ++j)
+            {
+                H.block<6, 6>(6 * a, 6 * index[prior.images[j]]) += prior.H.block<6, 6>(6 * i, 6 * j);
+            }
+        }
+    }
+
+    // Eliminate the points
+    std::vector<std::pair<int, WElem>, Eigen::aligned_allocator<std::pair<int, WElem>>> Ws;
+    for (int p : marg_points)
+    {
+        auto& wp = scene.worldPoints[points[p].wp];
+        BDiag Vp = BDiag::Zero();
+        BRes bp  = BRes::Zero();
+        Ws.clear();
+
+        for (int o : points[p].observations)
+        {
+            auto& obs   = observations[o];
+            int image   = keyframes_[obs.keyframe].image;
+            Linearization lin;
+            c += linearize(obs, scene.images[image].se3, wp.p, &lin);
+            Vp += lin.V;
+            bp += lin.bv;
+
+            auto iit = index.find(image);
+            if (iit == index.end()) continue;
+            int a = iit->second;
+            H.block<6, 6>(6 * a, 6 * a) += lin.U;
+            b.segment<6>(6 * a) += lin.bu;
+            Ws.emplace_back(a, lin.W);
+        }
+
+        if (wp.constant) continue;
+
+        BDiag Vp_inv = pseudoInverse(Vp);
+        for (auto& [a, Wa] : Ws)
+        {
+            WElem Y = Wa * Vp_inv;
+            b.segment<6>(6 * a) -= Y * bp;
+            for (auto& [a2, Wb] : Ws)
+            {
+                H.block<6, 6>(6 * a, 6 * a2) -= Y * Wb.transpose();
+            }
+        }
+        c -= bp.dot(Vp_inv * bp);
+    }
+
+    // Eliminate the keyframe
+    auto kit = index.find(image_id);
+    if (kit != index.end())
+    {
+        eliminatePose(H, b, c, kit->second);
+        images.erase(images.begin() + kit->second);
+    }
+
+    prior.images = images;
+    prior.x0.clear();
+    for (int image : images) prior.x0.push_back(scene.images[image].se3);
+    prior.H = H;
+    prior.b = b;
+    prior.c = c;
+
+    for (int p : marg_points)
+    {
+        int wp = points[p].wp;
+        marginalized_points.insert(wp);
+        removePoint(wp);
+    }
+    removeKeyframe(image_id);
+}
+
+double BASlidingWindow::linearize(const Observation& obs, const SE3& pose, const Vec3& point,
+                                  Linearization* lin) const
+{
+    Scene& scene = *_scene;
+    auto& img    = scene.images[keyframes_[obs.keyframe].image];
+    auto& ip     = img.stereoPoints[obs.image_point];
+
+    if (!ip)
+    {
+        if (lin)
+        {
+            lin->U.setZero();
+            lin->W.setZero();
+            lin->V.setZero();
+            lin->bu.setZero();
+            lin->bv.setZero();
+        }
+        return 0;
+    }
+
+    auto robust = [&](const auto& res, const auto& JrowPose, const auto& JrowPoint, double huber) {
+        double loss_weight = 1.0;
+        double res_2       = res.squaredNorm();
+        if (huber > 0)
+        {
+            auto rw     = Kernel::HuberLoss<T>(huber, res_2);
+            res_2       = rw(0);
+            loss_weight = rw(1);
+        }
+        if (lin)
+        {
+            lin->U  = loss_weight * JrowPose.transpose() * JrowPose;
+            lin->W  = loss_weight * JrowPose.transpose() * JrowPoint;
+            lin->V  = loss_weight * JrowPoint.transpose() * JrowPoint;
+            lin->bu = -loss_weight * JrowPose.transpose() * res;
+            lin->bv = -loss_weight * JrowPoint.transpose() * res;
+        }
+        return res_2;
+    };
+
+    auto& camera = scene.intrinsics[img.intr];
+    T w          = ip.weight * scene.scale();
+
+    if (ip.IsStereoOrDepth())
+    {
+        StereoCamera4 scam(camera, scene.bf);
+        auto stereo_point = ip.GetStereoPoint(scene.bf);
+        Matrix<T, 3, 6> JrowPose;
+        Matrix<T, 3, 3> JrowPoint;
+        auto [res, depth] = BundleAdjustmentStereo(scam, ip.point, stereo_point, pose, point, w,
+                                                   w * scene.stereo_weight, lin ? &JrowPose : nullptr,
+                                                   lin ? &JrowPoint : nullptr);
+        return robust(res, JrowPose, JrowPoint, baOptions.huberStereo);
+    }
+    else
+    {
+        Matrix<T, 2, 6> JrowPose;
+        Matrix<T, 2, 3> JrowPoint;
+        auto [res, depth] =
+            BundleAdjustment(camera, ip.point, pose, point, w, lin ? &JrowPose : nullptr, lin ? &JrowPoint : nullptr);
+        return robust(res, JrowPose, JrowPoint, baOptions.huberMono);
+    }
+}
+
+double BASlidingWindow::evaluatePrior(const AlignedVector<SE3>& x, Eigen::VectorXd* b_current) const
+{
+    int p = prior.images.size();
+    if (p == 0)
+    {
+        if (b_current) b_current->resize(0);
+        return 0;
+    }
+
+    Eigen::VectorXd dx(6 * p);
+    for (int i = 0; i < p; ++i)
+    {
+        dx.segment<6>(6 * i) = Sophus::se3_logd(x[i] * prior.x0[i].inverse());
+    }
+
+    Eigen::VectorXd Hdx = prior.H * dx;
+    if (b_current) *b_current = prior.b - Hdx;
+    return prior.c - 2 * prior.b.dot(dx) + dx.dot(Hdx);
+}
+
+void BASlidingWindow::init()
+{
+    Scene& scene = *_scene;
+
+    active_observations.clear();
+    for (int o = 0; o < (int)observations.size(); ++o)
+    {
+        if (observations[o].keyframe >= 0) active_observations.push_back(o);
+    }
+
+    x_u.resize(keyframes_.size());
+    oldx_u.resize(keyframes_.size());
+    variable_keyframes.clear();
+    for (int k = 0; k < (int)keyframes_.size(); ++k)
+    {
+        auto& kf = keyframes_[k];
+        if (kf.image == -1) continue;
+        x_u[k]      = scene.images[kf.image].se3;
+        kf.variable = scene.images[kf.image].constant ? -1 : (int)variable_keyframes.size();
+        if (kf.variable >= 0) variable_keyframes.push_back(k);
+    }
+
+    x_v.resize(points.size());
+    oldx_v.resize(points.size());
+    variable_points.clear();
+    for (int p = 0; p < (int)points.size(); ++p)
+    {
+        auto& point = points[p];
+        if (point.wp == -1) continue;
+        x_v[p]         = scene.worldPoints[point.wp].p;
+        point.variable = scene.worldPoints[point.wp].constant ? -1 : (int)variable_points.size();
+        if (point.variable >= 0) variable_points.push_back(p);
+    }
+
+    n = variable_keyframes.size();
+    m = variable_points.size();
+    U.resize(n);
+    bu.resize(n);
+    V.resize(m);
+    Vinv.resize(m);
+    bv.resize(m);
+    delta_v.resize(m);
+}
+
+double BASlidingWindow::computeQuadraticForm()
+{
+    double chi2 = 0;
+
+#pragma omp parallel num_threads(baOptions.helper_threads)
+    {
+#pragma omp for reduction(+ : chi2)
+        for (int i = 0; i < (int)active_observations.size(); ++i)
+        {
+            auto& obs = observations[active_observations[i]];
+            chi2 += linearize(obs, x_u[obs.keyframe], x_v[obs.point], &obs.lin);
+        }
+
+#pragma omp for nowait
+        for (int i = 0; i < n; ++i)
+        {
+            U[i].setZero();
+            bu[i].setZero();
+            for (int o : keyframes_[variable_keyframes[i]].observations)
+            {
+                U[i] += observations[o].lin.U;
+                bu[i] += observations[o].lin.bu;
+            }
+        }
+
+#pragma omp for
+        for (int i = 0; i < m; ++i)
+        {
+            V[i].setZero();
+            bv[i].setZero();
+            for (int o : points[variable_points[i]].observations)
+            {
+                V[i] += observations[o].lin.V;
+                bv[i] += observations[o].lin.bv;
+            }
+        }
+    }
+
+    if (!prior.images.empty())
+    {
+        // The diagonal blocks of the prior are added to U so that they are damped by addLambda().
+        // The off-diagonal blocks are added to S in solveLinearSystem().
+        AlignedVector<SE3> x;
+        for (int image : prior.images) x.push_back(x_u[keyframe_map[image]]);
+        Eigen::VectorXd b_current;
+        chi2 += evaluatePrior(x, &b_current);
+
+        for (int i = 0; i < (int)prior.images.size(); ++i)
+        {
+            int v = keyframes_[keyframe_map[prior.images[i]]].variable;
+            if (v == -1) continue;
+            U[v] += prior.H.block<6, 6>(6 * i, 6 * i);
+            bu[v] += b_current.segment<6>(6 * i);
+        }
+    }
+
+    return chi2;
+}
+
+void BASlidingWindow::addLambda(double lambda)
+{
+    for (auto& u : U) applyLMDiagonalInner(u, lambda);
+    for (auto& v : V) applyLMDiagonalInner(v, lambda);
+}
+
+void BASlidingWindow::solveLinearSystem()
+{
+    S.setZero(6 * n, 6 * n);
+    rhs.resize(6 * n);
+    for (int i = 0; i < n; ++i)
+    {
+        S.block<6, 6>(6 * i, 6 * i) = U[i];
+        rhs.segment<6>(6 * i)       = bu[i];
+    }
+
+    for (int i = 0; i < (int)prior.images.size(); ++i)
+    {
+        int vi = keyframes_[keyframe_map[prior.images[i]]].variable;
+        for (int j = 0; j < (int)prior.images.size(); ++j)
+        {
+            int vj = keyframes_[keyframe_map[prior.images[j]]].variable;
+            if (i == j || vi == -1 || vj == -1) continue;
+            S.block<6, 6>(6 * vi, 6 * vj) += prior.H.block<6, 6>(6 * i, 6 * j);
+        }
+    }
+
+    // S   = U - W * V^-1 * W^T
+    // rhs = bu - W * V^-1 * bv
+#pragma omp parallel num_threads(baOptions.helper_threads)
+    {
+        Eigen::MatrixXd S_local = Eigen::MatrixXd::Zero(6 * n, 6 * n);
+        Eigen::VectorXd r_local = Eigen::VectorXd::Zero(6 * n);
+
+#pragma omp for
+        for (int i = 0; i < m; ++i)
+        {
+            Vinv[i]    = V[i].inverse();
+            auto& p_os = points[variable_points[i]].observations;
+            for (int o : p_os)
+            {
+                int a = keyframes_[observations[o].keyframe].variable;
+                if (a == -1) continue;
+                WElem Y = observations[o].lin.W * Vinv[i];
+                r_local.segment<6>(6 * a) -= Y * bv[i];
+                for (int o2 : p_os)
+                {
+                    int b = keyframes_[observations[o2].keyframe].variable;
+                    if (b == -1) continue;
+                    S_local.block<6, 6>(6 * a, 6 * b) -= Y * observations[o2].lin.W.transpose();
+                }
+            }
+        }
+
+#pragma omp critical
+        {
+            S += S_local;
+            rhs += r_local;
+        }
+    }
+
+    delta_u = S.ldlt().solve(rhs);
+
+    // Back substitution
+    //   delta_v = V^-1 * (bv - W^T * delta_u)
+#pragma omp parallel for num_threads(baOptions.helper_threads)
+    for (int i = 0; i < m; ++i)
+    {
+        BRes q = bv[i];
+        for (int o : points[variable_points[i]].observations)
+        {
+            int a = keyframes_[observations[o].keyframe].variable;
+            if (a == -1) continue;
+            q -= observations[o].lin.W.transpose() * delta_u.segment<6>(6 * a);
+        }
+        delta_v[i] = Vinv[i] * q;
+    }
+}
+
+bool BASlidingWindow::addDelta()
+{
+    for (int i = 0; i < n; ++i)
+    {
+        int k     = variable_keyframes[i];
+        oldx_u[k] = x_u[k];
+        x_u[k]    = Sophus::se3_expd(delta_u.segment<6>(6 * i)) * x_u[k];
+    }
+    for (int i = 0; i < m; ++i)
+    {
+        int p     = variable_points[i];
+        oldx_v[p] = x_v[p];
+        x_v[p] += delta_v[i];
+    }
+    return true;
+}
+
+void BASlidingWindow::revertDelta()
+{
+    for (int k : variable_keyframes) x_u[k] = oldx_u[k];
+    for (int p : variable_points) x_v[p] = oldx_v[p];
+}
+
+double BASlidingWindow::computeCost()
+{
+    double chi2 = 0;
+#pragma omp parallel for num_threads(baOptions.helper_threads) reduction(+ : chi2)
+    for (int i = 0; i < (int)active_observations.size(); ++i)
+    {
+        auto& obs = observations[active_observations[i]];
+        chi2 += linearize(obs, x_u[obs.keyframe], x_v[obs.point], nullptr);
+    }
+
+    AlignedVector<SE3> x;
+    for (int image : prior.images) x.push_back(x_u[keyframe_map[image]]);
+    chi2 += evaluatePrior(x, nullptr);
+    return chi2;
+}
+
+void BASlidingWindow::finalize()
+{
+    Scene& scene = *_scene;
+    for (int k : variable_keyframes) scene.images[keyframes_[k].image].se3 = x_u[k];
+    for (int p : variable_points) scene.worldPoints[points[p].wp].p = x_v[p];
+}
+
+}  // namespace Saiga
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+
+#pragma once
+#include "saiga/vision/ba/BABase.h"
+#include "saiga/vision/scene/Scene.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Saiga
+{
+/**
+ * Sliding window bundle adjustment with a marginalization prior.
+ *
+ * BARec analyzes the complete scene in every init(). In an online SLAM system the cost of a local BA therefore grows
+ * with the map. This class keeps a window of keyframes and the structure of their observations between the solves.
+ * addKeyframe(), removeKeyframe() and removePoint() only touch the observations of the given keyframe or point.
+ * All world points observed by a window keyframe are optimized.
+ *
+ * marginalizeKeyframe() removes a keyframe together with all world points it observes. The linearized cost terms of
+ * these variables are reduced with the Schur complement to a dense prior on the remaining keyframes. If the
+ * keyframes move, the prior is updated with a first order approximation. Observations of marginalized world points
+ * are ignored by later addKeyframe() calls.
+ *
+ * The reduced camera system has the size of the window and is solved with a dense LDLT. Images with constant=true
+ * are not optimized.
+ *
+ * Usage:
+ *   BASlidingWindow ba;
+ *   ba.create(scene);
+ *   // for every new keyframe
+ *   ba.addKeyframe(image_id);
+ *   if (ba.keyframes().size() > 10) ba.marginalizeKeyframe(ba.keyframes().front());
+ *   ba.initAndSolve();
+ */
+class SAIGA_VISION_API BASlidingWindow : public BABase, public LMOptimizer
+{
+   public:
+    using T     = double;
+    using ADiag = Eigen::Matrix<T, 6, 6>;
+    using BDiag = Eigen::Matrix<T, 3, 3>;
+    using WElem = Eigen::Matrix<T, 6, 3>;
+    using ARes  = Eigen::Matrix<T, 6, 1>;
+    using BRes  = Eigen::Matrix<T, 3, 1>;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    BASlidingWindow() : BABase("Sliding Window BA") {}
+    virtual ~BASlidingWindow() {}
+
+    // Clears the window and the prior.
+    virtual void create(Scene& scene) override;
+
+    void addKeyframe(int image_id);
+
+    // The observations of this keyframe are dropped without a prior.
+    void removeKeyframe(int image_id);
+
+    // Removes the keyframe and all world points observed by it. Their information is kept in the prior.
+    void marginalizeKeyframe(int image_id);
+
+    // Removes the world point and all of its observations, for example after an outlier test.
+    void removePoint(int world_point_id);
+
+    // Image ids in insertion order
+    const std::vector<int>& keyframes() const { return window; }
+    const std::vector<int>& priorKeyframes() const { return prior.images; }
+    int numPoints() const { return point_map.size(); }
+    int numObservations() const { return observations.size() - free_observations.size(); }
+
+   private:
+    Scene* _scene = nullptr;
+
+    // The blocks of J^T J and -J^T r of one observation
+    struct Linearization
+    {
+        ADiag U;
+        WElem W;
+        BDiag V;
+        ARes bu;
+        BRes bv;
+    };
+
+    struct Observation
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        // Slots in 'keyframes_' and 'points'. -1 for unused observation slots.
+        int keyframe = -1;
+        int point    = -1;
+        // Index into scene.images[].stereoPoints
+        int image_point = -1;
+        Linearization lin;
+    };
+
+    struct Keyframe
+    {
+        int image = -1;
+        std::vector<int> observations;
+        // Index into the reduced camera system. -1 for constant images. Set in init().
+        int variable = -1;
+    };
+
+    struct Point
+    {
+        int wp = -1;
+        std::vector<int> observations;
+        // -1 for constant world points. Set in init().
+        int variable = -1;
+    };
+
+    // E(dx) = c - 2 * b^T * dx + dx^T * H * dx
+    // with dx_i = log(x_i * x0_i^-1) for all prior images i.
+    struct Prior
+    {
+        std::vector<int> images;
+        AlignedVector<SE3> x0;
+        Eigen::MatrixXd H;
+        Eigen::VectorXd b;
+        double c = 0;
+    };
+
+    // ============== Persistent structure ==============
+    std::vector<int> window;
+    std::vector<Keyframe> keyframes_;
+    std::vector<Point> points;
+    AlignedVector<Observation> observations;
+    std::vector<int> free_keyframes, free_points, free_observations;
+    std::unordered_map<int, int> keyframe_map, point_map;
+    std::unordered_set<int> marginalized_points;
+    Prior prior;
+
+    // ============== Per solve ==============
+    int n = 0, m = 0;
+    std::vector<int> active_observations;
+    std::vector<int> variable_keyframes, variable_points;
+    AlignedVector<SE3> x_u, oldx_u;
+    AlignedVector<Vec3> x_v, oldx_v;
+
+    AlignedVector<ADiag> U;
+    AlignedVector<ARes> bu;
+    AlignedVector<BDiag> V, Vinv;
+    AlignedVector<BRes> bv, delta_v;
+    Eigen::MatrixXd S;
+    Eigen::VectorXd rhs, delta_u;
+
+    // ============== LM Functions ==============
+
+    virtual void init() override;
+    virtual double computeQuadraticForm() override;
+    virtual void addLambda(double lambda) override;
+    virtual bool addDelta() override;
+    virtual void revertDelta() override;
+    virtual void solveLinearSystem() override;
+    virtual double computeCost() override;
+    virtual void finalize() override;
+
+    // Robust cost of one observation. The blocks are only computed if lin != nullptr.
+    double linearize(const Observation& obs, const SE3& pose, const Vec3& point, Linearization* lin) const;
+
+    // Evaluates the prior at the poses 'x'. b_current = -gradient/2 at x.
+    double evaluatePrior(const AlignedVector<SE3>& x, Eigen::VectorXd* b_current) const;
+
+    void removeObservation(int obs);
+};
+
+
+}  // namespace Saiga
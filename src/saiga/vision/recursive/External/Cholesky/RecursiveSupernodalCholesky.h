@@ -0,0 +1,586 @@
+/**
+ * This file is part of the Eigen Recursive Matrix Extension (ERME).
+ *
+ * Copyright (c) 2019 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "../Core.h"
+#include "Eigen/OrderingMethods"
+
+#include <algorithm>
+#include <vector>
+
+namespace Eigen::Recursive
+{
+/**
+ * Supernodal Cholesky factorization (L * D * L^T) of a sparse symmetric block matrix.
+ * Like RecursiveSimplicialLDLT, no pivoting is done. The matrix must be positive definite or at least have non zero
+ * pivots in the computed ordering.
+ *
+ * The matrix is a sparse matrix of MatrixScalar<Block> with square fixed size blocks. For example the reduced camera
+ * system of BA (6x6) or the PGO system (6x6 or 7x7). Only the triangle UpLo of the input is read.
+ *
+ * analyzePattern()
+ *   - AMD ordering of the block graph
+ *   - Elimination tree, postorder and the block structure of L
+ *   - Relaxed supernodes: Consecutive columns with (almost) the same structure are stored as one dense column major
+ *     panel.
+ *
+ * factorize()
+ *   - Left-looking supernodal factorization with dense Eigen kernels.
+ *   - All supernodes on the same level of the supernodal elimination tree are independent and factorized in parallel
+ *     with num_threads threads. The result does not depend on the number of threads.
+ *
+ * The symbolic analysis is cached. factorize() repeats it only if the sparsity pattern of A has changed.
+ * Therefore, the typical usage in a LM solver is to call factorize() + solve() in every iteration.
+ */
+template <typename _MatrixType, int _UpLo = Eigen::Upper>
+class RecursiveSupernodalLDLT
+{
+   public:
+    using MatrixType = _MatrixType;
+    using BlockType  = typename MatrixType::Scalar::M;
+    using Scalar     = typename BlockType::Scalar;
+
+    static constexpr int UpLo       = _UpLo;
+    static constexpr int block_size = BlockType::RowsAtCompileTime;
+    static_assert(BlockType::RowsAtCompileTime == BlockType::ColsAtCompileTime, "Only square blocks are supported.");
+
+    using DenseMatrix = Eigen::Matrix<Scalar, -1, -1>;
+    using DenseVector = Eigen::Matrix<Scalar, -1, 1>;
+    using PanelMap    = Eigen::Map<DenseMatrix>;
+
+    void compute(const MatrixType& A, int num_threads = 1)
+    {
+        analyzePattern(A);
+        factorize(A, num_threads);
+    }
+
+    void analyzePattern(const MatrixType& A);
+    void factorize(const MatrixType& A, int num_threads = 1);
+
+    // VectorType is a block vector, for example Eigen::Matrix<MatrixScalar<Eigen::Vector<double,6>>,-1,1>
+    template <typename VectorType>
+    VectorType solve(const VectorType& b) const;
+
+    ComputationInfo info() const { return m_info; }
+
+    int numSupernodes() const { return sn_first.size(); }
+    int numLevels() const { return levels.size(); }
+    // Number of scalar non zeros in the lower triangle of L (including the upper part of the diagonal blocks)
+    size_t nonZerosL() const { return values.size(); }
+
+   private:
+    struct Entry
+    {
+        // Offset into 'values' or -1 if the element is in the wrong triangle
+        int64_t offset;
+        int ld;
+        bool transpose;
+    };
+
+    struct Update
+    {
+        // Supernode k updates supernode s. The rows of k starting at 'row' are in s or below.
+        int k;
+        int row;
+    };
+
+    int n = 0;
+    ComputationInfo m_info = Success;
+    bool analyzed          = false;
+
+    // The pattern of A in iteration order. Used to detect a change in the sparsity pattern.
+    std::vector<int> pattern_outer, pattern_inner;
+    std::vector<Entry> entries;
+
+    // order[new] = old
+    std::vector<int> order;
+
+    // Supernode s contains the block columns [sn_first[s], sn_first[s] + sn_cols[s]).
+    // The block rows are sn_rows[sn_row_offset[s]], ... including the diagonal block.
+    std::vector<int> sn_first, sn_cols, sn_row_offset, sn_rows;
+    std::vector<int64_t> sn_value_offset;
+    std::vector<int> col_to_sn;
+    std::vector<std::vector<Update>> updates;
+    std::vector<std::vector<int>> levels;
+
+    std::vector<Scalar> values;
+    DenseVector diag;
+
+    int numRows(int s) const { return sn_row_offset[s + 1] - sn_row_offset[s]; }
+    const int* rows(int s) const { return sn_rows.data() + sn_row_offset[s]; }
+    PanelMap panel(int s)
+    {
+        return PanelMap(values.data() + sn_value_offset[s], numRows(s) * block_size, sn_cols[s] * block_size);
+    }
+    Eigen::Map<const DenseMatrix> panel(int s) const
+    {
+        return Eigen::Map<const DenseMatrix>(values.data() + sn_value_offset[s], numRows(s) * block_size,
+                                             sn_cols[s] * block_size);
+    }
+
+    bool samePattern(const MatrixType& A) const;
+    bool factorizeSupernode(int s, std::vector<int>& relative, DenseMatrix& tmp, DenseMatrix& scaled);
+};
+
+
+template <typename _MatrixType, int _UpLo>
+bool RecursiveSupernodalLDLT<_MatrixType, _UpLo>::samePattern(const MatrixType& A) const
+{
+    if (!analyzed || A.rows() != n || (int)pattern_outer.size() != A.outerSize() + 1) return false;
+    int e = 0;
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        if (pattern_outer[k] != e) return false;
+        for (typename MatrixType::InnerIterator it(A, k); it; ++it, ++e)
+        {
+            if (e >= (int)pattern_inner.size() || pattern_inner[e] != it.index()) return false;
+        }
+    }
+    return pattern_outer.back() == e;
+}
+
+template <typename _MatrixType, int _UpLo>
+void RecursiveSupernodalLDLT<_MatrixType, _UpLo>::analyzePattern(const MatrixType& A)
+{
+    eigen_assert(A.rows() == A.cols());
+    n = A.rows();
+
+    // ==== Pattern of the triangle UpLo ====
+    pattern_outer.clear();
+    pattern_inner.clear();
+    std::vector<std::pair<int, int>> elements;
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        pattern_outer.push_back(pattern_inner.size());
+        for (typename MatrixType::InnerIterator it(A, k); it; ++it)
+        {
+            pattern_inner.push_back(it.index());
+            elements.emplace_back(it.row(), it.col());
+        }
+    }
+    pattern_outer.push_back(pattern_inner.size());
+
+    auto inTriangle = [](int r, int c) { return (UpLo & Eigen::Upper) == Eigen::Upper ? r <= c : r >= c; };
+
+    // ==== AMD on the symmetric block graph ====
+    {
+        std::vector<Eigen::Triplet<double>> trips;
+        for (int i = 0; i < n; ++i) trips.emplace_back(i, i, 1);
+        for (auto [r, c] : elements)
+        {
+            if (r == c || !inTriangle(r, c)) continue;
+            trips.emplace_back(r, c, 1);
+            trips.emplace_back(c, r, 1);
+        }
+        Eigen::SparseMatrix<double, Eigen::ColMajor, int> graph(n, n);
+        graph.setFromTriplets(trips.begin(), trips.end());
+
+        Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> perm;
+        Eigen::AMDOrdering<int> amd;
+        amd(graph, perm);
+        order.assign(perm.indices().data(), perm.indices().data() + n);
+    }
+
+    // Lower block structure of the permuted matrix (rows > column) and the elimination tree.
+    std::vector<std::vector<int>> lower(n);
+    std::vector<int> parent(n);
+    auto buildStructure = [&]() {
+        std::vector<int> position(n);
+        for (int i = 0; i < n; ++i) position[order[i]] = i;
+
+        for (auto& l : lower) l.clear();
+        std::vector<std::vector<int>> upper(n);
+        for (auto [r, c] : elements)
+        {
+            if (r == c || !inTriangle(r, c)) continue;
+            int a = position[r], b = position[c];
+            lower[std::min(a, b)].push_back(std::max(a, b));
+            upper[std::max(a, b)].push_back(std::min(a, b));
+        }
+        for (auto& l : lower)
+        {
+            std::sort(l.begin(), l.end());
+            l.erase(std::unique(l.begin(), l.end()), l.end());
+        }
+
+        // Liu's algorithm with path compression
+        std::vector<int> ancestor(n, -1);
+        for (int k = 0; k < n; ++k)
+        {
+            parent[k] = -1;
+            for (int i : upper[k])
+            {
+                while (i != -1 && i < k)
+                {
+                    int next    = ancestor[i];
+                    ancestor[i] = k;
+                    if (next == -1) parent[i] = k;
+                    i = next;
+                }
+            }
+        }
+    };
+    buildStructure();
+
+    // ==== Postorder ====
+    // Afterwards, the nodes of each subtree are consecutive and the children of a node are numbered before it.
+    {
+        std::vector<int> head(n, -1), next(n, -1);
+        for (int k = n - 1; k >= 0; --k)
+        {
+            if (parent[k] == -1) continue;
+            next[k]         = head[parent[k]];
+            head[parent[k]] = k;
+        }
+
+        std::vector<int> post;
+        post.reserve(n);
+        std::vector<int> stack;
+        for (int root = 0; root < n; ++root)
+        {
+            if (parent[root] != -1) continue;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                int k = stack.back();
+                if (head[k] != -1)
+                {
+                    // Descend into the next child
+                    int c   = head[k];
+                    head[k] = next[c];
+                    stack.push_back(c);
+                }
+                else
+                {
+                    post.push_back(k);
+                    stack.pop_back();
+                }
+            }
+        }
+
+        std::vector<int> new_order(n);
+        for (int i = 0; i < n; ++i) new_order[i] = order[post[i]];
+        order = new_order;
+    }
+    buildStructure();
+
+    // ==== Block structure of L ====
+    // struct(L_k) = struct(A_k) + struct(L_c) of all children c (excluding k)
+    std::vector<std::vector<int>> structure(n);
+    {
+        std::vector<std::vector<int>> children(n);
+        for (int k = 0; k < n; ++k)
+        {
+            if (parent[k] != -1) children[parent[k]].push_back(k);
+        }
+        std::vector<int> tmp;
+        for (int k = 0; k < n; ++k)
+        {
+            auto& s = structure[k];
+            s       = lower[k];
+            for (int c : children[k])
+            {
+                tmp.clear();
+                // The first element of a child structure is always k
+                std::set_union(s.begin(), s.end(), structure[c].begin() + 1, structure[c].end(),
+                               std::back_inserter(tmp));
+                s.swap(tmp);
+            }
+        }
+    }
+
+    // ==== Relaxed supernodes ====
+    // Column k is appended to the current supernode if it is the parent of the previous column. The structure of
+    // the previous columns is then a subset of the structure of k. The explicitly stored zeros are limited similar to
+    // the relaxed amalgamation of CHOLMOD.
+    sn_first.clear();
+    sn_cols.clear();
+    col_to_sn.resize(n);
+    int64_t sn_nonzeros = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        int64_t col_nonzeros = 1 + structure[k].size();
+        bool merge           = false;
+        if (k > 0 && parent[k - 1] == k)
+        {
+            int64_t c        = sn_cols.back() + 1;
+            int64_t r        = c + structure[k].size();
+            int64_t stored   = c * r - c * (c - 1) / 2;
+            double zeros     = double(stored - sn_nonzeros - col_nonzeros) / stored;
+            double max_zeros = c <= 4 ? 1 : c <= 16 ? 0.8 : c <= 48 ? 0.1 : 0.05;
+            merge            = zeros <= max_zeros;
+        }
+        if (merge)
+        {
+            sn_cols.back()++;
+            sn_nonzeros += col_nonzeros;
+        }
+        else
+        {
+            sn_first.push_back(k);
+            sn_cols.push_back(1);
+            sn_nonzeros = col_nonzeros;
+        }
+        col_to_sn[k] = sn_first.size() - 1;
+    }
+
+    int num_sn = sn_first.size();
+    sn_row_offset.resize(num_sn + 1);
+    sn_value_offset.resize(num_sn + 1);
+    sn_rows.clear();
+    sn_row_offset[0]   = 0;
+    sn_value_offset[0] = 0;
+    for (int s = 0; s < num_sn; ++s)
+    {
+        int last = sn_first[s] + sn_cols[s] - 1;
+        for (int k = sn_first[s]; k <= last; ++k) sn_rows.push_back(k);
+        sn_rows.insert(sn_rows.end(), structure[last].begin(), structure[last].end());
+        sn_row_offset[s + 1] = sn_rows.size();
+        sn_value_offset[s + 1] =
+            sn_value_offset[s] + int64_t(numRows(s)) * block_size * int64_t(sn_cols[s]) * block_size;
+    }
+    values.resize(sn_value_offset[num_sn]);
+    diag.resize(n * block_size);
+
+    // ==== Update lists and levels of the supernodal tree ====
+    updates.clear();
+    updates.resize(num_sn);
+    std::vector<int> level(num_sn, 0);
+    levels.clear();
+    for (int s = 0; s < num_sn; ++s)
+    {
+        const int* r = rows(s);
+        int target   = -1;
+        for (int i = sn_cols[s]; i < numRows(s); ++i)
+        {
+            int t = col_to_sn[r[i]];
+            if (t != target)
+            {
+                updates[t].push_back({s, i});
+                target = t;
+            }
+        }
+
+        // Children are numbered before their parent
+        if (numRows(s) > sn_cols[s])
+        {
+            int p    = col_to_sn[r[sn_cols[s]]];
+            level[p] = std::max(level[p], level[s] + 1);
+        }
+        if (level[s] >= (int)levels.size()) levels.resize(level[s] + 1);
+        levels[level[s]].push_back(s);
+    }
+
+    // ==== Position of the elements of A in the panels ====
+    std::vector<int> position(n);
+    for (int i = 0; i < n; ++i) position[order[i]] = i;
+    entries.resize(elements.size());
+    for (size_t e = 0; e < elements.size(); ++e)
+    {
+        auto [r, c] = elements[e];
+        if (!inTriangle(r, c))
+        {
+            entries[e] = {-1, 0, false};
+            continue;
+        }
+        int a = position[r], b = position[c];
+        int row = std::max(a, b), col = std::min(a, b);
+        int s        = col_to_sn[col];
+        const int* R = rows(s);
+        int p        = std::lower_bound(R, R + numRows(s), row) - R;
+        int ld       = numRows(s) * block_size;
+        entries[e]   = {sn_value_offset[s] + int64_t(col - sn_first[s]) * block_size * ld + p * block_size, ld, a < b};
+    }
+
+    analyzed = true;
+}
+
+template <typename _MatrixType, int _UpLo>
+void RecursiveSupernodalLDLT<_MatrixType, _UpLo>::factorize(const MatrixType& A, int num_threads)
+{
+    if (!samePattern(A)) analyzePattern(A);
+
+    std::fill(values.begin(), values.end(), Scalar(0));
+
+    int e = 0;
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        for (typename MatrixType::InnerIterator it(A, k); it; ++it, ++e)
+        {
+            auto& entry = entries[e];
+            if (entry.offset < 0) continue;
+            Eigen::Map<Eigen::Matrix<Scalar, block_size, block_size>, 0, Eigen::OuterStride<>> dst(
+                values.data() + entry.offset, Eigen::OuterStride<>(entry.ld));
+            if (entry.transpose)
+                dst = it.value().get().transpose();
+            else
+                dst = it.value().get();
+        }
+    }
+
+    // The supernodes of one level only depend on lower levels. The implicit barrier of 'omp for' separates the levels.
+    bool success = true;
+#pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<int> relative(n);
+        DenseMatrix tmp, scaled;
+        for (auto& level : levels)
+        {
+#pragma omp for schedule(dynamic) reduction(&& : success)
+            for (int i = 0; i < (int)level.size(); ++i)
+            {
+                success = factorizeSupernode(level[i], relative, tmp, scaled) && success;
+            }
+        }
+    }
+    m_info = success ? Success : NumericalIssue;
+}
+
+template <typename _MatrixType, int _UpLo>
+bool RecursiveSupernodalLDLT<_MatrixType, _UpLo>::factorizeSupernode(int s, std::vector<int>& relative,
+                                                                     DenseMatrix& tmp, DenseMatrix& scaled)
+{
+    constexpr int B = block_size;
+    auto L          = panel(s);
+    const int* R    = rows(s);
+    int first       = sn_first[s];
+    int cols        = sn_cols[s];
+    for (int i = 0; i < numRows(s); ++i) relative[R[i]] = i;
+
+    // Left-looking: Subtract the contribution of all descendants
+    for (auto& u : updates[s])
+    {
+        auto Lk          = panel(u.k);
+        const int* Rk    = rows(u.k);
+        int rows_k       = numRows(u.k);
+        int in_s         = u.row;
+        int update_rows  = rows_k - u.row;
+        int update_cols  = 0;
+        while (in_s < rows_k && Rk[in_s] < first + cols)
+        {
+            ++in_s;
+            ++update_cols;
+        }
+
+        // tmp = L_below * D_k * L_top^T
+        auto below    = Lk.middleRows(u.row * B, update_rows * B);
+        scaled        = below.topRows(update_cols * B) * diag.segment(sn_first[u.k] * B, Lk.cols()).asDiagonal();
+        tmp.noalias() = below * scaled.transpose();
+
+        for (int j = 0; j < update_cols; ++j)
+        {
+            int col = Rk[u.row + j] - first;
+            for (int i = j; i < update_rows; ++i)
+            {
+                int row = relative[Rk[u.row + i]];
+                L.block(row * B, col * B, B, B) -= tmp.block(i * B, j * B, B, B);
+            }
+        }
+    }
+
+    // Blocked right-looking LDLT of the panel without pivoting
+    //   L11 * D * L11^T = A11
+    //   L21 = A21 * L11^-T * D^-1
+    constexpr int nb = 64;
+    int m            = cols * B;
+    int total_rows   = L.rows();
+    auto D           = diag.segment(first * B, m);
+    tmp.resize(m, 1);
+    for (int j0 = 0; j0 < m; j0 += nb)
+    {
+        int jb = std::min(nb, m - j0);
+        int j1 = j0 + jb;
+
+        // Unblocked factorization of the columns [j0, j1) including all rows below
+        for (int j = j0; j < j1; ++j)
+        {
+            auto lj = L.row(j).segment(j0, j - j0);
+            auto w  = tmp.col(0).head(j - j0);
+            w       = lj.transpose().cwiseProduct(D.segment(j0, j - j0));
+            D(j)    = L(j, j) - lj.dot(w);
+            if (D(j) == Scalar(0) || !std::isfinite(D(j))) return false;
+
+            int below = total_rows - j - 1;
+            L.col(j).tail(below) -= L.block(j + 1, j0, below, j - j0) * w;
+            L.col(j).tail(below) /= D(j);
+            L(j, j) = 1;
+        }
+
+        if (j1 == m) break;
+
+        // Update of the remaining columns
+        //   A22 -= L21 * D * L21^T
+        scaled      = L.block(j1, j0, m - j1, jb) * D.segment(j0, jb).asDiagonal();
+        auto L21    = L.block(j1, j0, m - j1, jb);
+        auto L31    = L.block(m, j0, total_rows - m, jb);
+        L.block(j1, j1, m - j1, m - j1).template triangularView<Eigen::Lower>() -= L21 * scaled.transpose();
+        L.block(m, j1, total_rows - m, m - j1).noalias() -= L31 * scaled.transpose();
+    }
+    return true;
+}
+
+template <typename _MatrixType, int _UpLo>
+template <typename VectorType>
+VectorType RecursiveSupernodalLDLT<_MatrixType, _UpLo>::solve(const VectorType& b) const
+{
+    constexpr int B = block_size;
+    eigen_assert(b.rows() == n);
+
+    DenseVector y(n * B);
+    for (int i = 0; i < n; ++i) y.segment(i * B, B) = b(order[i]).get();
+
+    DenseVector tmp;
+
+    // L * z = y
+    for (int s = 0; s < (int)sn_first.size(); ++s)
+    {
+        auto L         = panel(s);
+        const int* R   = rows(s);
+        int cols       = sn_cols[s];
+        auto ys        = y.segment(sn_first[s] * B, cols * B);
+        int below_rows = numRows(s) - cols;
+
+        L.topRows(cols * B).template triangularView<Eigen::UnitLower>().solveInPlace(ys);
+        if (below_rows == 0) continue;
+        tmp.noalias() = L.bottomRows(below_rows * B) * ys;
+        for (int i = 0; i < below_rows; ++i)
+        {
+            y.segment(R[cols + i] * B, B) -= tmp.segment(i * B, B);
+        }
+    }
+
+    y = y.cwiseQuotient(diag);
+
+    // L^T * x = z
+    for (int s = (int)sn_first.size() - 1; s >= 0; --s)
+    {
+        auto L         = panel(s);
+        const int* R   = rows(s);
+        int cols       = sn_cols[s];
+        auto ys        = y.segment(sn_first[s] * B, cols * B);
+        int below_rows = numRows(s) - cols;
+
+        if (below_rows > 0)
+        {
+            tmp.resize(below_rows * B);
+            for (int i = 0; i < below_rows; ++i)
+            {
+                tmp.segment(i * B, B) = y.segment(R[cols + i] * B, B);
+            }
+            ys.noalias() -= L.bottomRows(below_rows * B).transpose() * tmp;
+        }
+        L.topRows(cols * B).transpose().template triangularView<Eigen::UnitUpper>().solveInPlace(ys);
+    }
+
+    VectorType x(n);
+    for (int i = 0; i < n; ++i) x(order[i]).get() = y.segment(i * B, B);
+    return x;
+}
+
+}  // namespace Eigen::Recursive
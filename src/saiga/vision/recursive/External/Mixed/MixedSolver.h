@@ -31,6 +31,13 @@ struct LinearSolverOptions
     // -> Maybe in the future when I have implemented a supernodal recursive factorization
     //      I switch it back to false ;)
     bool cholmod = true;
+
+    // Direct solvers without cholmod: Use the supernodal block LDLT instead of the simplicial LDLT.
+    bool supernodal = true;
+
+    // Number of threads of the supernodal factorization.
+    // (The *_omp solvers instead use the threads of the surrounding parallel region.)
+    int numThreads = 1;
 };
 
 /**
@@ -60,6 +60,7 @@ class MixedSymmetricRecursiveSolver<
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
     using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using Supernodal   = RecursiveSupernodalLDLT<S1Type, Eigen::Upper>;
     using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
 
 
@@ -87,6 +88,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            supernodal    = nullptr;
         }
         else
         {
@@ -150,17 +152,27 @@ class MixedSymmetricRecursiveSolver<
 
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            if (solverOptions.supernodal)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // The ordering and symbolic factorization is computed in the first call and then reused.
+                if (!supernodal) supernodal = std::make_unique<Supernodal>();
+                supernodal->factorize(S1, solverOptions.numThreads);
+                da = supernodal->solve(ej);
             }
             else
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
+                da = ldlt->solve(ej);
             }
-            da = ldlt->solve(ej);
         }
         else
         {
@@ -216,6 +228,7 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<Supernodal> supernodal;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
@@ -269,6 +282,7 @@ class MixedSymmetricRecursiveSolver<
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
     using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using Supernodal   = RecursiveSupernodalLDLT<S1Type, Eigen::Upper>;
     using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
 
 
@@ -297,6 +311,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            supernodal    = nullptr;
         }
         else
         {
@@ -363,17 +378,27 @@ class MixedSymmetricRecursiveSolver<
 
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            if (solverOptions.supernodal)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // The ordering and symbolic factorization is computed in the first call and then reused.
+                if (!supernodal) supernodal = std::make_unique<Supernodal>();
+                supernodal->factorize(S1, solverOptions.numThreads);
+                da = supernodal->solve(ej);
             }
             else
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
+                da = ldlt->solve(ej);
             }
-            da = ldlt->solve(ej);
         }
         else
         {
@@ -563,6 +588,7 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<Supernodal> supernodal;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
@@ -27,8 +27,9 @@ template <typename T, int _Options, typename XType>
 class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>, XType>
 {
    public:
-    using AType = typename Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>;
-    using LDLT  = Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper>;
+    using AType      = typename Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>;
+    using LDLT       = Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper>;
+    using Supernodal = RecursiveSupernodalLDLT<AType, Eigen::Upper>;
 
     using ExpandedType = Eigen::SparseMatrix<typename T::Scalar, Eigen::RowMajor>;
 #ifdef SOLVER_USE_CHOLMOD
@@ -40,7 +41,8 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
 
     void Init()
     {
-        ldlt = nullptr;
+        ldlt       = nullptr;
+        supernodal = nullptr;
 #ifdef SOLVER_USE_CHOLMOD
         cholmodldlt = nullptr;
 #endif
@@ -80,6 +82,13 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
             }
             else
 #endif
+            if (solverOptions.supernodal)
+            {
+                if (!supernodal) supernodal = std::make_unique<Supernodal>();
+                supernodal->factorize(A, solverOptions.numThreads);
+                x = supernodal->solve(b);
+            }
+            else
             {
                 if (!ldlt)
                 {
@@ -154,6 +163,7 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
 
    private:
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<Supernodal> supernodal;
     Eigen::PermutationMatrix<-1> permFull;
     std::vector<int> orderingFull;
 #ifdef SOLVER_USE_CHOLMOD
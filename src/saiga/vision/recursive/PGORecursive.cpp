@@ -88,6 +88,12 @@ void PGORec::init()
 
     solver.Init();
 
+    // Edges of the same color write to disjoint blocks of S and b
+    edgeChi2.resize(scene.edges.size());
+    edgeColors = greedyEdgeColoring(n, scene.edges.size(), [&](int k) {
+        return std::make_pair(scene.edges[k].from, scene.edges[k].to);
+    });
+
     // Create a sparsity histogram
     if (false && optimizationOptions.debugOutput)
     {
@@ -108,80 +114,55 @@ void PGORec::init()
 double PGORec::computeQuadraticForm()
 {
     auto& scene = *_scene;
-
-
-    b.setZero();
-
-    // set diagonal elements of S to zero
-    for (int i = 0; i < S.rows(); ++i)
-    {
-        S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
-    }
-
     double chi2 = 0;
-    //#pragma omp parallel
 
-    //        auto b2 = b;
-    AlignedVector<PGOBlock> diagBlocks(n);
-    for (int i = 0; i < n; ++i)
-    {
-        diagBlocks[i].setZero();
-    }
-    double chi2local = 0;
-    //#pragma omp for
-    for (size_t k = 0; k < scene.edges.size(); ++k)
+#pragma omp parallel num_threads(optimizationOptions.numThreads)
     {
-        auto& e       = scene.edges[k];
-        auto& offsets = edgeOffsets[k];
-        int i         = e.from;
-        int j         = e.to;
-
-        auto& target_ij = S.valuePtr()[offsets].get();
-        //            auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
-        //            auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
-        auto& target_ii = diagBlocks[i];
-        auto& target_jj = diagBlocks[j];
-        auto& target_ir = b(i).get();
-        auto& target_jr = b(j).get();
-
+        // set diagonal elements of S to zero
+#pragma omp for
+        for (int i = 0; i < n; ++i)
         {
-            Eigen::Matrix<double, 6, 6> Jrowi, Jrowj;
-            Vec6 res = relPoseError(e.GetSE3(), x_u[i], x_u[j], e.weight, e.weight, &Jrowi, &Jrowj);
-
-            if (scene.vertices[i].constant) Jrowi.setZero();
-            if (scene.vertices[j].constant) Jrowj.setZero();
-
-            auto c = res.squaredNorm();
-
-            // JtJ
-            target_ij = Jrowi.transpose() * Jrowj;
-
-            target_ii += Jrowi.transpose() * Jrowi;
-            target_jj += Jrowj.transpose() * Jrowj;
-
-            // Jtb
-            target_ir -= Jrowi.transpose() * res;
-            target_jr -= Jrowj.transpose() * res;
-
-
-            chi2local += c;
+            S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
+            b(i).get().setZero();
         }
-    }
 
-    //#pragma omp atomic
-    chi2 += chi2local;
-    //#pragma omp critical
-    {
-        //            b += b2;
-    }
-
-    for (int i = 0; i < n; ++i)
-    {
-        //#pragma omp critical
-        S.valuePtr()[S.outerIndexPtr()[i]].get() += diagBlocks[i];
+        for (auto& color : edgeColors)
+        {
+#pragma omp for
+            for (int c = 0; c < (int)color.size(); ++c)
+            {
+                int k   = color[c];
+                auto& e = scene.edges[k];
+                int i   = e.from;
+                int j   = e.to;
+
+                auto& target_ij = S.valuePtr()[edgeOffsets[k]].get();
+                auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
+                auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
+                auto& target_ir = b(i).get();
+                auto& target_jr = b(j).get();
+
+                Eigen::Matrix<double, 6, 6> Jrowi, Jrowj;
+                Vec6 res = relPoseError(e.GetSE3(), x_u[i], x_u[j], e.weight, e.weight, &Jrowi, &Jrowj);
+
+                if (scene.vertices[i].constant) Jrowi.setZero();
+                if (scene.vertices[j].constant) Jrowj.setZero();
+
+                // JtJ
+                target_ij = Jrowi.transpose() * Jrowj;
+                target_ii += Jrowi.transpose() * Jrowi;
+                target_jj += Jrowj.transpose() * Jrowj;
+
+                // Jtb
+                target_ir -= Jrowi.transpose() * res;
+                target_jr -= Jrowj.transpose() * res;
+
+                edgeChi2[k] = res.squaredNorm();
+            }
+        }
     }
 
-
+    for (double c : edgeChi2) chi2 += c;
 
     //    if (optimizationOptions.debugOutput) std::cout << "chi2 " << chi2 << std::endl;
     return chi2;
@@ -196,29 +177,23 @@ double PGORec::computeCost()
     // using T          = BlockPGOScalar;
     //    using KernelType = Saiga::Kernel::PGO<double>;
 
-
-
-    double chi2 = 0;
-    for (size_t k = 0; k < scene.edges.size(); ++k)
+#pragma omp parallel for num_threads(optimizationOptions.numThreads)
+    for (int k = 0; k < (int)scene.edges.size(); ++k)
     {
         auto& e = scene.edges[k];
-        int i   = e.from;
-        int j   = e.to;
 
+        //            KernelType::PoseJacobiType Jrowi, Jrowj;
+        //            KernelType::ResidualType res;
+        //            KernelType::evaluateResidual(e.GetSE3(), x_u[i], x_u[j], res, e.weight);
 
-        {
-            //            KernelType::PoseJacobiType Jrowi, Jrowj;
-            //            KernelType::ResidualType res;
-            //            KernelType::evaluateResidual(e.GetSE3(), x_u[i], x_u[j], res, e.weight);
-
-            //  Eigen::Matrix<double, 6, 6> Ji, Jj;
+        //  Eigen::Matrix<double, 6, 6> Ji, Jj;
 
-            Vec6 res = relPoseError(e.GetSE3(), x_u[i], x_u[j], e.weight, e.weight);
-
-            auto c = res.squaredNorm();
-            chi2 += c;
-        }
+        Vec6 res    = relPoseError(e.GetSE3(), x_u[e.from], x_u[e.to], e.weight, e.weight);
+        edgeChi2[k] = res.squaredNorm();
     }
+
+    double chi2 = 0;
+    for (double c : edgeChi2) chi2 += c;
     return chi2;
 }
 
@@ -237,6 +212,7 @@ bool PGORec::addDelta()
     auto& scene = *_scene;
     oldx_u      = x_u;
 
+#pragma omp parallel for num_threads(optimizationOptions.numThreads)
     for (int i = 0; i < n; ++i)
     {
         if (scene.vertices[i].constant) continue;
@@ -266,6 +242,7 @@ void PGORec::solveLinearSystem()
     loptions.solverType = (optimizationOptions.solverType == OptimizationOptions::SolverType::Direct)
                               ? LinearSolverOptions::SolverType::Direct
                               : LinearSolverOptions::SolverType::Iterative;
+    loptions.numThreads = optimizationOptions.numThreads;
 
 
     solver.solve(S, delta_x, b, loptions);
@@ -50,6 +50,9 @@ class SAIGA_VISION_API PGORec : public PGOBase, public LMOptimizer
 
 
     std::vector<int> edgeOffsets;
+    std::vector<std::vector<int>> edgeColors;
+    // Squared error of every edge. Summed in edge order, so that chi2 does not depend on the number of threads.
+    std::vector<double> edgeChi2;
     PoseGraph* _scene;
 
     // ============== LM Functions ==============
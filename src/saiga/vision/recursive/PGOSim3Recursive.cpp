@@ -68,6 +68,7 @@ void PGOSim3Rec::init()
     }
 
     // Precompute the offset in the sparse matrix for every edge
+    edgeOffsets.clear();
     edgeOffsets.reserve(scene.edges.size());
     std::vector<int> localOffsets(n, 1);
     for (auto& e : scene.edges)
@@ -85,6 +86,12 @@ void PGOSim3Rec::init()
         edgeOffsets.emplace_back(offseti);
     }
 
+    // Edges of the same color write to disjoint blocks of S and b
+    edgeChi2.resize(scene.edges.size());
+    edgeColors = greedyEdgeColoring(n, scene.edges.size(), [&](int k) {
+        return std::make_pair(scene.edges[k].from, scene.edges[k].to);
+    });
+
     // Create a sparsity histogram
     if (false && optimizationOptions.debugOutput)
     {
@@ -111,88 +118,55 @@ double PGOSim3Rec::computeQuadraticForm()
     // using T          = BlockPGOScalar;
     //    using KernelType = Saiga::Kernel::PGOSim3<double>;
 
-    b.setZero();
-
-    // set diagonal elements of S to zero
-    for (int i = 0; i < n; ++i)
-    {
-        S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
-    }
-
     double chi2 = 0;
-    //#pragma omp parallel
 
-    //        auto b2 = b;
-    AlignedVector<PGOBlock> diagBlocks(n);
-    for (int i = 0; i < n; ++i)
+#pragma omp parallel num_threads(optimizationOptions.numThreads)
     {
-        diagBlocks[i].setZero();
-    }
-    double chi2local = 0;
-    //#pragma omp for
-    for (size_t k = 0; k < scene.edges.size(); ++k)
-    {
-        auto& e       = scene.edges[k];
-        auto& offsets = edgeOffsets[k];
-        int i         = e.from;
-        int j         = e.to;
-
-        auto& target_ij = S.valuePtr()[offsets].get();
-        //            auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
-        //            auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
-        auto& target_ii = diagBlocks[i];
-        auto& target_jj = diagBlocks[j];
-        auto& target_ir = b(i).get();
-        auto& target_jr = b(j).get();
-
+        // set diagonal elements of S to zero
+#pragma omp for
+        for (int i = 0; i < n; ++i)
         {
-            Eigen::Matrix<double, 7, 7> Jrowi, Jrowj;
-            Vec7 res = relPoseError(e.T_i_j, x_u[i], x_u[j], e.weight, e.weight, &Jrowi, &Jrowj);
+            S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
+            b(i).get().setZero();
+        }
 
-            if (scene.vertices[i].constant) Jrowi.setZero();
-            if (scene.vertices[j].constant) Jrowj.setZero();
+        for (auto& color : edgeColors)
+        {
+#pragma omp for
+            for (int c = 0; c < (int)color.size(); ++c)
+            {
+                int k   = color[c];
+                auto& e = scene.edges[k];
+                int i   = e.from;
+                int j   = e.to;
 
-            auto c = res.squaredNorm();
+                auto& target_ij = S.valuePtr()[edgeOffsets[k]].get();
+                auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
+                auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
+                auto& target_ir = b(i).get();
+                auto& target_jr = b(j).get();
 
-            // JtJ
-            target_ij = Jrowi.transpose() * Jrowj;
+                Eigen::Matrix<double, 7, 7> Jrowi, Jrowj;
+                Vec7 res = relPoseError(e.T_i_j, x_u[i], x_u[j], e.weight, e.weight, &Jrowi, &Jrowj);
 
-            auto ii = (Jrowi.transpose() * Jrowi).eval();
-            auto jj = (Jrowj.transpose() * Jrowj).eval();
-            //#pragma omp critical
-            {
-                target_ii += ii;
-                target_jj += jj;
-            }
-            auto ir = Jrowi.transpose() * res;
-            auto jr = Jrowj.transpose() * res;
-            //#pragma omp critical
-            {
-                // Jtb
-                target_ir -= ir;
-                target_jr -= jr;
-            }
+                if (scene.vertices[i].constant) Jrowi.setZero();
+                if (scene.vertices[j].constant) Jrowj.setZero();
 
+                // JtJ
+                target_ij = Jrowi.transpose() * Jrowj;
+                target_ii += Jrowi.transpose() * Jrowi;
+                target_jj += Jrowj.transpose() * Jrowj;
 
+                // Jtb
+                target_ir -= Jrowi.transpose() * res;
+                target_jr -= Jrowj.transpose() * res;
 
-            chi2local += c;
+                edgeChi2[k] = res.squaredNorm();
+            }
         }
     }
 
-    //#pragma omp atomic
-    chi2 += chi2local;
-    //#pragma omp critical
-    {
-        //            b += b2;
-    }
-
-    for (int i = 0; i < n; ++i)
-    {
-        //#pragma omp critical
-        S.valuePtr()[S.outerIndexPtr()[i]].get() += diagBlocks[i];
-    }
-
-
+    for (double c : edgeChi2) chi2 += c;
 
     //    if (optimizationOptions.debugOutput) std::cout << "chi2 " << chi2 << std::endl;
     return chi2;
@@ -203,22 +177,16 @@ double PGOSim3Rec::computeCost()
 {
     auto& scene = *_scene;
 
-
-    double chi2 = 0;
-    for (size_t k = 0; k < scene.edges.size(); ++k)
+#pragma omp parallel for num_threads(optimizationOptions.numThreads)
+    for (int k = 0; k < (int)scene.edges.size(); ++k)
     {
-        auto& e = scene.edges[k];
-        int i   = e.from;
-        int j   = e.to;
-
-
-        {
-            Vec7 res = relPoseError(e.T_i_j, x_u[i], x_u[j], e.weight, e.weight);
-
-            auto c = res.squaredNorm();
-            chi2 += c;
-        }
+        auto& e     = scene.edges[k];
+        Vec7 res    = relPoseError(e.T_i_j, x_u[e.from], x_u[e.to], e.weight, e.weight);
+        edgeChi2[k] = res.squaredNorm();
     }
+
+    double chi2 = 0;
+    for (double c : edgeChi2) chi2 += c;
     return chi2;
 }
 
@@ -237,11 +205,11 @@ bool PGOSim3Rec::addDelta()
     auto& scene = *_scene;
     oldx_u      = x_u;
 
+#pragma omp parallel for num_threads(optimizationOptions.numThreads)
     for (int i = 0; i < n; ++i)
     {
         if (scene.vertices[i].constant) continue;
         auto t = delta_x(i).get();
-
         if (scene.fixScale) t[6] = 0;
         x_u[i] = Sophus::dsim3_expd(t) * x_u[i];
     }
@@ -260,6 +228,7 @@ void PGOSim3Rec::solveLinearSystem()
     loptions.solverType = (optimizationOptions.solverType == OptimizationOptions::SolverType::Direct)
                               ? LinearSolverOptions::SolverType::Direct
                               : LinearSolverOptions::SolverType::Iterative;
+    loptions.numThreads = optimizationOptions.numThreads;
 
 
     solver.solve(S, delta_x, b, loptions);
@@ -72,6 +72,7 @@ void RecursiveArap::init()
     }
 
     // Precompute the offset in the sparse matrix for every edge
+    edgeOffsets.clear();
     edgeOffsets.reserve(scene.constraints.size());
     std::vector<int> localOffsets(n, 1);
     for (auto& e : scene.constraints)
@@ -89,6 +90,11 @@ void RecursiveArap::init()
         edgeOffsets.emplace_back(offseti);
     }
 
+    // Constraints of the same color write to disjoint blocks of S and b
+    edgeChi2.resize(scene.constraints.size());
+    targetChi2.resize(scene.target_indices.size());
+    edgeColors = greedyEdgeColoring(n, scene.constraints.size(), [&](int k) { return scene.constraints[k].ids; });
+
     // Create a sparsity histogram
     if (false && optimizationOptions.debugOutput)
     {
@@ -110,122 +116,129 @@ void RecursiveArap::init()
 double RecursiveArap::computeQuadraticForm()
 {
     auto& scene = *arap;
-
-
-    b.setZero();
-
-    // set diagonal elements of S to zero
-    for (int i = 0; i < n; ++i)
-    {
-        S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
-    }
-
-
     double chi2 = 0;
 
-    // Add targets
-    for (int k = 0; k < (int)scene.target_indices.size(); ++k)
+#pragma omp parallel num_threads(optimizationOptions.numThreads)
     {
-        int i = scene.target_indices[k];
-
-
-        auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
-        auto& target_ir = b(i).get();
-
-        auto p = x_u[i];
-        auto t = scene.target_positions[k];
-
-
-        Vec3 res = p.translation() - t;
-
-        Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowi;
-        Jrowi.block<3, 3>(0, 0) = Mat3::Identity();
-        Jrowi.block<3, 3>(0, 3) = Mat3::Zero();
-
-        // JtJ
-        target_ii += Jrowi.transpose() * Jrowi;
-
-        // Jtb
-        target_ir -= Jrowi.transpose() * res;
-
-        auto c = res.squaredNorm();
-        chi2 += c;
-    }
+        // set diagonal elements of S to zero
+#pragma omp for
+        for (int i = 0; i < n; ++i)
+        {
+            S.valuePtr()[S.outerIndexPtr()[i]].get().setZero();
+            b(i).get().setZero();
+        }
 
+        // Add targets
+        // A vertex can have multiple targets, therefore this part is not parallelized.
+#pragma omp single
+        for (int k = 0; k < (int)scene.target_indices.size(); ++k)
+        {
+            int i = scene.target_indices[k];
 
-    for (size_t k = 0; k < scene.constraints.size(); ++k)
-    {
-        auto& e       = scene.constraints[k];
-        auto& offsets = edgeOffsets[k];
-        int i         = e.ids.first;
-        int j         = e.ids.second;
 
-        double w_Reg = sqrt(e.weight);
+            auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
+            auto& target_ir = b(i).get();
 
-        auto& target_ij = S.valuePtr()[offsets].get();
-        auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
-        auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
-        auto& target_ir = b(i).get();
-        auto& target_jr = b(j).get();
+            auto p = x_u[i];
+            auto t = scene.target_positions[k];
 
 
-        auto pHat = x_u[i];
-        auto qHat = x_u[j];
-        {
-            Vec3 R_eij = pHat.so3() * e.e_ij;
-            Vec3 res   = w_Reg * (pHat.translation() - qHat.translation() - R_eij);
+            Vec3 res = p.translation() - t;
 
             Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowi;
             Jrowi.block<3, 3>(0, 0) = Mat3::Identity();
-            Jrowi.block<3, 3>(0, 3) = skew(R_eij);
-            Jrowi *= w_Reg;
-
-            Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowj;
-            Jrowj.block<3, 3>(0, 0) = -Mat3::Identity();
-            Jrowj.block<3, 3>(0, 3) = Mat3::Zero();
-            Jrowj *= w_Reg;
+            Jrowi.block<3, 3>(0, 3) = Mat3::Zero();
 
             // JtJ
-            target_ij = Jrowi.transpose() * Jrowj;
             target_ii += Jrowi.transpose() * Jrowi;
-            target_jj += Jrowj.transpose() * Jrowj;
 
             // Jtb
             target_ir -= Jrowi.transpose() * res;
-            target_jr -= Jrowj.transpose() * res;
 
-            auto c = res.squaredNorm();
-            chi2 += c;
+            targetChi2[k] = res.squaredNorm();
         }
-        if (1)
-        {
-            Vec3 R_eji = qHat.so3() * (-e.e_ij);
-            Vec3 res   = w_Reg * (qHat.translation() - pHat.translation() - R_eji);
-
-            Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowi;
-            Jrowi.block<3, 3>(0, 0) = -Mat3::Identity();
-            Jrowi.block<3, 3>(0, 3) = Mat3::Zero();
-            Jrowi *= w_Reg;
 
-            Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowj;
-            Jrowj.block<3, 3>(0, 0) = Mat3::Identity();
-            Jrowj.block<3, 3>(0, 3) = skew(R_eji);
-            Jrowj *= w_Reg;
-
-
-            target_ij += (Jrowi.transpose() * Jrowj);
-            target_ii += Jrowi.transpose() * Jrowi;
-            target_jj += Jrowj.transpose() * Jrowj;
-
-            // Jtb
-            target_ir -= Jrowi.transpose() * res;
-            target_jr -= Jrowj.transpose() * res;
 
-            auto c = res.squaredNorm();
-            chi2 += c;
+        for (auto& color : edgeColors)
+        {
+#pragma omp for
+            for (int c = 0; c < (int)color.size(); ++c)
+            {
+                int k   = color[c];
+                auto& e = scene.constraints[k];
+                int i   = e.ids.first;
+                int j   = e.ids.second;
+
+                double w_Reg = sqrt(e.weight);
+
+                auto& target_ij = S.valuePtr()[edgeOffsets[k]].get();
+                auto& target_ii = S.valuePtr()[S.outerIndexPtr()[i]].get();
+                auto& target_jj = S.valuePtr()[S.outerIndexPtr()[j]].get();
+                auto& target_ir = b(i).get();
+                auto& target_jr = b(j).get();
+
+
+                auto pHat     = x_u[i];
+                auto qHat     = x_u[j];
+                double chi2_c = 0;
+                {
+                    Vec3 R_eij = pHat.so3() * e.e_ij;
+                    Vec3 res   = w_Reg * (pHat.translation() - qHat.translation() - R_eij);
+
+                    Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowi;
+                    Jrowi.block<3, 3>(0, 0) = Mat3::Identity();
+                    Jrowi.block<3, 3>(0, 3) = skew(R_eij);
+                    Jrowi *= w_Reg;
+
+                    Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowj;
+                    Jrowj.block<3, 3>(0, 0) = -Mat3::Identity();
+                    Jrowj.block<3, 3>(0, 3) = Mat3::Zero();
+                    Jrowj *= w_Reg;
+
+                    // JtJ
+                    target_ij = Jrowi.transpose() * Jrowj;
+                    target_ii += Jrowi.transpose() * Jrowi;
+                    target_jj += Jrowj.transpose() * Jrowj;
+
+                    // Jtb
+                    target_ir -= Jrowi.transpose() * res;
+                    target_jr -= Jrowj.transpose() * res;
+
+                    chi2_c += res.squaredNorm();
+                }
+                if (1)
+                {
+                    Vec3 R_eji = qHat.so3() * (-e.e_ij);
+                    Vec3 res   = w_Reg * (qHat.translation() - pHat.translation() - R_eji);
+
+                    Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowi;
+                    Jrowi.block<3, 3>(0, 0) = -Mat3::Identity();
+                    Jrowi.block<3, 3>(0, 3) = Mat3::Zero();
+                    Jrowi *= w_Reg;
+
+                    Eigen::Matrix<T, 3, 6, Eigen::RowMajor> Jrowj;
+                    Jrowj.block<3, 3>(0, 0) = Mat3::Identity();
+                    Jrowj.block<3, 3>(0, 3) = skew(R_eji);
+                    Jrowj *= w_Reg;
+
+
+                    target_ij += (Jrowi.transpose() * Jrowj);
+                    target_ii += Jrowi.transpose() * Jrowi;
+                    target_jj += Jrowj.transpose() * Jrowj;
+
+                    // Jtb
+                    target_ir -= Jrowi.transpose() * res;
+                    target_jr -= Jrowj.transpose() * res;
+
+                    chi2_c += res.squaredNorm();
+                }
+                edgeChi2[k] = chi2_c;
+            }
         }
     }
 
+    for (double c : targetChi2) chi2 += c;
+    for (double c : edgeChi2) chi2 += c;
     return chi2;
 }
 
@@ -248,6 +261,7 @@ bool RecursiveArap::addDelta()
 {
     oldx_u = x_u;
 
+#pragma omp parallel for num_threads(optimizationOptions.numThreads)
     for (int i = 0; i < n; ++i)
     {
         auto t = delta_x(i).get();
@@ -267,6 +281,7 @@ void RecursiveArap::solveLinearSystem()
     loptions.solverType = (optimizationOptions.solverType == OptimizationOptions::SolverType::Direct)
                               ? LinearSolverOptions::SolverType::Direct
                               : LinearSolverOptions::SolverType::Iterative;
+    loptions.numThreads = optimizationOptions.numThreads;
 
 
 
@@ -277,40 +292,46 @@ double RecursiveArap::computeCost()
 {
     auto& scene = *arap;
 
-    double chi2 = 0;
-
-    for (int k = 0; k < (int)scene.target_indices.size(); ++k)
-    {
-        int i    = scene.target_indices[k];
-        auto p   = x_u[i];
-        auto t   = scene.target_positions[k];
-        Vec3 res = p.translation() - t;
-        auto c   = res.squaredNorm();
-        chi2 += c;
-    }
-
-    for (size_t k = 0; k < scene.constraints.size(); ++k)
+#pragma omp parallel num_threads(optimizationOptions.numThreads)
     {
-        auto& e = scene.constraints[k];
-        int i   = e.ids.first;
-        int j   = e.ids.second;
-
-
-        auto pHat = x_u[i];
-        auto qHat = x_u[j];
+#pragma omp for nowait
+        for (int k = 0; k < (int)scene.target_indices.size(); ++k)
         {
-            Vec3 R_eij = pHat.so3() * e.e_ij;
-            Vec3 res   = sqrt(e.weight) * (pHat.translation() - qHat.translation() - R_eij);
-            auto c     = res.squaredNorm();
-            chi2 += c;
+            int i         = scene.target_indices[k];
+            auto p        = x_u[i];
+            auto t        = scene.target_positions[k];
+            Vec3 res      = p.translation() - t;
+            targetChi2[k] = res.squaredNorm();
         }
+
+#pragma omp for
+        for (int k = 0; k < (int)scene.constraints.size(); ++k)
         {
-            Vec3 R_eji = qHat.so3() * (-e.e_ij);
-            Vec3 res   = sqrt(e.weight) * (qHat.translation() - pHat.translation() - R_eji);
-            auto c     = res.squaredNorm();
-            chi2 += c;
+            auto& e = scene.constraints[k];
+            int i   = e.ids.first;
+            int j   = e.ids.second;
+
+
+            auto pHat     = x_u[i];
+            auto qHat     = x_u[j];
+            double chi2_c = 0;
+            {
+                Vec3 R_eij = pHat.so3() * e.e_ij;
+                Vec3 res   = sqrt(e.weight) * (pHat.translation() - qHat.translation() - R_eij);
+                chi2_c += res.squaredNorm();
+            }
+            {
+                Vec3 R_eji = qHat.so3() * (-e.e_ij);
+                Vec3 res   = sqrt(e.weight) * (qHat.translation() - pHat.translation() - R_eji);
+                chi2_c += res.squaredNorm();
+            }
+            edgeChi2[k] = chi2_c;
         }
     }
+
+    double chi2 = 0;
+    for (double c : targetChi2) chi2 += c;
+    for (double c : edgeChi2) chi2 += c;
     return chi2;
 }
 
@@ -50,6 +50,10 @@ class SAIGA_VISION_API RecursiveArap : public ArapBase, public LMOptimizer
     Eigen::Recursive::MixedSymmetricRecursiveSolver<PSType, PBType> solver;
     AlignedVector<SE3> x_u, oldx_u;
     std::vector<int> edgeOffsets;
+    std::vector<std::vector<int>> edgeColors;
+    // Squared error of every constraint and target. Summed in order, so that chi2 does not depend on the number of
+    // threads.
+    std::vector<double> edgeChi2, targetChi2;
 };
 
 }  // namespace Saiga
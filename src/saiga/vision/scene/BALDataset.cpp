@@ -6,11 +6,13 @@
 
 #include "BALDataset.h"
 
+#include "saiga/core/util/MemoryMappedFile.h"
 #include "saiga/core/util/assert.h"
-#include "saiga/core/util/file.h"
-#include "saiga/core/util/tostring.h"
 
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 #ifdef SAIGA_USE_CERES
 #    include "saiga/vision/ceres/CeresBAL.h"
@@ -24,69 +26,74 @@ BALDataset::BALDataset(const std::string& file)
 {
     std::cout << "> Loading BALDataset " << file << std::endl;
 
-    auto data = File::loadFileStringArray(file);
-
-    int num_cameras, num_points, num_observations;
-
-    std::stringstream in(data.front());
-    in >> num_cameras >> num_points >> num_observations;
+    // The file is parsed directly from the memory mapping. This is a lot faster than reading it line by line into
+    // strings, which previously took longer than solving the problem.
+    MemoryMappedFile mf(file);
+    SAIGA_ASSERT(mf.isOpen());
+    const char* current = mf.data();
+    const char* end     = current + mf.size();
+
+    auto nextToken = [&]() {
+        while (current < end && isspace(*current)) ++current;
+        const char* begin = current;
+        while (current < end && !isspace(*current)) ++current;
+        SAIGA_ASSERT(begin != current);
+
+        // The mapping is not null terminated
+        char buffer[64];
+        int length = std::min<int>(current - begin, sizeof(buffer) - 1);
+        memcpy(buffer, begin, length);
+        buffer[length] = 0;
+        return std::strtod(buffer, nullptr);
+    };
+
+    int num_cameras      = nextToken();
+    int num_points       = nextToken();
+    int num_observations = nextToken();
 
     cameras.resize(num_cameras);
     observations.resize(num_observations);
     points.resize(num_points);
 
-
-
-    int start = 1;
-#pragma omp parallel for
     for (int i = 0; i < num_observations; ++i)
     {
-        std::stringstream in(data[start + i]);
-        BALObservation o;
-        in >> o.camera_index >> o.point_index >> o.point[0] >> o.point[1];
-        observations[i] = (o);
+        BALObservation& o = observations[i];
+        o.camera_index    = nextToken();
+        o.point_index     = nextToken();
+        o.point[0]        = nextToken();
+        o.point[1]        = nextToken();
     }
 
-    start += num_observations;
-#pragma omp parallel for
     for (int i = 0; i < num_cameras; ++i)
     {
-        BALCamera c;
+        BALCamera& c = cameras[i];
         Vec3 r;
         Vec3 t;
 
+        r(0) = nextToken();
+        r(1) = nextToken();
+        r(2) = nextToken();
 
-        r(0) = Saiga::to_double(data[start + i * 9 + 0]);
-        r(1) = Saiga::to_double(data[start + i * 9 + 1]);
-        r(2) = Saiga::to_double(data[start + i * 9 + 2]);
-
-        t(0) = Saiga::to_double(data[start + i * 9 + 3]);
-        t(1) = Saiga::to_double(data[start + i * 9 + 4]);
-        t(2) = Saiga::to_double(data[start + i * 9 + 5]);
+        t(0) = nextToken();
+        t(1) = nextToken();
+        t(2) = nextToken();
 
-        c.f  = Saiga::to_double(data[start + i * 9 + 6]);
-        c.k1 = Saiga::to_double(data[start + i * 9 + 7]);
-        c.k2 = Saiga::to_double(data[start + i * 9 + 8]);
+        c.f  = nextToken();
+        c.k1 = nextToken();
+        c.k2 = nextToken();
 
         auto angle           = r.norm();
         Eigen::Vector3d axis = angle > 0.00001 ? r / angle : Eigen::Vector3d(0, 1, 0);
         Eigen::AngleAxis<double> a(angle, axis);
-        c.se3      = SE3((Quat)a, t);
-        cameras[i] = (c);
+        c.se3 = SE3((Quat)a, t);
     }
-    start += num_cameras * 9;
 
-#pragma omp parallel for
     for (int i = 0; i < num_points; ++i)
     {
-        BALPoint p;
-
-        p.point(0) = Saiga::to_double(data[start + i * 3 + 0]);
-        p.point(1) = Saiga::to_double(data[start + i * 3 + 1]);
-        p.point(2) = Saiga::to_double(data[start + i * 3 + 2]);
-
-
-        points[i] = (p);
+        BALPoint& p = points[i];
+        p.point(0)  = nextToken();
+        p.point(1)  = nextToken();
+        p.point(2)  = nextToken();
     }
 
 
@@ -167,18 +174,16 @@ double BALDataset::rms()
 
 Scene BALDataset::makeScene()
 {
-    SAIGA_EXIT_ERROR("not implemented after extrinsic change");
     Scene scene;
-    std::vector<double> fs;
     for (BALCamera& c : cameras)
     {
         int id = scene.images.size();
 
         SceneImage si;
+        si.se3  = c.extr().first;
         si.intr = id;
         scene.images.push_back(si);
         scene.intrinsics.push_back(c.intr());
-        fs.push_back(c.f);
     }
 
     for (BALObservation& o : observations)
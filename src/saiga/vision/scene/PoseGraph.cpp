@@ -30,6 +30,8 @@ PoseGraph::PoseGraph(const Scene& scene, int minEdges)
     std::vector<std::vector<int>> schurStructure;
     schurStructure.clear();
     schurStructure.resize(n, std::vector<int>(n, 0));
+    // The observation index of the scene doesn't help here, because the scattered increments of the dense image-image
+    // counts dominate the runtime.
     for (auto& wp : scene.worldPoints)
     {
         for (auto& ref : wp.stereoreferences)
@@ -7,6 +7,7 @@
 #include "Scene.h"
 
 #include "saiga/core/imgui/imgui.h"
+#include "saiga/core/util/Algorithm.h"
 #include "saiga/core/util/assert.h"
 #include "saiga/vision/kernels/PGO.h"
 #include "saiga/vision/kernels/Robust.h"
@@ -85,6 +86,7 @@ void Scene::clear()
     worldPoints.clear();
     images.clear();
     rel_pose_constraints.clear();
+    observation_index.clear();
 }
 
 void Scene::reserve(int _images, int points, int observations)
@@ -182,6 +184,76 @@ void Scene::fixWorldPointReferences()
         }
         iid++;
     }
+
+    if (!observation_index.empty()) buildObservationIndex();
+}
+
+void SceneObservationIndex::clear()
+{
+    image_offsets.clear();
+    point_offsets.clear();
+    obs_image.clear();
+    obs_image_point.clear();
+    obs_wp.clear();
+    point_obs.clear();
+    generation = 0;
+}
+
+void Scene::buildObservationIndex()
+{
+    auto& index = observation_index;
+    index.clear();
+    index.generation = observation_generation;
+
+    index.image_offsets.reserve(images.size() + 1);
+    index.image_offsets.push_back(0);
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        auto& img = images[i];
+        for (int j = 0; j < (int)img.stereoPoints.size(); ++j)
+        {
+            int wp = img.stereoPoints[j].wp;
+            if (wp == -1) continue;
+            index.obs_image.push_back(i);
+            index.obs_image_point.push_back(j);
+            index.obs_wp.push_back(wp);
+        }
+        index.image_offsets.push_back(index.obs_wp.size());
+    }
+
+    // Counting sort by world point
+    index.point_offsets.resize(worldPoints.size() + 1, 0);
+    for (int wp : index.obs_wp) index.point_offsets[wp]++;
+    Saiga::exclusive_scan(index.point_offsets.begin(), index.point_offsets.end(), index.point_offsets.begin(), 0);
+
+    index.point_obs.resize(index.obs_wp.size());
+    std::vector<int> current(index.point_offsets.begin(), index.point_offsets.end() - 1);
+    for (int o = 0; o < index.numObservations(); ++o)
+    {
+        index.point_obs[current[index.obs_wp[o]]++] = o;
+    }
+}
+
+bool Scene::observationIndexValid() const
+{
+    if (!hasObservationIndex()) return false;
+    auto& index = observation_index;
+
+    int o = 0;
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        if (index.image_offsets[i] != o) return false;
+        auto& img = images[i];
+        for (int j = 0; j < (int)img.stereoPoints.size(); ++j)
+        {
+            int wp = img.stereoPoints[j].wp;
+            if (wp == -1) continue;
+            if (o >= index.numObservations()) return false;
+            if (index.obs_image[o] != i || index.obs_image_point[o] != j || index.obs_wp[o] != wp) return false;
+            o++;
+        }
+    }
+    return o == index.numObservations() && index.image_offsets.back() == o;
 }
 
 bool Scene::valid() const
@@ -217,7 +289,7 @@ Saiga::Statistics<double> Scene::statistics()
     {
         for (auto& o : im.stereoPoints)
         {
-            if (!o.wp) continue;
+            if (!o) continue;
             stats.push_back(std::sqrt(residualNorm2(im, o)));
         }
     }
@@ -233,7 +305,7 @@ Saiga::Statistics<double> Scene::depthStatistics()
     {
         for (auto& o : im.stereoPoints)
         {
-            if (!o.wp) continue;
+            if (!o) continue;
             stats.push_back((depth(im, o)));
         }
     }
@@ -287,6 +359,7 @@ void Scene::removeWorldPoint(int id)
 
     wp.valid = false;
     wp.stereoreferences.clear();
+    observationsChanged();
     SAIGA_ASSERT(!wp);
 }
 
@@ -307,6 +380,7 @@ void Scene::removeCamera(int id)
     }
 
     im.validPoints = 0;
+    observationsChanged();
     SAIGA_ASSERT(!im);
     SAIGA_ASSERT(valid());
 }
@@ -353,6 +427,8 @@ void Scene::compress()
         if (img.validPoints == 0) std::cout << "invalid camera " << i << std::endl;
         i++;
     }
+
+    buildObservationIndex();
 }
 
 std::vector<int> Scene::validImages()
@@ -161,6 +161,35 @@ struct RelPoseConstraint
     std::vector<RelDepth> rel_depth_constraints;
 };
 
+/**
+ * Compact observation index of a scene in CSR format.
+ *
+ * The observations of image i are [image_offsets[i], image_offsets[i+1]). The observations of world point j are
+ * point_obs[point_offsets[j]] ... point_obs[point_offsets[j+1]-1]. Image points with wp == -1 are not included.
+ * In contrast to WorldPoint::stereoreferences and SceneImage::stereoPoints, all arrays are flat and can be iterated
+ * linearly without chasing a pointer for each point.
+ */
+struct SAIGA_VISION_API SceneObservationIndex
+{
+    std::vector<int> image_offsets;
+    std::vector<int> point_offsets;
+
+    // Per observation: image id, index into images[].stereoPoints and world point id
+    std::vector<int> obs_image;
+    std::vector<int> obs_image_point;
+    std::vector<int> obs_wp;
+
+    // Observation ids sorted by world point
+    std::vector<int> point_obs;
+
+    // Scene::observationGeneration() at the time the index was built
+    uint64_t generation = 0;
+
+    int numObservations() const { return obs_wp.size(); }
+    bool empty() const { return image_offsets.empty(); }
+    void clear();
+};
+
 class SAIGA_VISION_API Scene
 {
    public:
@@ -251,6 +280,28 @@ class SAIGA_VISION_API Scene
     std::vector<int> validImages();
     std::vector<int> validPoints();
 
+    // Builds the CSR observation index. compress() always builds it and fixWorldPointReferences() updates an
+    // existing index. The other Scene functions which change observations mark it as outdated.
+    // Note: rms(), chi2() and statistics() don't use the index. They traverse the image points in memory order
+    // anyways and the index would only add an indirection.
+    void buildObservationIndex();
+
+    // The scene cannot detect direct changes of images[].stereoPoints or worldPoints. After such a change call
+    // observationsChanged() or fixWorldPointReferences(), otherwise the optimizers use an outdated index.
+    void observationsChanged() { observation_generation++; }
+    uint64_t observationGeneration() const { return observation_generation; }
+
+    bool hasObservationIndex() const
+    {
+        return !observation_index.empty() && observation_index.generation == observation_generation &&
+               observation_index.image_offsets.size() == images.size() + 1 &&
+               observation_index.point_offsets.size() == worldPoints.size() + 1;
+    }
+    const SceneObservationIndex& observationIndex() const { return observation_index; }
+
+    // Compares the index with the image points. O(observations), use it only for debugging.
+    bool observationIndexValid() const;
+
     // ================================= IO =================================
     // -> defined in Scene_io.cpp
 
@@ -258,7 +309,16 @@ class SAIGA_VISION_API Scene
     bool imgui();
     void save(const std::string& file);
     void load(const std::string& file);
+
+    // Flat binary format, see SceneView.h. Much faster to load than the text format.
+    void saveBinary(const std::string& file);
+    // Returns false if the file does not exist or has an unsupported version.
+    bool loadBinary(const std::string& file);
     double chi2Huber(double huber);
+
+   private:
+    SceneObservationIndex observation_index;
+    uint64_t observation_generation = 0;
 };
 
 SAIGA_VISION_API std::ostream& operator<<(std::ostream& strm, Scene& scene);
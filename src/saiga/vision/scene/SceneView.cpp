@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SceneView.h"
+
+#include "saiga/core/util/assert.h"
+
+#include "Scene.h"
+
+#include <cstring>
+#include <limits>
+
+namespace Saiga
+{
+constexpr char SceneFileHeader::kMagic[8];
+
+void SceneFileHeader::computeLayout()
+{
+    memcpy(magic, kMagic, sizeof(magic));
+    version     = kVersion;
+    header_size = sizeof(SceneFileHeader);
+    byte_order  = kByteOrder;
+
+    uint64_t offset = 0;
+    auto next       = [&offset](uint64_t bytes) {
+        offset          = (offset + kAlignment - 1) / kAlignment * kAlignment;
+        uint64_t result = offset;
+        offset += bytes;
+        return result;
+    };
+
+    next(sizeof(SceneFileHeader));
+    intrinsics        = next(num_intrinsics * 5 * sizeof(double));
+    image_pose        = next(num_images * 7 * sizeof(double));
+    image_velocity    = next(num_images * 7 * sizeof(double));
+    image_intr        = next(num_images * sizeof(int32_t));
+    image_constant    = next(num_images * sizeof(uint8_t));
+    image_obs_offsets = next((num_images + 1) * sizeof(int64_t));
+    obs_wp            = next(num_observations * sizeof(int32_t));
+    obs_point         = next(num_observations * 2 * sizeof(double));
+    obs_depth         = next(num_observations * sizeof(double));
+    obs_weight        = next(num_observations * sizeof(float));
+    point_position    = next(num_points * 3 * sizeof(double));
+    point_flags       = next(num_points * sizeof(uint8_t));
+    file_size         = offset;
+}
+
+bool SceneFileHeader::check(uint64_t size) const
+{
+    if (size < sizeof(SceneFileHeader)) return false;
+    if (memcmp(magic, kMagic, sizeof(magic)) != 0) return false;
+    if (version != kVersion || header_size != sizeof(SceneFileHeader)) return false;
+    if (byte_order != kByteOrder) return false;
+    if (num_intrinsics < 0 || num_images < 0 || num_points < 0 || num_observations < 0) return false;
+
+    // Every element needs at least one byte. This also prevents overflows in computeLayout().
+    if ((uint64_t)num_intrinsics > size || (uint64_t)num_images > size || (uint64_t)num_points > size ||
+        (uint64_t)num_observations > size)
+        return false;
+    // The accessors use int for these indices
+    constexpr int64_t max_index = std::numeric_limits<int>::max();
+    if (num_intrinsics > max_index || num_images >= max_index || num_points > max_index) return false;
+
+    // The layout is fully defined by the counts
+    SceneFileHeader expected = *this;
+    expected.computeLayout();
+    return memcmp(&expected, this, sizeof(SceneFileHeader)) == 0 && file_size <= size;
+}
+
+bool SceneView::open(const std::string& file_name)
+{
+    close();
+    if (!file.open(file_name, MemoryMappedFile::Mode::Read)) return false;
+
+    auto h = reinterpret_cast<const SceneFileHeader*>(file.data());
+    if (!h || !h->check(file.size()))
+    {
+        std::cout << "SceneView: " << file_name << " is not a valid scene file (version " << SceneFileHeader::kVersion
+                  << ")." << std::endl;
+        close();
+        return false;
+    }
+    header = h;
+
+    if (auto error = checkIndices())
+    {
+        std::cout << "SceneView: invalid " << error << " in " << file_name << "." << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+const char* SceneView::checkIndices() const
+{
+    // The CSR offsets must start at zero, be monotonic and end at the number of observations.
+    // -> All ranges [observationBegin(i), observationEnd(i)) are inside the observation arrays.
+    if (observationBegin(0) != 0) return "image_obs_offsets";
+    for (int i = 0; i < numImages(); ++i)
+    {
+        if (observationEnd(i) < observationBegin(i)) return "image_obs_offsets";
+    }
+    if (observationEnd(numImages() - 1) != numObservations()) return "image_obs_offsets";
+
+    for (int i = 0; i < numImages(); ++i)
+    {
+        if (intr(i) < 0 || intr(i) >= numIntrinsics()) return "image_intr";
+    }
+
+    // Unused observations have the world point -1
+    for (int64_t o = 0; o < numObservations(); ++o)
+    {
+        int wp = observationWorldPoint(o);
+        if (wp < -1 || wp >= numPoints()) return "obs_wp";
+    }
+    return nullptr;
+}
+
+void SceneView::close()
+{
+    file.close();
+    header = nullptr;
+}
+
+void SceneView::makeScene(Scene& scene) const
+{
+    SAIGA_ASSERT(isOpen());
+
+    scene               = Scene();
+    scene.bf            = header->bf;
+    scene.globalScale   = header->global_scale;
+    scene.stereo_weight = header->stereo_weight;
+
+    scene.intrinsics.resize(numIntrinsics());
+    for (int i = 0; i < numIntrinsics(); ++i)
+    {
+        scene.intrinsics[i] = intrinsics(i);
+    }
+
+    scene.images.resize(numImages());
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < numImages(); ++i)
+    {
+        auto& img    = scene.images[i];
+        img.se3      = pose(i);
+        img.velocity = velocity(i);
+        img.intr     = intr(i);
+        img.constant = constant(i);
+
+        int64_t begin = observationBegin(i);
+        img.stereoPoints.resize(observationEnd(i) - begin);
+        for (int j = 0; j < (int)img.stereoPoints.size(); ++j)
+        {
+            auto& ip  = img.stereoPoints[j];
+            ip.wp     = observationWorldPoint(begin + j);
+            ip.point  = observationPoint(begin + j);
+            ip.depth  = observationDepth(begin + j);
+            ip.weight = observationWeight(begin + j);
+        }
+    }
+
+    scene.worldPoints.resize(numPoints());
+#pragma omp parallel for
+    for (int i = 0; i < numPoints(); ++i)
+    {
+        scene.worldPoints[i].p        = pointPosition(i);
+        scene.worldPoints[i].constant = pointConstant(i);
+    }
+
+    scene.fixWorldPointReferences();
+
+    // Points without references are invalid anyways. fixWorldPointReferences() marks all others as valid.
+    for (int i = 0; i < numPoints(); ++i)
+    {
+        scene.worldPoints[i].valid &= pointValid(i);
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/MemoryMappedFile.h"
+#include "saiga/vision/VisionTypes.h"
+
+#include <cstdint>
+
+namespace Saiga
+{
+class Scene;
+
+/**
+ * Binary scene file. Written by Scene::saveBinary().
+ *
+ * The file starts with this header followed by flat arrays (structure of arrays). Every array begins at a 64 byte
+ * aligned offset. The observations are stored in CSR order: The observations of image i are the range
+ * [image_obs_offsets[i], image_obs_offsets[i+1]).
+ *
+ * All values are stored in the byte order of the machine that wrote the file. The header contains kByteOrder, so
+ * that files from a machine with a different byte order are detected and rejected.
+ *
+ *   intrinsics         double[num_intrinsics][5]   fx fy cx cy s
+ *   image_pose         double[num_images][7]       SE3::params()
+ *   image_velocity     double[num_images][7]       SE3::params()
+ *   image_intr         int32[num_images]
+ *   image_constant     uint8[num_images]
+ *   image_obs_offsets  int64[num_images + 1]
+ *   obs_wp             int32[num_observations]
+ *   obs_point          double[num_observations][2]
+ *   obs_depth          double[num_observations]
+ *   obs_weight         float[num_observations]
+ *   point_position     double[num_points][3]
+ *   point_flags        uint8[num_points]            bit 0: valid, bit 1: constant
+ */
+struct SAIGA_VISION_API SceneFileHeader
+{
+    static constexpr char kMagic[8]         = {'S', 'A', 'I', 'G', 'A', 'S', 'C', 'N'};
+    static constexpr uint32_t kVersion      = 2;
+    static constexpr uint64_t kByteOrder    = 0x0102030405060708;
+    static constexpr uint64_t kAlignment    = 64;
+    static constexpr uint8_t kPointValid    = 1;
+    static constexpr uint8_t kPointConstant = 2;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t byte_order;
+
+    int64_t num_intrinsics;
+    int64_t num_images;
+    int64_t num_points;
+    int64_t num_observations;
+
+    double bf;
+    double stereo_weight;
+    double global_scale;
+
+    // Byte offsets from the beginning of the file
+    uint64_t intrinsics;
+    uint64_t image_pose;
+    uint64_t image_velocity;
+    uint64_t image_intr;
+    uint64_t image_constant;
+    uint64_t image_obs_offsets;
+    uint64_t obs_wp;
+    uint64_t obs_point;
+    uint64_t obs_depth;
+    uint64_t obs_weight;
+    uint64_t point_position;
+    uint64_t point_flags;
+
+    // Total file size
+    uint64_t file_size;
+
+    // Sets magic, version, byte order and the array offsets from the element counts.
+    void computeLayout();
+
+    // Checks magic, version, byte order and that all arrays are inside a file of the given size.
+    bool check(uint64_t size) const;
+};
+
+/**
+ * Read-only, zero-copy access to a binary scene file.
+ *
+ * The file is memory mapped and the accessors point directly into the mapping. Nothing is copied by open() and the
+ * pages are only loaded when they are accessed. Use makeScene() to create a Scene for the optimizers.
+ *
+ * open() validates all indices (observation offsets, intrinsic and world point references), therefore the
+ * accessors can be used without further checks on any file that was opened successfully.
+ *
+ * Usage:
+ *   SceneView view("dubrovnik.bscene");
+ *   SAIGA_ASSERT(view.isOpen());
+ *   for (int64_t o = view.observationBegin(i); o < view.observationEnd(i); ++o)
+ *       std::cout << view.observationPoint(o).transpose() << std::endl;
+ */
+class SAIGA_VISION_API SceneView
+{
+   public:
+    SceneView() {}
+    SceneView(const std::string& file) { open(file); }
+
+    // Returns false if the file does not exist, is not a valid scene file of a supported version or contains
+    // out of range indices.
+    bool open(const std::string& file);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    const SceneFileHeader& fileHeader() const { return *header; }
+
+    int numIntrinsics() const { return header->num_intrinsics; }
+    int numImages() const { return header->num_images; }
+    int numPoints() const { return header->num_points; }
+    int64_t numObservations() const { return header->num_observations; }
+
+    IntrinsicsPinholed intrinsics(int i) const
+    {
+        return Vec5(Eigen::Map<const Vec5>(array<double>(header->intrinsics) + 5 * i));
+    }
+
+    Eigen::Map<const SE3> pose(int image) const
+    {
+        return Eigen::Map<const SE3>(array<double>(header->image_pose) + 7 * image);
+    }
+    Eigen::Map<const SE3> velocity(int image) const
+    {
+        return Eigen::Map<const SE3>(array<double>(header->image_velocity) + 7 * image);
+    }
+    int intr(int image) const { return array<int32_t>(header->image_intr)[image]; }
+    bool constant(int image) const { return array<uint8_t>(header->image_constant)[image]; }
+
+    int64_t observationBegin(int image) const { return array<int64_t>(header->image_obs_offsets)[image]; }
+    int64_t observationEnd(int image) const { return array<int64_t>(header->image_obs_offsets)[image + 1]; }
+
+    int observationWorldPoint(int64_t obs) const { return array<int32_t>(header->obs_wp)[obs]; }
+    Eigen::Map<const Vec2> observationPoint(int64_t obs) const
+    {
+        return Eigen::Map<const Vec2>(array<double>(header->obs_point) + 2 * obs);
+    }
+    double observationDepth(int64_t obs) const { return array<double>(header->obs_depth)[obs]; }
+    float observationWeight(int64_t obs) const { return array<float>(header->obs_weight)[obs]; }
+
+    Eigen::Map<const Vec3> pointPosition(int point) const
+    {
+        return Eigen::Map<const Vec3>(array<double>(header->point_position) + 3 * point);
+    }
+    bool pointValid(int point) const
+    {
+        return array<uint8_t>(header->point_flags)[point] & SceneFileHeader::kPointValid;
+    }
+    bool pointConstant(int point) const
+    {
+        return array<uint8_t>(header->point_flags)[point] & SceneFileHeader::kPointConstant;
+    }
+
+    // Copies the view into a Scene. The images and their observations are converted in parallel.
+    void makeScene(Scene& scene) const;
+
+   private:
+    MemoryMappedFile file;
+    const SceneFileHeader* header = nullptr;
+
+    // Returns the name of the first array with an out of range index or nullptr.
+    const char* checkIndices() const;
+
+    template <typename T>
+    const T* array(uint64_t offset) const
+    {
+        return reinterpret_cast<const T*>(file.data() + offset);
+    }
+};
+
+}  // namespace Saiga
@@ -10,7 +10,9 @@
 #include "saiga/vision/util/Random.h"
 
 #include "Scene.h"
+#include "SceneView.h"
 
+#include <cstring>
 #include <fstream>
 namespace Saiga
 {
@@ -200,6 +202,108 @@ void Scene::load(const std::string& file)
 }
 
 
+void Scene::saveBinary(const std::string& file)
+{
+    SAIGA_ASSERT(valid());
+    std::cout << "Saving binary scene to " << file << "." << std::endl;
+
+    SceneFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.num_intrinsics   = intrinsics.size();
+    header.num_images       = images.size();
+    header.num_points       = worldPoints.size();
+    header.num_observations = 0;
+    for (auto& img : images) header.num_observations += img.stereoPoints.size();
+    header.bf            = bf;
+    header.stereo_weight = stereo_weight;
+    header.global_scale  = globalScale;
+    header.computeLayout();
+
+    std::ofstream strm(file, std::ios::binary);
+    SAIGA_ASSERT(strm.is_open());
+
+    auto write = [&](uint64_t offset, const auto& data) {
+        SAIGA_ASSERT((uint64_t)strm.tellp() <= offset);
+        while ((uint64_t)strm.tellp() < offset) strm.put(0);
+        strm.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(data[0]));
+    };
+
+    std::vector<double> intrinsics_data;
+    for (auto& i : intrinsics)
+    {
+        Vec5 c = i.coeffs();
+        intrinsics_data.insert(intrinsics_data.end(), c.data(), c.data() + 5);
+    }
+
+    std::vector<double> pose, velocity;
+    std::vector<int32_t> intr;
+    std::vector<uint8_t> constant;
+    std::vector<int64_t> obs_offsets = {0};
+    for (auto& img : images)
+    {
+        pose.insert(pose.end(), img.se3.data(), img.se3.data() + SE3::num_parameters);
+        velocity.insert(velocity.end(), img.velocity.data(), img.velocity.data() + SE3::num_parameters);
+        intr.push_back(img.intr);
+        constant.push_back(img.constant);
+        obs_offsets.push_back(obs_offsets.back() + img.stereoPoints.size());
+    }
+
+    std::vector<int32_t> obs_wp;
+    std::vector<double> obs_point, obs_depth;
+    std::vector<float> obs_weight;
+    obs_wp.reserve(header.num_observations);
+    obs_point.reserve(header.num_observations * 2);
+    obs_depth.reserve(header.num_observations);
+    obs_weight.reserve(header.num_observations);
+    for (auto& img : images)
+    {
+        for (auto& ip : img.stereoPoints)
+        {
+            obs_wp.push_back(ip.wp);
+            obs_point.push_back(ip.point(0));
+            obs_point.push_back(ip.point(1));
+            obs_depth.push_back(ip.depth);
+            obs_weight.push_back(ip.weight);
+        }
+    }
+
+    std::vector<double> point_position;
+    std::vector<uint8_t> point_flags;
+    for (auto& wp : worldPoints)
+    {
+        point_position.insert(point_position.end(), wp.p.data(), wp.p.data() + 3);
+        point_flags.push_back((wp.valid ? SceneFileHeader::kPointValid : 0) |
+                              (wp.constant ? SceneFileHeader::kPointConstant : 0));
+    }
+
+    strm.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(header.intrinsics, intrinsics_data);
+    write(header.image_pose, pose);
+    write(header.image_velocity, velocity);
+    write(header.image_intr, intr);
+    write(header.image_constant, constant);
+    write(header.image_obs_offsets, obs_offsets);
+    write(header.obs_wp, obs_wp);
+    write(header.obs_point, obs_point);
+    write(header.obs_depth, obs_depth);
+    write(header.obs_weight, obs_weight);
+    write(header.point_position, point_position);
+    write(header.point_flags, point_flags);
+    SAIGA_ASSERT((uint64_t)strm.tellp() == header.file_size);
+}
+
+bool Scene::loadBinary(const std::string& file)
+{
+    std::cout << "Loading binary scene from " << file << "." << std::endl;
+
+    SceneView view;
+    if (!view.open(SearchPathes::data(file))) return false;
+    view.makeScene(*this);
+    SAIGA_ASSERT(valid());
+    return true;
+}
+
+
 std::ostream& operator<<(std::ostream& strm, Scene& scene)
 {
     strm << "[Scene]" << std::endl;
@@ -8,6 +8,7 @@
  *  - Removed support for non-ORB feature descriptors
  *  - Optimized loading, saving, matching
  *  - Removed dependency to opencv
+ *  - Flat tree with SIMD distance computation for transform
  *
  * Original License: BSD-like
  *          https://github.com/dorian3d/DBoW2/blob/master/LICENSE.txt
@@ -20,6 +21,7 @@
 #include "saiga/core/time/all.h"
 #include "saiga/core/util/BinaryFile.h"
 #include "saiga/vision/features/Features.h"
+#include "saiga/vision/features/HammingMatcher.h"
 
 #include <algorithm>
 #include <array>
@@ -241,6 +243,21 @@ class TemplatedVocabulary
     void transform(const std::vector<Descriptor>& features, BowVector& v, FeatureVector& fv, int levelsup,
                    int num_threads = 1) const;
 
+    /**
+     * Word id, word weight and node id ("levelsup" levels up) of n descriptors.
+     * The descriptors are processed in groups level by level. The descents of a group are independent, therefore
+     * the cache misses in the lower levels of the tree overlap.
+     */
+    void transform(const Descriptor* features, int n, int levelsup, WordId* word_ids, WordValue* weights,
+                   NodeId* node_ids) const;
+
+    /**
+     * Builds the flat tree used by transform(). Called by create() and loadRaw().
+     * The children of a node are stored consecutively and their descriptors in the transposed block layout of
+     * HammingTransposeBlocks. The nearest child is then computed with a single SIMD kernel call.
+     */
+    void compile();
+
 
     /**
      * Returns the score of two vectors
@@ -351,6 +368,17 @@ class TemplatedVocabulary
         inline bool isLeaf() const { return children.empty(); }
     };
 
+    /// Node of the flat tree
+    struct FlatNode
+    {
+        NodeId id;
+        /// The children are [child_begin, child_begin + num_children) of flat_nodes. No children for words.
+        int child_begin;
+        int num_children;
+        WordId word_id;
+        WordValue weight;
+    };
+
    protected:
     /**
      * Returns a set of pointers to descriptores
@@ -450,6 +478,12 @@ class TemplatedVocabulary
     std::vector<Node*> m_words;
 
 
+    /// Flat tree (see compile()). The children of each node start at a multiple of 8.
+    FlatNode flat_root;
+    std::vector<FlatNode> flat_nodes;
+    std::vector<uint64_t> flat_blocks;
+    Saiga::HammingKernel flat_kernel = Saiga::HammingKernel::Scalar;
+
     mutable std::vector<std::pair<WordId, WordValue>> tmp_bow_data;
     mutable std::vector<std::pair<NodeId, int>> tmp_feature_data;
 };
@@ -482,6 +516,9 @@ void TemplatedVocabulary<Descriptor>::create(const std::vector<std::vector<Descr
     // create the words
     createWords();
 
+    // setNodeWeights already uses the flat tree
+    compile();
+
     // and set the weight of each node of the tree
     setNodeWeights(training_features);
 }
@@ -856,6 +893,11 @@ void TemplatedVocabulary<Descriptor>::setNodeWeights(const std::vector<std::vect
             m_words[i]->weight = log((double)NDocs / (double)Ni[i]);
         }  // else // This cannot occur if using kmeans++
     }
+
+    for (FlatNode& n : flat_nodes)
+    {
+        if (n.id >= 0) n.weight = m_nodes[n.id].weight;
+    }
 }
 
 
@@ -892,22 +934,35 @@ void TemplatedVocabulary<Descriptor>::transform(const std::vector<Descriptor>& f
     v.clear();
     fv.clear();
 
+    constexpr int group = 64;
+    int num_groups      = (N + group - 1) / group;
+
 #pragma omp parallel num_threads(num_threads)
     {
 #pragma omp for
-        for (int i = 0; i < N; ++i)
+        for (int g = 0; g < num_groups; ++g)
         {
-            auto [word_id, weight, nid] = transform(features[i], levelsup);
+            int begin = g * group;
+            int n     = std::min(group, N - begin);
 
-            if (weight > 0)
-            {
-                tmp_bow_data[i]     = {word_id, weight};
-                tmp_feature_data[i] = {nid, i};
-            }
-            else
+            WordId word_ids[group];
+            WordValue weights[group];
+            NodeId node_ids[group];
+            transform(features.data() + begin, n, levelsup, word_ids, weights, node_ids);
+
+            for (int j = 0; j < n; ++j)
             {
-                tmp_bow_data[i]     = {-1, weight};
-                tmp_feature_data[i] = {-1, i};
+                int i = begin + j;
+                if (weights[j] > 0)
+                {
+                    tmp_bow_data[i]     = {word_ids[j], weights[j]};
+                    tmp_feature_data[i] = {node_ids[j], i};
+                }
+                else
+                {
+                    tmp_bow_data[i]     = {-1, weights[j]};
+                    tmp_feature_data[i] = {-1, i};
+                }
             }
         }
 
@@ -938,46 +993,103 @@ template <class Descriptor>
 std::tuple<WordId, WordValue, NodeId> TemplatedVocabulary<Descriptor>::transform(const Descriptor& feature,
                                                                                  int levelsup) const
 {
-    // propagate the feature down the tree
-    //    std::vector<NodeId> nodes;
-    //    typename std::vector<NodeId>::const_iterator nit;
+    WordId word_id;
+    WordValue weight;
+    NodeId nid;
+    transform(&feature, 1, levelsup, &word_id, &weight, &nid);
+    return {word_id, weight, nid};
+}
 
-    // level at which the node must be stored in nid, if given
-    const int nid_level = m_L - levelsup;
+// --------------------------------------------------------------------------
 
-    NodeId nid = 0;
+template <class Descriptor>
+void TemplatedVocabulary<Descriptor>::transform(const Descriptor* features, int n, int levelsup, WordId* word_ids,
+                                                WordValue* weights, NodeId* node_ids) const
+{
+    // level at which the node must be stored in node_ids
+    const int nid_level = m_L - levelsup;
 
-    NodeId final_id   = 0;  // root
-    int current_level = 0;
+    constexpr int group = 16;
+    const FlatNode* nodes[group];
 
-    do
+    for (int begin = 0; begin < n; begin += group)
     {
-        ++current_level;
-        auto& nodes = m_nodes[final_id].children;
-        final_id    = nodes[0];
-
-        auto best_d = Saiga::distance(feature, m_nodes[final_id].descriptor);
+        int m = std::min(group, n - begin);
+        for (int i = 0; i < m; ++i)
+        {
+            nodes[i]            = &flat_root;
+            node_ids[begin + i] = 0;
+        }
 
-        for (auto nit = nodes.begin() + 1; nit != nodes.end(); ++nit)
+        // propagate the features down the tree
+        for (int level = 1, active = m; active > 0; ++level)
         {
-            NodeId id = *nit;
-            auto d    = Saiga::distance(feature, m_nodes[id].descriptor);
-            if (d < best_d)
+            active = 0;
+            for (int i = 0; i < m; ++i)
             {
-                best_d   = d;
-                final_id = id;
+                const FlatNode* node = nodes[i];
+                if (node->num_children == 0) continue;
+
+                int c = Saiga::HammingNearest(features[begin + i], flat_blocks.data() + node->child_begin * 4,
+                                              node->num_children, flat_kernel);
+                nodes[i] = &flat_nodes[node->child_begin + c];
+                if (level == nid_level) node_ids[begin + i] = nodes[i]->id;
+                active++;
             }
         }
 
-        if (current_level == nid_level) nid = final_id;
+        for (int i = 0; i < m; ++i)
+        {
+            word_ids[begin + i] = nodes[i]->word_id;
+            weights[begin + i]  = nodes[i]->weight;
+        }
+    }
+}
 
-    } while (!m_nodes[final_id].isLeaf());
+// --------------------------------------------------------------------------
 
-    // turn node id into word id
-    WordId word_id   = m_nodes[final_id].word_id;
-    WordValue weight = m_nodes[final_id].weight;
+template <class Descriptor>
+void TemplatedVocabulary<Descriptor>::compile()
+{
+    static_assert(std::is_same<Descriptor, Saiga::DescriptorORB>::value, "The flat tree is only implemented for ORB.");
 
-    return {word_id, weight, nid};
+    flat_kernel = Saiga::SelectHammingKernel(Saiga::HammingKernel::Auto);
+    flat_nodes.clear();
+    flat_blocks.clear();
+    flat_root = FlatNode{0, 0, 0, 0, 0};
+    if (m_nodes.empty()) return;
+
+    auto make_node = [this](NodeId id) {
+        const Node& n = m_nodes[id];
+        return FlatNode{id, 0, (int)n.children.size(), n.word_id, n.weight};
+    };
+    flat_root = make_node(0);
+
+    // Breadth first. -1 is the root
+    std::vector<int> queue = {-1};
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        FlatNode& node = queue[q] < 0 ? flat_root : flat_nodes[queue[q]];
+        if (node.num_children == 0) continue;
+
+        const auto& children = m_nodes[node.id].children;
+        node.child_begin     = flat_nodes.size();
+        for (NodeId c : children)
+        {
+            queue.push_back(flat_nodes.size());
+            flat_nodes.push_back(make_node(c));
+        }
+        // Padding, so that every node has its own blocks
+        while (flat_nodes.size() % 8 != 0) flat_nodes.push_back(FlatNode{-1, 0, 0, 0, 0});
+    }
+
+    std::vector<Descriptor> descriptors(flat_nodes.size(), Descriptor{});
+    for (size_t i = 0; i < flat_nodes.size(); ++i)
+    {
+        if (flat_nodes[i].id >= 0) descriptors[i] = m_nodes[flat_nodes[i].id].descriptor;
+    }
+    flat_blocks.resize(Saiga::HammingBlocksSize(descriptors.size()));
+    Saiga::HammingTransposeBlocks(descriptors, flat_blocks.data());
 }
 
 // --------------------------------------------------------------------------
@@ -1037,19 +1149,38 @@ void TemplatedVocabulary<Descriptor>::getWordsFromNode(NodeId nid, std::vector<W
 template <class Descriptor>
 void TemplatedVocabulary<Descriptor>::loadRaw(const std::string& file)
 {
-    Saiga::BinaryFile bf(file, std::ios_base::in);
-    if (!bf.strm.is_open())
+    // Read the whole file at once. Parsing the ~1M nodes of the ORB-SLAM vocabulary directly from the stream is slow.
+    std::ifstream strm(file, std::ios::binary | std::ios::ate);
+    if (!strm.is_open())
     {
         throw std::runtime_error("Could not load Voc file.");
     }
+    std::vector<char> data(strm.tellg());
+    strm.seekg(0);
+    strm.read(data.data(), data.size());
+
+    // id, parent, weight, word_id, descriptor
+    constexpr size_t node_size = 3 * sizeof(int) + sizeof(double) + sizeof(Descriptor);
+    // parameters, node count and word count
+    constexpr size_t header = 4 * sizeof(int) + 2 * sizeof(size_t);
+    if (!strm || data.size() < header)
+    {
+        throw std::runtime_error("Invalid Voc file.");
+    }
+
+    Saiga::BinaryInputVector bf(data.data(), data.size());
     int scoringid;
     int m_weighting_old;
     bf >> m_k >> m_L >> scoringid >> m_weighting_old;
 
-
-
     size_t nodecount;
     bf >> nodecount;
+    if (nodecount == 0 || nodecount > (data.size() - header) / node_size)
+    {
+        throw std::runtime_error("Invalid Voc file.");
+    }
+
+    m_nodes.clear();
     m_nodes.resize(nodecount);
     for (Node& n : m_nodes)
     {
@@ -1060,14 +1191,22 @@ void TemplatedVocabulary<Descriptor>::loadRaw(const std::string& file)
     }
 
     // words
-    std::vector<std::pair<int, int>> words;
-    bf >> words;
+    size_t wordcount;
+    bf >> wordcount;
+    if (wordcount > (data.size() - bf.current) / sizeof(std::pair<int, int>))
+    {
+        throw std::runtime_error("Invalid Voc file.");
+    }
+    std::vector<std::pair<int, int>> words(wordcount);
+    for (auto& w : words) bf >> w;
 
     m_words.resize(words.size());
     for (auto i = 0; i < m_words.size(); ++i)
     {
         m_words[i] = &m_nodes[words[i].second];
     }
+
+    compile();
 }
 
 
@@ -152,6 +152,7 @@ OptimizationResults LMOptimizer::solve()
             solveLinearSystem();
         }
         result.linear_solver_time += ltime;
+        result.iterations++;
 
         addDelta();
 
@@ -283,6 +284,7 @@ OptimizationResults LMOptimizer::solveOMP()
 
 #pragma omp single
             {
+                result.iterations++;
                 if (newChi2 < current_chi2)
                 {
                     // accept
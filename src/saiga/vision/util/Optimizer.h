@@ -23,6 +23,9 @@ struct SAIGA_VISION_API OptimizationResults
     double jtj_time           = 0;
     double total_time         = 0;
 
+    // Number of solved linear systems (the LM optimizer may terminate early)
+    int iterations = 0;
+
     bool success = false;
 };
 
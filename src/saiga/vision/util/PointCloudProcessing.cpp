@@ -0,0 +1,321 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "PointCloudProcessing.h"
+
+#include "saiga/core/geometry/kdtree.h"
+
+namespace Saiga
+{
+namespace
+{
+// The points are grouped in two passes. First, they are scattered into a fixed number of partitions by the hash of
+// their voxel. Then each partition is reduced independently with a small open addressing hash table.
+constexpr int NUM_PARTITIONS = 256;
+constexpr int CHUNK_SIZE     = 16 * 1024;
+
+// 21 bits per axis -> voxel coordinates in [-2^20, 2^20)
+uint64_t VoxelKey(const vec3& p, float voxel_size_inv)
+{
+    constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+    ivec3 v                 = (p * voxel_size_inv).array().floor().cast<int>();
+    uint64_t x              = uint64_t(v.x() + (1 << 20)) & mask;
+    uint64_t y              = uint64_t(v.y() + (1 << 20)) & mask;
+    uint64_t z              = uint64_t(v.z() + (1 << 20)) & mask;
+    return x | (y << 21) | (z << 42);
+}
+
+// Finalizer of splitmix64
+uint64_t HashKey(uint64_t k)
+{
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return k;
+}
+
+// The upper 8 bits select the partition, the lower bits are used inside the partition.
+int Partition(uint64_t hash)
+{
+    return hash >> 56;
+}
+
+}  // namespace
+
+std::vector<vec3> VoxelGridDownsample(const std::vector<vec3>& points, float voxel_size,
+                                      std::vector<int>* voxel_of_point)
+{
+    SAIGA_ASSERT(voxel_size > 0);
+
+    int N                = points.size();
+    int num_chunks       = iDivUp(N, CHUNK_SIZE);
+    float voxel_size_inv = 1.0f / voxel_size;
+
+    // Pass 1: Hash all points and count the points of each (chunk, partition) pair
+    std::vector<uint64_t> hashes(N);
+    std::vector<uint64_t> keys(N);
+    std::vector<int> offsets(num_chunks * NUM_PARTITIONS, 0);
+#pragma omp parallel for
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        int* count = offsets.data() + c * NUM_PARTITIONS;
+        for (int i = c * CHUNK_SIZE; i < std::min(N, (c + 1) * CHUNK_SIZE); ++i)
+        {
+            keys[i]   = VoxelKey(points[i], voxel_size_inv);
+            hashes[i] = HashKey(keys[i]);
+            count[Partition(hashes[i])]++;
+        }
+    }
+
+    // Exclusive prefix sum in partition major order
+    // -> The points of a partition are ordered by their index and the result doesn't depend on the thread count.
+    std::vector<int> partition_begin(NUM_PARTITIONS + 1);
+    int running = 0;
+    for (int p = 0; p < NUM_PARTITIONS; ++p)
+    {
+        partition_begin[p] = running;
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            int n                           = offsets[c * NUM_PARTITIONS + p];
+            offsets[c * NUM_PARTITIONS + p] = running;
+            running += n;
+        }
+    }
+    partition_begin[NUM_PARTITIONS] = running;
+
+    // Pass 2: Scatter the point indices into the partitions
+    std::vector<int> order(N);
+#pragma omp parallel for
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        int* offset = offsets.data() + c * NUM_PARTITIONS;
+        for (int i = c * CHUNK_SIZE; i < std::min(N, (c + 1) * CHUNK_SIZE); ++i)
+        {
+            order[offset[Partition(hashes[i])]++] = i;
+        }
+    }
+
+    // Pass 3: Reduce each partition. The voxel id is local to the partition.
+    std::vector<std::vector<vec3>> centroids(NUM_PARTITIONS);
+    std::vector<int> local_voxel(N);
+#pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < NUM_PARTITIONS; ++p)
+    {
+        int begin = partition_begin[p];
+        int end   = partition_begin[p + 1];
+        if (begin == end) continue;
+
+        int table_size = 1;
+        while (table_size < 2 * (end - begin)) table_size *= 2;
+        std::vector<std::pair<uint64_t, int>> table(table_size, {0, -1});
+
+        std::vector<Vec3> sums;
+        std::vector<int> counts;
+        for (int j = begin; j < end; ++j)
+        {
+            int i   = order[j];
+            int pos = hashes[i] & (table_size - 1);
+            while (table[pos].second != -1 && table[pos].first != keys[i])
+            {
+                pos = (pos + 1) & (table_size - 1);
+            }
+
+            auto& entry = table[pos];
+            if (entry.second == -1)
+            {
+                entry = {keys[i], (int)sums.size()};
+                sums.push_back(Vec3::Zero());
+                counts.push_back(0);
+            }
+            sums[entry.second] += points[i].cast<double>();
+            counts[entry.second]++;
+            local_voxel[i] = entry.second;
+        }
+
+        auto& result = centroids[p];
+        result.resize(sums.size());
+        for (size_t v = 0; v < sums.size(); ++v)
+        {
+            result[v] = (sums[v] / counts[v]).cast<float>();
+        }
+    }
+
+    std::vector<int> partition_offset(NUM_PARTITIONS + 1, 0);
+    for (int p = 0; p < NUM_PARTITIONS; ++p)
+    {
+        partition_offset[p + 1] = partition_offset[p] + centroids[p].size();
+    }
+
+    std::vector<vec3> result(partition_offset.back());
+#pragma omp parallel for
+    for (int p = 0; p < NUM_PARTITIONS; ++p)
+    {
+        std::copy(centroids[p].begin(), centroids[p].end(), result.begin() + partition_offset[p]);
+    }
+
+    if (voxel_of_point)
+    {
+        voxel_of_point->resize(N);
+#pragma omp parallel for
+        for (int i = 0; i < N; ++i)
+        {
+            (*voxel_of_point)[i] = partition_offset[Partition(hashes[i])] + local_voxel[i];
+        }
+    }
+    return result;
+}
+
+std::vector<vec3> EstimateNormals(const std::vector<vec3>& points, int k, const vec3& view_point)
+{
+    SAIGA_ASSERT(k >= 3);
+    int N = points.size();
+    std::vector<vec3> normals(N);
+    if (N == 0) return normals;
+
+    KDTree<3, vec3> tree(points);
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < N; ++i)
+    {
+        auto neighbors = tree.KNearestNeighborSearch(points[i], k);
+        if (neighbors.size() < 3)
+        {
+            normals[i] = vec3::Zero();
+            continue;
+        }
+
+        vec3 mean = vec3::Zero();
+        for (auto n : neighbors) mean += points[n];
+        mean /= neighbors.size();
+
+        mat3 cov = mat3::Zero();
+        for (auto n : neighbors)
+        {
+            vec3 d = points[n] - mean;
+            cov += d * d.transpose();
+        }
+
+        // The eigenvalues are sorted in increasing order
+        Eigen::SelfAdjointEigenSolver<mat3> solver;
+        solver.computeDirect(cov);
+        vec3 normal = solver.eigenvectors().col(0);
+
+        if (normal.dot(view_point - points[i]) < 0) normal = -normal;
+        normals[i] = normal;
+    }
+    return normals;
+}
+
+std::vector<int> StatisticalOutlierRemoval(const std::vector<vec3>& points, int k, float std_ratio)
+{
+    SAIGA_ASSERT(k >= 1);
+    int N = points.size();
+    if (N == 0) return {};
+
+    KDTree<3, vec3> tree(points);
+
+    // The mean distance to the k neighbors. Negative if the point has no neighbours.
+    std::vector<float> mean_distance(N);
+    double sum = 0, sum_sq = 0;
+    int valid  = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+ : sum, sum_sq, valid)
+    for (int i = 0; i < N; ++i)
+    {
+        // +1 because the point itself is part of the result. For duplicate points a duplicate can be returned instead
+        // of the point itself. The k nearest other points are then the first k results.
+        auto neighbors = tree.KNearestNeighborSearch(points[i], k + 1);
+
+        float d = 0;
+        int n   = 0;
+        for (auto j : neighbors)
+        {
+            if (j == i) continue;
+            if (n == k) break;
+            d += (points[j] - points[i]).norm();
+            n++;
+        }
+
+        if (n == 0)
+        {
+            mean_distance[i] = -1;
+            continue;
+        }
+        d /= n;
+        mean_distance[i] = d;
+        sum += d;
+        sum_sq += double(d) * d;
+        valid++;
+    }
+
+    if (valid == 0) return {};
+    double mean      = sum / valid;
+    double variance  = std::max(0.0, sum_sq / valid - mean * mean);
+    double threshold = mean + std_ratio * std::sqrt(variance);
+
+    std::vector<int> inliers;
+    inliers.reserve(N);
+    for (int i = 0; i < N; ++i)
+    {
+        if (mean_distance[i] >= 0 && mean_distance[i] <= threshold) inliers.push_back(i);
+    }
+    return inliers;
+}
+
+std::vector<int> RadiusOutlierRemoval(const std::vector<vec3>& points, float radius, int min_neighbors)
+{
+    int N = points.size();
+    if (N == 0) return {};
+
+    KDTree<3, vec3> tree(points);
+
+    std::vector<unsigned char> inlier(N);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < N; ++i)
+    {
+        // The point itself is included in the result
+        int neighbors = int(tree.RadiusSearch(points[i], radius).size()) - 1;
+        inlier[i]     = neighbors >= min_neighbors;
+    }
+
+    std::vector<int> inliers;
+    for (int i = 0; i < N; ++i)
+    {
+        if (inlier[i]) inliers.push_back(i);
+    }
+    return inliers;
+}
+
+PreprocessedPointCloud PreprocessPointCloud(const std::vector<vec3>& points, const PointCloudPreprocessParams& params)
+{
+    PreprocessedPointCloud result;
+
+    if (params.voxel_size > 0)
+    {
+        result.points = VoxelGridDownsample(points, params.voxel_size);
+    }
+    else
+    {
+        result.points = points;
+    }
+
+    if (params.outlier_k > 0)
+    {
+        auto inliers = StatisticalOutlierRemoval(result.points, params.outlier_k, params.outlier_std_ratio);
+        std::vector<vec3> filtered(inliers.size());
+        for (size_t i = 0; i < inliers.size(); ++i)
+        {
+            filtered[i] = result.points[inliers[i]];
+        }
+        result.points = std::move(filtered);
+    }
+
+    result.normals = EstimateNormals(result.points, params.normal_k, params.view_point);
+    return result;
+}
+
+}  // namespace Saiga
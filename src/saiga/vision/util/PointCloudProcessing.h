@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/vision/VisionTypes.h"
+
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * Preprocessing of unorganized point clouds.
+ * For organized point clouds (depth images) see Depthmap.h.
+ *
+ * All functions are multi-threaded with OpenMP.
+ */
+
+/**
+ * Replaces all points inside a voxel of size 'voxel_size' by their centroid.
+ *
+ * The points are grouped with a spatial hash instead of sorting, therefore the runtime is linear in the number of
+ * points. The output is deterministic and independent of the number of threads.
+ *
+ * If 'voxel_of_point' is not null, it is set to the output index of each input point. This can be used to
+ * downsample additional attributes.
+ */
+SAIGA_VISION_API std::vector<vec3> VoxelGridDownsample(const std::vector<vec3>& points, float voxel_size,
+                                                       std::vector<int>* voxel_of_point = nullptr);
+
+/**
+ * Normal estimation by principal component analysis of the k nearest neighbours (including the point itself).
+ *
+ * The normals are oriented towards 'view_point'. Points with less than 3 neighbours get a zero normal.
+ */
+SAIGA_VISION_API std::vector<vec3> EstimateNormals(const std::vector<vec3>& points, int k = 10,
+                                                   const vec3& view_point = vec3::Zero());
+
+/**
+ * Statistical outlier removal.
+ *
+ * Computes the mean distance of each point to its k nearest neighbours. A point is an outlier, if this distance
+ * is larger than mean + std_ratio * standard deviation (over all points).
+ *
+ * Returns the indices of the inliers in increasing order.
+ */
+SAIGA_VISION_API std::vector<int> StatisticalOutlierRemoval(const std::vector<vec3>& points, int k = 20,
+                                                            float std_ratio = 2);
+
+/**
+ * Removes all points with less than 'min_neighbors' other points in the given radius.
+ *
+ * Returns the indices of the inliers in increasing order.
+ */
+SAIGA_VISION_API std::vector<int> RadiusOutlierRemoval(const std::vector<vec3>& points, float radius,
+                                                       int min_neighbors);
+
+
+struct SAIGA_VISION_API PointCloudPreprocessParams
+{
+    // 0 disables the downsampling
+    float voxel_size = 0.01;
+
+    // 0 disables the outlier removal
+    int outlier_k           = 20;
+    float outlier_std_ratio = 2;
+
+    int normal_k    = 10;
+    vec3 view_point = vec3::Zero();
+};
+
+struct SAIGA_VISION_API PreprocessedPointCloud
+{
+    std::vector<vec3> points;
+    std::vector<vec3> normals;
+};
+
+/**
+ * Downsampling -> Outlier removal -> Normal estimation
+ *
+ * A typical preprocessing before a global registration (for example RegistrationRANSAC) or ICP.
+ */
+SAIGA_VISION_API PreprocessedPointCloud PreprocessPointCloud(const std::vector<vec3>& points,
+                                                             const PointCloudPreprocessParams& params);
+
+}  // namespace Saiga
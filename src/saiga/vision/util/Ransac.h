@@ -9,6 +9,10 @@
 #include "saiga/core/util/Thread/omp.h"
 #include "saiga/vision/VisionTypes.h"
 
+#include <algorithm>
+#include <atomic>
+#include <random>
+
 
 namespace Saiga
 {
@@ -32,10 +36,69 @@ struct RansacParameters
     int reserveN = 0;
 
     // Number of omp threads in that group
-    // Note:
+    // Note: If compute() is called outside of a parallel region, a team of this size is created.
     int threads = 1;
+
+    // Adaptive termination. After every new best model the number of iterations is reduced to
+    //    log(1 - confidence) / log(1 - w^ModelSize)
+    // where w is the inlier ratio of this model. maxIterations is the upper bound.
+    // With 30% outliers and maxIterations=1000 (see sample_vision_ransac_benchmark) this reduces the time of the
+    // five point RANSAC from 87 to 7 ms, homography from 20 to 1.2 ms and P3P from 5 to 0.15 ms.
+    bool adaptive     = true;
+    double confidence = 0.999;
+
+    // PROSAC sampling [Chum, Matas 2005]. The first samples are drawn from the best points and the sampling set grows
+    // until it contains all points at maxIterations. The points must be sorted by quality (best first), for example by
+    // ascending descriptor distance.
+    bool prosac = false;
+
+    // SPRT model verification [Matas, Chum 2005]. The residuals of a model are evaluated until the likelihood ratio
+    // shows that it is a bad model. The probability that a point is consistent with a bad model (sprt_delta) and the
+    // inlier ratio (sprt_epsilon) are updated during the run. sprt_model_cost is the time of computeModel() relative to
+    // one computeResidual().
+    //
+    // sprt_epsilon must be a lower bound of the inlier ratio, because models with less inliers are rejected. It is
+    // raised to the inlier ratio of the best model and halved after kSprtMaxRejections rejections in a row. The test
+    // is only active while epsilon > delta. With 30% outliers the SPRT saves ~10% on top of the adaptive termination.
+    bool sprt              = false;
+    double sprt_delta      = 0.05;
+    double sprt_epsilon    = 0.05;
+    double sprt_model_cost = 200;
 };
 
+// Number of iterations to draw at least one outlier free sample with the given probability.
+inline int RansacRequiredIterations(double inlier_ratio, int sample_size, double confidence, int maxIterations)
+{
+    if (confidence >= 1) return maxIterations;
+    if (inlier_ratio >= 1) return 1;
+
+    double p = pow(inlier_ratio, sample_size);
+    if (p <= 0) return maxIterations;
+
+    double k = log(1 - confidence) / std::log1p(-p);
+    return std::max(1, (int)std::min<double>(ceil(k), maxIterations));
+}
+
+// Points in a structure of arrays layout for the vectorized computeResiduals() of the derived classes.
+template <int Dim>
+struct RansacPoints
+{
+    std::array<std::vector<double>, Dim> coeffs;
+
+    void set(ArrayView<const Eigen::Matrix<double, Dim, 1>> points)
+    {
+        for (int d = 0; d < Dim; ++d)
+        {
+            coeffs[d].resize(points.size());
+            for (int i = 0; i < (int)points.size(); ++i)
+            {
+                coeffs[d][i] = points[i](d);
+            }
+        }
+    }
+
+    const double* operator[](int d) const { return coeffs[d].data(); }
+};
 
 template <typename Derived, typename Model, int ModelSize>
 class RansacBase
@@ -47,26 +110,33 @@ class RansacBase
         SAIGA_ASSERT(params.maxIterations > 0);
         SAIGA_ASSERT(OMP::getNumThreads() == 1);
 
-        numInliers.resize(params.maxIterations);
-        models.resize(params.maxIterations);
-
-        residuals.resize(params.maxIterations);
-        for (auto&& r : residuals) r.reserve(params.reserveN);
-
-        inliers.resize(params.maxIterations);
-        for (auto&& r : inliers) r.reserve(params.reserveN);
-
         SAIGA_ASSERT(params.threads >= 1);
-        generators.resize(params.threads);
-        threadLocalBestModel.resize(params.threads);
+        threadData.resize(params.threads);
         for (int i = 0; i < params.threads; ++i)
         {
-            generators[i].seed(ransacRandomSeed + 6643838879UL * i);
+            auto& td = threadData[i];
+            td.generator.seed(ransacRandomSeed + 6643838879UL * i);
+            td.inlier.reserve(params.reserveN);
+            td.best_inlier.reserve(params.reserveN);
         }
+        bestInlierMask.reserve(params.reserveN);
     }
 
     const RansacParameters& Params() const { return params; }
 
+    // Residuals of the points [begin, end) written to residuals[0, end - begin). Derived classes can hide this
+    // function with a vectorized version. The default calls computeResidual() for every point.
+    void computeResiduals(const Model& model, int begin, int end, double* residuals)
+    {
+        for (int j = begin; j < end; ++j)
+        {
+            residuals[j - begin] = derived().computeResidual(model, j);
+        }
+    }
+
+    // Number of hypotheses of the last compute(). Smaller than maxIterations in adaptive mode.
+    int Iterations() const { return numIterations; }
+
    protected:
     // indices of subset
     using Subset = std::array<int, ModelSize>;
@@ -75,99 +145,291 @@ class RansacBase
     RansacBase(const RansacParameters& _params) { init(_params); }
 
 
-
+    // Returns the number of inliers of the best model. The model and its inlier mask are stored in bestModel and
+    // bestInlierMask. Must be called by all threads of a team of size params.threads or outside of a parallel region.
+    //
+    // Iteration 'it' is processed by thread 'it % threads' with the generator of that thread. Without the adaptive
+    // termination and SPRT the result therefore doesn't depend on the scheduling. Disable both for reproducible
+    // multi-threaded results.
     int compute(int _N)
     {
         SAIGA_ASSERT(params.maxIterations > 0);
-        SAIGA_ASSERT(OMP::getNumThreads() == params.threads);
 
-        int tid = OMP::getThreadNum();
-        // compute random sample subsets
-        std::uniform_int_distribution<int> dis(0, _N - 1);
-        auto& gen = generators[tid];
+        if (params.threads > 1 && OMP::getNumThreads() == 1)
+        {
+#pragma omp parallel num_threads(params.threads)
+            {
+                computeTeam(_N);
+            }
+        }
+        else
+        {
+            SAIGA_ASSERT(OMP::getNumThreads() == params.threads);
+            computeTeam(_N);
+        }
+        return bestNumInliers;
+    }
+
+
+    // total number of sample points
+    int N;
+    RansacParameters params;
+
+    // The result of compute()
+    Model bestModel;
+    std::vector<char> bestInlierMask;
+    int bestNumInliers = 0;
+    int numIterations  = 0;
+
+   private:
+    struct SAIGA_ALIGN_CACHE ThreadData
+    {
+        std::mt19937 generator;
+
+        Model model, best_model;
+        std::vector<char> inlier, best_inlier;
+        std::vector<double> residual;
+        int best_inliers = 0;
+        int best_it      = -1;
+        int iterations   = 0;
+
+        // SPRT state
+        double delta, epsilon, A;
+        int sprt_rejections = 0;
+    };
 
+    // Number of residuals computed at once. The SPRT is evaluated after each block.
+    static constexpr int kResidualBlock = 256;
 
-        auto& bestModel = threadLocalBestModel[tid]();
-        bestModel       = {0, 0};
+    // Consecutive SPRT rejections after which epsilon is assumed to be overestimated.
+    static constexpr int kSprtMaxRejections = 50;
 
+    // make sure we don't run into false sharing
+    AlignedVector<ThreadData, SAIGA_CACHE_LINE_SIZE> threadData;
+
+    // PROSAC: Iteration t (1 based) samples from the first n points, where n is the smallest value with
+    // prosacGrowth[n - ModelSize] >= t.
+    std::vector<int> prosacGrowth;
+
+    std::atomic<int> requiredIterations;
+
+    Derived& derived() { return *static_cast<Derived*>(this); }
+
+    void computeTeam(int _N)
+    {
+        int tid  = OMP::getThreadNum();
+        auto& td = threadData[tid];
 
-#pragma omp for
-        for (int it = 0; it < params.maxIterations; ++it)
+#pragma omp single
         {
-            auto& model     = models[it];
-            auto& inlier    = inliers[it];
-            auto& residual  = residuals[it];
-            auto& numInlier = numInliers[it];
+            N                  = _N;
+            requiredIterations = params.maxIterations;
+            if (params.prosac) computeProsacGrowth();
+        }
 
-            numInlier = 0;
-            residual.resize(_N);
-            inlier.resize(_N);
+        td.inlier.resize(N);
+        td.best_inliers = 0;
+        td.best_it      = -1;
+        td.iterations   = 0;
+        td.delta        = params.sprt_delta;
+        td.epsilon         = params.sprt_epsilon;
+        td.sprt_rejections = 0;
+        updateSprt(td);
 
-            Subset set;
-            for (auto j : Range(0, ModelSize))
+        for (int it = tid; it < requiredIterations.load(std::memory_order_relaxed); it += params.threads)
+        {
+            td.iterations++;
+
+            Subset set = sample(it, td.generator);
+            if (!derived().computeModel(set, td.model)) continue;
+
+            int numInlier = evaluate(td);
+
+            if (numInlier > td.best_inliers)
             {
-                auto idx = dis(gen);
-                set[j]   = idx;
+                std::swap(td.model, td.best_model);
+                std::swap(td.inlier, td.best_inlier);
+                td.inlier.resize(N);
+                td.best_inliers = numInlier;
+                td.best_it      = it;
+
+                if (params.sprt && numInlier > td.epsilon * N)
+                {
+                    td.epsilon = double(numInlier) / N;
+                    updateSprt(td);
+                }
+
+                if (params.adaptive)
+                {
+                    int k   = RansacRequiredIterations(double(numInlier) / N, ModelSize, params.confidence,
+                                                     params.maxIterations);
+                    int cur = requiredIterations.load();
+                    while (k < cur && !requiredIterations.compare_exchange_weak(cur, k))
+                    {
+                    }
+                }
             }
+        }
 
-            if (!derived().computeModel(set, model)) continue;
+#pragma omp barrier
 
-            for (int j = 0; j < _N; ++j)
+#pragma omp single
+        {
+            int best       = 0;
+            numIterations  = 0;
+            bestNumInliers = 0;
+            for (int th = 0; th < params.threads; ++th)
             {
-                residual[j] = derived().computeResidual(model, j);
+                auto& t = threadData[th];
+                numIterations += t.iterations;
+                if (t.best_inliers > bestNumInliers ||
+                    (t.best_inliers == bestNumInliers && t.best_it < threadData[best].best_it))
+                {
+                    bestNumInliers = t.best_inliers;
+                    best           = th;
+                }
+            }
 
-                bool inl  = residual[j] < params.residualThreshold;
-                inlier[j] = inl;
-                numInlier += inl;
+            auto& t = threadData[best];
+            if (bestNumInliers > 0)
+            {
+                bestModel = t.best_model;
+                std::swap(bestInlierMask, t.best_inlier);
             }
+            else
+            {
+                bestInlierMask.assign(N, 0);
+            }
+        }
+    }
 
-            if (numInlier > bestModel.first)
+    Subset sample(int it, std::mt19937& gen)
+    {
+        Subset set;
+        if (!params.prosac || N <= ModelSize || it + 1 > prosacGrowth.back())
+        {
+            std::uniform_int_distribution<int> dis(0, N - 1);
+            for (auto j : Range(0, ModelSize))
             {
-                bestModel.first  = numInlier;
-                bestModel.second = it;
+                set[j] = dis(gen);
             }
+            return set;
         }
 
-#pragma omp single
+        // The point n-1 and ModelSize-1 different points of [0, n-1)
+        int n = std::lower_bound(prosacGrowth.begin(), prosacGrowth.end(), it + 1) - prosacGrowth.begin() + ModelSize;
+        std::uniform_int_distribution<int> dis(0, n - 2);
+        set[ModelSize - 1] = n - 1;
+        for (int j = 0; j < ModelSize - 1; ++j)
         {
-            N             = _N;
-            bestIdx       = 0;
-            int bestCount = 0;
-            for (int th = 0; th < params.threads; ++th)
+            int idx;
+            do
             {
-                auto&& thbestModel = threadLocalBestModel[th]();
-                auto inl           = thbestModel.first;
-                auto it            = thbestModel.second;
-                //                std::cout << "th best " << th << " " << it << " " << inl << std::endl;
-                if (inl > bestCount)
+                idx = dis(gen);
+            } while (std::find(set.begin(), set.begin() + j, idx) != set.begin() + j);
+            set[j] = idx;
+        }
+        return set;
+    }
+
+    // Returns the number of inliers or -1 if the model was rejected by the SPRT.
+    int evaluate(ThreadData& td)
+    {
+        int numInlier = 0;
+        bool test     = params.sprt && td.epsilon > td.delta;
+        double lambda = 1;
+
+        double consistent   = td.delta / td.epsilon;
+        double inconsistent = (1 - td.delta) / (1 - td.epsilon);
+
+        td.residual.resize(kResidualBlock);
+        double* residual = td.residual.data();
+        char* inlier     = td.inlier.data();
+        double threshold = params.residualThreshold;
+
+        for (int begin = 0; begin < N; begin += kResidualBlock)
+        {
+            int end = std::min(N, begin + kResidualBlock);
+            derived().computeResiduals(td.model, begin, end, residual);
+
+            if (!test)
+            {
+#pragma omp simd reduction(+ : numInlier)
+                for (int j = begin; j < end; ++j)
                 {
-                    bestCount = inl;
-                    bestIdx   = it;
+                    char inl  = residual[j - begin] < threshold;
+                    inlier[j] = inl;
+                    numInlier += inl;
+                }
+                continue;
+            }
+
+            for (int j = begin; j < end; ++j)
+            {
+                bool inl  = residual[j - begin] < threshold;
+                inlier[j] = inl;
+                numInlier += inl;
+
+                lambda *= inl ? consistent : inconsistent;
+                if (lambda > td.A)
+                {
+                    // The model is bad. Its inlier ratio is an estimate of delta.
+                    td.delta = 0.95 * td.delta + 0.05 * double(numInlier) / (j + 1);
+                    td.delta = std::max(td.delta, 1e-3);
+
+                    // Also the correct model is rejected if epsilon is larger than the actual inlier ratio.
+                    if (++td.sprt_rejections >= kSprtMaxRejections)
+                    {
+                        td.epsilon *= 0.5;
+                        td.sprt_rejections = 0;
+                    }
+                    updateSprt(td);
+                    return -1;
                 }
             }
         }
-        return bestIdx;
+        td.sprt_rejections = 0;
+        return numInlier;
     }
 
+    // The decision threshold A is the solution of A = K + 1 + log(A) [Matas, Chum 2005].
+    void updateSprt(ThreadData& td)
+    {
+        double d = td.delta;
+        double e = std::min(td.epsilon, 1 - 1e-6);
+        double C = (1 - d) * log((1 - d) / (1 - e)) + d * log(d / e);
+        double K = params.sprt_model_cost * C;
 
-    // total number of sample points
-    int N;
-    RansacParameters params;
-    AlignedVector<std::vector<double>> residuals;
-    AlignedVector<std::vector<char>> inliers;
-    AlignedVector<int> numInliers;
-    AlignedVector<Model> models;
-
-    // make sure we don't run into false sharing
-    AlignedVector<AlignedStruct<std::pair<int, int>, SAIGA_CACHE_LINE_SIZE>> threadLocalBestModel;
+        td.A = K + 1;
+        for (int i = 0; i < 10; ++i)
+        {
+            td.A = K + 1 + log(td.A);
+        }
+    }
 
-    // each thread has one generator
-    std::vector<std::mt19937> generators;
+    void computeProsacGrowth()
+    {
+        prosacGrowth.clear();
+        if (N <= ModelSize) return;
 
-    int bestIdx;
+        // T_n: Expected number of samples from the first n points in maxIterations uniform samples
+        double T_n = params.maxIterations;
+        for (int i = 0; i < ModelSize; ++i)
+        {
+            T_n *= double(ModelSize - i) / (N - i);
+        }
 
-   private:
-    Derived& derived() { return *static_cast<Derived*>(this); }
+        int T_n_prime = 1;
+        prosacGrowth.resize(N - ModelSize + 1);
+        prosacGrowth[0] = T_n_prime;
+        for (int n = ModelSize + 1; n <= N; ++n)
+        {
+            double T_n_next = T_n * n / (n - ModelSize);
+            T_n_prime += (int)ceil(T_n_next - T_n);
+            T_n = T_n_next;
+            prosacGrowth[n - ModelSize] = T_n_prime;
+        }
+    }
 };
 
 inline int RansacIterationsFromProbability(int input_N, double probability, int minInliers, int maxIterations)
@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/geometry/AccelerationStructure.h"
+#include "saiga/core/time/performanceMeasure.h"
+#include "saiga/core/util/table.h"
+
+#include "gtest/gtest.h"
+
+using namespace Saiga;
+using namespace Saiga::AccelerationStructure;
+
+std::vector<Triangle> RandomTriangles(int n, float size)
+{
+    std::vector<Triangle> result;
+    for (int i = 0; i < n; ++i)
+    {
+        Triangle t;
+        t.a = Random::MatrixUniform<vec3>(-1, 1);
+        t.b = t.a + Random::MatrixGauss<vec3>(0, size);
+        t.c = t.a + Random::MatrixGauss<vec3>(0, size);
+        result.push_back(t);
+    }
+    return result;
+}
+
+// Coherent rays from a point outside the unit cube
+std::vector<Ray> RandomRays(int n)
+{
+    std::vector<Ray> result;
+    vec3 origin(0.3, 0.5, 4);
+    for (int i = 0; i < n; ++i)
+    {
+        vec3 target = Random::MatrixUniform<vec3>(-1, 1);
+        result.push_back(Ray((target - origin).normalized(), origin));
+    }
+    // Sort by direction to get coherent packets
+    std::sort(result.begin(), result.end(), [](const Ray& a, const Ray& b) {
+        return std::make_pair(int(a.direction.y() * 50), a.direction.x()) <
+               std::make_pair(int(b.direction.y() * 50), b.direction.x());
+    });
+    return result;
+}
+
+// A bumpy height field in the xy-plane with 2*n*n triangles
+std::vector<Triangle> HeightField(int n)
+{
+    auto height = [n](int x, int y) {
+        vec2 p = vec2(x, y) / n * 20;
+        return vec3(float(x) / n * 2 - 1, float(y) / n * 2 - 1, 0.1f * sin(p.x()) * cos(p.y()));
+    };
+
+    std::vector<Triangle> result;
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            result.push_back(Triangle(height(x, y), height(x + 1, y), height(x + 1, y + 1)));
+            result.push_back(Triangle(height(x, y), height(x + 1, y + 1), height(x, y + 1)));
+        }
+    }
+    return result;
+}
+
+// Rays of a w x h camera image looking down on the height field
+std::vector<Ray> CameraRays(int w, int h)
+{
+    std::vector<Ray> result;
+    vec3 origin(0.2, -2, 2);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            vec3 target(float(x) / w * 2 - 1, float(y) / h * 2 - 1, 0);
+            result.push_back(Ray((target - origin).normalized(), origin));
+        }
+    }
+    return result;
+}
+
+// If multiple triangles have the same distance the index is not unique
+void ExpectSameHit(const RayTriangleIntersection& a, const RayTriangleIntersection& b, bool check_index = true)
+{
+    ASSERT_EQ(a.valid, b.valid);
+    if (!a.valid) return;
+    EXPECT_EQ(a.t, b.t);
+    if (check_index) EXPECT_EQ(a.triangleIndex, b.triangleIndex);
+}
+
+void CompareToBruteForce(const std::vector<Triangle>& triangles, BVH& bvh, bool check_index = true)
+{
+    auto rays = RandomRays(2000);
+    BruteForce bf(triangles);
+    auto ref = bf.getClosest(rays);
+
+    int num_hits = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        ExpectSameHit(ref[i], bvh.getClosest(rays[i]), check_index);
+        num_hits += ref[i].valid;
+    }
+    EXPECT_GT(num_hits, 100);
+
+    for (int packet_size : {4, 8})
+    {
+        bvh.packet_size = packet_size;
+        auto result     = bvh.getClosest(rays);
+        ASSERT_EQ(result.size(), rays.size());
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            ExpectSameHit(ref[i], result[i], check_index);
+        }
+    }
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto sort = [](auto v) {
+            std::sort(v.begin(), v.end(), [](auto& a, auto& b) { return a.triangleIndex < b.triangleIndex; });
+            return v;
+        };
+        auto a = sort(bf.getAll(rays[i]));
+        auto b = sort(bvh.getAll(rays[i]));
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t j = 0; j < a.size(); ++j)
+        {
+            ExpectSameHit(a[j], b[j], check_index);
+        }
+    }
+}
+
+TEST(BVH, ObjectMedian)
+{
+    Random::setSeed(93467);
+    auto triangles = RandomTriangles(5000, 0.05);
+    ObjectMedianBVH bvh(triangles);
+    CompareToBruteForce(triangles, bvh);
+}
+
+TEST(BVH, SAH)
+{
+    Random::setSeed(93467);
+    auto triangles = RandomTriangles(5000, 0.05);
+    SAHBVH bvh(triangles);
+    CompareToBruteForce(triangles, bvh);
+
+    // The closest point query uses the binary tree
+    ObjectMedianBVH reference(triangles);
+    for (int i = 0; i < 100; ++i)
+    {
+        vec3 p = Random::MatrixUniform<vec3>(-2, 2);
+        EXPECT_EQ(reference.ClosestPoint(p).first, bvh.ClosestPoint(p).first);
+    }
+}
+
+TEST(BVH, Wide)
+{
+    Random::setSeed(93467);
+    auto triangles = RandomTriangles(5000, 0.05);
+    BVH4 bvh4(triangles);
+    CompareToBruteForce(triangles, bvh4);
+    BVH8 bvh8(triangles);
+    CompareToBruteForce(triangles, bvh8);
+    EXPECT_LT(bvh8.NumWideNodes(), bvh4.NumWideNodes());
+}
+
+TEST(BVH, Degenerate)
+{
+    Random::setSeed(93467);
+    // Many triangles with the same center and a few small ones
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Triangle t;
+        t.a = vec3(-0.5, -0.5, 0);
+        t.b = vec3(0.5, -0.5, 0);
+        t.c = vec3(0, 0.5, 0);
+        triangles.push_back(t);
+    }
+    auto random = RandomTriangles(100, 0.01);
+    triangles.insert(triangles.end(), random.begin(), random.end());
+
+    SAHBVH bvh(triangles);
+    CompareToBruteForce(triangles, bvh, false);
+    BVH8 bvh8(triangles);
+    CompareToBruteForce(triangles, bvh8, false);
+
+    SAHBVH empty(std::vector<Triangle>{});
+    EXPECT_FALSE(empty.getClosest(Ray(vec3(0, 0, 1), vec3(0, 0, 0))).valid);
+}
+
+TEST(BVH, Benchmark)
+{
+    Random::setSeed(93467);
+    auto triangles = HeightField(300);
+    auto rays      = CameraRays(512, 512);
+
+    std::unique_ptr<BVH> median, sah, bvh4, bvh8;
+    auto st_build_median = measureObject(3, [&]() { median = std::make_unique<ObjectMedianBVH>(triangles); });
+    auto st_build_sah    = measureObject(3, [&]() { sah = std::make_unique<SAHBVH>(triangles); });
+    auto st_build_bvh4   = measureObject(3, [&]() { bvh4 = std::make_unique<BVH4>(triangles); });
+    auto st_build_bvh8   = measureObject(3, [&]() { bvh8 = std::make_unique<BVH8>(triangles); });
+
+    auto trace_single = [&](BVH& bvh) {
+        return measureObject(3, [&]() {
+            for (auto& ray : rays) bvh.getClosest(ray);
+        });
+    };
+    auto trace_batch = [&](BVH& bvh) { return measureObject(3, [&]() { bvh.getClosest(rays); }); };
+
+    std::cout << "BVH with " << triangles.size() << " triangles, " << rays.size() << " rays" << std::endl;
+    Table table({25, 15, 15, 15});
+    table << "Structure"
+          << "Build (ms)"
+          << "Single (ms)"
+          << "Batched (ms)";
+    table << "ObjectMedianBVH" << st_build_median.median << trace_single(*median).median
+          << trace_batch(*median).median;
+    table << "SAHBVH" << st_build_sah.median << trace_single(*sah).median << trace_batch(*sah).median;
+    table << "BVH4" << st_build_bvh4.median << trace_single(*bvh4).median << trace_batch(*bvh4).median;
+    table << "BVH8" << st_build_bvh8.median << trace_single(*bvh8).median << trace_batch(*bvh8).median;
+}
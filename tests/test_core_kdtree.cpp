@@ -8,7 +8,9 @@
 #include "saiga/core/Core.h"
 #include "saiga/core/geometry/kdtree.h"
 #include "saiga/core/math/all.h"
+#include "saiga/core/time/performanceMeasure.h"
 #include "saiga/core/util/Align.h"
+#include "saiga/core/util/table.h"
 
 #include "gtest/gtest.h"
 
@@ -120,3 +122,88 @@ TEST(kdtree, RadiusSearch)
         EXPECT_EQ(RadiusSearch(points, sp, r), tree.RadiusSearch(sp, r));
     }
 }
+
+TEST(kdtree, Batched)
+{
+    Random::setSeed(30947643);
+    auto points        = RandomPoints(5000);
+    auto search_points = RandomPoints(100);
+    KDT tree(points);
+
+    auto nn     = tree.NearestNeighborSearch(search_points);
+    auto knn    = tree.KNearestNeighborSearch(search_points, 10);
+    auto radius = tree.RadiusSearch(search_points, 0.2);
+    ASSERT_EQ(nn.size(), search_points.size());
+    ASSERT_EQ(knn.size(), search_points.size());
+    ASSERT_EQ(radius.size(), search_points.size());
+
+    for (size_t i = 0; i < search_points.size(); ++i)
+    {
+        EXPECT_EQ(NearestNeighborBruteForce(points, search_points[i]), nn[i]);
+        EXPECT_EQ(KNearestNeighborBruteForce(points, search_points[i], 10), knn[i]);
+        EXPECT_EQ(RadiusSearch(points, search_points[i], 0.2), radius[i]);
+    }
+}
+
+TEST(kdtree, DuplicatePoints)
+{
+    Random::setSeed(30947643);
+    // Many points with the same coordinate on the split axis
+    std::vector<vec3> points;
+    for (int i = 0; i < 1000; ++i)
+    {
+        points.push_back(vec3(Random::uniformInt(0, 3), Random::uniformInt(0, 3), 0));
+    }
+    auto search_points = RandomPoints(10);
+    KDT tree(points);
+
+    for (auto sp : search_points)
+    {
+        EXPECT_EQ(RadiusSearch(points, sp, 1.5), tree.RadiusSearch(sp, 1.5));
+        auto knn = tree.KNearestNeighborSearch(sp, 20);
+        auto ref = KNearestNeighborBruteForce(points, sp, 20);
+        ASSERT_EQ(knn.size(), ref.size());
+        for (int i = 0; i < 20; ++i)
+        {
+            // Only the distances are unique
+            EXPECT_EQ((points[knn[i]] - sp).squaredNorm(), (points[ref[i]] - sp).squaredNorm());
+        }
+    }
+}
+
+TEST(kdtree, Benchmark)
+{
+    Random::setSeed(30947643);
+    auto points        = RandomPoints(200000);
+    auto search_points = RandomPoints(20000);
+    int k              = 10;
+    float r            = 0.05;
+
+    std::unique_ptr<KDT> tree;
+    auto st_build = measureObject(3, [&]() { tree = std::make_unique<KDT>(points); });
+
+    auto st_brute = measureObject(1, [&]() {
+        for (int i = 0; i < 100; ++i) KNearestNeighborBruteForce(points, search_points[i], k);
+    });
+
+    auto st_knn = measureObject(3, [&]() {
+        for (auto& sp : search_points) tree->KNearestNeighborSearch(sp, k);
+    });
+    auto st_knn_batched = measureObject(3, [&]() { tree->KNearestNeighborSearch(search_points, k); });
+
+    auto st_radius = measureObject(3, [&]() {
+        for (auto& sp : search_points) tree->RadiusSearch(sp, r);
+    });
+    auto st_radius_batched = measureObject(3, [&]() { tree->RadiusSearch(search_points, r); });
+
+    std::cout << "KDTree with " << points.size() << " points, " << search_points.size() << " queries" << std::endl;
+    Table table({35, 15});
+    table << "Operation"
+          << "Time (ms)";
+    table << "Build" << st_build.median;
+    table << "KNN Brute Force (extrapolated)" << st_brute.median * search_points.size() / 100;
+    table << "KNN" << st_knn.median;
+    table << "KNN Batched" << st_knn_batched.median;
+    table << "Radius" << st_radius.median;
+    table << "Radius Batched" << st_radius_batched.median;
+}
@@ -0,0 +1,245 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/util/Thread/WorkStealing.h"
+#include "saiga/core/util/Thread/threadPool.h"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <numeric>
+#include <thread>
+
+using namespace Saiga;
+using WorkStealing::ChaseLevDeque;
+using WorkStealing::Task;
+
+TEST(WorkStealing, DequeOrder)
+{
+    // Small initial capacity -> the deque has to grow
+    ChaseLevDeque deque(4);
+    std::vector<Task> tasks(100);
+
+    for (auto& t : tasks) deque.push(&t);
+    EXPECT_EQ(deque.size(), 100);
+
+    // The owner pops LIFO, thieves steal FIFO
+    EXPECT_EQ(deque.pop(), &tasks[99]);
+    EXPECT_EQ(deque.steal(), &tasks[0]);
+    EXPECT_EQ(deque.steal(), &tasks[1]);
+    EXPECT_EQ(deque.pop(), &tasks[98]);
+    EXPECT_EQ(deque.size(), 96);
+
+    for (int i = 97; i >= 2; --i) EXPECT_EQ(deque.pop(), &tasks[i]);
+    EXPECT_EQ(deque.size(), 0);
+    EXPECT_EQ(deque.pop(), nullptr);
+    EXPECT_EQ(deque.steal(), nullptr);
+}
+
+TEST(WorkStealing, DequeConcurrentSteal)
+{
+    // The owner pushes and pops while other threads steal.
+    // Every task must be taken exactly once.
+    int n = 200000;
+    std::vector<Task> tasks(n);
+    std::vector<std::atomic<int>> taken(n);
+    for (auto& t : taken) t = 0;
+
+    ChaseLevDeque deque(16);
+    std::atomic<bool> done = {false};
+
+    auto take = [&](Task* t) { taken[t - tasks.data()].fetch_add(1, std::memory_order_relaxed); };
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i)
+    {
+        thieves.emplace_back([&]() {
+            while (!done.load(std::memory_order_acquire) || deque.size() > 0)
+            {
+                if (auto t = deque.steal()) take(t);
+            }
+        });
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        deque.push(&tasks[i]);
+        if (i % 3 == 0)
+        {
+            if (auto t = deque.pop()) take(t);
+        }
+    }
+    while (auto t = deque.pop()) take(t);
+    done = true;
+    for (auto& t : thieves) t.join();
+
+    for (int i = 0; i < n; ++i) EXPECT_EQ(taken[i], 1) << "Task " << i;
+}
+
+TEST(WorkStealing, Enqueue)
+{
+    for (int threads : {0, 1, 4})
+    {
+        WorkStealingScheduler scheduler(threads);
+
+        std::vector<std::future<int>> results;
+        for (int i = 0; i < 1000; ++i)
+        {
+            results.push_back(scheduler.enqueue([](int x) { return x * x; }, i));
+        }
+        for (int i = 0; i < 1000; ++i)
+        {
+            EXPECT_EQ(results[i].get(), i * i);
+        }
+
+        auto f = scheduler.enqueue([]() -> int { throw std::runtime_error("test"); });
+        EXPECT_THROW(f.get(), std::runtime_error);
+    }
+}
+
+static int fib(WorkStealingScheduler& scheduler, int n)
+{
+    if (n < 2) return n;
+    int a, b;
+    TaskGroup group(scheduler);
+    group.run([&]() { a = fib(scheduler, n - 1); });
+    b = fib(scheduler, n - 2);
+    group.wait();
+    return a + b;
+}
+
+TEST(WorkStealing, TaskGroupWait)
+{
+    // Nested fork/join. The waiting threads have to execute pending tasks, otherwise this deadlocks with one worker.
+    for (int threads : {0, 1, 4})
+    {
+        WorkStealingScheduler scheduler(threads);
+        EXPECT_EQ(fib(scheduler, 20), 6765);
+
+        // Wait from a worker thread
+        auto f = scheduler.enqueue([&]() { return fib(scheduler, 15); });
+        EXPECT_EQ(f.get(), 610);
+    }
+
+    // Large closures, which don't fit into the inline storage of the tasks.
+    WorkStealingScheduler scheduler(2);
+    std::atomic<int> sum = {0};
+    {
+        TaskGroup group(scheduler);
+        for (int i = 0; i < 100; ++i)
+        {
+            std::array<int, 64> data;
+            data.fill(i);
+            group.run([data, &sum]() { sum += data[63]; });
+        }
+        group.wait();
+        EXPECT_TRUE(group.finished());
+    }
+    EXPECT_EQ(sum, 99 * 100 / 2);
+}
+
+TEST(WorkStealing, ParallelFor)
+{
+    WorkStealingScheduler scheduler(4);
+    for (int grain : {0, 1, 7, 1000})
+    {
+        int n = 10000;
+        std::vector<int> visited(n, 0);
+        scheduler.parallel_for(0, n, [&](int i) { visited[i]++; }, grain);
+        EXPECT_EQ(std::count(visited.begin(), visited.end(), 1), n);
+    }
+
+    // Empty range
+    scheduler.parallel_for(5, 5, [&](int) { ADD_FAILURE(); });
+}
+
+TEST(WorkStealing, ParallelReduce)
+{
+    WorkStealingScheduler scheduler(4);
+    int n = 100000;
+    std::vector<long> data(n);
+    std::iota(data.begin(), data.end(), 0);
+
+    for (int grain : {0, 1, 100})
+    {
+        long sum = scheduler.parallel_reduce(
+            0, n, 0L, [&](int i, long& partial) { partial += data[i]; }, std::plus<long>(), grain);
+        EXPECT_EQ(sum, long(n - 1) * n / 2);
+    }
+
+    // std::vector<bool> would pack the partial results into shared words
+    bool all_positive = scheduler.parallel_reduce(
+        0, n, true, [&](int i, bool& partial) { partial = partial && data[i] >= 0; },
+        [](bool a, bool b) { return a && b; }, 1);
+    EXPECT_TRUE(all_positive);
+
+    bool any_negative = scheduler.parallel_reduce(
+        0, n, false, [&](int i, bool& partial) { partial = partial || data[i] < 0; },
+        [](bool a, bool b) { return a || b; }, 1);
+    EXPECT_FALSE(any_negative);
+
+    // Empty range
+    int empty = scheduler.parallel_reduce(3, 3, 42, [](int, int&) {}, std::plus<int>());
+    EXPECT_EQ(empty, 42);
+}
+
+TEST(WorkStealing, TaskRecycling)
+{
+    WorkStealingScheduler scheduler(4);
+    std::atomic<int> sum = {0};
+
+    // The tasks are submitted by a thread which is not a worker and executed by the workers.
+    // After the first round, all task objects come back to the submitting thread.
+    auto round = [&]() {
+        TaskGroup group(scheduler);
+        for (int i = 0; i < 100; ++i)
+        {
+            group.run([&sum]() { sum++; });
+        }
+        group.wait();
+    };
+
+    round();
+    size_t allocations = WorkStealing::numTaskAllocations();
+    for (int i = 0; i < 100; ++i) round();
+    EXPECT_EQ(WorkStealing::numTaskAllocations(), allocations);
+    EXPECT_EQ(sum, 101 * 100);
+
+    // The submitting thread exits before its tasks are finished.
+    TaskGroup group(scheduler);
+    std::thread producer([&]() {
+        for (int i = 0; i < 1000; ++i)
+        {
+            group.run([&sum]() { sum++; });
+        }
+    });
+    producer.join();
+    group.wait();
+    EXPECT_EQ(sum, 101 * 100 + 1000);
+}
+
+TEST(WorkStealing, ThreadPool)
+{
+    for (auto type : {ThreadPoolScheduler::CentralQueue, ThreadPoolScheduler::WorkStealing})
+    {
+        for (int threads : {0, 1, 4})
+        {
+            ThreadPool pool(threads, "TestTP", type);
+            std::vector<std::future<int>> results;
+            for (int i = 0; i < 10000; ++i)
+            {
+                results.push_back(pool.enqueue([i]() { return i + 1; }));
+            }
+            for (int i = 0; i < 10000; ++i)
+            {
+                EXPECT_EQ(results[i].get(), i + 1);
+            }
+
+            auto f = pool.enqueue([]() { throw std::runtime_error("test"); });
+            EXPECT_THROW(f.get(), std::runtime_error);
+        }
+    }
+}
@@ -252,6 +252,76 @@ TEST(BoW, Full)
     testVocMatching(features, orbVoc2);
 }
 
+TEST(BoW, FlatTree)
+{
+    std::vector<std::vector<Descriptor>> features;
+    loadFeatures(features);
+
+    // With 10^4 words and 6000 training features most nodes have less than k children.
+    srand(23053250);
+    OrbVocabulary2 voc(10, 4);
+    voc.create(features);
+    voc.saveRaw("testvoc_flat.minibow");
+
+    OrbVocabulary ref_voc;
+    ref_voc.loadRaw("testvoc_flat.minibow");
+    OrbVocabulary2 loaded_voc("testvoc_flat.minibow");
+
+    for (int levelsup : {0, 2})
+    {
+        MiniBow::BowVector ref_bv;
+        MiniBow::FeatureVector ref_fv;
+        ref_voc.transform(features.front(), ref_bv, ref_fv, levelsup);
+
+        MiniBow2::BowVector bv, loaded_bv;
+        MiniBow2::FeatureVector fv, loaded_fv;
+        voc.transform(features.front(), bv, fv, levelsup, 4);
+        loaded_voc.transform(features.front(), loaded_bv, loaded_fv, levelsup);
+
+        EXPECT_EQ(bv, loaded_bv);
+        EXPECT_EQ(fv, loaded_fv);
+
+        ASSERT_EQ(ref_bv.size(), bv.size());
+        auto it1 = ref_bv.begin();
+        for (auto& b : bv)
+        {
+            EXPECT_EQ(it1->first, b.first);
+            EXPECT_NEAR(it1->second, b.second, 0.001);
+            ++it1;
+        }
+
+        ASSERT_EQ(ref_fv.size(), fv.size());
+        auto it2 = ref_fv.begin();
+        for (auto& f : fv)
+        {
+            EXPECT_EQ(it2->first, f.first);
+            // the feature reference must not be sorted
+            std::vector<unsigned int> ref_indices(it2->second.begin(), it2->second.end());
+            std::vector<unsigned int> indices(f.second.begin(), f.second.end());
+            std::sort(ref_indices.begin(), ref_indices.end());
+            std::sort(indices.begin(), indices.end());
+            EXPECT_EQ(ref_indices, indices);
+            ++it2;
+        }
+    }
+
+    // The batched transform of a few features must not depend on the group size
+    std::vector<MiniBow2::WordId> word_ids(5);
+    std::vector<MiniBow2::WordValue> weights(5);
+    std::vector<MiniBow2::NodeId> node_ids(5);
+    voc.transform(features[1].data(), 5, 2, word_ids.data(), weights.data(), node_ids.data());
+    for (int i = 0; i < 5; ++i)
+    {
+        MiniBow2::WordId word_id;
+        MiniBow2::WordValue weight;
+        MiniBow2::NodeId node_id;
+        voc.transform(features[1].data() + i, 1, 2, &word_id, &weight, &node_id);
+        EXPECT_EQ(word_ids[i], word_id);
+        EXPECT_EQ(weights[i], weight);
+        EXPECT_EQ(node_ids[i], node_id);
+    }
+}
+
 TEST(BoW, Orb)
 {
     OrbVocabulary2 orbVoc2;
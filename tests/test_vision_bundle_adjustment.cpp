@@ -12,6 +12,8 @@
 #include "saiga/vision/recursive/BAPointOnly.h"
 #include "saiga/vision/recursive/BARecursive.h"
 #include "saiga/vision/recursive/BARecursiveRel.h"
+#include "saiga/vision/recursive/BASlidingWindow.h"
+#include "saiga/vision/scene/SceneView.h"
 #include "saiga/vision/scene/SynteticScene.h"
 //#include "saiga/vision/scene/SynteticScene.h"
 
@@ -231,6 +233,166 @@ TEST(Scene, LoadStore)
 }
 
 
+TEST(Scene, LoadStoreBinary)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[3].constant               = true;
+    scene.worldPoints[7].constant          = true;
+    scene.images[5].stereoPoints[0].depth  = 2.5;
+    scene.images[5].stereoPoints[1].weight = 0.5;
+    scene.saveBinary("test.bscene");
+
+    SceneView view("test.bscene");
+    ASSERT_TRUE(view.isOpen());
+    EXPECT_EQ(view.numImages(), scene.images.size());
+    EXPECT_EQ(view.numPoints(), scene.worldPoints.size());
+    EXPECT_EQ(view.observationEnd(5) - view.observationBegin(5), scene.images[5].stereoPoints.size());
+    EXPECT_EQ(view.pose(5).params(), scene.images[5].se3.params());
+
+    Scene scene2;
+    EXPECT_TRUE(scene2.loadBinary("test.bscene"));
+    EXPECT_EQ(scene.intrinsics.size(), scene2.intrinsics.size());
+    EXPECT_EQ(scene.images.size(), scene2.images.size());
+    EXPECT_EQ(scene.worldPoints.size(), scene2.worldPoints.size());
+    EXPECT_EQ(scene.chi2(), scene2.chi2());
+
+    for (int i = 0; i < (int)scene.worldPoints.size(); ++i)
+    {
+        EXPECT_EQ(scene.worldPoints[i].p, scene2.worldPoints[i].p);
+        EXPECT_EQ(scene.worldPoints[i].valid, scene2.worldPoints[i].valid);
+        EXPECT_EQ(scene.worldPoints[i].constant, scene2.worldPoints[i].constant);
+    }
+
+    for (int i = 0; i < (int)scene.images.size(); ++i)
+    {
+        EXPECT_EQ(scene.images[i].se3.params(), scene2.images[i].se3.params());
+        EXPECT_EQ(scene.images[i].constant, scene2.images[i].constant);
+        EXPECT_EQ(scene.images[i].intr, scene2.images[i].intr);
+        EXPECT_EQ(scene.images[i].validPoints, scene2.images[i].validPoints);
+        ASSERT_EQ(scene.images[i].stereoPoints.size(), scene2.images[i].stereoPoints.size());
+
+        for (int j = 0; j < (int)scene.images[i].stereoPoints.size(); ++j)
+        {
+            auto& ip1 = scene.images[i].stereoPoints[j];
+            auto& ip2 = scene2.images[i].stereoPoints[j];
+            EXPECT_EQ(ip1.wp, ip2.wp);
+            EXPECT_EQ(ip1.point, ip2.point);
+            EXPECT_EQ(ip1.depth, ip2.depth);
+            EXPECT_EQ(ip1.weight, ip2.weight);
+        }
+    }
+
+    // Unknown versions are rejected
+    {
+        std::fstream strm("test.bscene", std::ios::in | std::ios::out | std::ios::binary);
+        strm.seekp(offsetof(SceneFileHeader, version));
+        uint32_t version = SceneFileHeader::kVersion + 1;
+        strm.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    Scene scene3;
+    EXPECT_FALSE(scene3.loadBinary("test.bscene"));
+}
+
+TEST(Scene, LoadStoreBinaryInvalid)
+{
+    Scene scene = SynteticScene::CircleSphere(500, 5, 100);
+    scene.saveBinary("test_invalid.bscene");
+    SceneFileHeader header;
+    {
+        SceneView view("test_invalid.bscene");
+        ASSERT_TRUE(view.isOpen());
+        header = view.fileHeader();
+    }
+
+    // Writes the value at the byte offset into a fresh copy of the file and tries to open it.
+    auto open_patched = [&](uint64_t offset, auto value) {
+        scene.saveBinary("test_invalid.bscene");
+        {
+            std::fstream strm("test_invalid.bscene", std::ios::in | std::ios::out | std::ios::binary);
+            strm.seekp(offset);
+            strm.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        SceneView view;
+        return view.open("test_invalid.bscene");
+    };
+
+    // Unused observation -> valid
+    EXPECT_TRUE(open_patched(header.obs_wp + 3 * sizeof(int32_t), int32_t(-1)));
+
+    // Different byte order
+    EXPECT_FALSE(open_patched(offsetof(SceneFileHeader, byte_order), uint64_t(0x0807060504030201)));
+    // Overflow of the layout computation
+    EXPECT_FALSE(open_patched(offsetof(SceneFileHeader, num_points), int64_t(1) << 62));
+
+    // Negative and non-monotonic observation ranges
+    EXPECT_FALSE(open_patched(header.image_obs_offsets + 1 * sizeof(int64_t), int64_t(-5)));
+    EXPECT_FALSE(open_patched(header.image_obs_offsets + 2 * sizeof(int64_t), header.num_observations));
+    EXPECT_FALSE(open_patched(header.image_obs_offsets, int64_t(1)));
+
+    // Out of range intrinsics and world points
+    EXPECT_FALSE(open_patched(header.image_intr + 2 * sizeof(int32_t), int32_t(header.num_intrinsics)));
+    EXPECT_FALSE(open_patched(header.image_intr, int32_t(-1)));
+    EXPECT_FALSE(open_patched(header.obs_wp + 3 * sizeof(int32_t), int32_t(header.num_points)));
+    EXPECT_FALSE(open_patched(header.obs_wp + 7 * sizeof(int32_t), int32_t(-2)));
+}
+
+TEST(Scene, ObservationIndex)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[3].stereoPoints[5].wp = -1;
+    EXPECT_FALSE(scene.hasObservationIndex());
+    scene.compress();
+    ASSERT_TRUE(scene.hasObservationIndex());
+
+    auto& index = scene.observationIndex();
+    for (int i = 0; i < (int)scene.images.size(); ++i)
+    {
+        EXPECT_EQ(index.image_offsets[i + 1] - index.image_offsets[i], scene.images[i].validPoints);
+        for (int o = index.image_offsets[i]; o < index.image_offsets[i + 1]; ++o)
+        {
+            EXPECT_EQ(index.obs_image[o], i);
+            EXPECT_EQ(index.obs_wp[o], scene.images[i].stereoPoints[index.obs_image_point[o]].wp);
+        }
+    }
+
+    for (int j = 0; j < (int)scene.worldPoints.size(); ++j)
+    {
+        auto& refs = scene.worldPoints[j].stereoreferences;
+        ASSERT_EQ(index.point_offsets[j + 1] - index.point_offsets[j], refs.size());
+        for (int k = index.point_offsets[j]; k < index.point_offsets[j + 1]; ++k)
+        {
+            int o = index.point_obs[k];
+            EXPECT_EQ(index.obs_wp[o], j);
+            std::pair<int, int> ref(index.obs_image[o], index.obs_image_point[o]);
+            EXPECT_TRUE(std::find(refs.begin(), refs.end(), ref) != refs.end());
+        }
+    }
+    EXPECT_TRUE(scene.observationIndexValid());
+
+    // Direct changes have to be reported
+    scene.images[4].stereoPoints[2].wp = -1;
+    EXPECT_FALSE(scene.observationIndexValid());
+    scene.observationsChanged();
+    EXPECT_FALSE(scene.hasObservationIndex());
+    scene.fixWorldPointReferences();
+    EXPECT_TRUE(scene.hasObservationIndex());
+    EXPECT_TRUE(scene.observationIndexValid());
+
+    scene.removeWorldPoint(scene.images[4].stereoPoints[3].wp);
+    EXPECT_FALSE(scene.hasObservationIndex());
+
+    // The structure of BARec does not depend on the index
+    BundleAdjustmentTest test;
+    BAOptions options;
+    auto ref = test.solveRec(options);
+    test.scene.compress();
+    auto res = test.solveRec(options);
+    ExpectClose(ref.chi2(), res.chi2(), 1e-5);
+
+    scene.removeWorldPoint(0);
+    EXPECT_FALSE(scene.hasObservationIndex());
+}
+
 TEST(BundleAdjustment, Empty)
 {
     Scene scene;
@@ -330,6 +492,93 @@ TEST(BundleAdjustment, PartialConstant)
 }
 
 
+TEST(BundleAdjustment, MixedPrecision)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        BundleAdjustmentTest test;
+        BAOptions options;
+        auto ref = test.solveRec(options);
+
+        options.precision = BAOptions::Precision::Mixed;
+        for (int refinement = 0; refinement < 2; ++refinement)
+        {
+            options.refinement_iterations = refinement;
+            auto res                      = test.solveRec(options);
+            ExpectClose(ref.chi2(), res.chi2(), 1e-1);
+        }
+    }
+}
+
+
+TEST(BundleAdjustment, MatrixFreeSchur)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        BundleAdjustmentTest test;
+        test.opoptions.solverType = OptimizationOptions::SolverType::Iterative;
+        BAOptions options;
+        auto ref = test.solveRec(options);
+
+        options.matrix_free_schur = true;
+        auto res                  = test.solveRec(options);
+        ExpectClose(ref.chi2(), res.chi2(), 1e-1);
+
+        options.precision = BAOptions::Precision::Mixed;
+        res               = test.solveRec(options);
+        ExpectClose(ref.chi2(), res.chi2(), 1e-1);
+    }
+}
+
+
+TEST(BundleAdjustment, SlidingWindow)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        BundleAdjustmentTest test;
+        test.opoptions.solverType = OptimizationOptions::SolverType::Direct;
+        BAOptions options;
+        auto ref = test.solveRec(options);
+
+        // All images in the window -> same problem as BARec
+        auto cpy = test.scene;
+        BASlidingWindow ba;
+        ba.optimizationOptions = test.opoptions;
+        ba.baOptions           = options;
+        ba.create(cpy);
+        for (int j = 0; j < (int)cpy.images.size(); ++j) ba.addKeyframe(j);
+        ba.initAndSolve();
+        ExpectClose(ref.chi2(), cpy.chi2(), 1e-1);
+
+        // The prior keeps the remaining keyframes at the optimum
+        auto before = cpy.images;
+        ba.marginalizeKeyframe(0);
+        ba.marginalizeKeyframe(1);
+        EXPECT_EQ(ba.keyframes().size(), cpy.images.size() - 2);
+        ba.initAndSolve();
+        for (int j = 2; j < (int)cpy.images.size(); ++j)
+        {
+            ExpectCloseRelative(before[j].se3.translation(), cpy.images[j].se3.translation(), 1e-5, false);
+        }
+    }
+
+    // Incremental mode with a fixed window size
+    BundleAdjustmentTest test;
+    auto cpy = test.scene;
+    BASlidingWindow ba;
+    ba.optimizationOptions = test.opoptions;
+    ba.create(cpy);
+    for (int j = 0; j < (int)cpy.images.size(); ++j)
+    {
+        ba.addKeyframe(j);
+        if (ba.keyframes().size() > 4) ba.marginalizeKeyframe(ba.keyframes().front());
+        auto result = ba.initAndSolve();
+        EXPECT_LE(ba.keyframes().size(), 4);
+        EXPECT_LE(result.cost_final, result.cost_initial);
+    }
+}
+
+
 TEST(BundleAdjustment, Huber)
 {
     Random::setSeed(923652);
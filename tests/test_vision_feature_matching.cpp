@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/HammingMatcher.h"
+#include "saiga/vision/features/MultiIndexHashing.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// The first half of 'train' are noisy copies of the queries. Uses many duplicates to test the tie breaking.
+static void RandomDescriptors(int n, int m, std::vector<DescriptorORB>& query, std::vector<DescriptorORB>& train)
+{
+    query.resize(n);
+    train.resize(m);
+    for (auto& d : query)
+        for (auto& w : d) w = Random::urand64();
+    for (int j = 0; j < m; ++j)
+    {
+        if (j < m / 2 && j < n)
+        {
+            train[j] = query[j];
+            for (int f = Random::uniformInt(0, 40); f > 0; --f)
+            {
+                int bit = Random::uniformInt(0, 255);
+                train[j][bit / 64] ^= uint64_t(1) << (bit % 64);
+            }
+        }
+        else if (j > 0 && Random::sampleBool(0.1))
+        {
+            train[j] = train[Random::uniformInt(0, j - 1)];
+        }
+        else
+        {
+            for (auto& w : train[j]) w = Random::urand64();
+        }
+    }
+}
+
+// The scalar loop of the original BruteForceMatcher::matchKnn2
+static std::vector<std::pair<int, int>> ReferenceKnn2(const std::vector<DescriptorORB>& query,
+                                                      const std::vector<DescriptorORB>& train)
+{
+    std::vector<std::pair<int, int>> knn2(query.size() * 2, {1000, -1});
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        auto& best   = knn2[2 * i];
+        auto& second = knn2[2 * i + 1];
+        for (int j = 0; j < (int)train.size(); ++j)
+        {
+            int dis = distance(query[i], train[j]);
+            if (dis < best.first)
+            {
+                second = best;
+                best   = {dis, j};
+            }
+            else if (dis < second.first)
+            {
+                second = {dis, j};
+            }
+        }
+    }
+    return knn2;
+}
+
+TEST(FeatureMatching, Knn2)
+{
+    Random::setSeed(3468346);
+
+    for (auto size : std::vector<std::pair<int, int>>{{1, 1}, {5, 0}, {100, 37}, {333, 1111}, {1000, 1003}})
+    {
+        std::vector<DescriptorORB> query, train;
+        RandomDescriptors(size.first, size.second, query, train);
+        auto ref = ReferenceKnn2(query, train);
+
+        for (auto kernel : {HammingKernel::Scalar, HammingKernel::AVX2, HammingKernel::AVX512})
+        {
+            if (!HammingKernelSupported(kernel)) continue;
+            for (int threads : {1, 3})
+            {
+                HammingMatcher matcher(kernel, threads);
+                std::vector<std::pair<int, int>> knn2(query.size() * 2);
+                matcher.Knn2(query, train, knn2.data());
+                EXPECT_EQ(knn2, ref) << "Kernel " << int(kernel) << " threads " << threads << " size " << size.first
+                                     << "x" << size.second;
+            }
+        }
+    }
+
+    // The old interface uses the same implementation
+    std::vector<DescriptorORB> query, train;
+    RandomDescriptors(200, 300, query, train);
+    BruteForceMatcher<DescriptorORB> bf;
+    bf.matchKnn2(query, train);
+    std::vector<std::pair<int, int>> knn2(bf.knn2.data(), bf.knn2.data() + bf.knn2.size());
+    EXPECT_EQ(knn2, ReferenceKnn2(query, train));
+}
+
+TEST(FeatureMatching, RatioAndMutual)
+{
+    Random::setSeed(9238742);
+    std::vector<DescriptorORB> query, train;
+    RandomDescriptors(700, 900, query, train);
+    // Competing queries for the first 100 train descriptors. Only one of them is a mutual match.
+    for (int i = 600; i < 700; ++i)
+    {
+        query[i] = train[i - 600];
+        query[i][0] ^= uint64_t(Random::uniformInt(0, 255)) << 8;
+    }
+
+    int threshold = 50;
+    float ratio   = 0.8;
+    auto knn2     = ReferenceKnn2(query, train);
+
+    // Nearest query of each train descriptor
+    std::vector<int> col_best(train.size(), -1), col_dist(train.size(), 1000);
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        for (int j = 0; j < (int)train.size(); ++j)
+        {
+            int dis = distance(query[i], train[j]);
+            if (dis < col_dist[j])
+            {
+                col_dist[j] = dis;
+                col_best[j] = i;
+            }
+        }
+    }
+
+    std::vector<std::pair<int, int>> ref_ratio, ref_mutual;
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        auto best = knn2[2 * i], second = knn2[2 * i + 1];
+        if (best.first > threshold || float(best.first) > float(second.first) * ratio) continue;
+        ref_ratio.push_back({i, best.second});
+        if (col_best[best.second] == i) ref_mutual.push_back({i, best.second});
+    }
+    EXPECT_GT(ref_mutual.size(), 300);
+    EXPECT_LT(ref_mutual.size(), ref_ratio.size());
+
+    for (auto kernel : {HammingKernel::Scalar, HammingKernel::AVX2, HammingKernel::AVX512})
+    {
+        if (!HammingKernelSupported(kernel)) continue;
+        for (int threads : {1, 4})
+        {
+            HammingMatcher matcher(kernel, threads);
+            std::vector<std::pair<int, int>> matches;
+            EXPECT_EQ(matcher.Match(query, train, threshold, ratio, false, matches), ref_ratio.size());
+            EXPECT_EQ(matches, ref_ratio);
+            EXPECT_EQ(matcher.Match(query, train, threshold, ratio, true, matches), ref_mutual.size());
+            EXPECT_EQ(matches, ref_mutual);
+        }
+    }
+}
+
+TEST(FeatureMatching, MultiIndexHashing)
+{
+    Random::setSeed(1238457);
+    std::vector<DescriptorORB> query, train;
+    RandomDescriptors(120, 6000, query, train);
+
+    MultiIndexHashing mih;
+    std::vector<int> ids;
+    for (auto& d : train) ids.push_back(mih.Insert(d));
+    EXPECT_EQ(mih.size(), train.size());
+
+    // Remove some and insert new descriptors, which reuse the ids
+    for (int i = 0; i < 1000; ++i)
+    {
+        int id = ids[Random::uniformInt(0, ids.size() - 1)];
+        if (mih.Valid(id)) mih.Remove(id);
+    }
+    for (int i = 0; i < 50; ++i)
+    {
+        DescriptorORB d = query[i];
+        d[3] ^= 0xFF;
+        ids.push_back(mih.Insert(d));
+    }
+
+    std::vector<int> valid_ids;
+    for (int id = 0; id < (int)train.size(); ++id)
+        if (mih.Valid(id)) valid_ids.push_back(id);
+    EXPECT_EQ(mih.size(), valid_ids.size());
+
+    std::vector<std::pair<int, int>> result;
+    for (auto& q : query)
+    {
+        std::vector<std::pair<int, int>> ref;
+        for (int id : valid_ids) ref.push_back({distance(q, mih.Descriptor(id)), id});
+        std::sort(ref.begin(), ref.end());
+
+        // The first max_size elements of ref with distance <= r
+        auto prefix = [&](int r, int max_size) {
+            std::vector<std::pair<int, int>> p;
+            for (auto& e : ref)
+                if (e.first <= r && (int)p.size() < max_size) p.push_back(e);
+            return p;
+        };
+
+        for (int radius : {0, 20, 47, 80})
+        {
+            mih.RadiusSearch(q, radius, result);
+            EXPECT_EQ(result, prefix(radius, ref.size()));
+        }
+
+        for (int k : {1, 2, 10})
+        {
+            mih.KnnSearch(q, k, result, 256);
+            EXPECT_EQ(result, prefix(256, k));
+            mih.KnnSearch(q, k, result, 40);
+            EXPECT_EQ(result, prefix(40, k));
+        }
+    }
+}
+
+}  // namespace Saiga
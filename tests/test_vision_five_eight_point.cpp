@@ -232,6 +232,127 @@ TEST(EpipolarGeometry, FivePointAlgorithm)
     std::cout << "failed " << failed << std::endl;
 }
 
+TEST(EpipolarGeometry, AdaptiveRansac)
+{
+    FiveEightPointTest test;
+
+    // Replace the last 30% of the matches by outliers. The PROSAC quality order is therefore the index.
+    int num_outliers = test.N * 0.3;
+    for (int i = test.N - num_outliers; i < test.N; ++i)
+    {
+        Vec2 ip                    = Vec2(Random::sampleDouble(0, 640), Random::sampleDouble(0, 480));
+        test.normalized_points2[i] = test.K2.unproject2(ip);
+    }
+
+    RansacParameters params;
+    params.maxIterations     = 1000;
+    double epipolarTheshold  = 2.0 / test.K1.fx;
+    params.residualThreshold = epipolarTheshold * epipolarTheshold;
+    params.reserveN          = test.N;
+    params.threads           = 2;
+    params.adaptive          = false;
+    params.sprt              = false;
+
+    auto solve = [&](const RansacParameters& params) {
+        FivePointRansac fpr(params);
+        Mat3 E;
+        SE3 T;
+        std::vector<int> inliers;
+        std::vector<char> inlierMask;
+        int num_inliers = fpr.solve(test.normalized_points1, test.normalized_points2, E, T, inliers, inlierMask);
+
+        EXPECT_EQ(num_inliers, inliers.size());
+        EXPECT_EQ(inlierMask.size(), test.N);
+
+        // The vectorized residuals must match the scalar ones
+        std::vector<double> residuals(test.N);
+        fpr.computeResiduals({E, T}, 0, test.N, residuals.data());
+        for (int i = 0; i < test.N; ++i)
+        {
+            EXPECT_NEAR(residuals[i], fpr.computeResidual({E, T}, i), 1e-12);
+        }
+
+        Vec3 t     = T.translation().normalized();
+        Vec3 ref_t = test.reference_T.translation().normalized();
+        if (t(2) < 0) t *= -1;
+        if (ref_t(2) < 0) ref_t *= -1;
+        ExpectCloseRelative(t, ref_t, 1e-2, false);
+        return std::make_pair(num_inliers, fpr.Iterations());
+    };
+
+    auto [inliers_fixed, its_fixed] = solve(params);
+    EXPECT_EQ(its_fixed, params.maxIterations);
+    EXPECT_GE(inliers_fixed, (test.N - num_outliers) * 0.9);
+
+    params.adaptive = true;
+
+    auto [inliers_adaptive, its_adaptive] = solve(params);
+    EXPECT_LT(its_adaptive, params.maxIterations);
+    EXPECT_GE(inliers_adaptive, inliers_fixed * 0.95);
+
+    params.prosac = true;
+
+    auto [inliers_prosac, its_prosac] = solve(params);
+    EXPECT_LT(its_prosac, params.maxIterations);
+    EXPECT_GE(inliers_prosac, inliers_fixed * 0.95);
+
+    params.prosac = false;
+    params.sprt   = true;
+
+    auto [inliers_sprt, its_sprt] = solve(params);
+    EXPECT_LT(its_sprt, params.maxIterations);
+    EXPECT_GE(inliers_sprt, inliers_fixed * 0.95);
+}
+
+TEST(EpipolarGeometry, SprtLowInlierRatio)
+{
+    FiveEightPointTest test;
+
+    // Only the first 8% of the matches are inliers. They are sorted first, therefore PROSAC samples them early.
+    int num_inliers = test.N * 0.08;
+    for (int i = num_inliers; i < test.N; ++i)
+    {
+        Vec2 ip                    = Vec2(Random::sampleDouble(0, 640), Random::sampleDouble(0, 480));
+        test.normalized_points2[i] = test.K2.unproject2(ip);
+    }
+
+    RansacParameters params;
+    params.maxIterations     = 1000;
+    double epipolarTheshold  = 2.0 / test.K1.fx;
+    params.residualThreshold = epipolarTheshold * epipolarTheshold;
+    params.reserveN          = test.N;
+    params.threads           = 1;
+    params.prosac            = true;
+
+    auto solve = [&](const RansacParameters& params) {
+        FivePointRansac fpr(params);
+        Mat3 E;
+        SE3 T;
+        std::vector<int> inliers;
+        std::vector<char> inlierMask;
+        int n = fpr.solve(test.normalized_points1, test.normalized_points2, E, T, inliers, inlierMask);
+        EXPECT_GE(n, num_inliers * 0.9);
+
+        Vec3 t     = T.translation().normalized();
+        Vec3 ref_t = test.reference_T.translation().normalized();
+        if (t(2) < 0) t *= -1;
+        if (ref_t(2) < 0) ref_t *= -1;
+        ExpectCloseRelative(t, ref_t, 1e-2, false);
+    };
+
+    solve(params);
+
+    // The correct model must pass the SPRT, although its inlier ratio is close to delta
+    params.sprt = true;
+    solve(params);
+
+    // The initial epsilon is larger than the inlier ratio -> the correct model is rejected until epsilon was lowered.
+    // More iterations, so that PROSAC still samples from the inliers after that.
+    params.sprt_epsilon  = 0.2;
+    params.maxIterations = 3000;
+    solve(params);
+}
+
 TEST(EpipolarGeometry, Benchmark)
 {
     int its = 50;
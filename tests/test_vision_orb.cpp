@@ -0,0 +1,247 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/image/all.h"
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+#include "saiga/vision/features/ORBExtractorAsync.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Random rectangles with noise. Has lots of corners with different contrast.
+static TemplatedImage<unsigned char> SyntheticImage(int h, int w)
+{
+    TemplatedImage<unsigned char> img(h, w);
+    img.getImageView().set(100);
+    for (int r = 0; r < 60; ++r)
+    {
+        int y0 = Random::uniformInt(0, h - 1), x0 = Random::uniformInt(0, w - 1);
+        int y1 = std::min(h, y0 + Random::uniformInt(5, 80)), x1 = std::min(w, x0 + Random::uniformInt(5, 80));
+        int c  = Random::uniformInt(0, 255);
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x) img(y, x) = c;
+    }
+    for (int y : img.rowRange())
+        for (int x : img.colRange()) img(y, x) = std::min(255, std::max(0, img(y, x) + Random::uniformInt(-3, 3)));
+    return img;
+}
+
+// Brute force FAST-9 score: the largest t such that 9 contiguous pixels are all > center + t or all < center - t.
+static int ReferenceScore(ImageView<unsigned char> img, int y, int x)
+{
+    const int cx[16] = {0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+    const int cy[16] = {3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1, 0, 1, 2, 3};
+    int best         = -1;
+    for (int t = 0; t < 255; ++t)
+    {
+        bool corner = false;
+        for (int s = 0; s < 16 && !corner; ++s)
+        {
+            bool brighter = true, darker = true;
+            for (int k = 0; k < 9; ++k)
+            {
+                int v = img(y + cy[(s + k) % 16], x + cx[(s + k) % 16]);
+                brighter &= v > img(y, x) + t;
+                darker &= v < img(y, x) - t;
+            }
+            corner = brighter || darker;
+        }
+        if (!corner) break;
+        best = t;
+    }
+    return best;
+}
+
+TEST(ORB, FastDetector)
+{
+    Random::setSeed(3468);
+    auto img = SyntheticImage(120, 157);
+    int th   = 15;
+
+    TemplatedImage<int> scores(img.rows, img.cols);
+    scores.getImageView().set(-1);
+    for (int y = 3; y < img.rows - 3; ++y)
+        for (int x = 3; x < img.cols - 3; ++x) scores(y, x) = ReferenceScore(img, y, x);
+
+    FastDetector fast(th, false);
+    std::vector<KeyPoint<float>> keypoints;
+    fast.Detect(img.getImageView(), keypoints);
+
+    std::vector<KeyPoint<float>> expected;
+    for (int y : img.rowRange())
+        for (int x : img.colRange())
+            if (scores(y, x) >= th) expected.emplace_back(x, y, 7, -1, scores(y, x));
+
+    ASSERT_GT(expected.size(), 100);
+    EXPECT_EQ(keypoints, expected);
+
+    // Non-maximum suppression
+    fast.nonmax_suppression = true;
+    keypoints.clear();
+    fast.Detect(img.getImageView(), keypoints);
+
+    std::vector<KeyPoint<float>> expected_nms;
+    for (auto& kp : expected)
+    {
+        int x = kp.point.x(), y = kp.point.y();
+        bool max = true;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                if ((dx || dy) && scores(y + dy, x + dx) >= th && scores(y + dy, x + dx) >= kp.response) max = false;
+        if (max) expected_nms.push_back(kp);
+    }
+    EXPECT_LT(expected_nms.size(), expected.size());
+    EXPECT_EQ(keypoints, expected_nms);
+
+    // Bands
+    std::vector<KeyPoint<float>> keypoints_bands;
+    for (int row = 0; row < img.rows; row += 17)
+    {
+        fast.Detect(img.getImageView(), keypoints_bands, row, row + 17);
+    }
+    EXPECT_EQ(keypoints_bands, expected_nms);
+}
+
+TEST(ORB, ImageFilters)
+{
+    Random::setSeed(923);
+    auto img = SyntheticImage(91, 123);
+
+    // Bilinear resize compared to a floating point implementation
+    TemplatedImage<unsigned char> small(76, 102);
+    ImageTransformation::ResizeLinear(img.getImageView(), small.getImageView());
+    float sx = float(img.cols) / small.cols, sy = float(img.rows) / small.rows;
+    int max_diff = 0;
+    for (int y : small.rowRange())
+    {
+        for (int x : small.colRange())
+        {
+            float fx = std::max(0.f, (x + 0.5f) * sx - 0.5f), fy = std::max(0.f, (y + 0.5f) * sy - 0.5f);
+            int x0 = std::min<int>(fx, img.cols - 1), y0 = std::min<int>(fy, img.rows - 1);
+            int x1 = std::min(x0 + 1, img.cols - 1), y1 = std::min(y0 + 1, img.rows - 1);
+            float ax = fx - x0, ay = fy - y0;
+            float v  = (1 - ay) * ((1 - ax) * img(y0, x0) + ax * img(y0, x1)) +
+                      ay * ((1 - ax) * img(y1, x0) + ax * img(y1, x1));
+            max_diff = std::max(max_diff, std::abs(iRound(v) - small(y, x)));
+        }
+    }
+    EXPECT_LE(max_diff, 1);
+
+    // Gaussian blur compared to a floating point 2D convolution
+    int radius  = 3;
+    float sigma = 2;
+    TemplatedImage<unsigned char> blurred(img.rows, img.cols);
+    ImageTransformation::GaussianBlur(img.getImageView(), blurred.getImageView(), radius, sigma);
+    auto reflect = [](int i, int n) { return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i); };
+    max_diff     = 0;
+    for (int y : img.rowRange())
+    {
+        for (int x : img.colRange())
+        {
+            float sum = 0, wsum = 0;
+            for (int dy = -radius; dy <= radius; ++dy)
+            {
+                for (int dx = -radius; dx <= radius; ++dx)
+                {
+                    float w = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+                    sum += w * img(reflect(y + dy, img.rows), reflect(x + dx, img.cols));
+                    wsum += w;
+                }
+            }
+            max_diff = std::max(max_diff, std::abs(iRound(sum / wsum) - blurred(y, x)));
+        }
+    }
+    EXPECT_LE(max_diff, 2);
+
+    // Border
+    int border = 5;
+    TemplatedImage<unsigned char> with_border(img.rows + 2 * border, img.cols + 2 * border);
+    img.getImageView().copyTo(with_border.getImageView().subImageView(border, border, img.rows, img.cols));
+    ImageTransformation::FillBorderReflect101(with_border.getImageView(), border);
+    for (int y : with_border.rowRange())
+    {
+        for (int x : with_border.colRange())
+        {
+            ASSERT_EQ(with_border(y, x), img(reflect(y - border, img.rows), reflect(x - border, img.cols)));
+        }
+    }
+}
+
+TEST(ORB, Extractor)
+{
+    Random::setSeed(1532);
+    auto img = SyntheticImage(480, 640);
+
+    int num_features = 1000;
+    ORBExtractor extractor(num_features, 1.2, 8, 20, 7, 1);
+
+    std::vector<KeyPoint<float>> keypoints, keypoints2;
+    std::vector<DescriptorORB> descriptors, descriptors2;
+    extractor.Detect(img.getImageView(), keypoints, descriptors);
+
+    EXPECT_EQ(keypoints.size(), descriptors.size());
+    EXPECT_GT(keypoints.size(), num_features / 2);
+    EXPECT_LE(keypoints.size(), num_features * 1.1);
+
+    std::vector<int> per_level(8, 0);
+    for (auto& kp : keypoints)
+    {
+        EXPECT_GE(kp.point.x(), 0);
+        EXPECT_GE(kp.point.y(), 0);
+        EXPECT_LT(kp.point.x(), img.cols);
+        EXPECT_LT(kp.point.y(), img.rows);
+        ASSERT_GE(kp.octave, 0);
+        ASSERT_LT(kp.octave, 8);
+        per_level[kp.octave]++;
+    }
+    for (int level = 0; level < 8; ++level) EXPECT_GT(per_level[level], 0) << "level " << level;
+
+    // The internal buffers are reused
+    extractor.Detect(img.getImageView(), keypoints2, descriptors2);
+    EXPECT_EQ(keypoints, keypoints2);
+    EXPECT_EQ(descriptors, descriptors2);
+}
+
+TEST(ORB, ExtractorAsync)
+{
+    Random::setSeed(6342);
+    std::vector<TemplatedImage<unsigned char>> images;
+    for (int i = 0; i < 6; ++i) images.push_back(SyntheticImage(480, 640));
+
+    ORBExtractor extractor(1000, 1.2, 8, 20, 7, 1);
+    ORBExtractorAsync extractor_async(1000, 1.2, 8, 20, 7, 4, 2);
+
+    std::vector<std::future<ORBExtractorAsync::Features>> futures;
+    for (auto& img : images) futures.push_back(extractor_async.Detect(img.getImageView()));
+
+    std::vector<int> order;
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        extractor_async.Detect(images[i].getImageView(), [&order, i](ORBExtractorAsync::Features&&) {
+            order.push_back(i);
+        });
+    }
+
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        std::vector<KeyPoint<float>> keypoints;
+        std::vector<DescriptorORB> descriptors;
+        extractor.Detect(images[i].getImageView(), keypoints, descriptors);
+
+        auto features = futures[i].get();
+        EXPECT_GT(keypoints.size(), 500);
+        EXPECT_EQ(features.keypoints, keypoints);
+        EXPECT_EQ(features.descriptors, descriptors);
+    }
+
+    extractor_async.Wait();
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5}));
+}
+
+}  // namespace Saiga
@@ -0,0 +1,127 @@
+﻿/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/vision/util/PointCloudProcessing.h"
+
+#include "gtest/gtest.h"
+
+#include <map>
+
+namespace Saiga
+{
+std::vector<vec3> RandomPlanePoints(int n, float z)
+{
+    std::vector<vec3> result;
+    for (int i = 0; i < n; ++i)
+    {
+        vec2 xy = Random::MatrixUniform<vec2>(-1, 1);
+        result.push_back(vec3(xy.x(), xy.y(), z));
+    }
+    return result;
+}
+
+TEST(PointCloud, VoxelGridDownsample)
+{
+    Random::setSeed(3947);
+    std::vector<vec3> points;
+    for (int i = 0; i < 100000; ++i)
+    {
+        points.push_back(Random::MatrixUniform<vec3>(-1, 1));
+    }
+    float voxel_size = 0.1;
+
+    std::vector<int> voxel_of_point;
+    auto result = VoxelGridDownsample(points, voxel_size, &voxel_of_point);
+
+    // Reference with a sorted map
+    std::map<std::tuple<int, int, int>, std::pair<Vec3, int>> ref;
+    for (auto& p : points)
+    {
+        ivec3 v = (p / voxel_size).array().floor().cast<int>();
+        auto& e = ref[{v.x(), v.y(), v.z()}];
+        if (e.second == 0) e.first.setZero();
+        e.first += p.cast<double>();
+        e.second += 1;
+    }
+    ASSERT_EQ(result.size(), ref.size());
+
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        ivec3 v = (points[i] / voxel_size).array().floor().cast<int>();
+        auto& e = ref[{v.x(), v.y(), v.z()}];
+        EXPECT_LT((result[voxel_of_point[i]] - (e.first / e.second).cast<float>()).norm(), 1e-5);
+    }
+}
+
+TEST(PointCloud, EstimateNormals)
+{
+    Random::setSeed(3947);
+    auto points  = RandomPlanePoints(10000, 0.5);
+    auto normals = EstimateNormals(points, 10, vec3(0, 0, 2));
+    ASSERT_EQ(points.size(), normals.size());
+
+    for (auto& n : normals)
+    {
+        EXPECT_NEAR(n.norm(), 1, 1e-4);
+        EXPECT_GT(n.z(), 0.999);
+    }
+}
+
+TEST(PointCloud, OutlierRemoval)
+{
+    Random::setSeed(3947);
+    int num_inliers = 10000;
+    auto points     = RandomPlanePoints(num_inliers, 0);
+    for (int i = 0; i < 20; ++i)
+    {
+        points.push_back(Random::MatrixUniform<vec3>(-1, 1) + vec3(0, 0, 3));
+    }
+
+    auto statistical = StatisticalOutlierRemoval(points, 20, 2);
+    EXPECT_TRUE(std::is_sorted(statistical.begin(), statistical.end()));
+    EXPECT_EQ(std::count_if(statistical.begin(), statistical.end(), [&](int i) { return i >= num_inliers; }), 0);
+    EXPECT_GT(statistical.size(), num_inliers * 0.95);
+
+    auto radius = RadiusOutlierRemoval(points, 0.05, 3);
+    EXPECT_EQ(std::count_if(radius.begin(), radius.end(), [&](int i) { return i >= num_inliers; }), 0);
+    EXPECT_GT(radius.size(), num_inliers * 0.95);
+
+    PointCloudPreprocessParams params;
+    params.voxel_size = 0.02;
+    params.view_point = vec3(0, 0, 1);
+    auto cloud        = PreprocessPointCloud(points, params);
+    ASSERT_EQ(cloud.points.size(), cloud.normals.size());
+    for (size_t i = 0; i < cloud.points.size(); ++i)
+    {
+        EXPECT_LT(cloud.points[i].z(), 0.5);
+        EXPECT_GT(cloud.normals[i].z(), 0.99);
+    }
+}
+
+TEST(PointCloud, OutlierRemovalDuplicates)
+{
+    // Every point three times. The 2 nearest neighbors are the duplicates, so all mean distances are 0.
+    Random::setSeed(3947);
+    std::vector<vec3> points;
+    for (auto& p : RandomPlanePoints(1000, 0))
+    {
+        for (int i = 0; i < 3; ++i) points.push_back(p);
+    }
+
+    auto statistical = StatisticalOutlierRemoval(points, 2, 0);
+    EXPECT_EQ(statistical.size(), points.size());
+}
+
+}  // namespace Saiga
+
+int main()
+{
+    Saiga::initSaigaSampleNoWindow();
+    testing::InitGoogleTest();
+
+    return RUN_ALL_TESTS();
+}
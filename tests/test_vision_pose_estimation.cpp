@@ -111,3 +111,47 @@ TEST(PoseEstimation, Sim3)
         test.TestBasic();
     }
 }
+
+TEST(PoseEstimation, RobustBatch)
+{
+    using T = double;
+    StereoCamera4Base<T> K(458.654, 457.296, 367.215, 248.375, 0, 50);
+
+    // Frames with noise, outliers and mixed mono/stereo observations
+    std::vector<PoseOptimizationScene<T>> scenes(16);
+    for (auto& scene : scenes)
+    {
+        scene.K    = K;
+        scene.pose = Random::randomSE3();
+        for (int i = 0; i < 200; ++i)
+        {
+            ObsBase<T> o;
+            o.ip     = Vec2(Random::sampleDouble(0, K.cx * 2), Random::sampleDouble(0, K.cy * 2));
+            double d = Random::sampleDouble(1, 5);
+            Vec3 wp  = scene.pose.inverse() * K.unproject(o.ip, d);
+            o.ip += Vec2(Random::gaussRand(0, 0.5), Random::gaussRand(0, 0.5));
+            if (Random::sampleDouble(0, 1) < 0.3) o.depth = d;
+            if (Random::sampleDouble(0, 1) < 0.1) o.ip = Vec2(Random::sampleDouble(0, K.cx * 2), o.ip(1));
+            scene.obs.push_back(o);
+            scene.wps.push_back(wp);
+        }
+        scene.outlier.resize(scene.obs.size(), false);
+        scene.pose = Random::JitterPose(scene.pose, 0.04, 0.01);
+    }
+
+    RobustPoseOptimization<T, false> rpo;
+
+    auto batched         = scenes;
+    auto batched_inliers = rpo.optimizePoseRobust(batched, 4);
+    ASSERT_EQ(batched_inliers.size(), scenes.size());
+
+    for (int i = 0; i < (int)scenes.size(); ++i)
+    {
+        auto ref    = scenes[i];
+        int inliers = rpo.optimizePoseRobust(ref);
+
+        EXPECT_EQ(batched_inliers[i], inliers);
+        EXPECT_EQ(batched[i].outlier, ref.outlier);
+        EXPECT_EQ(batched[i].pose.params(), ref.pose.params());
+    }
+}
@@ -71,6 +71,17 @@ class PoseGraphOptimizationTest
         ExpectClose(scene1.chi2(), scene2.chi2(), 1e-5);
     }
 
+    void testParallel()
+    {
+        opoptions.numThreads = 1;
+        auto scene1          = solveRec();
+        opoptions.numThreads = 8;
+        auto scene2          = solveRec();
+
+        // The accumulation order does not depend on the number of threads
+        EXPECT_EQ(scene1.chi2(), scene2.chi2());
+    }
+
     void buildScene(bool with_scale_drift)
     {
         if (with_scale_drift)
@@ -159,4 +170,14 @@ TEST(PoseGraphOptimization, LoopClosingSim3)
     }
 }
 
+TEST(PoseGraphOptimization, Parallel)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        PoseGraphOptimizationTest test;
+        test.buildScene(i == 1);
+        test.testParallel();
+    }
+}
+
 }  // namespace Saiga
@@ -121,6 +121,24 @@ TEST(RecursiveLinearSolver, SparseBlock)
         BType residual = A * x - b;
         EXPECT_LE(expand(residual).squaredNorm(), 1e-10);
     }
+
+    {
+        // Solve recursive supernodal ldlt
+        Eigen::Recursive::RecursiveSupernodalLDLT<AType, Eigen::Upper> sn_ldlt;
+        sn_ldlt.compute(A);
+        ASSERT_EQ(sn_ldlt.info(), Eigen::Success);
+        BType x        = sn_ldlt.solve(b);
+        BType residual = A * x - b;
+        EXPECT_LE(expand(residual).squaredNorm(), 1e-10);
+
+        // Second factorization with the cached ordering
+        AType A2 = A;
+        A2.coeffRef(0, 0).get().diagonal().array() += 1;
+        sn_ldlt.factorize(A2);
+        x        = sn_ldlt.solve(b);
+        residual = A2 * x - b;
+        EXPECT_LE(expand(residual).squaredNorm(), 1e-10);
+    }
 }
 
 TEST(RecursiveLinearSolver, BA)
@@ -265,6 +283,17 @@ TEST(RecursiveLinearSolver, BA)
         ExpectCloseRelative(ref_x2, expand(x.v), 1e-10, false);
     }
 
+    {
+        setZero(x);
+        Eigen::Recursive::LinearSolverOptions lops;
+        lops.solverType = Eigen::Recursive::LinearSolverOptions::SolverType::Direct;
+        lops.supernodal = false;
+        solver.analyzePattern(A, lops);
+        solver.solve(A, x, b, lops);
+        ExpectCloseRelative(ref_x1, expand(x.u), 1e-10, false);
+        ExpectCloseRelative(ref_x2, expand(x.v), 1e-10, false);
+    }
+
     {
         setZero(x);
         Eigen::Recursive::LinearSolverOptions lops;
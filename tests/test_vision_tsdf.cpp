@@ -5,8 +5,11 @@
  */
 #include "saiga/core/Core.h"
 #include "saiga/core/model/model_loader_ply.h"
+#include "saiga/vision/reconstruction/IncrementalSurfaceExtractor.h"
 #include "saiga/vision/reconstruction/MarchingCubes.h"
 #include "saiga/vision/reconstruction/SparseTSDF.h"
+#include "saiga/vision/reconstruction/SparseTSDFStreamer.h"
+#include "saiga/vision/reconstruction/TSDFRaycaster.h"
 #include "saiga/vision/reconstruction/VoxelFusion.h"
 
 #include "gtest/gtest.h"
@@ -50,11 +53,9 @@ std::shared_ptr<SparseTSDF> CreateSphereTSDF(vec3 position, float radius, float
                 for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
                 {
                     vec3 global_pos = tsdf->GlobalPosition(id, i, j, k);
-                    auto& cell      = b.data[i][j][k];
 
-                    float d       = (global_pos - position).norm() - radius;
-                    cell.distance = d;
-                    cell.weight   = 1;
+                    float d = (global_pos - position).norm() - radius;
+                    b.Set(i, j, k, {d, 1});
                 }
             }
         }
@@ -107,6 +108,248 @@ TEST(TSDF, Create)
 //    }
 }
 
+TEST(TSDF, IncrementalExtraction)
+{
+    auto tsdf = CreateSphereTSDF(vec3(0, 0, 0), 0.5, 0.05, 1);
+
+    auto full_triangles = [&]() {
+        int n = 0;
+        for (auto& v : tsdf->ExtractSurface(0, 4, 0, 1, false)) n += v.size();
+        return n;
+    };
+
+    IncrementalSurfaceExtractor extractor(tsdf.get(), 0, 4, 0);
+    EXPECT_EQ(extractor.Update(1), tsdf->current_blocks);
+    EXPECT_EQ(extractor.NumTriangles(), full_triangles());
+    EXPECT_EQ(extractor.CompactMesh().NumFaces(), full_triangles());
+
+    // Nothing changed
+    EXPECT_EQ(extractor.Update(1), 0);
+
+    // Grow the sphere inside one block
+    UnifiedMesh before = extractor.Mesh();
+    ivec3 index        = tsdf->GetBlockIndex(vec3(0.5, 0, 0));
+    int id             = tsdf->GetBlockId(index);
+    ASSERT_GE(id, 0);
+    auto& grow = tsdf->blocks[id];
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 8; ++j)
+            for (int k = 0; k < 8; ++k) grow.SetDistance(i, j, k, grow.Distance(i, j, k) - 0.02);
+    tsdf->SetDirty(id);
+
+    EXPECT_LE(extractor.Update(1), 8);
+    EXPECT_EQ(extractor.NumTriangles(), full_triangles());
+    EXPECT_EQ(extractor.CompactMesh().NumFaces(), full_triangles());
+
+    // The triangles of all other blocks are unchanged
+    std::vector<bool> changed(extractor.Mesh().NumFaces(), false);
+    for (auto r : extractor.ChangedTriangles())
+    {
+        for (int t = r.first; t < r.first + r.second; ++t) changed[t] = true;
+    }
+    for (int t = 0; t < before.NumFaces(); ++t)
+    {
+        if (changed[t]) continue;
+        EXPECT_EQ(before.triangles[t], extractor.Mesh().triangles[t]);
+        EXPECT_EQ(before.position[3 * t], extractor.Mesh().position[3 * t]);
+    }
+
+    // Erased blocks don't leave triangles behind
+    index = tsdf->GetBlockIndex(vec3(0, 0.5, 0));
+    ASSERT_GE(tsdf->GetBlockId(index), 0);
+    EXPECT_TRUE(tsdf->EraseBlock(index));
+    extractor.Update(1);
+    EXPECT_EQ(extractor.NumTriangles(), full_triangles());
+    EXPECT_EQ(extractor.CompactMesh().NumFaces(), full_triangles());
+}
+
+TEST(TSDF, IntegrationKernels)
+{
+    int w = 160;
+    int h = 120;
+    TemplatedImage<float> depth(h, w);
+    for (auto y : depth.rowRange())
+    {
+        for (auto x : depth.colRange())
+        {
+            depth(y, x) = 0.8 + 0.001 * x + 0.05 * sin(y * 0.1);
+        }
+    }
+    // Invalid depth values
+    for (auto x : depth.colRange())
+    {
+        depth(60, x) = 0;
+    }
+
+    auto fuse = [&](IntegrationKernel kernel) {
+        FusionScene scene;
+        scene.K                         = IntrinsicsPinholed(150, 150, 80, 60, 0);
+        scene.dis.k1                    = 0.05;
+        scene.params.hash_size          = 100000;
+        scene.params.verbose            = false;
+        scene.params.integration_kernel = kernel;
+        for (int i = 0; i < 2; ++i)
+        {
+            FusionImage fi;
+            fi.depthMap = depth.getConstImageView();
+            fi.V        = SE3(Quat::Identity(), Vec3(0.01 * i, 0.005 * i, 0));
+            scene.images.push_back(fi);
+        }
+        scene.Preprocess();
+        scene.AnalyseSparseStructure();
+        scene.ComputeWeight();
+        scene.Integrate();
+        return scene.tsdf;
+    };
+
+    auto ref = fuse(IntegrationKernel::Scalar);
+    EXPECT_GT(ref->NumNonZeroVoxels(), 0);
+
+    for (auto kernel : {IntegrationKernel::AVX2, IntegrationKernel::AVX512})
+    {
+        if (!IntegrationKernelSupported(kernel)) continue;
+        auto tsdf = fuse(kernel);
+        ASSERT_EQ(tsdf->current_blocks, ref->current_blocks);
+
+        // The vectorized kernels use single precision. Voxels which project exactly on a pixel boundary can
+        // therefore be updated differently.
+        int mismatches  = 0;
+        double max_diff = 0;
+        for (int b = 0; b < ref->current_blocks; ++b)
+        {
+            auto& b1 = ref->blocks[b];
+            auto* b2 = tsdf->GetBlock(b1.index);
+            ASSERT_TRUE(b2);
+            for (int i = 0; i < 8; ++i)
+                for (int j = 0; j < 8; ++j)
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        auto v1 = b1.Get(i, j, k);
+                        auto v2 = b2->Get(i, j, k);
+                        if (std::abs(v1.weight - v2.weight) > 1e-4)
+                        {
+                            mismatches++;
+                            continue;
+                        }
+                        if (v1.weight > 0) max_diff = std::max<double>(max_diff, std::abs(v1.distance - v2.distance));
+                    }
+        }
+        EXPECT_LT(mismatches, ref->NumNonZeroVoxels() / 1000 + 1);
+        EXPECT_LT(max_diff, 1e-3);
+    }
+}
+
+TEST(TSDF, IntegrationDirtyBlocks)
+{
+    int w = 160;
+    int h = 120;
+    TemplatedImage<float> depth(h, w);
+    depth.getImageView().set(0.8);
+    TemplatedImage<float> no_depth(h, w);
+    no_depth.getImageView().set(0);
+
+    for (auto kernel : {IntegrationKernel::Scalar, IntegrationKernel::AVX2, IntegrationKernel::AVX512})
+    {
+        if (!IntegrationKernelSupported(kernel)) continue;
+        FusionScene scene;
+        scene.K                         = IntrinsicsPinholed(150, 150, 80, 60, 0);
+        scene.params.hash_size          = 100000;
+        scene.params.verbose            = false;
+        scene.params.integration_kernel = kernel;
+
+        FusionImage fi;
+        fi.depthMap = depth.getConstImageView();
+        fi.V        = SE3();
+        scene.images.push_back(fi);
+        scene.Preprocess();
+        scene.AnalyseSparseStructure();
+        scene.ComputeWeight();
+        scene.Integrate();
+        EXPECT_GT(scene.tsdf->TakeDirtyBlocks().size(), 0);
+
+        // An image without valid depth doesn't change any voxel
+        scene.images[0].depthMap = no_depth.getConstImageView();
+        scene.Integrate();
+        EXPECT_GT(scene.images[0].visible_blocks.size(), 0);
+        EXPECT_EQ(scene.tsdf->TakeDirtyBlocks().size(), 0);
+    }
+}
+
+TEST(TSDF, VoxelLayout)
+{
+    using ReferenceGrid = BlockSparseGrid<TSDFVoxel, 8, VoxelLayoutAoS<TSDFVoxel, 8>>;
+    using CompactLayout = VoxelLayoutSoA<TSDFVoxel, 8, Eigen::half, uint8_t, 4>;
+    using CompactGrid   = BlockSparseGrid<TSDFVoxel, 8, CompactLayout>;
+    static_assert(sizeof(ReferenceGrid::VoxelBlock::data) == 512 * 8, "Incorrect Voxel Size");
+    static_assert(sizeof(SparseTSDF::VoxelBlock::data) == 512 * 8, "Incorrect Voxel Size");
+    static_assert(sizeof(CompactGrid::VoxelBlock::data) == 512 * 3, "Incorrect Voxel Size");
+
+    ReferenceGrid ref(0.01, 10, 1000);
+    SparseTSDF tsdf(0.01, 10, 1000);
+    CompactGrid grid(0.01, 10, 1000);
+    Random::setSeed(4395);
+
+    // The weights are multiples of 1/WEIGHT_SCALE and can therefore be stored exactly in the compact layout.
+    auto sphere = CreateSphereTSDF(vec3(0, 0, 0), 0.5, 0.05, 1);
+    for (int b = 0; b < 50; ++b)
+    {
+        auto& sb = sphere->blocks[b];
+        auto* rb = ref.InsertBlock(sb.index);
+        auto* tb = tsdf.InsertBlock(sb.index);
+        auto* cb = grid.InsertBlock(sb.index);
+        EXPECT_TRUE(tb->Empty());
+        EXPECT_TRUE(cb->Empty());
+        for (int i = 0; i < 8; ++i)
+        {
+            for (int j = 0; j < 8; ++j)
+            {
+                for (int k = 0; k < 8; ++k)
+                {
+                    auto v            = sb.Get(i, j, k);
+                    v.weight          = Random::uniformInt(0, 240) / 4.0f;
+                    rb->data[i][j][k] = v;
+                    tb->Set(i, j, k, v);
+                    cb->Set(i, j, k, v);
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < 50; ++b)
+    {
+        auto& rb = ref.blocks[b];
+        auto* tb = tsdf.GetBlock(rb.index);
+        auto* cb = grid.GetBlock(rb.index);
+        ASSERT_TRUE(tb);
+        ASSERT_TRUE(cb);
+        EXPECT_FALSE(cb->Empty());
+        for (int i = 0; i < 8; ++i)
+        {
+            for (int j = 0; j < 8; ++j)
+            {
+                for (int k = 0; k < 8; ++k)
+                {
+                    auto v = rb.data[i][j][k];
+
+                    // The float SoA layout is lossless
+                    EXPECT_EQ(tb->Distance(i, j, k), v.distance);
+                    EXPECT_EQ(tb->Weight(i, j, k), v.weight);
+
+                    // fp16 has an 11 bit mantissa
+                    EXPECT_NEAR(cb->Distance(i, j, k), v.distance, std::abs(v.distance) * 1e-3);
+                    EXPECT_EQ(cb->Weight(i, j, k), v.weight);
+                }
+            }
+        }
+        EXPECT_EQ(grid.GetVoxel(rb.index * 8).distance, cb->Distance(0, 0, 0));
+        EXPECT_EQ(tsdf.GetVoxel(rb.index * 8).weight, rb.data[0][0][0].weight);
+    }
+
+    grid.EraseBlock(ref.blocks[0].index);
+    EXPECT_EQ(grid.GetBlock(ref.blocks[0].index), nullptr);
+    EXPECT_EQ(grid.Size(), 49);
+}
+
 TEST(TSDF, InsertRemoveBlock)
 {
     {
@@ -145,6 +388,83 @@ TEST(TSDF, InsertRemoveBlock)
     }
 }
 
+TEST(TSDF, ParallelInsert)
+{
+    // Start with a tiny capacity so that the block storage grows during the parallel insertion.
+    SparseTSDF tsdf(1, 1, 1000);
+
+    int n = 40;
+#pragma omp parallel for num_threads(8)
+    for (int i = 0; i < n * n * n * 4; ++i)
+    {
+        int j = i % (n * n * n);
+        ivec3 id(j % n, (j / n) % n, j / (n * n));
+        auto* block = tsdf.InsertBlockLock(id);
+        EXPECT_EQ(block->index, id);
+    }
+
+    EXPECT_EQ(tsdf.current_blocks, n * n * n);
+    EXPECT_EQ(tsdf.NumBlocksInRect(iRect<3>(ivec3(0, 0, 0), ivec3(n, n, n))), n * n * n);
+    for (int z = 0; z < n; ++z)
+    {
+        for (int y = 0; y < n; ++y)
+        {
+            for (int x = 0; x < n; ++x)
+            {
+                EXPECT_TRUE(tsdf.GetBlock({x, y, z}));
+            }
+        }
+    }
+}
+
+TEST(TSDF, Streaming)
+{
+    SparseTSDF tsdf(1, 1000, 1000);
+
+    int n = 12;
+    for (int z = 0; z < n; ++z)
+    {
+        for (int y = 0; y < n; ++y)
+        {
+            for (int x = 0; x < n; ++x)
+            {
+                auto* block = tsdf.InsertBlock({x, y, z});
+                // Every second block stays empty
+                if ((x + y + z) % 2 == 0) continue;
+                for (int k = 0; k < 8; ++k)
+                {
+                    block->Set(x % 8, y % 8, k, {float(x + y * n + z * n * n), 1});
+                }
+            }
+        }
+    }
+    SparseTSDF ref = tsdf;
+
+    TSDFStreamingParams params;
+    params.file               = "tsdf_streaming_test.bin";
+    params.ram_budget_mb      = 100 * sizeof(SparseTSDF::VoxelBlock) / (1000.0 * 1000.0);
+    params.working_set_radius = 8 * 2;
+
+    SparseTSDFStreamer streamer(&tsdf, params);
+    streamer.UpdateWorkingSet(vec3(0, 0, 0));
+    EXPECT_EQ(tsdf.current_blocks, streamer.MaxResidentBlocks());
+    EXPECT_GT(streamer.IOStatistics().evicted_blocks, 0);
+    EXPECT_GT(streamer.IOStatistics().dropped_blocks, 0);
+    // The blocks around the camera are still resident
+    EXPECT_GE(tsdf.GetBlockId({0, 0, 0}), 0);
+
+    // The evicted blocks are loaded on access. The dropped (empty) blocks are inserted again.
+    for (int i = 0; i < ref.current_blocks; ++i)
+    {
+        auto& b1 = ref.blocks[i];
+        auto* b2 = tsdf.InsertBlock(b1.index);
+        ASSERT_TRUE(b2);
+        EXPECT_EQ(b1.index, b2->index);
+        EXPECT_EQ(memcmp(&b1.data, &b2->data, sizeof(b1.data)), 0);
+    }
+    EXPECT_EQ(tsdf.current_blocks, ref.current_blocks);
+}
+
 TEST(TSDF, Crop)
 {
     Random::setSeed(394765346);
@@ -233,16 +553,16 @@ TEST(TSDF, TrilinearInterpolation)
 
     tsdf.SetForAll(0, 1);
 
-    b->data[0][0][0].distance = 0;
-    b->data[0][0][1].distance = 0;
-    b->data[0][1][0].distance = 0;
-    b->data[0][1][1].distance = 0;
+    b->SetDistance(0, 0, 0, 0);
+    b->SetDistance(0, 0, 1, 0);
+    b->SetDistance(0, 1, 0, 0);
+    b->SetDistance(0, 1, 1, 0);
 
-    b->data[1][0][0].distance = 1;
-    b->data[1][0][1].distance = 1;
-    b->data[1][1][0].distance = 1;
-    b->data[1][1][1].distance = 1;
-    b->data[3][3][3].weight   = 0;
+    b->SetDistance(1, 0, 0, 1);
+    b->SetDistance(1, 0, 1, 1);
+    b->SetDistance(1, 1, 0, 1);
+    b->SetDistance(1, 1, 1, 1);
+    b->SetWeight(3, 3, 3, 0);
 
     SparseTSDF::Voxel v;
 
@@ -342,6 +662,89 @@ TEST(TSDF, Trace)
     rgb_image2.save("tsdf_trace2.png");
 }
 
+TEST(TSDF, Raycast)
+{
+    int w = 80;
+    int h = 60;
+    TemplatedImage<float> depth(h, w);
+    ArrayImage<Vec3> normals(h, w);
+
+    SE3 pose(Quat::Identity(), Vec3(0.1, 0, -2));
+    IntrinsicsPinholed K(60, 60, w / 2, h / 2, 0);
+    RaycastTSDF(*test->tsdf, pose, K, depth.getImageView(), normals);
+
+    std::vector<double> errors;
+    int mismatches = 0;
+    for (auto y : depth.rowRange())
+    {
+        for (auto x : depth.colRange())
+        {
+            Vec3 dir = K.unproject(Vec2(x, y), 1).normalized();
+            dir      = pose.so3() * dir;
+
+            float t = test->tsdf->RaySurfaceIntersection<2>(pose.translation().cast<float>(), dir.cast<float>(), 0,
+                                                            3, test->tsdf->voxel_size * 3, 0);
+            // The reference uses a fixed step size and can miss the surface at the silhouette.
+            mismatches += (t < 3) != (depth(y, x) > 0);
+            if (depth(y, x) == 0)
+            {
+                EXPECT_FALSE(normals(y, x).allFinite());
+                continue;
+            }
+
+            Vec3 p_world = pose * K.unproject(Vec2(x, y), depth(y, x));
+            errors.push_back(std::abs(test->sphere.sdf(p_world.cast<float>())));
+
+            Vec3 n_ref = pose.so3().inverse() * (p_world - test->sphere.pos.cast<double>()).normalized();
+            EXPECT_GT(normals(y, x).dot(n_ref), 0.95);
+        }
+    }
+
+    EXPECT_GT(errors.size(), 500);
+    EXPECT_LT(mismatches, 10);
+    Statistics stats(errors);
+    EXPECT_LT(stats.max, 0.002);
+    EXPECT_LT(stats.mean, 0.001);
+}
+
+TEST(TSDF, RaycastStreamed)
+{
+    int w = 80;
+    int h = 60;
+    SE3 pose(Quat::Identity(), Vec3(0.1, 0, -2));
+    IntrinsicsPinholed K(60, 60, w / 2, h / 2, 0);
+
+    TemplatedImage<float> ref_depth(h, w);
+    RaycastTSDF(*test->tsdf, pose, K, ref_depth.getImageView(), {});
+
+    SparseTSDF tsdf = *test->tsdf;
+    TSDFStreamingParams params;
+    params.file               = "tsdf_raycast_streaming_test.bin";
+    params.ram_budget_mb      = 20 * sizeof(SparseTSDF::VoxelBlock) / (1000.0 * 1000.0);
+    params.working_set_radius = 0.1;
+
+    // Evict almost all blocks of the sphere
+    SparseTSDFStreamer streamer(&tsdf, params);
+    streamer.UpdateWorkingSet(vec3(100, 100, 100));
+    EXPECT_EQ(tsdf.current_blocks, streamer.MaxResidentBlocks());
+
+    // The rays load the evicted blocks -> same result as without streaming
+    TemplatedImage<float> depth(h, w);
+    RaycastTSDF(tsdf, pose, K, depth.getImageView(), {});
+    EXPECT_GT(streamer.IOStatistics().loaded_blocks, 0);
+
+    int num_valid = 0;
+    for (auto y : depth.rowRange())
+    {
+        for (auto x : depth.colRange())
+        {
+            EXPECT_EQ(depth(y, x), ref_depth(y, x));
+            num_valid += depth(y, x) > 0;
+        }
+    }
+    EXPECT_GT(num_valid, 500);
+}
+
 }  // namespace Saiga
 
 int main()
@@ -130,7 +130,7 @@ TEST(TSDF, LoadStore)
     test->scene.tsdf->Save("tsdf.dat");
     test2.Load("tsdf.dat");
     EXPECT_EQ(test2, *test->scene.tsdf);
-    test2.blocks[12].data[5][3][1].distance = 10;
+    test2.blocks[12].SetDistance(5, 3, 1, 10);
     EXPECT_TRUE(!(test2 == *test->scene.tsdf));
 
 